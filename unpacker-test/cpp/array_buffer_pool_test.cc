@@ -0,0 +1,47 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "array_buffer_pool.h"
+
+#include "gtest/gtest.h"
+
+namespace {
+
+const uint32_t kBufferSize = 1024;
+
+}  // namespace
+
+TEST(ArrayBufferPoolTest, AcquireNewBuffer) {
+  ArrayBufferPool pool(4 * kBufferSize);
+  pp::VarArrayBuffer array_buffer = pool.Acquire(kBufferSize);
+  EXPECT_EQ(kBufferSize, array_buffer.ByteLength());
+  EXPECT_EQ(0, pool.pooled_bytes());
+}
+
+TEST(ArrayBufferPoolTest, ReuseReleasedBuffer) {
+  ArrayBufferPool pool(4 * kBufferSize);
+  pp::VarArrayBuffer array_buffer = pool.Acquire(kBufferSize);
+  pool.Release(array_buffer);
+  EXPECT_EQ(kBufferSize, pool.pooled_bytes());
+
+  // A buffer with a different size is not reused.
+  EXPECT_EQ(kBufferSize / 2, pool.Acquire(kBufferSize / 2).ByteLength());
+  EXPECT_EQ(kBufferSize, pool.pooled_bytes());
+
+  pp::VarArrayBuffer reused_array_buffer = pool.Acquire(kBufferSize);
+  EXPECT_TRUE(array_buffer == reused_array_buffer);
+  EXPECT_EQ(0, pool.pooled_bytes());
+}
+
+TEST(ArrayBufferPoolTest, ReleaseAboveLimit) {
+  ArrayBufferPool pool(kBufferSize);
+  pp::VarArrayBuffer first_array_buffer = pool.Acquire(kBufferSize);
+  pp::VarArrayBuffer second_array_buffer = pool.Acquire(kBufferSize);
+  pool.Release(first_array_buffer);
+  pool.Release(second_array_buffer);
+  EXPECT_EQ(kBufferSize, pool.pooled_bytes());
+
+  pool.Clear();
+  EXPECT_EQ(0, pool.pooled_bytes());
+}
@@ -0,0 +1,68 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "compressibility.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// Returns data that deflate can't compress.
+std::string CreateRandomData(size_t size) {
+  std::string data(size, '\0');
+  uint32_t state = 12345;
+  for (size_t i = 0; i < size; ++i) {
+    state = state * 1103515245 + 12345;
+    data[i] = static_cast<char>(state >> 16);
+  }
+  return data;
+}
+
+std::string CreateText(size_t size) {
+  std::string text;
+  for (int line = 0; text.size() < size; ++line)
+    text += "Line " + std::string(1, 'a' + line % 26) + " of some text.\n";
+  return text.substr(0, size);
+}
+
+bool IsIncompressible(const std::string& data) {
+  return compressibility::IsIncompressible(data.data(), data.size());
+}
+
+}  // namespace
+
+TEST(CompressibilityTest, TextIsCompressible) {
+  EXPECT_FALSE(IsIncompressible(CreateText(compressibility::kSampleSize)));
+}
+
+TEST(CompressibilityTest, RandomDataIsIncompressible) {
+  EXPECT_TRUE(IsIncompressible(CreateRandomData(compressibility::kSampleSize)));
+  // Only the sample is looked at.
+  EXPECT_TRUE(IsIncompressible(
+      CreateRandomData(compressibility::kSampleSize) +
+      CreateText(compressibility::kSampleSize)));
+}
+
+TEST(CompressibilityTest, RepeatedRandomDataIsCompressible) {
+  // The bytes look random, but deflate finds the repetitions.
+  std::string data = CreateRandomData(compressibility::kSampleSize / 4);
+  EXPECT_FALSE(IsIncompressible(data + data + data + data));
+}
+
+TEST(CompressibilityTest, CompressedFormatsAreIncompressible) {
+  std::string text = CreateText(compressibility::kSampleSize);
+  EXPECT_TRUE(IsIncompressible("\xff\xd8\xff\xe0" + text));         // JPEG.
+  EXPECT_TRUE(IsIncompressible("PK\x03\x04" + text));               // Zip.
+  EXPECT_TRUE(IsIncompressible(std::string("\0\0\0\x18", 4) +       // MP4.
+                               "ftypmp42" + text));
+  EXPECT_FALSE(IsIncompressible("PK\x05\x06" + text));
+}
+
+TEST(CompressibilityTest, ShortDataIsCompressible) {
+  EXPECT_FALSE(IsIncompressible(
+      CreateRandomData(compressibility::kMinimumSampleSize - 1)));
+  EXPECT_FALSE(IsIncompressible(""));
+}
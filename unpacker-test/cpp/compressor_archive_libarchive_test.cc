@@ -0,0 +1,193 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "compressor_archive_libarchive.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "fake_lib_archive.h"
+#include "gtest/gtest.h"
+#include "ppapi/cpp/var_array_buffer.h"
+#include "request.h"
+#include "stats.h"
+
+namespace {
+
+// Fake CompressorStream that serves the data of the entries in the order they
+// are added. The archive itself is collected by fake_lib_archive.
+class FakeCompressorStream : public CompressorStream {
+ public:
+  FakeCompressorStream()
+      : read_offset_(0), rewind_count_(0), fail_reads_(false) {}
+
+  virtual int64_t Write(int64_t bytes_to_write,
+                        const pp::VarArrayBuffer& buffer) {
+    return bytes_to_write;
+  }
+
+  virtual pp::VarArrayBuffer AcquireWriteBuffer(uint32_t size) {
+    return pp::VarArrayBuffer(size);
+  }
+
+  virtual void WriteChunkDone(int64_t write_bytes) {}
+
+  virtual void SetWriteOffset(int64_t offset) {}
+
+  virtual int64_t Flush() { return 0; }
+
+  virtual void StartEntry(int64_t entry_size) {
+    ASSERT_FALSE(entries_.empty());
+    current_entry_ = entries_.front();
+    entries_.pop_front();
+    ASSERT_EQ(static_cast<int64_t>(current_entry_.size()), entry_size);
+    read_offset_ = 0;
+  }
+
+  virtual void RewindEntry() {
+    read_offset_ = 0;
+    ++rewind_count_;
+  }
+
+  virtual void SetNextEntryData(const pp::VarArrayBuffer& buffer,
+                                int64_t offset) {}
+
+  virtual int64_t Read(int64_t bytes_to_read, char* destination_buffer) {
+    const char* data = NULL;
+    int64_t read_bytes = ReadInPlace(bytes_to_read, &data);
+    if (read_bytes > 0)
+      memcpy(destination_buffer, data, read_bytes);
+    return read_bytes;
+  }
+
+  virtual int64_t ReadInPlace(int64_t bytes_to_read, const char** data) {
+    if (fail_reads_)
+      return -1;
+    int64_t read_bytes = std::min(
+        bytes_to_read,
+        static_cast<int64_t>(current_entry_.size()) - read_offset_);
+    *data = current_entry_.data() + read_offset_;
+    read_offset_ += read_bytes;
+    return read_bytes;
+  }
+
+  virtual void ReadFileChunkDone(int64_t offset,
+                                 int64_t read_bytes,
+                                 const pp::VarArrayBuffer& buffer) {}
+
+  virtual int64_t ReadArchive(int64_t offset,
+                              int64_t length,
+                              char* destination_buffer) {
+    return -1;
+  }
+
+  virtual void ReadArchiveChunkDone(int64_t read_bytes,
+                                    const pp::VarArrayBuffer& buffer) {}
+
+  // Queues the data of the next entry with data.
+  void AddEntryData(const std::string& data) { entries_.push_back(data); }
+
+  void set_fail_reads(bool fail_reads) { fail_reads_ = fail_reads; }
+
+  // The number of RewindEntry calls.
+  int rewind_count() const { return rewind_count_; }
+
+ private:
+  std::deque<std::string> entries_;
+  std::string current_entry_;
+  int64_t read_offset_;
+  int rewind_count_;
+  bool fail_reads_;
+};
+
+}  // namespace
+
+// Tests the deduplication of the files of tar archives.
+class CompressorArchiveLibarchiveTest : public testing::Test {
+ protected:
+  CompressorArchiveLibarchiveTest() : archive(NULL) {}
+
+  virtual void SetUp() {
+    fake_lib_archive_config::ResetVariables();
+    archive = new CompressorArchiveLibarchive(
+        &stream, request::format::kTar, -1 /* compression_level */,
+        true /* deduplicate */);
+    archive->set_stats(&stats);
+    ASSERT_TRUE(archive->CreateArchive());
+  }
+
+  virtual void TearDown() { delete archive; }
+
+  // Adds a file with data to the archive.
+  void AddFile(const std::string& pathname, const std::string& data) {
+    stream.AddEntryData(data);
+    archive->AddToArchive(pathname, data.size(), 0 /* modification_time */,
+                          false /* is_directory */);
+  }
+
+  FakeCompressorStream stream;
+  Stats stats;
+  CompressorArchiveLibarchive* archive;
+};
+
+TEST_F(CompressorArchiveLibarchiveTest, SameSizeFilesAreWritten) {
+  AddFile("a", "abcd");
+  EXPECT_EQ(0, stream.rewind_count());
+  AddFile("b", "abce");
+  AddFile("c", "xyz");
+
+  // Only b is hashed before its header, then read again to be written.
+  EXPECT_EQ(1, stream.rewind_count());
+  const std::vector<fake_lib_archive_config::WrittenEntry>& entries =
+      fake_lib_archive_config::written_entries;
+  ASSERT_EQ(3u, entries.size());
+  EXPECT_EQ("a", entries[0].pathname);
+  EXPECT_EQ("abcd", entries[0].data);
+  EXPECT_EQ("b", entries[1].pathname);
+  EXPECT_EQ(4, entries[1].size);
+  EXPECT_EQ("", entries[1].hardlink);
+  EXPECT_EQ("abce", entries[1].data);
+  EXPECT_EQ("xyz", entries[2].data);
+  EXPECT_FALSE(fake_lib_archive_config::archive_write_failed);
+  EXPECT_EQ(0, stats.Get(Stats::ENTRIES_DEDUPLICATED));
+}
+
+TEST_F(CompressorArchiveLibarchiveTest, DuplicatesAreHardLinks) {
+  AddFile("a", "abcd");
+  AddFile("b", "abce");
+  AddFile("c", "abcd");
+  AddFile("d", "abce");
+
+  const std::vector<fake_lib_archive_config::WrittenEntry>& entries =
+      fake_lib_archive_config::written_entries;
+  ASSERT_EQ(4u, entries.size());
+  // A hard link has no data.
+  EXPECT_EQ("c", entries[2].pathname);
+  EXPECT_EQ("a", entries[2].hardlink);
+  EXPECT_EQ(0, entries[2].size);
+  EXPECT_EQ("", entries[2].data);
+  EXPECT_EQ("d", entries[3].pathname);
+  EXPECT_EQ("b", entries[3].hardlink);
+  EXPECT_EQ(0, entries[3].size);
+  EXPECT_EQ("", entries[3].data);
+  EXPECT_FALSE(fake_lib_archive_config::archive_write_failed);
+
+  EXPECT_EQ(2, stats.Get(Stats::ENTRIES_DEDUPLICATED));
+  EXPECT_EQ(8, stats.Get(Stats::BYTES_DEDUPLICATED));
+}
+
+TEST_F(CompressorArchiveLibarchiveTest, HashReadFailureFailsArchive) {
+  AddFile("a", "abcd");
+  stream.set_fail_reads(true);
+  AddFile("b", "abcd");
+
+  // b is not written, not even as a hard link.
+  EXPECT_TRUE(fake_lib_archive_config::archive_write_failed);
+  EXPECT_EQ(NULL, archive->archive());
+  ASSERT_EQ(1u, fake_lib_archive_config::written_entries.size());
+  EXPECT_EQ(0, stats.Get(Stats::ENTRIES_DEDUPLICATED));
+}
@@ -0,0 +1,433 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "compressor_archive_parallel_zip.h"
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi/cpp/var_array_buffer.h"
+#include "ppapi_simple/ps_main.h"
+#include "zlib.h"
+
+namespace {
+
+// The general purpose flag of the entries followed by a data descriptor.
+const uint16_t kDataDescriptorFlag = 1 << 3;
+
+// Fake CompressorStream that serves the data of the entries in the order they
+// are added and collects the archive. The archive collected is also the one
+// read by ReadArchive, so it can be appended to.
+class FakeCompressorStream : public CompressorStream {
+ public:
+  FakeCompressorStream()
+      : write_offset_(-1), read_offset_(0), fail_reads_(false) {}
+
+  virtual int64_t Write(int64_t bytes_to_write,
+                        const pp::VarArrayBuffer& buffer) {
+    // Like JavaScript, the archive is truncated at the offset of the write.
+    if (write_offset_ >= 0)
+      archive_.resize(write_offset_);
+    write_offset_ = -1;
+    pp::VarArrayBuffer array_buffer(buffer);
+    const char* data = static_cast<const char*>(array_buffer.Map());
+    archive_.insert(archive_.end(), data, data + bytes_to_write);
+    array_buffer.Unmap();
+    return bytes_to_write;
+  }
+
+  virtual pp::VarArrayBuffer AcquireWriteBuffer(uint32_t size) {
+    return pp::VarArrayBuffer(size);
+  }
+
+  virtual void WriteChunkDone(int64_t write_bytes) {}
+
+  virtual void SetWriteOffset(int64_t offset) { write_offset_ = offset; }
+
+  virtual int64_t Flush() { return 0; }
+
+  virtual void StartEntry(int64_t entry_size) {
+    ASSERT_FALSE(entries_.empty());
+    current_entry_ = entries_.front();
+    entries_.pop_front();
+    ASSERT_EQ(static_cast<int64_t>(current_entry_.size()), entry_size);
+    read_offset_ = 0;
+  }
+
+  virtual void RewindEntry() { read_offset_ = 0; }
+
+  virtual void SetNextEntryData(const pp::VarArrayBuffer& buffer,
+                                int64_t offset) {}
+
+  virtual int64_t Read(int64_t bytes_to_read, char* destination_buffer) {
+    const char* data = NULL;
+    int64_t read_bytes = ReadInPlace(bytes_to_read, &data);
+    if (read_bytes > 0)
+      memcpy(destination_buffer, data, read_bytes);
+    return read_bytes;
+  }
+
+  virtual int64_t ReadInPlace(int64_t bytes_to_read, const char** data) {
+    if (fail_reads_)
+      return -1;
+    int64_t read_bytes = std::min(
+        bytes_to_read,
+        static_cast<int64_t>(current_entry_.size()) - read_offset_);
+    *data = current_entry_.data() + read_offset_;
+    read_offset_ += read_bytes;
+    return read_bytes;
+  }
+
+  virtual void ReadFileChunkDone(int64_t offset,
+                                 int64_t read_bytes,
+                                 const pp::VarArrayBuffer& buffer) {}
+
+  virtual int64_t ReadArchive(int64_t offset,
+                              int64_t length,
+                              char* destination_buffer) {
+    int64_t read_bytes = std::min(
+        length, static_cast<int64_t>(archive_.size()) - offset);
+    if (read_bytes > 0)
+      memcpy(destination_buffer, archive_.data() + offset, read_bytes);
+    return read_bytes;
+  }
+
+  virtual void ReadArchiveChunkDone(int64_t read_bytes,
+                                    const pp::VarArrayBuffer& buffer) {}
+
+  // Queues the data of the next entry with data.
+  void AddEntryData(const std::string& data) { entries_.push_back(data); }
+
+  void set_fail_reads(bool fail_reads) { fail_reads_ = fail_reads; }
+
+  const std::string& archive() const { return archive_; }
+
+  void set_archive(const std::string& archive) { archive_ = archive; }
+
+ private:
+  int64_t write_offset_;
+  std::deque<std::string> entries_;
+  std::string current_entry_;
+  int64_t read_offset_;
+  bool fail_reads_;
+  std::string archive_;
+};
+
+// An entry read back from the central directory of an archive.
+struct ZipEntry {
+  std::string pathname;
+  uint16_t flags;
+  uint16_t method;
+  uint32_t crc;
+  uint32_t compressed_size;
+  uint32_t external_attributes;
+  std::string data;  // Inflated.
+};
+
+uint16_t ReadUint16(const std::string& archive, size_t offset) {
+  return static_cast<uint8_t>(archive[offset]) |
+         (static_cast<uint8_t>(archive[offset + 1]) << 8);
+}
+
+uint32_t ReadUint32(const std::string& archive, size_t offset) {
+  return ReadUint16(archive, offset) |
+         (static_cast<uint32_t>(ReadUint16(archive, offset + 2)) << 16);
+}
+
+std::string Inflate(const std::string& deflated, size_t size) {
+  std::string data(size, '\0');
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  EXPECT_EQ(Z_OK, inflateInit2(&stream, -MAX_WBITS));
+  stream.next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(deflated.data()));
+  stream.avail_in = deflated.size();
+  stream.next_out = reinterpret_cast<Bytef*>(&data[0]);
+  stream.avail_out = data.size();
+  EXPECT_EQ(Z_STREAM_END, inflate(&stream, Z_FINISH));
+  EXPECT_EQ(0u, stream.avail_out);
+  inflateEnd(&stream);
+  return data;
+}
+
+// Parses the entries of an archive without zip64 records through its central
+// directory, checking their local headers on the way.
+std::vector<ZipEntry> ParseArchive(const std::string& archive) {
+  std::vector<ZipEntry> entries;
+  const size_t kEndSize = 22;
+  EXPECT_LE(kEndSize, archive.size());
+  if (archive.size() < kEndSize)
+    return entries;
+  size_t end = archive.size() - kEndSize;
+  EXPECT_EQ(0x06054b50u, ReadUint32(archive, end));
+  uint16_t entry_count = ReadUint16(archive, end + 10);
+  size_t offset = ReadUint32(archive, end + 16);
+
+  for (uint16_t i = 0; i < entry_count; ++i) {
+    EXPECT_EQ(0x02014b50u, ReadUint32(archive, offset));
+    ZipEntry entry;
+    entry.flags = ReadUint16(archive, offset + 8);
+    entry.method = ReadUint16(archive, offset + 10);
+    entry.crc = ReadUint32(archive, offset + 16);
+    entry.compressed_size = ReadUint32(archive, offset + 20);
+    uint32_t uncompressed_size = ReadUint32(archive, offset + 24);
+    uint16_t name_length = ReadUint16(archive, offset + 28);
+    uint16_t extra_length = ReadUint16(archive, offset + 30);
+    entry.external_attributes = ReadUint32(archive, offset + 38);
+    size_t local_header_offset = ReadUint32(archive, offset + 42);
+    entry.pathname = archive.substr(offset + 46, name_length);
+    offset += 46 + name_length + extra_length;
+
+    EXPECT_EQ(0x04034b50u, ReadUint32(archive, local_header_offset));
+    EXPECT_EQ(entry.method, ReadUint16(archive, local_header_offset + 8));
+    // Zip readers reject stored entries with a data descriptor, as they can't
+    // find their end.
+    if (entry.method == 0) {
+      EXPECT_EQ(0, entry.flags & kDataDescriptorFlag);
+    }
+    size_t data_offset = local_header_offset + 30 +
+                         ReadUint16(archive, local_header_offset + 26) +
+                         ReadUint16(archive, local_header_offset + 28);
+    std::string data = archive.substr(data_offset, entry.compressed_size);
+    entry.data = entry.method == 8 ? Inflate(data, uncompressed_size) : data;
+    entries.push_back(entry);
+  }
+  return entries;
+}
+
+uint32_t Crc(const std::string& data) {
+  return crc32(crc32(0L, Z_NULL, 0),
+               reinterpret_cast<const Bytef*>(data.data()), data.size());
+}
+
+// Returns data that deflate can't compress much.
+std::string CreateRandomData(size_t size) {
+  std::string data(size, '\0');
+  uint32_t state = 12345;
+  for (size_t i = 0; i < size; ++i) {
+    state = state * 1103515245 + 12345;
+    data[i] = static_cast<char>(state >> 16);
+  }
+  return data;
+}
+
+}  // namespace
+
+class CompressorArchiveParallelZipTest : public testing::Test {
+ protected:
+  CompressorArchiveParallelZipTest()
+      : worker_pool(pp::InstanceHandle(PSGetInstanceId()), 4),
+        archive(NULL) {}
+
+  virtual void SetUp() {
+    ASSERT_TRUE(worker_pool.Start());
+    CreateArchive(-1 /* compression_level */);
+  }
+
+  // Replaces the archive created by SetUp by an archive with
+  // compression_level.
+  void CreateArchive(int compression_level) {
+    delete archive;
+    archive = new CompressorArchiveParallelZip(&stream, &worker_pool, 4,
+                                               compression_level);
+    ASSERT_TRUE(archive->CreateArchive());
+  }
+
+  // Replaces the archive by an archive appending to the one written by the
+  // stream.
+  bool OpenArchive() {
+    delete archive;
+    archive = new CompressorArchiveParallelZip(&stream, &worker_pool, 4,
+                                               -1 /* compression_level */);
+    return archive->OpenArchive(stream.archive().size());
+  }
+
+  virtual void TearDown() { delete archive; }
+
+  void AddFile(const std::string& pathname, const std::string& data) {
+    if (!data.empty())
+      stream.AddEntryData(data);
+    archive->AddToArchive(pathname, data.size(), 0, false);
+  }
+
+  WorkerPool worker_pool;
+  FakeCompressorStream stream;
+  CompressorArchiveParallelZip* archive;
+};
+
+TEST_F(CompressorArchiveParallelZipTest, EntriesAreWrittenInOrder) {
+  std::vector<std::string> pathnames;
+  std::vector<std::string> contents;
+  archive->AddToArchive("dir", 0, 0, true);
+  for (int i = 0; i < 20; ++i) {
+    std::string content;
+    for (int j = 0; j <= i * 1000; ++j)
+      content += "entry " + std::string(1, 'a' + i % 26) + "\n";
+    pathnames.push_back("dir/file" + std::string(1, 'a' + i));
+    contents.push_back(content);
+  }
+  // An empty entry and an entry streamed instead of buffered.
+  pathnames.push_back("dir/empty");
+  contents.push_back("");
+  pathnames.push_back("dir/big");
+  contents.push_back(CreateRandomData(
+      CompressorArchiveParallelZip::kMaximumBufferedEntrySize + 1000));
+  pathnames.push_back("dir/last");
+  contents.push_back("last");
+
+  for (size_t i = 0; i < pathnames.size(); ++i)
+    AddFile(pathnames[i], contents[i]);
+  archive->CloseArchive(false /* has_error */);
+
+  std::vector<ZipEntry> entries = ParseArchive(stream.archive());
+  ASSERT_EQ(pathnames.size() + 1, entries.size());
+  EXPECT_EQ("dir/", entries[0].pathname);
+  EXPECT_EQ(0x10u, entries[0].external_attributes & 0x10);
+  for (size_t i = 0; i < pathnames.size(); ++i) {
+    const ZipEntry& entry = entries[i + 1];
+    EXPECT_EQ(pathnames[i], entry.pathname);
+    EXPECT_EQ(contents[i], entry.data);
+    EXPECT_EQ(Crc(contents[i]), entry.crc);
+    EXPECT_EQ(0u, entry.external_attributes & 0x10);
+  }
+  // The big entry is deflated while it is written.
+  EXPECT_EQ(8, entries[pathnames.size() - 1].flags & 8);
+}
+
+TEST_F(CompressorArchiveParallelZipTest, ReadErrorDropsArchive) {
+  AddFile("first", "first");
+  stream.set_fail_reads(true);
+  AddFile("second", "second");
+  AddFile("third", "third");
+  archive->CloseArchive(false /* has_error */);
+
+  // Nothing is written after the error, including the central directory.
+  EXPECT_EQ(std::string::npos, stream.archive().find("second"));
+  EXPECT_EQ(std::string::npos, stream.archive().find("PK\x05\x06"));
+}
+
+TEST_F(CompressorArchiveParallelZipTest, BlocksOfBigEntryShareDictionary) {
+  // The pattern repeats within the deflate window, so the blocks only refer
+  // to the previous data with the end of the previous block as dictionary.
+  // Without it, every block would hold the pattern once more.
+  const size_t kPatternSize = 30 * 1024;
+  std::string pattern = CreateRandomData(kPatternSize);
+  std::string content;
+  while (content.size() <
+         CompressorArchiveParallelZip::kMaximumBufferedEntrySize +
+             CompressorArchiveParallelZip::kBlockSize / 2) {
+    content += pattern;
+  }
+  AddFile("big", content);
+  archive->CloseArchive(false /* has_error */);
+
+  std::vector<ZipEntry> entries = ParseArchive(stream.archive());
+  ASSERT_EQ(1u, entries.size());
+  EXPECT_EQ(content, entries[0].data);
+  EXPECT_EQ(Crc(content), entries[0].crc);
+  EXPECT_GT(3 * kPatternSize, stream.archive().size());
+}
+
+TEST_F(CompressorArchiveParallelZipTest, IncompressibleEntriesAreStored) {
+  Stats stats;
+  archive->set_stats(&stats);
+  std::string random = CreateRandomData(100 * 1024);
+  std::string big_random = CreateRandomData(
+      CompressorArchiveParallelZip::kMaximumBufferedEntrySize + 1000);
+  std::string text(100 * 1024, 'a');
+  AddFile("random", random);
+  AddFile("big_random", big_random);
+  AddFile("text", text);
+  archive->CloseArchive(false /* has_error */);
+
+  std::vector<ZipEntry> entries = ParseArchive(stream.archive());
+  ASSERT_EQ(3u, entries.size());
+  EXPECT_EQ(0, entries[0].method);
+  EXPECT_EQ(random, entries[0].data);
+  // Big entries are deflated at level 0 instead, which barely grows them.
+  EXPECT_EQ(8, entries[1].method);
+  EXPECT_EQ(big_random, entries[1].data);
+  EXPECT_EQ(Crc(big_random), entries[1].crc);
+  EXPECT_GT(big_random.size() + 1024, entries[1].compressed_size);
+  EXPECT_EQ(8, entries[2].method);
+  EXPECT_EQ(text, entries[2].data);
+
+  EXPECT_EQ(2, stats.Get(Stats::ENTRIES_STORED));
+  EXPECT_EQ(static_cast<int64_t>(random.size() + big_random.size()),
+            stats.Get(Stats::BYTES_STORED));
+}
+
+TEST_F(CompressorArchiveParallelZipTest, LevelZeroStoresAllEntries) {
+  CreateArchive(0 /* compression_level */);
+  Stats stats;
+  archive->set_stats(&stats);
+  std::string text(100 * 1024, 'a');
+  std::string big_text(
+      CompressorArchiveParallelZip::kMaximumBufferedEntrySize + 1000, 'b');
+  AddFile("text", text);
+  AddFile("big_text", big_text);
+  archive->CloseArchive(false /* has_error */);
+
+  std::vector<ZipEntry> entries = ParseArchive(stream.archive());
+  ASSERT_EQ(2u, entries.size());
+  EXPECT_EQ(0, entries[0].method);
+  EXPECT_EQ(text, entries[0].data);
+  EXPECT_EQ(8, entries[1].method);
+  EXPECT_EQ(big_text, entries[1].data);
+  EXPECT_LT(big_text.size(), entries[1].compressed_size);
+  // Only the entries stored because they look incompressible are counted.
+  EXPECT_EQ(0, stats.Get(Stats::ENTRIES_STORED));
+}
+
+TEST_F(CompressorArchiveParallelZipTest, EntriesAreAppendedToArchive) {
+  std::string big_random = CreateRandomData(
+      CompressorArchiveParallelZip::kMaximumBufferedEntrySize + 1000);
+  AddFile("first", "first");
+  AddFile("big_random", big_random);
+  archive->CloseArchive(false /* has_error */);
+  // The comment of the archive is dropped.
+  std::string original = stream.archive();
+  original[original.size() - 2] = 7;
+  stream.set_archive(original + "comment");
+
+  ASSERT_TRUE(OpenArchive());
+  AddFile("second", "second");
+  archive->AddToArchive("dir", 0, 0, true);
+  archive->CloseArchive(false /* has_error */);
+
+  // The existing entries are kept as they are.
+  size_t central_directory_offset = ReadUint32(original, original.size() - 6);
+  EXPECT_EQ(original.substr(0, central_directory_offset),
+            stream.archive().substr(0, central_directory_offset));
+  std::vector<ZipEntry> entries = ParseArchive(stream.archive());
+  ASSERT_EQ(4u, entries.size());
+  EXPECT_EQ("first", entries[0].pathname);
+  EXPECT_EQ("first", entries[0].data);
+  EXPECT_EQ("big_random", entries[1].pathname);
+  EXPECT_EQ(big_random, entries[1].data);
+  EXPECT_EQ("second", entries[2].pathname);
+  EXPECT_EQ("second", entries[2].data);
+  EXPECT_EQ("dir/", entries[3].pathname);
+  EXPECT_EQ(std::string::npos, stream.archive().find("comment"));
+}
+
+TEST_F(CompressorArchiveParallelZipTest, OpenArchiveFailsWithoutEndRecord) {
+  AddFile("first", "first");
+  archive->CloseArchive(false /* has_error */);
+  std::string original = stream.archive();
+
+  // Data after the end record isn't a comment.
+  stream.set_archive(original + "garbage");
+  EXPECT_FALSE(OpenArchive());
+  // The central directory must end where the end record starts.
+  stream.set_archive(original.substr(0, 10) + original);
+  EXPECT_FALSE(OpenArchive());
+  stream.set_archive("first");
+  EXPECT_FALSE(OpenArchive());
+}
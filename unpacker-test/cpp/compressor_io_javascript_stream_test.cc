@@ -0,0 +1,374 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "compressor_io_javascript_stream.h"
+
+#include <cstring>
+#include <pthread.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "ppapi/cpp/var_array_buffer.h"
+
+namespace {
+
+// The size of the entry read in the tests.
+const int64_t kEntrySize = 10;
+
+// Fake JavaScriptCompressorRequestor that records the read file chunk
+// requests and the offsets of the write chunk requests. The tests respond to
+// them with ReadFileChunkDone and WriteChunkDone.
+class FakeJavaScriptCompressorRequestor
+    : public JavaScriptCompressorRequestorInterface {
+ public:
+  FakeJavaScriptCompressorRequestor() { pthread_mutex_init(&lock_, NULL); }
+
+  virtual ~FakeJavaScriptCompressorRequestor() {
+    pthread_mutex_destroy(&lock_);
+  }
+
+  virtual void WriteChunkRequest(int64_t length,
+                                 const pp::VarArrayBuffer& buffer,
+                                 int64_t offset) {
+    pthread_mutex_lock(&lock_);
+    write_offsets_.push_back(offset);
+    pthread_mutex_unlock(&lock_);
+  }
+
+  virtual void ReadFileChunkRequest(int64_t offset, int64_t length) {
+    pthread_mutex_lock(&lock_);
+    requests_.push_back(std::make_pair(offset, length));
+    pthread_mutex_unlock(&lock_);
+  }
+
+  virtual void ReadArchiveChunkRequest(int64_t offset, int64_t length) {}
+
+  // Returns the (offset, length) of the requests sent so far.
+  std::vector<std::pair<int64_t, int64_t> > requests() {
+    pthread_mutex_lock(&lock_);
+    std::vector<std::pair<int64_t, int64_t> > requests = requests_;
+    pthread_mutex_unlock(&lock_);
+    return requests;
+  }
+
+  // Waits until count requests were sent.
+  void WaitForRequests(size_t count) {
+    while (requests().size() < count)
+      usleep(1000);
+  }
+
+  // Returns the offsets of the write chunk requests sent so far, negative
+  // when appending.
+  std::vector<int64_t> write_offsets() {
+    pthread_mutex_lock(&lock_);
+    std::vector<int64_t> write_offsets = write_offsets_;
+    pthread_mutex_unlock(&lock_);
+    return write_offsets;
+  }
+
+  int write_requests() { return write_offsets().size(); }
+
+  // Waits until count write chunk requests were sent.
+  void WaitForWriteRequests(int count) {
+    while (write_requests() < count)
+      usleep(1000);
+  }
+
+ private:
+  pthread_mutex_t lock_;
+  std::vector<std::pair<int64_t, int64_t> > requests_;
+  std::vector<int64_t> write_offsets_;
+};
+
+// A Read of the stream running on another thread, as Read blocks until
+// ReadFileChunkDone is called.
+struct PendingRead {
+  CompressorIOJavaScriptStream* stream;
+  int64_t bytes_to_read;
+  char buffer[kEntrySize];
+  int64_t read_bytes;
+  pthread_t thread;
+};
+
+void* ReadOnThread(void* data) {
+  PendingRead* read = static_cast<PendingRead*>(data);
+  read->read_bytes = read->stream->Read(read->bytes_to_read, read->buffer);
+  return NULL;
+}
+
+// A Write or Flush of the stream running on another thread, as both can block
+// until WriteChunkDone is called.
+struct PendingWrite {
+  CompressorIOJavaScriptStream* stream;
+  bool flush;  // Flush instead of Write.
+  int64_t result;
+  pthread_t thread;
+};
+
+void* WriteOnThread(void* data) {
+  PendingWrite* write = static_cast<PendingWrite*>(data);
+  write->result = write->flush
+                      ? write->stream->Flush()
+                      : write->stream->Write(kEntrySize,
+                                             pp::VarArrayBuffer(kEntrySize));
+  return NULL;
+}
+
+// Returns a chunk of the entry, where every byte is its offset in the entry.
+pp::VarArrayBuffer CreateChunk(int64_t offset, int64_t length) {
+  pp::VarArrayBuffer chunk(length);
+  char* data = static_cast<char*>(chunk.Map());
+  for (int64_t i = 0; i < length; ++i)
+    data[i] = static_cast<char>(offset + i);
+  chunk.Unmap();
+  return chunk;
+}
+
+}  // namespace
+
+class CompressorIOJavaScriptStreamTest : public testing::Test {
+ protected:
+  CompressorIOJavaScriptStreamTest() : stream(&requestor) {}
+
+  void StartRead(int64_t bytes_to_read) {
+    pending_read.stream = &stream;
+    pending_read.bytes_to_read = bytes_to_read;
+    pending_read.read_bytes = 0;
+    ASSERT_EQ(0, pthread_create(&pending_read.thread, NULL, &ReadOnThread,
+                                &pending_read));
+  }
+
+  // Waits for the Read started by StartRead and returns its result.
+  int64_t FinishRead() {
+    pthread_join(pending_read.thread, NULL);
+    return pending_read.read_bytes;
+  }
+
+  void StartWrite(bool flush) {
+    pending_write.stream = &stream;
+    pending_write.flush = flush;
+    pending_write.result = 0;
+    ASSERT_EQ(0, pthread_create(&pending_write.thread, NULL, &WriteOnThread,
+                                &pending_write));
+  }
+
+  // Waits for the Write or Flush started by StartWrite and returns its result.
+  int64_t FinishWrite() {
+    pthread_join(pending_write.thread, NULL);
+    return pending_write.result;
+  }
+
+  void RespondWithChunk(int64_t offset, int64_t length) {
+    stream.ReadFileChunkDone(offset, length, CreateChunk(offset, length));
+  }
+
+  FakeJavaScriptCompressorRequestor requestor;
+  CompressorIOJavaScriptStream stream;
+  PendingRead pending_read;
+  PendingWrite pending_write;
+};
+
+TEST_F(CompressorIOJavaScriptStreamTest, ReadAhead) {
+  stream.set_read_ahead_depth(2);
+  stream.StartEntry(kEntrySize);
+
+  // The first Read requests its chunk and the next two.
+  StartRead(4);
+  requestor.WaitForRequests(3);
+  RespondWithChunk(0, 4);
+  EXPECT_EQ(4, FinishRead());
+  EXPECT_EQ(0, pending_read.buffer[0]);
+  EXPECT_EQ(3, pending_read.buffer[3]);
+
+  std::vector<std::pair<int64_t, int64_t> > requests = requestor.requests();
+  ASSERT_EQ(3u, requests.size());
+  EXPECT_EQ(std::make_pair(int64_t(0), int64_t(4)), requests[0]);
+  EXPECT_EQ(std::make_pair(int64_t(4), int64_t(4)), requests[1]);
+  EXPECT_EQ(std::make_pair(int64_t(8), int64_t(2)), requests[2]);
+
+  // The chunks read ahead are returned without new requests.
+  RespondWithChunk(4, 4);
+  RespondWithChunk(8, 2);
+  char buffer[kEntrySize];
+  EXPECT_EQ(4, stream.Read(4, buffer));
+  EXPECT_EQ(4, buffer[0]);
+  EXPECT_EQ(2, stream.Read(2, buffer));
+  EXPECT_EQ(8, buffer[0]);
+  EXPECT_EQ(9, buffer[1]);
+  EXPECT_EQ(3u, requestor.requests().size());
+}
+
+TEST_F(CompressorIOJavaScriptStreamTest, NoReadAhead) {
+  stream.set_read_ahead_depth(0);
+  stream.StartEntry(kEntrySize);
+
+  StartRead(4);
+  requestor.WaitForRequests(1);
+  RespondWithChunk(0, 4);
+  EXPECT_EQ(4, FinishRead());
+  EXPECT_EQ(1u, requestor.requests().size());
+}
+
+TEST_F(CompressorIOJavaScriptStreamTest, ReadError) {
+  stream.StartEntry(kEntrySize);
+
+  StartRead(4);
+  requestor.WaitForRequests(1);
+  stream.ReadFileChunkDone(0, -1, pp::VarArrayBuffer());
+  EXPECT_GT(0, FinishRead());
+}
+
+TEST_F(CompressorIOJavaScriptStreamTest, StartEntryDropsChunksReadAhead) {
+  stream.set_read_ahead_depth(1);
+  stream.StartEntry(kEntrySize);
+
+  StartRead(4);
+  requestor.WaitForRequests(2);
+  RespondWithChunk(0, 4);
+  EXPECT_EQ(4, FinishRead());
+
+  // The chunk read ahead for the previous entry is dropped, so the next entry
+  // requests its chunks again.
+  stream.StartEntry(kEntrySize);
+  RespondWithChunk(4, 4);
+  StartRead(4);
+  requestor.WaitForRequests(4);
+  RespondWithChunk(0, 4);
+  EXPECT_EQ(4, FinishRead());
+
+  std::vector<std::pair<int64_t, int64_t> > requests = requestor.requests();
+  ASSERT_EQ(4u, requests.size());
+  EXPECT_EQ(0, requests[2].first);
+  EXPECT_EQ(4, requests[3].first);
+}
+
+TEST_F(CompressorIOJavaScriptStreamTest, ReadInPlace) {
+  stream.set_read_ahead_depth(1);
+  stream.StartEntry(kEntrySize);
+
+  StartRead(4);
+  requestor.WaitForRequests(2);
+  RespondWithChunk(0, 4);
+  EXPECT_EQ(4, FinishRead());
+
+  // The data is returned in the buffer received from JavaScript.
+  pp::VarArrayBuffer chunk = CreateChunk(4, 4);
+  stream.ReadFileChunkDone(4, 4, chunk);
+  const char* data = NULL;
+  EXPECT_EQ(4, stream.ReadInPlace(4, &data));
+  EXPECT_EQ(chunk.Map(), data);
+  EXPECT_EQ(4, data[0]);
+}
+
+TEST_F(CompressorIOJavaScriptStreamTest, EntryDataSentWithTheEntry) {
+  // The data of the entry starts at offset 2 of the batch.
+  stream.SetNextEntryData(CreateChunk(0, kEntrySize + 2), 2);
+  stream.StartEntry(kEntrySize);
+
+  char buffer[kEntrySize];
+  EXPECT_EQ(4, stream.Read(4, buffer));
+  EXPECT_EQ(2, buffer[0]);
+  EXPECT_EQ(6, stream.Read(kEntrySize, buffer));
+  EXPECT_EQ(6, buffer[0]);
+  EXPECT_EQ(11, buffer[5]);
+  EXPECT_EQ(0u, requestor.requests().size());
+
+  // The next entry requests its chunks again.
+  stream.StartEntry(kEntrySize);
+  StartRead(4);
+  requestor.WaitForRequests(1);
+  RespondWithChunk(0, 4);
+  EXPECT_EQ(4, FinishRead());
+  EXPECT_EQ(0, pending_read.buffer[0]);
+}
+
+TEST_F(CompressorIOJavaScriptStreamTest, RewindEntry) {
+  stream.set_read_ahead_depth(0);
+  stream.StartEntry(kEntrySize);
+
+  StartRead(4);
+  requestor.WaitForRequests(1);
+  RespondWithChunk(0, 4);
+  EXPECT_EQ(4, FinishRead());
+
+  // The entry is read again from its beginning.
+  stream.RewindEntry();
+  StartRead(4);
+  requestor.WaitForRequests(2);
+  RespondWithChunk(0, 4);
+  EXPECT_EQ(4, FinishRead());
+  EXPECT_EQ(0, requestor.requests()[1].first);
+}
+
+TEST_F(CompressorIOJavaScriptStreamTest, WriteRecyclesBuffers) {
+  pp::VarArrayBuffer buffer = stream.AcquireWriteBuffer(kEntrySize);
+  void* data = buffer.Map();
+  buffer.Unmap();
+  EXPECT_EQ(kEntrySize, stream.Write(kEntrySize, buffer));
+
+  // The buffer is reused once sent to JavaScript.
+  pp::VarArrayBuffer next_buffer = stream.AcquireWriteBuffer(kEntrySize);
+  EXPECT_EQ(data, next_buffer.Map());
+  next_buffer.Unmap();
+}
+
+TEST_F(CompressorIOJavaScriptStreamTest, WriteOffsetAppliesToNextWrite) {
+  pp::VarArrayBuffer buffer(kEntrySize);
+  stream.SetWriteOffset(100);
+  EXPECT_EQ(kEntrySize, stream.Write(kEntrySize, buffer));
+  EXPECT_EQ(kEntrySize, stream.Write(kEntrySize, buffer));
+
+  // The chunks after the first one are appended to it.
+  std::vector<int64_t> write_offsets = requestor.write_offsets();
+  ASSERT_EQ(2u, write_offsets.size());
+  EXPECT_EQ(100, write_offsets[0]);
+  EXPECT_GT(0, write_offsets[1]);
+}
+
+TEST_F(CompressorIOJavaScriptStreamTest, WriteBehind) {
+  stream.set_write_behind_depth(2);
+  pp::VarArrayBuffer buffer(kEntrySize);
+
+  // The first chunks are left to be written by JavaScript.
+  EXPECT_EQ(kEntrySize, stream.Write(kEntrySize, buffer));
+  EXPECT_EQ(kEntrySize, stream.Write(kEntrySize, buffer));
+  EXPECT_EQ(2, requestor.write_requests());
+
+  // The next one waits until a chunk is written.
+  StartWrite(false /* flush */);
+  requestor.WaitForWriteRequests(3);
+  stream.WriteChunkDone(kEntrySize);
+  EXPECT_EQ(kEntrySize, FinishWrite());
+
+  // Flush waits for all of them.
+  StartWrite(true /* flush */);
+  stream.WriteChunkDone(kEntrySize);
+  stream.WriteChunkDone(kEntrySize);
+  EXPECT_EQ(0, FinishWrite());
+  EXPECT_EQ(0, stream.Flush());
+}
+
+TEST_F(CompressorIOJavaScriptStreamTest, NoWriteBehind) {
+  stream.set_write_behind_depth(0);
+
+  StartWrite(false /* flush */);
+  requestor.WaitForWriteRequests(1);
+  stream.WriteChunkDone(kEntrySize);
+  EXPECT_EQ(kEntrySize, FinishWrite());
+}
+
+TEST_F(CompressorIOJavaScriptStreamTest, WriteBehindError) {
+  stream.set_write_behind_depth(2);
+  pp::VarArrayBuffer buffer(kEntrySize);
+  EXPECT_EQ(kEntrySize, stream.Write(kEntrySize, buffer));
+  stream.WriteChunkDone(-1);
+
+  // The error is reported by the next Write, without sending the chunk, and
+  // by Flush.
+  EXPECT_GT(0, stream.Write(kEntrySize, buffer));
+  EXPECT_EQ(1, requestor.write_requests());
+  EXPECT_GT(0, stream.Flush());
+}
@@ -21,10 +21,17 @@ struct archive {
   // Used by archive_read_data to know how many bytes were read from
   // fake_lib_archive_config::kArchiveData during last call.
   int64_t data_offset;
+
+  // The error number returned by archive_errno.
+  int error_number;
 };
 
 struct archive_entry {
-  // Content not needed.
+  // Set for the entries written. The entries read use the constants of
+  // fake_lib_archive_config instead.
+  std::string pathname;
+  int64_t size;
+  std::string hardlink;
 };
 
 namespace {
@@ -60,6 +67,9 @@ int archive_read_next_header_return_value = ARCHIVE_OK;
 int archive_read_seek_header_return_value = ARCHIVE_OK;
 mode_t archive_entry_filetype_return_value = S_IFREG;  // Regular file.
 
+std::vector<WrittenEntry> written_entries;
+bool archive_write_failed = false;
+
 void ResetVariables() {
   archive_data = NULL;
   archive_data_size = 0;
@@ -79,6 +89,9 @@ void ResetVariables() {
 
   archive_read_next_header_return_value = ARCHIVE_OK;
   archive_entry_filetype_return_value = S_IFREG;
+
+  written_entries.clear();
+  archive_write_failed = false;
 }
 
 }  // namespace fake_lib_archive_config
@@ -213,3 +226,163 @@ ssize_t archive_read_data(archive* archive_object,
   archive_object->data_offset += read_bytes;
   return read_bytes;
 }
+
+int archive_filter_count(archive* archive_object) {
+  return 1;
+}
+
+int archive_filter_code(archive* archive_object, int filter) {
+  return ARCHIVE_FILTER_NONE;
+}
+
+int64_t archive_filter_bytes(archive* archive_object, int filter) {
+  return archive_object->data_offset;
+}
+
+// The fake archive is a RAR archive, so its data is never stored as is.
+int archive_format(archive* archive_object) {
+  return ARCHIVE_FORMAT_RAR;
+}
+
+const char* archive_format_name(archive* archive_object) {
+  return "RAR";
+}
+
+int archive_entry_is_data_encrypted(archive_entry* entry) {
+  return 0;
+}
+
+int archive_entry_sparse_count(archive_entry* entry) {
+  return 0;
+}
+
+int archive_errno(archive* archive_object) {
+  return archive_object->error_number;
+}
+
+void archive_clear_error(archive* archive_object) {
+  archive_object->error_number = 0;
+}
+
+archive_entry* archive_entry_new() {
+  archive_entry* entry = new archive_entry;
+  entry->size = 0;
+  return entry;
+}
+
+void archive_entry_free(archive_entry* entry) {
+  delete entry;
+}
+
+void archive_entry_set_pathname(archive_entry* entry, const char* pathname) {
+  entry->pathname = pathname;
+}
+
+void archive_entry_set_size(archive_entry* entry, la_int64_t size) {
+  entry->size = size;
+}
+
+void archive_entry_set_mtime(archive_entry* entry, time_t time, long nsec) {
+  // Nothing to do.
+}
+
+void archive_entry_set_filetype(archive_entry* entry, unsigned int type) {
+  // Nothing to do.
+}
+
+void archive_entry_set_perm(archive_entry* entry, mode_t permission) {
+  // Nothing to do.
+}
+
+void archive_entry_set_hardlink(archive_entry* entry, const char* hardlink) {
+  entry->hardlink = hardlink;
+}
+
+// The fake archive written collects the entries in
+// fake_lib_archive_config::written_entries instead of writing them through
+// the callbacks passed to archive_write_open.
+archive* archive_write_new() {
+  test_archive.data_offset = 0;
+  test_archive.error_number = 0;
+  return &test_archive;
+}
+
+int archive_write_set_format_zip(archive* archive_object) {
+  return ARCHIVE_OK;
+}
+
+int archive_write_set_format_pax_restricted(archive* archive_object) {
+  return ARCHIVE_OK;
+}
+
+int archive_write_add_filter_by_name(archive* archive_object,
+                                     const char* name) {
+  return ARCHIVE_OK;
+}
+
+int archive_write_set_format_option(archive* archive_object,
+                                    const char* module,
+                                    const char* option,
+                                    const char* value) {
+  return ARCHIVE_OK;
+}
+
+int archive_write_set_filter_option(archive* archive_object,
+                                    const char* module,
+                                    const char* option,
+                                    const char* value) {
+  return ARCHIVE_OK;
+}
+
+int archive_write_set_bytes_per_block(archive* archive_object,
+                                      int bytes_per_block) {
+  return ARCHIVE_OK;
+}
+
+int archive_write_set_bytes_in_last_block(archive* archive_object,
+                                          int bytes_in_last_block) {
+  return ARCHIVE_OK;
+}
+
+int archive_write_open(archive* archive_object,
+                       void* client_data,
+                       archive_open_callback* opener,
+                       archive_write_callback* writer,
+                       archive_close_callback* closer) {
+  return ARCHIVE_OK;
+}
+
+int archive_write_zip_set_compression_deflate(archive* archive_object) {
+  return ARCHIVE_OK;
+}
+
+int archive_write_zip_set_compression_store(archive* archive_object) {
+  return ARCHIVE_OK;
+}
+
+int archive_write_header(archive* archive_object, archive_entry* entry) {
+  fake_lib_archive_config::WrittenEntry written_entry;
+  written_entry.pathname = entry->pathname;
+  written_entry.size = entry->size;
+  written_entry.hardlink = entry->hardlink;
+  fake_lib_archive_config::written_entries.push_back(written_entry);
+  return ARCHIVE_OK;
+}
+
+la_ssize_t archive_write_data(archive* archive_object,
+                              const void* buffer,
+                              size_t length) {
+  PP_DCHECK(!fake_lib_archive_config::written_entries.empty());
+  fake_lib_archive_config::written_entries.back().data.append(
+      static_cast<const char*>(buffer), length);
+  return length;
+}
+
+int archive_write_fail(archive* archive_object) {
+  fake_lib_archive_config::archive_write_failed = true;
+  return ARCHIVE_FATAL;
+}
+
+int archive_write_free(archive* archive_object) {
+  return ARCHIVE_OK;
+}
@@ -9,6 +9,8 @@
 #define FAKE_LIB_ARCHIVE_H_
 
 #include <limits>
+#include <string>
+#include <vector>
 
 #include "archive.h"
 
@@ -66,6 +68,22 @@ extern int archive_read_seek_header_return_value;
 // By default it should be set to regular file.
 extern mode_t archive_entry_filetype_return_value;
 
+// An entry written with archive_write_header, with the data written after it
+// with archive_write_data.
+struct WrittenEntry {
+  std::string pathname;
+  int64_t size;
+  std::string hardlink;  // Empty if the entry is not a hard link.
+  std::string data;
+};
+
+// The entries written since the last ResetVariables.
+extern std::vector<WrittenEntry> written_entries;
+
+// True once archive_write_fail was called.
+// By default it is set to false.
+extern bool archive_write_failed;
+
 // Resets all variables to default values.
 void ResetVariables();
 
@@ -0,0 +1,132 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "hasher.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// The digests of the test vectors of BLAKE3, where the input of length n is
+// the bytes 0, 1, ..., 250, 0, 1, ... up to n bytes.
+struct TestVector {
+  size_t length;
+  const char* sha256;
+  const char* blake3;
+};
+
+const TestVector kTestVectors[] = {
+    {0,
+     "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+     "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262"},
+    {1,
+     "6e340b9cffb37a989ca544e6bb780a2c78901d3fb33738768511a30617afa01d",
+     "2d3adedff11b61f14c886e35afa036736dcd87a74d27b5c1510225d0f592e213"},
+    {1023,
+     "1c5e88a585b61754df6137d66632a7348557a88358afc401b0a0a4fc427104a9",
+     "10108970eeda3eb932baac1428c7a2163b0e924c9a9e25b35bba72b28f70bd11"},
+    {1024,
+     "2bce1ba628720664be4b9fdd77aae0678e5f0f3f02fc6ff641ec879094f6a404",
+     "42214739f095a406f3fc83deb889744ac00df831c10daa55189b5d121c855af7"},
+    {1025,
+     "bc0b6b10b89b9487a12fda2a8cc13194e7091c217aabf8b92846274026f4bcd0",
+     "d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444"},
+    {2049,
+     "26e1e2808e3a6cf967ca03f6749a063c5ed55f92f5874653a1faabed78346f00",
+     "5f4d72f40d7a5f82b15ca2b2e44b1de3c2ef86c426c95c1af0b6879522563030"},
+    {8193,
+     "7e3691790cd64b19d4edb1a80e988214515abeb53aa0f34ffbfe4b4bf405d120",
+     "bab6c09cb8ce8cf459261398d2e7aef35700bf488116ceb94a36d0f5f1b7bc3b"},
+    {102400,
+     "74588b7f0bcc354ac14d9cf199fa3a20c05f0c7293b9075b2f2e146e718de800",
+     "bc3e3d41a1146b069abffad3c0d44860cf664390afce4d9661f7902e7943e085"},
+};
+
+std::string CreateInput(size_t length) {
+  std::string input(length, '\0');
+  for (size_t i = 0; i < length; ++i)
+    input[i] = static_cast<char>(i % 251);
+  return input;
+}
+
+// Returns the digest of input, passed to hasher in chunks of chunk_size bytes.
+std::string Hash(Hasher* hasher, const std::string& input, size_t chunk_size) {
+  hasher->Reset();
+  for (size_t offset = 0; offset < input.size(); offset += chunk_size) {
+    hasher->Update(input.data() + offset,
+                   std::min(chunk_size, input.size() - offset));
+  }
+  return hasher->Finish();
+}
+
+// Checks the digests of the test vectors, passed in chunks of various sizes.
+void ExpectTestVectors(const std::string& algorithm, bool blake3) {
+  Hasher* hasher = Hasher::Create(algorithm);
+  ASSERT_TRUE(hasher);
+
+  const size_t kChunkSizes[] = {1, 63, 64, 1000, 1024, 1 << 20};
+  for (size_t i = 0; i < sizeof(kTestVectors) / sizeof(kTestVectors[0]); ++i) {
+    std::string input = CreateInput(kTestVectors[i].length);
+    std::string expected =
+        blake3 ? kTestVectors[i].blake3 : kTestVectors[i].sha256;
+    for (size_t j = 0; j < sizeof(kChunkSizes) / sizeof(kChunkSizes[0]); ++j) {
+      EXPECT_EQ(expected, Hash(hasher, input, kChunkSizes[j]))
+          << "length " << input.size() << ", chunk size " << kChunkSizes[j];
+    }
+  }
+
+  delete hasher;
+}
+
+}  // namespace
+
+TEST(HasherTest, Sha256) {
+  ExpectTestVectors("sha256", false);
+}
+
+TEST(HasherTest, Blake3) {
+  ExpectTestVectors("blake3", true);
+}
+
+TEST(HasherTest, Blake3FourChunksAtOnce) {
+  Hasher* hasher = Hasher::Create("blake3");
+  ASSERT_TRUE(hasher);
+
+  // Passed at once, the whole chunks followed by more data are compressed 4
+  // at a time. Passed in chunks of 1000 bytes, they are compressed one at a
+  // time.
+  const size_t kLengths[] = {4096, 4097, 5 * 1024 + 1, 9 * 1024,
+                             17 * 1024 + 100};
+  for (size_t i = 0; i < sizeof(kLengths) / sizeof(kLengths[0]); ++i) {
+    std::string input = CreateInput(kLengths[i]);
+    EXPECT_EQ(Hash(hasher, input, 1000), Hash(hasher, input, input.size()))
+        << "length " << input.size();
+  }
+
+  delete hasher;
+}
+
+TEST(HasherTest, Crc32c) {
+  Hasher* hasher = Hasher::Create("crc32c");
+  ASSERT_TRUE(hasher);
+
+  EXPECT_EQ("00000000", Hash(hasher, "", 1));
+  EXPECT_EQ("e3069283", Hash(hasher, "123456789", 1));
+  EXPECT_EQ("e3069283", Hash(hasher, "123456789", 9));
+
+  std::string input = CreateInput(1025);
+  EXPECT_EQ("c8d03add", Hash(hasher, input, 1));
+  EXPECT_EQ("c8d03add", Hash(hasher, input, 13));
+  EXPECT_EQ("c8d03add", Hash(hasher, input, input.size()));
+
+  delete hasher;
+}
+
+TEST(HasherTest, UnknownAlgorithm) {
+  EXPECT_EQ(NULL, Hasher::Create("md5"));
+}
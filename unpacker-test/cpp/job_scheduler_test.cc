@@ -0,0 +1,47 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "job_scheduler.h"
+
+#include "gtest/gtest.h"
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi_simple/ps_main.h"
+
+// The worker pool is never started, so the posted jobs stay in the queues.
+class JobSchedulerTest : public testing::Test {
+ protected:
+  JobSchedulerTest()
+      : worker_pool(pp::InstanceHandle(PSGetInstanceId()), 1),
+        scheduler(&worker_pool) {}
+
+  static void DoNothing(void* user_data, int32_t result) {}
+
+  WorkerPool worker_pool;
+  JobScheduler scheduler;
+};
+
+TEST_F(JobSchedulerTest, NoJobs) {
+  EXPECT_FALSE(scheduler.HasJobsAbove(JobScheduler::PRIORITY_BULK));
+
+  JobScheduler::WaitStats wait_stats =
+      scheduler.GetWaitStats(JobScheduler::PRIORITY_INTERACTIVE);
+  EXPECT_EQ(0, wait_stats.jobs);
+  EXPECT_EQ(0, wait_stats.total_wait_us);
+  EXPECT_EQ(0, wait_stats.max_wait_us);
+}
+
+TEST_F(JobSchedulerTest, HasJobsAbove) {
+  pp::CompletionCallback callback(&JobSchedulerTest::DoNothing, NULL);
+
+  scheduler.PostJob(JobScheduler::PRIORITY_BULK, callback);
+  EXPECT_FALSE(scheduler.HasJobsAbove(JobScheduler::PRIORITY_BULK));
+
+  scheduler.PostJobFront(JobScheduler::PRIORITY_METADATA, callback);
+  EXPECT_TRUE(scheduler.HasJobsAbove(JobScheduler::PRIORITY_BULK));
+  EXPECT_FALSE(scheduler.HasJobsAbove(JobScheduler::PRIORITY_METADATA));
+
+  scheduler.PostJob(JobScheduler::PRIORITY_INTERACTIVE, callback);
+  EXPECT_TRUE(scheduler.HasJobsAbove(JobScheduler::PRIORITY_METADATA));
+  EXPECT_FALSE(scheduler.HasJobsAbove(JobScheduler::PRIORITY_INTERACTIVE));
+}
@@ -0,0 +1,203 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "pattern_matcher.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// Returns the matches of patterns in data, passed to the matcher in chunks of
+// chunk_size bytes.
+std::vector<PatternMatcher::Match> FindAll(
+    const std::vector<std::string>& patterns,
+    const std::string& data,
+    size_t chunk_size) {
+  PatternMatcher matcher(patterns);
+  std::vector<PatternMatcher::Match> matches;
+  for (size_t offset = 0; offset < data.size(); offset += chunk_size) {
+    matcher.Find(data.data() + offset,
+                 std::min(chunk_size, data.size() - offset), &matches);
+  }
+  EXPECT_EQ(static_cast<int64_t>(data.size()), matcher.stream_offset());
+  return matches;
+}
+
+// Checks that the match-th match is pattern at offset.
+void ExpectMatch(const std::vector<PatternMatcher::Match>& matches,
+                 size_t match,
+                 size_t pattern,
+                 int64_t offset) {
+  ASSERT_LT(match, matches.size());
+  EXPECT_EQ(pattern, matches[match].pattern);
+  EXPECT_EQ(offset, matches[match].offset);
+}
+
+// Returns the matches of patterns in data, checking every pattern at every
+// position. Matches ending at the same position are ordered by pattern.
+std::vector<PatternMatcher::Match> FindNaive(
+    const std::vector<std::string>& patterns,
+    const std::string& data) {
+  std::vector<PatternMatcher::Match> matches;
+  for (size_t end = 1; end <= data.size(); ++end) {
+    for (size_t i = 0; i < patterns.size(); ++i) {
+      size_t length = patterns[i].size();
+      if (length > 0 && length <= end &&
+          data.compare(end - length, length, patterns[i]) == 0) {
+        PatternMatcher::Match match;
+        match.pattern = i;
+        match.offset = end - length;
+        matches.push_back(match);
+      }
+    }
+  }
+  return matches;
+}
+
+// Checks that patterns are found in data like FindNaive does, whatever the
+// size of the chunks.
+void ExpectSameMatches(const std::vector<std::string>& patterns,
+                       const std::string& data) {
+  std::vector<PatternMatcher::Match> expected = FindNaive(patterns, data);
+  ASSERT_FALSE(expected.empty());
+  for (size_t chunk_size = 1; chunk_size <= data.size(); ++chunk_size) {
+    std::vector<PatternMatcher::Match> matches =
+        FindAll(patterns, data, chunk_size);
+    ASSERT_EQ(expected.size(), matches.size());
+    for (size_t i = 0; i < matches.size(); ++i)
+      ExpectMatch(matches, i, expected[i].pattern, expected[i].offset);
+  }
+}
+
+// Returns 100 bytes of data with the patterns, in turns, at offsets around
+// the 16 bytes compared at once and in the last bytes of the data.
+std::string CreateData(const std::vector<std::string>& patterns) {
+  const size_t kOffsets[] = {0, 14, 16, 31, 45, 64, 90, 97};
+  std::string data(100, '-');
+  for (size_t i = 0; i < sizeof(kOffsets) / sizeof(kOffsets[0]); ++i) {
+    const std::string& pattern = patterns[i % patterns.size()];
+    data.replace(kOffsets[i], pattern.size(), pattern);
+  }
+  return data;
+}
+
+}  // namespace
+
+TEST(PatternMatcherTest, SinglePattern) {
+  std::vector<std::string> patterns;
+  patterns.push_back("needle");
+  std::vector<PatternMatcher::Match> matches =
+      FindAll(patterns, "hayneedlehayneedl needle", 1024);
+
+  ASSERT_EQ(2u, matches.size());
+  ExpectMatch(matches, 0, 0, 3);
+  ExpectMatch(matches, 1, 0, 18);
+}
+
+TEST(PatternMatcherTest, MultiplePatterns) {
+  std::vector<std::string> patterns;
+  patterns.push_back("he");
+  patterns.push_back("she");
+  patterns.push_back("his");
+  patterns.push_back("hers");
+  std::vector<PatternMatcher::Match> matches =
+      FindAll(patterns, "ushers his", 1024);
+
+  // Overlapping matches are all found, ordered by their end.
+  ASSERT_EQ(4u, matches.size());
+  ExpectMatch(matches, 0, 1, 1);  // she
+  ExpectMatch(matches, 1, 0, 2);  // he
+  ExpectMatch(matches, 2, 3, 2);  // hers
+  ExpectMatch(matches, 3, 2, 7);  // his
+}
+
+TEST(PatternMatcherTest, MatchesSpanningChunks) {
+  std::vector<std::string> patterns;
+  patterns.push_back("abcab");
+  patterns.push_back("xyz");
+  std::string data = "abcabcabxyzabcab";
+
+  std::vector<PatternMatcher::Match> expected = FindAll(patterns, data, 1024);
+  ASSERT_EQ(4u, expected.size());
+  ExpectMatch(expected, 0, 0, 0);
+  ExpectMatch(expected, 1, 0, 3);
+  ExpectMatch(expected, 2, 1, 8);
+  ExpectMatch(expected, 3, 0, 11);
+
+  for (size_t chunk_size = 1; chunk_size < data.size(); ++chunk_size) {
+    std::vector<PatternMatcher::Match> matches =
+        FindAll(patterns, data, chunk_size);
+    ASSERT_EQ(expected.size(), matches.size());
+    for (size_t i = 0; i < matches.size(); ++i)
+      ExpectMatch(matches, i, expected[i].pattern, expected[i].offset);
+  }
+}
+
+TEST(PatternMatcherTest, FewFirstBytes) {
+  // The bytes that can't start a pattern are skipped with vector compares.
+  std::vector<std::string> patterns;
+  patterns.push_back("ab");
+  patterns.push_back("cd");
+  patterns.push_back("efg");
+  ExpectSameMatches(patterns, CreateData(patterns));
+}
+
+TEST(PatternMatcherTest, ManyFirstBytes) {
+  // Too many bytes start a pattern for vector compares, so the bytes that
+  // can't start one are skipped with the lookup table.
+  std::vector<std::string> patterns;
+  for (char first_byte = '0'; first_byte <= '9'; ++first_byte)
+    patterns.push_back(std::string(1, first_byte) + "x");
+  ExpectSameMatches(patterns, CreateData(patterns));
+}
+
+TEST(PatternMatcherTest, BinaryData) {
+  std::vector<std::string> patterns;
+  patterns.push_back(std::string("\0\xff", 2));
+  std::string data("\xff\0\xff\0\0\xff", 6);
+  std::vector<PatternMatcher::Match> matches = FindAll(patterns, data, 1024);
+
+  ASSERT_EQ(2u, matches.size());
+  ExpectMatch(matches, 0, 0, 1);
+  ExpectMatch(matches, 1, 0, 4);
+}
+
+TEST(PatternMatcherTest, EmptyAndDuplicatePatterns) {
+  std::vector<std::string> patterns;
+  patterns.push_back("");
+  patterns.push_back("aa");
+  patterns.push_back("aa");
+  std::vector<PatternMatcher::Match> matches = FindAll(patterns, "aaa", 1024);
+
+  ASSERT_EQ(4u, matches.size());
+  ExpectMatch(matches, 0, 1, 0);
+  ExpectMatch(matches, 1, 2, 0);
+  ExpectMatch(matches, 2, 1, 1);
+  ExpectMatch(matches, 3, 2, 1);
+}
+
+TEST(PatternMatcherTest, NoPatterns) {
+  std::vector<std::string> patterns;
+  EXPECT_TRUE(FindAll(patterns, "anything", 3).empty());
+}
+
+TEST(PatternMatcherTest, Reset) {
+  std::vector<std::string> patterns;
+  patterns.push_back("abc");
+  PatternMatcher matcher(patterns);
+  std::vector<PatternMatcher::Match> matches;
+
+  // A match can't span streams.
+  matcher.Find("xxab", 4, &matches);
+  matcher.Reset();
+  EXPECT_EQ(0, matcher.stream_offset());
+  matcher.Find("cabc", 4, &matches);
+
+  ASSERT_EQ(1u, matches.size());
+  ExpectMatch(matches, 0, 0, 1);
+}
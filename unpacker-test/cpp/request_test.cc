@@ -15,6 +15,7 @@ const char kFileSystemId[] = "id";
 const char kRequestId[] = "0";
 const char kError[] = "error";
 const int64_t kLength = 100;
+const int kPartIndex = 2;
 
 }  // namespace
 
@@ -44,7 +45,7 @@ TEST(request, CreateReadMetadataDoneResponse) {
 TEST(request, CreateReadChunkRequest) {
   int64_t expected_offset = std::numeric_limits<int64_t>::max();
   pp::VarDictionary read_chunk = request::CreateReadChunkRequest(
-      kFileSystemId, kRequestId, expected_offset, kLength);
+      kFileSystemId, kRequestId, kPartIndex, expected_offset, kLength);
 
   EXPECT_TRUE(read_chunk.Get(request::key::kOperation).is_int());
   EXPECT_EQ(request::READ_CHUNK,
@@ -57,6 +58,9 @@ TEST(request, CreateReadChunkRequest) {
   EXPECT_TRUE(read_chunk.Get(request::key::kRequestId).is_string());
   EXPECT_EQ(kRequestId, read_chunk.Get(request::key::kRequestId).AsString());
 
+  EXPECT_TRUE(read_chunk.Get(request::key::kPartIndex).is_int());
+  EXPECT_EQ(kPartIndex, read_chunk.Get(request::key::kPartIndex).AsInt());
+
   EXPECT_TRUE(read_chunk.Get(request::key::kOffset).is_string());
   std::stringstream ss_offset(read_chunk.Get(request::key::kOffset).AsString());
   int64_t offset;
@@ -139,6 +143,190 @@ TEST(request, CreateReadFileDoneResponse) {
             read_file_done.Get(request::key::kHasMoreData).AsBool());
 }
 
+TEST(request, CreateReadFilesDoneResponse) {
+  pp::VarArrayBuffer array_buffer(kLength);
+  int64_t expected_index = std::numeric_limits<int64_t>::max();
+  pp::VarDictionary read_files_done = request::CreateReadFilesDoneResponse(
+      kFileSystemId, kRequestId, expected_index, array_buffer, true);
+
+  EXPECT_TRUE(read_files_done.Get(request::key::kOperation).is_int());
+  EXPECT_EQ(request::READ_FILES_DONE,
+            read_files_done.Get(request::key::kOperation).AsInt());
+
+  EXPECT_TRUE(read_files_done.Get(request::key::kRequestId).is_string());
+  EXPECT_EQ(kRequestId,
+            read_files_done.Get(request::key::kRequestId).AsString());
+
+  EXPECT_TRUE(read_files_done.Get(request::key::kIndex).is_string());
+  std::stringstream ss_index(
+      read_files_done.Get(request::key::kIndex).AsString());
+  int64_t index;
+  ss_index >> index;
+  EXPECT_EQ(expected_index, index);
+
+  EXPECT_TRUE(read_files_done.Get(request::key::kReadFileData)
+                  .is_array_buffer());
+  EXPECT_EQ(array_buffer, pp::VarArrayBuffer(read_files_done.Get(
+                              request::key::kReadFileData)));
+
+  EXPECT_TRUE(read_files_done.Get(request::key::kHasMoreData).is_bool());
+  EXPECT_TRUE(read_files_done.Get(request::key::kHasMoreData).AsBool());
+}
+
+TEST(request, CreateSearchDoneResponse) {
+  pp::VarArray hits;
+  hits.Set(0, pp::VarDictionary());
+  pp::VarDictionary search_done = request::CreateSearchDoneResponse(
+      kFileSystemId, kRequestId, hits, false);
+
+  EXPECT_TRUE(search_done.Get(request::key::kOperation).is_int());
+  EXPECT_EQ(request::SEARCH_DONE,
+            search_done.Get(request::key::kOperation).AsInt());
+
+  EXPECT_TRUE(search_done.Get(request::key::kRequestId).is_string());
+  EXPECT_EQ(kRequestId, search_done.Get(request::key::kRequestId).AsString());
+
+  EXPECT_TRUE(search_done.Get(request::key::kHits).is_array());
+  EXPECT_EQ(1u, pp::VarArray(search_done.Get(request::key::kHits))
+                    .GetLength());
+
+  EXPECT_TRUE(search_done.Get(request::key::kHasMoreData).is_bool());
+  EXPECT_FALSE(search_done.Get(request::key::kHasMoreData).AsBool());
+}
+
+TEST(request, CreateHashEntriesDoneResponse) {
+  pp::VarArray digests;
+  digests.Set(0, pp::VarDictionary());
+  pp::VarDictionary hash_entries_done = request::CreateHashEntriesDoneResponse(
+      kFileSystemId, kRequestId, digests, true);
+
+  EXPECT_TRUE(hash_entries_done.Get(request::key::kOperation).is_int());
+  EXPECT_EQ(request::HASH_ENTRIES_DONE,
+            hash_entries_done.Get(request::key::kOperation).AsInt());
+
+  EXPECT_TRUE(hash_entries_done.Get(request::key::kRequestId).is_string());
+  EXPECT_EQ(kRequestId,
+            hash_entries_done.Get(request::key::kRequestId).AsString());
+
+  EXPECT_TRUE(hash_entries_done.Get(request::key::kDigests).is_array());
+  EXPECT_EQ(1u, pp::VarArray(hash_entries_done.Get(request::key::kDigests))
+                    .GetLength());
+
+  EXPECT_TRUE(hash_entries_done.Get(request::key::kHasMoreData).is_bool());
+  EXPECT_TRUE(hash_entries_done.Get(request::key::kHasMoreData).AsBool());
+}
+
+TEST(request, CreateGetStatsDoneResponse) {
+  pp::VarDictionary stats;
+  stats.Set(request::key::kVolumes, pp::VarDictionary());
+  stats.Set(request::key::kCompressors, pp::VarDictionary());
+  pp::VarDictionary get_stats_done =
+      request::CreateGetStatsDoneResponse(kRequestId, stats);
+
+  EXPECT_TRUE(get_stats_done.Get(request::key::kOperation).is_int());
+  EXPECT_EQ(request::GET_STATS_DONE,
+            get_stats_done.Get(request::key::kOperation).AsInt());
+
+  EXPECT_TRUE(get_stats_done.Get(request::key::kRequestId).is_string());
+  EXPECT_EQ(kRequestId,
+            get_stats_done.Get(request::key::kRequestId).AsString());
+
+  EXPECT_TRUE(get_stats_done.Get(request::key::kStats).is_dictionary());
+  pp::VarDictionary response_stats(get_stats_done.Get(request::key::kStats));
+  EXPECT_TRUE(response_stats.Get(request::key::kVolumes).is_dictionary());
+  EXPECT_TRUE(response_stats.Get(request::key::kCompressors).is_dictionary());
+}
+
+TEST(request, CreateGetTraceDoneResponse) {
+  const std::string trace = "{\"traceEvents\":[]}";
+  pp::VarDictionary get_trace_done =
+      request::CreateGetTraceDoneResponse(kRequestId, trace);
+
+  EXPECT_TRUE(get_trace_done.Get(request::key::kOperation).is_int());
+  EXPECT_EQ(request::GET_TRACE_DONE,
+            get_trace_done.Get(request::key::kOperation).AsInt());
+
+  EXPECT_TRUE(get_trace_done.Get(request::key::kRequestId).is_string());
+  EXPECT_EQ(kRequestId,
+            get_trace_done.Get(request::key::kRequestId).AsString());
+
+  EXPECT_TRUE(get_trace_done.Get(request::key::kTrace).is_string());
+  EXPECT_EQ(trace, get_trace_done.Get(request::key::kTrace).AsString());
+}
+
+TEST(request, CreateStatPathDoneResponse) {
+  pp::VarDictionary metadata;
+  metadata.Set("name", "file.txt");
+
+  pp::VarDictionary stat_path_done = request::CreateStatPathDoneResponse(
+      kFileSystemId, kRequestId, metadata);
+
+  EXPECT_TRUE(stat_path_done.Get(request::key::kOperation).is_int());
+  EXPECT_EQ(request::STAT_PATH_DONE,
+            stat_path_done.Get(request::key::kOperation).AsInt());
+
+  EXPECT_TRUE(stat_path_done.Get(request::key::kFileSystemId).is_string());
+  EXPECT_EQ(kFileSystemId,
+            stat_path_done.Get(request::key::kFileSystemId).AsString());
+
+  EXPECT_TRUE(stat_path_done.Get(request::key::kRequestId).is_string());
+  EXPECT_EQ(kRequestId,
+            stat_path_done.Get(request::key::kRequestId).AsString());
+
+  EXPECT_TRUE(stat_path_done.Get(request::key::kMetadata).is_dictionary());
+  EXPECT_EQ(metadata,
+            pp::VarDictionary(stat_path_done.Get(request::key::kMetadata)));
+}
+
+TEST(request, CreateReadFileChunkRequest) {
+  const int compressor_id = 3;
+  int64_t expected_offset = std::numeric_limits<int64_t>::max();
+  pp::VarDictionary read_file_chunk = request::CreateReadFileChunkRequest(
+      compressor_id, expected_offset, kLength);
+
+  EXPECT_TRUE(read_file_chunk.Get(request::key::kOperation).is_int());
+  EXPECT_EQ(request::READ_FILE_CHUNK,
+            read_file_chunk.Get(request::key::kOperation).AsInt());
+
+  EXPECT_TRUE(read_file_chunk.Get(request::key::kCompressorId).is_int());
+  EXPECT_EQ(compressor_id,
+            read_file_chunk.Get(request::key::kCompressorId).AsInt());
+
+  EXPECT_TRUE(read_file_chunk.Get(request::key::kOffset).is_string());
+  std::stringstream ss_offset(
+      read_file_chunk.Get(request::key::kOffset).AsString());
+  int64_t offset;
+  ss_offset >> offset;
+  EXPECT_EQ(expected_offset, offset);
+
+  EXPECT_TRUE(read_file_chunk.Get(request::key::kLength).is_string());
+  std::stringstream ss_length(
+      read_file_chunk.Get(request::key::kLength).AsString());
+  int64_t length;
+  ss_length >> length;
+  EXPECT_EQ(kLength, length);
+}
+
+TEST(request, IsPackRequest) {
+  EXPECT_FALSE(request::IsPackRequest(request::READ_METADATA));
+  EXPECT_FALSE(request::IsPackRequest(request::FILE_SYSTEM_ERROR));
+  EXPECT_TRUE(request::IsPackRequest(request::CREATE_ARCHIVE));
+  EXPECT_TRUE(request::IsPackRequest(request::CLOSE_ARCHIVE_DONE));
+  EXPECT_TRUE(request::IsPackRequest(request::COMPRESSOR_ERROR));
+  EXPECT_FALSE(request::IsPackRequest(request::OPEN_FILE_BY_PATH));
+  EXPECT_FALSE(request::IsPackRequest(request::STAT_PATH_DONE));
+  EXPECT_FALSE(request::IsPackRequest(request::GET_STATS));
+}
+
+TEST(request, IsModuleRequest) {
+  EXPECT_FALSE(request::IsModuleRequest(request::READ_METADATA));
+  EXPECT_FALSE(request::IsModuleRequest(request::CREATE_ARCHIVE));
+  EXPECT_FALSE(request::IsModuleRequest(request::HASH_ENTRIES_DONE));
+  EXPECT_FALSE(request::IsModuleRequest(request::COMPRESSOR_ERROR));
+  EXPECT_TRUE(request::IsModuleRequest(request::GET_STATS));
+  EXPECT_TRUE(request::IsModuleRequest(request::GET_STATS_DONE));
+}
+
 TEST(request, CreateFileSystemError) {
   pp::VarDictionary error =
       request::CreateFileSystemError(kFileSystemId, kRequestId, kError);
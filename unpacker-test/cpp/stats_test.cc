@@ -0,0 +1,117 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "stats.h"
+
+#include <pthread.h>
+
+#include "gtest/gtest.h"
+#include "ppapi/cpp/var_array.h"
+
+namespace {
+
+const int kThreadCount = 4;
+const int kAddsPerThread = 10000;
+
+// Adds to a counter and records in a histogram kAddsPerThread times.
+void* AddMany(void* stats) {
+  for (int i = 0; i < kAddsPerThread; ++i) {
+    static_cast<Stats*>(stats)->Add(Stats::BYTES_FETCHED, 2);
+    static_cast<Stats*>(stats)->Record(Stats::DECOMPRESS_DATA_US, 3);
+  }
+  return NULL;
+}
+
+}  // namespace
+
+TEST(StatsTest, Counters) {
+  Stats stats;
+  EXPECT_EQ(0, stats.Get(Stats::READ_CHUNK_REQUESTS));
+
+  stats.Add(Stats::READ_CHUNK_REQUESTS, 1);
+  stats.Add(Stats::READ_CHUNK_REQUESTS, 1);
+  stats.Add(Stats::BYTES_FETCHED, 1LL << 40);
+  EXPECT_EQ(2, stats.Get(Stats::READ_CHUNK_REQUESTS));
+  EXPECT_EQ(1LL << 40, stats.Get(Stats::BYTES_FETCHED));
+  EXPECT_EQ(0, stats.Get(Stats::BYTES_WRITTEN));
+}
+
+TEST(StatsTest, BucketOf) {
+  EXPECT_EQ(0, Stats::BucketOf(-5));
+  EXPECT_EQ(0, Stats::BucketOf(0));
+  EXPECT_EQ(1, Stats::BucketOf(1));
+  EXPECT_EQ(2, Stats::BucketOf(2));
+  EXPECT_EQ(2, Stats::BucketOf(3));
+  EXPECT_EQ(3, Stats::BucketOf(4));
+  EXPECT_EQ(11, Stats::BucketOf(1024));
+  EXPECT_EQ(Stats::kHistogramBucketCount - 1, Stats::BucketOf(1LL << 62));
+}
+
+TEST(StatsTest, Histograms) {
+  Stats stats;
+  stats.Record(Stats::READ_CHUNK_WAIT_US, 0);
+  stats.Record(Stats::READ_CHUNK_WAIT_US, 5);
+  stats.Record(Stats::READ_CHUNK_WAIT_US, 6);
+
+  EXPECT_EQ(3, stats.GetCount(Stats::READ_CHUNK_WAIT_US));
+  EXPECT_EQ(11, stats.GetSum(Stats::READ_CHUNK_WAIT_US));
+  EXPECT_EQ(1, stats.GetBucket(Stats::READ_CHUNK_WAIT_US, 0));
+  EXPECT_EQ(2, stats.GetBucket(Stats::READ_CHUNK_WAIT_US, 3));
+  EXPECT_EQ(0, stats.GetCount(Stats::DECOMPRESS_DATA_US));
+}
+
+TEST(StatsTest, ScopedTimer) {
+  Stats stats;
+  {
+    Stats::ScopedTimer timer(&stats, Stats::ADD_TO_ARCHIVE_US);
+  }
+  EXPECT_EQ(1, stats.GetCount(Stats::ADD_TO_ARCHIVE_US));
+  EXPECT_LE(0, stats.GetSum(Stats::ADD_TO_ARCHIVE_US));
+
+  // Nothing is recorded without stats.
+  Stats::ScopedTimer timer(NULL, Stats::ADD_TO_ARCHIVE_US);
+}
+
+TEST(StatsTest, ConcurrentUpdates) {
+  Stats stats;
+  pthread_t threads[kThreadCount];
+  for (int i = 0; i < kThreadCount; ++i)
+    ASSERT_EQ(0, pthread_create(&threads[i], NULL, &AddMany, &stats));
+  for (int i = 0; i < kThreadCount; ++i)
+    pthread_join(threads[i], NULL);
+
+  EXPECT_EQ(2 * kThreadCount * kAddsPerThread,
+            stats.Get(Stats::BYTES_FETCHED));
+  EXPECT_EQ(kThreadCount * kAddsPerThread,
+            stats.GetCount(Stats::DECOMPRESS_DATA_US));
+  EXPECT_EQ(3 * kThreadCount * kAddsPerThread,
+            stats.GetSum(Stats::DECOMPRESS_DATA_US));
+  EXPECT_EQ(kThreadCount * kAddsPerThread,
+            stats.GetBucket(Stats::DECOMPRESS_DATA_US, 2));
+}
+
+TEST(StatsTest, ToVarDictionary) {
+  Stats stats;
+  stats.Add(Stats::BYTES_DECOMPRESSED, 1234);
+  stats.Record(Stats::DECOMPRESS_DATA_US, 4);
+  pp::VarDictionary dictionary = stats.ToVarDictionary();
+
+  // Only the counters and histograms that were updated are reported.
+  EXPECT_TRUE(dictionary.Get("bytes_decompressed").is_string());
+  EXPECT_EQ("1234", dictionary.Get("bytes_decompressed").AsString());
+  EXPECT_TRUE(dictionary.Get("bytes_skipped").is_undefined());
+  EXPECT_TRUE(dictionary.Get("read_chunk_wait_us").is_undefined());
+
+  EXPECT_TRUE(dictionary.Get("decompress_data_us").is_dictionary());
+  pp::VarDictionary histogram(dictionary.Get("decompress_data_us"));
+  EXPECT_EQ("1", histogram.Get("count").AsString());
+  EXPECT_EQ("4", histogram.Get("sum").AsString());
+
+  // The buckets end with the last one that is not empty.
+  EXPECT_TRUE(histogram.Get("buckets").is_array());
+  pp::VarArray buckets(histogram.Get("buckets"));
+  ASSERT_EQ(4u, buckets.GetLength());
+  EXPECT_EQ("0", buckets.Get(0).AsString());
+  EXPECT_EQ("1", buckets.Get(3).AsString());
+}
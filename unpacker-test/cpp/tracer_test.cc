@@ -0,0 +1,90 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "tracer.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+const char kEmptyTrace[] = "{\"traceEvents\":[],\"displayTimeUnit\":\"ms\"}";
+
+// Returns the number of occurrences of pattern in text.
+int CountOccurrences(const std::string& text, const std::string& pattern) {
+  int count = 0;
+  for (size_t position = text.find(pattern); position != std::string::npos;
+       position = text.find(pattern, position + 1)) {
+    ++count;
+  }
+  return count;
+}
+
+}  // namespace
+
+// The tracer is shared by all the tests, so every test starts by enabling it,
+// which drops the events of the previous tests.
+class TracerTest : public testing::Test {
+ protected:
+  virtual void TearDown() { Tracer::Disable(); }
+};
+
+TEST_F(TracerTest, Disabled) {
+  Tracer::Enable(Tracer::kDefaultCapacity);
+  Tracer::Disable();
+  EXPECT_FALSE(Tracer::IsEnabled());
+
+  {
+    Tracer::ScopedEvent event("job", "ReadFile");
+  }
+  Tracer::BeginAsync("io", "ReadChunk", 1, "length", 10);
+  Tracer::EndAsync("io", "ReadChunk", 1);
+  EXPECT_EQ(kEmptyTrace, Tracer::DumpJson());
+}
+
+TEST_F(TracerTest, CompleteEvent) {
+  Tracer::Enable(Tracer::kDefaultCapacity);
+  EXPECT_TRUE(Tracer::IsEnabled());
+  {
+    Tracer::ScopedEvent event("job", "ReadMetadata");
+  }
+
+  std::string trace = Tracer::DumpJson();
+  EXPECT_EQ(1, CountOccurrences(trace, "\"ph\":\"X\""));
+  EXPECT_EQ(1, CountOccurrences(trace, "\"cat\":\"job\""));
+  EXPECT_EQ(1, CountOccurrences(trace, "\"name\":\"ReadMetadata\""));
+  EXPECT_EQ(1, CountOccurrences(trace, "\"dur\":"));
+}
+
+TEST_F(TracerTest, AsyncEvents) {
+  Tracer::Enable(Tracer::kDefaultCapacity);
+  uint64_t id = Tracer::AsyncId(this, 1024);
+  EXPECT_NE(id, Tracer::AsyncId(this, 2048));
+  Tracer::BeginAsync("io", "ReadChunk", id, "length", 512);
+  Tracer::EndAsync("io", "ReadChunk", id);
+
+  std::string trace = Tracer::DumpJson();
+  EXPECT_EQ(1, CountOccurrences(trace, "\"ph\":\"b\""));
+  EXPECT_EQ(1, CountOccurrences(trace, "\"ph\":\"e\""));
+  EXPECT_EQ(1, CountOccurrences(trace, "\"args\":{\"length\":512}"));
+  // The beginning is dumped before the end.
+  EXPECT_LT(trace.find("\"ph\":\"b\""), trace.find("\"ph\":\"e\""));
+}
+
+TEST_F(TracerTest, RingBufferKeepsLastEvents) {
+  Tracer::Enable(2);
+  Tracer::BeginAsync("io", "First", 1, NULL, 0);
+  Tracer::BeginAsync("io", "Second", 2, NULL, 0);
+  Tracer::BeginAsync("io", "Third", 3, NULL, 0);
+
+  std::string trace = Tracer::DumpJson();
+  EXPECT_EQ(0, CountOccurrences(trace, "First"));
+  EXPECT_EQ(0, CountOccurrences(trace, "\"args\""));
+  EXPECT_LT(trace.find("Second"), trace.find("Third"));
+
+  // Enabling again drops the events.
+  Tracer::Enable(2);
+  EXPECT_EQ(kEmptyTrace, Tracer::DumpJson());
+}
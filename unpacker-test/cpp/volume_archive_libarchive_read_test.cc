@@ -260,3 +260,260 @@ TEST_F(VolumeArchiveLibarchiveReadTest, ReadFailureAfterSucessfulRead) {
     EXPECT_EQ(read_data_error, volume_archive->error_message());
   }
 }
+
+// Test ReadDataInto with consecutive chunks that cover all of the data.
+TEST_F(VolumeArchiveLibarchiveReadTest, ReadIntoSuccessConsecutiveChunks) {
+  fake_lib_archive_config::archive_data = kArchiveData;
+  fake_lib_archive_config::archive_data_size = sizeof(kArchiveData);
+  int64_t archive_data_size = fake_lib_archive_config::archive_data_size;
+
+  char buffer[sizeof(kArchiveData)];
+  int64_t length = archive_data_size / 3;
+  EXPECT_EQ(length, volume_archive->ReadDataInto(0, length, buffer));
+  EXPECT_EQ(length,
+            volume_archive->ReadDataInto(length, length, buffer + length));
+  EXPECT_EQ(archive_data_size - 2 * length,
+            volume_archive->ReadDataInto(2 * length,
+                                         archive_data_size,
+                                         buffer + 2 * length));
+  EXPECT_EQ(0, memcmp(buffer, kArchiveData, archive_data_size));
+}
+
+// Test ReadDataInto with an offset that requires skipping data.
+TEST_F(VolumeArchiveLibarchiveReadTest, ReadIntoSuccessWithSkip) {
+  fake_lib_archive_config::archive_data = kArchiveData;
+  fake_lib_archive_config::archive_data_size = sizeof(kArchiveData);
+  int64_t archive_data_size = fake_lib_archive_config::archive_data_size;
+
+  char buffer[sizeof(kArchiveData)];
+  int64_t offset = archive_data_size / 2;
+  int64_t length = archive_data_size - offset;
+  EXPECT_EQ(length, volume_archive->ReadDataInto(offset, length, buffer));
+  EXPECT_EQ(0, memcmp(buffer, kArchiveData + offset, length));
+}
+
+// Test ReadDataInto uses the data decompressed ahead by ReadData.
+TEST_F(VolumeArchiveLibarchiveReadTest, ReadIntoSuccessAfterDecompressAhead) {
+  fake_lib_archive_config::archive_data = kArchiveData;
+  fake_lib_archive_config::archive_data_size = sizeof(kArchiveData);
+  int64_t archive_data_size = fake_lib_archive_config::archive_data_size;
+
+  int64_t length = archive_data_size / 4;
+  const char* read_data_buffer = NULL;
+  EXPECT_EQ(length, volume_archive->ReadData(0, length, &read_data_buffer));
+  volume_archive->MaybeDecompressAhead();
+
+  char buffer[sizeof(kArchiveData)];
+  int64_t offset = archive_data_size / 2;
+  EXPECT_EQ(length, volume_archive->ReadDataInto(offset, length, buffer));
+  EXPECT_EQ(0, memcmp(buffer, kArchiveData + offset, length));
+}
+
+// Test ReadDataInto with length greater than
+// volume_archive_constants::kDecompressBufferSize.
+TEST_F(VolumeArchiveLibarchiveReadTest, ReadIntoSuccessForLargeLength) {
+  int64_t buffer_length = volume_archive_constants::kDecompressBufferSize * 2;
+
+  char* expected_buffer = new char[buffer_length];  // Stack is small for tests.
+  memset(expected_buffer, 1, buffer_length);
+  fake_lib_archive_config::archive_data = expected_buffer;
+  fake_lib_archive_config::archive_data_size = buffer_length;
+
+  char* buffer = new char[buffer_length];
+  EXPECT_EQ(buffer_length,
+            volume_archive->ReadDataInto(0, buffer_length, buffer));
+  EXPECT_EQ(0, memcmp(buffer, expected_buffer, buffer_length));
+
+  delete[] buffer;
+  delete[] expected_buffer;
+}
+
+// Test reads that arrive out of order are served from the reorder buffer.
+TEST_F(VolumeArchiveLibarchiveReadTest, ReadIntoSuccessForBackwardsOffset) {
+  fake_lib_archive_config::archive_data = kArchiveData;
+  fake_lib_archive_config::archive_data_size = sizeof(kArchiveData);
+  int64_t archive_data_size = fake_lib_archive_config::archive_data_size;
+
+  char buffer[sizeof(kArchiveData)];
+  int64_t offset = archive_data_size / 2;
+  int64_t length = archive_data_size - offset;
+  EXPECT_EQ(length, volume_archive->ReadDataInto(offset, length, buffer));
+  EXPECT_EQ(0, memcmp(buffer, kArchiveData + offset, length));
+
+  EXPECT_EQ(offset, volume_archive->ReadDataInto(0, offset, buffer));
+  EXPECT_EQ(0, memcmp(buffer, kArchiveData, offset));
+}
+
+// Test ReadData serves reads that arrive out of order from the reorder buffer.
+TEST_F(VolumeArchiveLibarchiveReadTest, ReadSuccessForBackwardsOffset) {
+  fake_lib_archive_config::archive_data = kArchiveData;
+  fake_lib_archive_config::archive_data_size = sizeof(kArchiveData);
+  int64_t archive_data_size = fake_lib_archive_config::archive_data_size;
+
+  int64_t offset = archive_data_size / 2;
+  const char* buffer = NULL;
+  int64_t read_bytes = volume_archive->ReadData(offset, 1, &buffer);
+  EXPECT_EQ(1, read_bytes);
+  EXPECT_EQ(kArchiveData[offset], buffer[0]);
+
+  read_bytes = volume_archive->ReadData(0, offset, &buffer);
+  EXPECT_LT(0, read_bytes);
+  EXPECT_GE(offset, read_bytes);
+  EXPECT_EQ(0, memcmp(buffer, kArchiveData, read_bytes));
+}
+
+// Test reads before the data kept in the reorder buffer fail.
+TEST_F(VolumeArchiveLibarchiveReadTest, ReadIntoFailureForBackwardsOffset) {
+  int64_t buffer_length = volume_archive_constants::kReorderBufferSize * 2;
+
+  char* expected_buffer = new char[buffer_length];
+  memset(expected_buffer, 1, buffer_length);
+  fake_lib_archive_config::archive_data = expected_buffer;
+  fake_lib_archive_config::archive_data_size = buffer_length;
+
+  char buffer[1];
+  EXPECT_EQ(1, volume_archive->ReadDataInto(buffer_length - 1, 1, buffer));
+  EXPECT_EQ(1, volume_archive->ReadDataInto(
+                   buffer_length - volume_archive_constants::kReorderBufferSize,
+                   1, buffer));
+  EXPECT_GT(0, volume_archive->ReadDataInto(0, 1, buffer));
+
+  delete[] expected_buffer;
+}
+
+TEST_F(VolumeArchiveLibarchiveReadTest, ReadIntoFailure) {
+  fake_lib_archive_config::archive_data = NULL;
+  char buffer[10];
+  EXPECT_GT(0, volume_archive->ReadDataInto(0, sizeof(buffer), buffer));
+
+  std::string read_data_error =
+      std::string(volume_archive_constants::kArchiveReadDataErrorPrefix) +
+      fake_lib_archive_config::kArchiveError;
+  EXPECT_EQ(read_data_error, volume_archive->error_message());
+}
+
+// Test the decompress window grows for sequential reads up to its maximum.
+TEST_F(VolumeArchiveLibarchiveReadTest, SequentialReadsGrowDecompressWindow) {
+  int64_t buffer_length =
+      volume_archive_constants::kMaximumDecompressWindowSize * 4;
+  char* expected_buffer = new char[buffer_length];
+  memset(expected_buffer, 1, buffer_length);
+  fake_lib_archive_config::archive_data = expected_buffer;
+  fake_lib_archive_config::archive_data_size = buffer_length;
+
+  int64_t offset = 0;
+  int64_t length = volume_archive_constants::kDecompressBufferSize;
+  for (int i = 0; i < 8; ++i) {
+    const char* buffer = NULL;
+    int64_t read_bytes = volume_archive->ReadData(offset, length, &buffer);
+    ASSERT_LT(0, read_bytes);
+    offset += read_bytes;
+    volume_archive->MaybeDecompressAhead();
+  }
+  EXPECT_EQ(VolumeArchiveLibarchive::ACCESS_SEQUENTIAL,
+            volume_archive->access_pattern());
+  EXPECT_EQ(volume_archive_constants::kMaximumDecompressWindowSize,
+            volume_archive->decompress_window_size());
+  // The reads from VolumeReader grow with the window.
+  EXPECT_EQ(volume_archive_constants::kMaximumDecompressWindowSize,
+            volume_archive->reader_data_size());
+
+  delete[] expected_buffer;
+}
+
+// Test strided reads keep the decompress window.
+TEST_F(VolumeArchiveLibarchiveReadTest, StridedReadsKeepDecompressWindow) {
+  int64_t buffer_length = volume_archive_constants::kDecompressBufferSize * 8;
+  char* expected_buffer = new char[buffer_length];
+  memset(expected_buffer, 1, buffer_length);
+  fake_lib_archive_config::archive_data = expected_buffer;
+  fake_lib_archive_config::archive_data_size = buffer_length;
+
+  char buffer[16];
+  int64_t stride = volume_archive_constants::kDecompressBufferSize;
+  for (int64_t offset = 0; offset < buffer_length; offset += stride)
+    ASSERT_EQ(16, volume_archive->ReadDataInto(offset, 16, buffer));
+  EXPECT_EQ(VolumeArchiveLibarchive::ACCESS_STRIDED,
+            volume_archive->access_pattern());
+  // The first skip is random, as the stride is not known yet.
+  EXPECT_EQ(volume_archive_constants::kDecompressBufferSize,
+            volume_archive->decompress_window_size());
+
+  delete[] expected_buffer;
+}
+
+// Test random reads shrink the decompress window.
+TEST_F(VolumeArchiveLibarchiveReadTest, RandomReadsShrinkDecompressWindow) {
+  int64_t buffer_length = volume_archive_constants::kDecompressBufferSize * 8;
+  char* expected_buffer = new char[buffer_length];
+  memset(expected_buffer, 1, buffer_length);
+  fake_lib_archive_config::archive_data = expected_buffer;
+  fake_lib_archive_config::archive_data_size = buffer_length;
+
+  char buffer[16];
+  ASSERT_EQ(16, volume_archive->ReadDataInto(0, 16, buffer));
+  ASSERT_EQ(16, volume_archive->ReadDataInto(16, 16, buffer));
+  EXPECT_LT(volume_archive_constants::kDecompressBufferSize,
+            volume_archive->decompress_window_size());
+
+  ASSERT_EQ(16, volume_archive->ReadDataInto(1000, 16, buffer));
+  ASSERT_EQ(16, volume_archive->ReadDataInto(5000, 16, buffer));
+  EXPECT_EQ(VolumeArchiveLibarchive::ACCESS_RANDOM,
+            volume_archive->access_pattern());
+  EXPECT_EQ(volume_archive_constants::kDecompressBufferSize,
+            volume_archive->decompress_window_size());
+
+  delete[] expected_buffer;
+}
+
+// Test reads served from the reorder buffer don't change the access pattern.
+TEST_F(VolumeArchiveLibarchiveReadTest, ReorderBufferReadsKeepAccessPattern) {
+  int64_t buffer_length = volume_archive_constants::kDecompressBufferSize * 8;
+  char* expected_buffer = new char[buffer_length];
+  memset(expected_buffer, 1, buffer_length);
+  fake_lib_archive_config::archive_data = expected_buffer;
+  fake_lib_archive_config::archive_data_size = buffer_length;
+
+  char buffer[16];
+  ASSERT_EQ(16, volume_archive->ReadDataInto(1000, 16, buffer));
+  ASSERT_EQ(16, volume_archive->ReadDataInto(1016, 16, buffer));
+  int64_t decompress_window_size = volume_archive->decompress_window_size();
+  EXPECT_LT(volume_archive_constants::kDecompressBufferSize,
+            decompress_window_size);
+
+  ASSERT_EQ(16, volume_archive->ReadDataInto(0, 16, buffer));
+  const char* data = NULL;
+  ASSERT_EQ(16, volume_archive->ReadData(16, 16, &data));
+  EXPECT_EQ(VolumeArchiveLibarchive::ACCESS_SEQUENTIAL,
+            volume_archive->access_pattern());
+  EXPECT_EQ(decompress_window_size, volume_archive->decompress_window_size());
+
+  delete[] expected_buffer;
+}
+
+// Test parallel readers of the same file keep a grown decompress window. The
+// reader behind is served from the reorder buffer, while the reader ahead
+// reads sequentially.
+TEST_F(VolumeArchiveLibarchiveReadTest, InterleavedReadsKeepDecompressWindow) {
+  int64_t buffer_length = volume_archive_constants::kDecompressBufferSize * 8;
+  char* expected_buffer = new char[buffer_length];
+  memset(expected_buffer, 1, buffer_length);
+  fake_lib_archive_config::archive_data = expected_buffer;
+  fake_lib_archive_config::archive_data_size = buffer_length;
+
+  char buffer[16];
+  int64_t behind_offset = 0;
+  int64_t ahead_offset = 4096;
+  for (int i = 0; i < 8; ++i) {
+    ASSERT_EQ(16, volume_archive->ReadDataInto(ahead_offset, 16, buffer));
+    ahead_offset += 16;
+    ASSERT_EQ(16, volume_archive->ReadDataInto(behind_offset, 16, buffer));
+    behind_offset += 16;
+  }
+  EXPECT_EQ(VolumeArchiveLibarchive::ACCESS_SEQUENTIAL,
+            volume_archive->access_pattern());
+  EXPECT_EQ(volume_archive_constants::kMaximumDecompressWindowSize,
+            volume_archive->decompress_window_size());
+
+  delete[] expected_buffer;
+}
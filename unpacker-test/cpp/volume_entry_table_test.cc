@@ -0,0 +1,132 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "volume_entry_table.h"
+
+#include <sstream>
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+const int64_t kSize = 1024;
+const time_t kModificationTime = 1000;
+
+}  // namespace
+
+TEST(VolumeEntryTableTest, Empty) {
+  VolumeEntryTable table;
+  EXPECT_EQ(1u, table.size());
+  EXPECT_TRUE(table.is_directory(VolumeEntryTable::kRootId));
+  EXPECT_STREQ("", table.name(VolumeEntryTable::kRootId));
+  EXPECT_EQ(VolumeEntryTable::kInvalidId, table.AddEntry("", 0, false, 0, 0));
+  EXPECT_EQ(1u, table.size());
+}
+
+TEST(VolumeEntryTableTest, AddEntry) {
+  VolumeEntryTable table;
+  VolumeEntryTable::EntryId id =
+      table.AddEntry("file.txt", 3, false, kSize, kModificationTime);
+
+  EXPECT_EQ(2u, table.size());
+  EXPECT_EQ(VolumeEntryTable::kRootId, table.parent_id(id));
+  EXPECT_STREQ("file.txt", table.name(id));
+  EXPECT_EQ(3, table.archive_index(id));
+  EXPECT_FALSE(table.is_directory(id));
+  EXPECT_EQ(kSize, table.file_size(id));
+  EXPECT_EQ(kModificationTime, table.modification_time(id));
+}
+
+TEST(VolumeEntryTableTest, AddEntryCreatesParentDirectories) {
+  VolumeEntryTable table;
+  VolumeEntryTable::EntryId id =
+      table.AddEntry("./a/b/file.txt", 0, false, kSize, kModificationTime);
+
+  EXPECT_EQ(4u, table.size());
+  VolumeEntryTable::EntryId b_id = table.parent_id(id);
+  EXPECT_STREQ("b", table.name(b_id));
+  EXPECT_TRUE(table.is_directory(b_id));
+  EXPECT_EQ(-1, table.archive_index(b_id));
+  EXPECT_EQ(kModificationTime, table.modification_time(b_id));
+
+  VolumeEntryTable::EntryId a_id = table.parent_id(b_id);
+  EXPECT_STREQ("a", table.name(a_id));
+  EXPECT_EQ(VolumeEntryTable::kRootId, table.parent_id(a_id));
+  EXPECT_LT(a_id, b_id);
+  EXPECT_LT(b_id, id);
+}
+
+TEST(VolumeEntryTableTest, AddDirectoryAfterItsChildren) {
+  VolumeEntryTable table;
+  VolumeEntryTable::EntryId file_id =
+      table.AddEntry("dir/file.txt", 0, false, kSize, kModificationTime);
+  VolumeEntryTable::EntryId dir_id =
+      table.AddEntry("dir/", 1, true, 0, kModificationTime + 1);
+
+  EXPECT_EQ(3u, table.size());
+  EXPECT_EQ(dir_id, table.parent_id(file_id));
+  EXPECT_TRUE(table.is_directory(dir_id));
+  EXPECT_EQ(1, table.archive_index(dir_id));
+  EXPECT_EQ(kModificationTime + 1, table.modification_time(dir_id));
+}
+
+TEST(VolumeEntryTableTest, SameNameInDifferentDirectories) {
+  VolumeEntryTable table;
+  VolumeEntryTable::EntryId first_id =
+      table.AddEntry("a/file.txt", 0, false, kSize, kModificationTime);
+  VolumeEntryTable::EntryId second_id =
+      table.AddEntry("b/file.txt", 1, false, kSize, kModificationTime);
+
+  EXPECT_NE(first_id, second_id);
+  // Names are stored only once.
+  EXPECT_EQ(table.name(first_id), table.name(second_id));
+}
+
+TEST(VolumeEntryTableTest, ManyEntries) {
+  const int kEntries = 10000;
+  VolumeEntryTable table;
+  for (int i = 0; i < kEntries; ++i) {
+    std::stringstream path;
+    path << "dir" << i % 10 << "/file" << i;
+    table.AddEntry(path.str(), i, false, i, kModificationTime);
+  }
+  table.Compact();
+
+  // The entries, the 10 directories and the root.
+  EXPECT_EQ(static_cast<size_t>(kEntries + 10 + 1), table.size());
+  EXPECT_LT(table.MemoryUsage() / table.size(), 100u);
+
+  // Adding an existing entry again doesn't create a new one.
+  VolumeEntryTable::EntryId id =
+      table.AddEntry("dir7/file1237", 1237, false, 5, kModificationTime);
+  EXPECT_EQ(static_cast<size_t>(kEntries + 10 + 1), table.size());
+  EXPECT_EQ(5, table.file_size(id));
+  EXPECT_STREQ("dir7", table.name(table.parent_id(id)));
+}
+
+TEST(VolumeEntryTableTest, FindEntry) {
+  VolumeEntryTable table;
+  VolumeEntryTable::EntryId file_id =
+      table.AddEntry("a/b/file.txt", 0, false, kSize, kModificationTime);
+  VolumeEntryTable::EntryId dir_id = table.parent_id(file_id);
+
+  EXPECT_EQ(file_id, table.FindEntry("a/b/file.txt"));
+  EXPECT_EQ(file_id, table.FindEntry("/a/b/file.txt"));
+  EXPECT_EQ(file_id, table.FindEntry("./a/b/file.txt"));
+  EXPECT_EQ(dir_id, table.FindEntry("/a/b/"));
+  EXPECT_EQ(VolumeEntryTable::kRootId, table.FindEntry("/"));
+
+  EXPECT_EQ(VolumeEntryTable::kInvalidId, table.FindEntry("/a/file.txt"));
+  EXPECT_EQ(VolumeEntryTable::kInvalidId, table.FindEntry("/a/b/missing"));
+  EXPECT_EQ(VolumeEntryTable::kInvalidId, table.FindEntry("/a/b/file"));
+}
+
+TEST(VolumeEntryTableTest, Clear) {
+  VolumeEntryTable table;
+  table.AddEntry("a/b/c", 0, false, kSize, kModificationTime);
+  table.Clear();
+  EXPECT_EQ(1u, table.size());
+  EXPECT_TRUE(table.is_directory(VolumeEntryTable::kRootId));
+}
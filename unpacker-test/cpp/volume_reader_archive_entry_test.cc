@@ -0,0 +1,391 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "volume_reader_archive_entry.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "fake_volume_reader.h"
+#include "gtest/gtest.h"
+#include "ppapi/cpp/logging.h"
+
+namespace {
+
+// The index of the entry read by the tests and the number of entries.
+const int64_t kEntryIndex = 2;
+const int64_t kEntryCount = 4;
+
+// Where the data of the entry with kEntryIndex starts in the outer archive.
+const int64_t kEntryDataOffset = 64;
+
+const char kPassphrase[] = "secret";
+
+// Counts the outer archives opened by VolumeReaderArchiveEntry and the reads
+// of their data.
+struct OpenerLog {
+  OpenerLog() : opened(0), closed(0), read_data_calls(0), reader_bytes(0) {}
+
+  int opened;
+  int closed;
+  int read_data_calls;  // The calls of VolumeArchive::ReadData.
+  int64_t reader_bytes;  // The bytes read with VolumeArchive::reader().
+};
+
+// A reader of the data of the outer archive that provides a passphrase.
+class OuterVolumeReader : public FakeVolumeReader {
+ public:
+  OuterVolumeReader(const std::vector<char>* archive_data, OpenerLog* log)
+      : archive_data_(archive_data), log_(log), offset_(0) {}
+
+  int64_t Read(int64_t bytes_to_read, const void** destination_buffer) {
+    int64_t read_bytes = std::min(
+        bytes_to_read, static_cast<int64_t>(archive_data_->size()) - offset_);
+    *destination_buffer = &(*archive_data_)[0] + offset_;
+    offset_ += read_bytes;
+    log_->reader_bytes += read_bytes;
+    return read_bytes;
+  }
+
+  int64_t Seek(int64_t offset, int whence) {
+    PP_DCHECK(whence == SEEK_SET);
+    if (offset < 0 || offset > static_cast<int64_t>(archive_data_->size()))
+      return ARCHIVE_FATAL;
+    offset_ = offset;
+    return offset_;
+  }
+
+  const char* Passphrase() { return kPassphrase; }
+
+ private:
+  const std::vector<char>* archive_data_;
+  OpenerLog* log_;
+  int64_t offset_;
+};
+
+// An outer archive that returns the data of the entry with kEntryIndex without
+// copying it. Like VolumeArchiveLibarchive, it can't read backwards. In case
+// the entry is stored, the data can be read with the reader of the archive as
+// well.
+class FakeOuterArchive : public VolumeArchive {
+ public:
+  FakeOuterArchive(const std::vector<char>* archive_data,
+                   bool has_index,
+                   bool stored,
+                   OpenerLog* log)
+      : VolumeArchive(new OuterVolumeReader(archive_data, log)),
+        archive_data_(archive_data),
+        has_index_(has_index),
+        stored_(stored),
+        log_(log),
+        last_read_offset_(0) {
+    curr_index = 0;
+  }
+
+  virtual ~FakeOuterArchive() { Cleanup(); }
+
+  virtual bool Init(const std::string& encoding, bool raw) { return true; }
+
+  virtual Result GetNextHeader() {
+    last_read_offset_ = 0;
+    ++curr_index;
+    return curr_index <= kEntryCount ? RESULT_SUCCESS : RESULT_EOF;
+  }
+
+  virtual Result GetNextHeader(const char** path_name,
+                               int64_t* size,
+                               bool* is_directory,
+                               time_t* modification_time) {
+    return GetNextHeader();
+  }
+
+  virtual bool SeekHeader(int64_t index) {
+    if (!has_index_)
+      return false;
+    curr_index = index;
+    return true;
+  }
+
+  virtual int64_t ReadData(int64_t offset,
+                           int64_t length,
+                           const char** buffer) {
+    ++log_->read_data_calls;
+    // The entry with kEntryIndex was reached with GetNextHeader.
+    if (curr_index != kEntryIndex + 1 || offset < last_read_offset_)
+      return -1;
+    int64_t read_bytes = std::min(
+        length,
+        static_cast<int64_t>(archive_data_->size()) - kEntryDataOffset -
+            offset);
+    *buffer = &(*archive_data_)[kEntryDataOffset + offset];
+    last_read_offset_ = offset + read_bytes;
+    return read_bytes;
+  }
+
+  virtual int64_t ReadDataInto(int64_t offset,
+                               int64_t length,
+                               char* destination) {
+    const char* buffer = NULL;
+    int64_t read_bytes = ReadData(offset, length, &buffer);
+    if (read_bytes > 0)
+      memcpy(destination, buffer, read_bytes);
+    return read_bytes;
+  }
+
+  virtual void MaybeDecompressAhead() {}
+
+  virtual int64_t GetStoredDataOffset() {
+    return stored_ && curr_index == kEntryIndex + 1 ? kEntryDataOffset : -1;
+  }
+
+  virtual bool Cleanup() {
+    CleanupReader();
+    return true;
+  }
+
+ private:
+  const std::vector<char>* archive_data_;
+  const bool has_index_;
+  const bool stored_;
+  OpenerLog* log_;
+  int64_t last_read_offset_;
+};
+
+class FakeArchiveOpener : public ArchiveOpenerInterface {
+ public:
+  FakeArchiveOpener(const std::vector<char>* archive_data,
+                    bool has_index,
+                    bool stored,
+                    bool fail,
+                    OpenerLog* log)
+      : archive_data_(archive_data),
+        has_index_(has_index),
+        stored_(stored),
+        fail_(fail),
+        log_(log) {}
+
+  virtual VolumeArchive* Open() {
+    if (fail_)
+      return NULL;
+    ++log_->opened;
+    return new FakeOuterArchive(archive_data_, has_index_, stored_, log_);
+  }
+
+  virtual void Close(VolumeArchive* archive) {
+    ++log_->closed;
+    archive->Cleanup();
+    delete archive;
+  }
+
+ private:
+  const std::vector<char>* archive_data_;
+  const bool has_index_;
+  const bool stored_;
+  const bool fail_;
+  OpenerLog* log_;
+};
+
+}  // namespace
+
+class VolumeReaderArchiveEntryTest : public testing::Test {
+ protected:
+  VolumeReaderArchiveEntryTest() : stored_(false) {}
+
+  virtual void SetUp() {
+    entry_data_.resize(1000);
+    for (size_t i = 0; i < entry_data_.size(); ++i)
+      entry_data_[i] = static_cast<char>(i % 251);
+    archive_data_.assign(kEntryDataOffset, 0);
+    archive_data_.insert(archive_data_.end(), entry_data_.begin(),
+                         entry_data_.end());
+  }
+
+  VolumeReaderArchiveEntry* CreateReader(bool has_index, bool fail) {
+    return new VolumeReaderArchiveEntry(
+        new FakeArchiveOpener(&archive_data_, has_index, stored_, fail, &log_),
+        kEntryIndex, entry_data_.size());
+  }
+
+  // Checks that length bytes were read without copying from offset.
+  void ExpectEntryData(const void* buffer, int64_t offset, int64_t length) {
+    EXPECT_EQ(0, memcmp(&entry_data_[offset], buffer, length));
+  }
+
+  std::vector<char> entry_data_;
+  std::vector<char> archive_data_;  // The entry data after kEntryDataOffset.
+  bool stored_;  // Whether the entry is stored in the outer archive as is.
+  OpenerLog log_;
+};
+
+TEST_F(VolumeReaderArchiveEntryTest, ReadWholeEntry) {
+  VolumeReaderArchiveEntry* reader = CreateReader(true, false);
+
+  const void* buffer = NULL;
+  int64_t offset = 0;
+  int64_t read_bytes = 0;
+  while ((read_bytes = reader->Read(300, &buffer)) > 0) {
+    ExpectEntryData(buffer, offset, read_bytes);
+    offset += read_bytes;
+    EXPECT_EQ(offset, reader->offset());
+  }
+  EXPECT_EQ(0, read_bytes);
+  EXPECT_EQ(static_cast<int64_t>(entry_data_.size()), offset);
+  EXPECT_EQ(1, log_.opened);
+
+  delete reader;
+  EXPECT_EQ(1, log_.closed);
+}
+
+TEST_F(VolumeReaderArchiveEntryTest, ReadEntryOfArchiveWithoutIndex) {
+  VolumeReaderArchiveEntry* reader = CreateReader(false, false);
+
+  const void* buffer = NULL;
+  EXPECT_EQ(100, reader->Read(100, &buffer));
+  ExpectEntryData(buffer, 0, 100);
+  EXPECT_EQ(1, log_.opened);
+
+  delete reader;
+}
+
+TEST_F(VolumeReaderArchiveEntryTest, ReadFailsIfOpenFails) {
+  VolumeReaderArchiveEntry* reader = CreateReader(true, true);
+
+  const void* buffer = NULL;
+  EXPECT_EQ(ARCHIVE_FATAL, reader->Read(100, &buffer));
+  EXPECT_EQ(NULL, reader->Passphrase());
+
+  delete reader;
+  EXPECT_EQ(0, log_.closed);
+}
+
+TEST_F(VolumeReaderArchiveEntryTest, SeekForward) {
+  VolumeReaderArchiveEntry* reader = CreateReader(true, false);
+
+  const void* buffer = NULL;
+  EXPECT_EQ(100, reader->Read(100, &buffer));
+  EXPECT_EQ(500, reader->Seek(500, SEEK_SET));
+  EXPECT_EQ(100, reader->Read(100, &buffer));
+  ExpectEntryData(buffer, 500, 100);
+  EXPECT_EQ(1, log_.opened);
+
+  delete reader;
+}
+
+TEST_F(VolumeReaderArchiveEntryTest, SeekBackwardsSeeksHeader) {
+  VolumeReaderArchiveEntry* reader = CreateReader(true, false);
+
+  const void* buffer = NULL;
+  EXPECT_EQ(500, reader->Read(500, &buffer));
+  EXPECT_EQ(10, reader->Seek(10, SEEK_SET));
+  EXPECT_EQ(100, reader->Read(100, &buffer));
+  ExpectEntryData(buffer, 10, 100);
+
+  // The outer archive has an index, so it is reused.
+  EXPECT_EQ(1, log_.opened);
+  EXPECT_EQ(0, log_.closed);
+
+  delete reader;
+}
+
+TEST_F(VolumeReaderArchiveEntryTest, SeekBackwardsReopensArchiveWithoutIndex) {
+  VolumeReaderArchiveEntry* reader = CreateReader(false, false);
+
+  const void* buffer = NULL;
+  EXPECT_EQ(500, reader->Read(500, &buffer));
+  EXPECT_EQ(10, reader->Seek(10, SEEK_SET));
+  EXPECT_EQ(100, reader->Read(100, &buffer));
+  ExpectEntryData(buffer, 10, 100);
+
+  EXPECT_EQ(2, log_.opened);
+  EXPECT_EQ(1, log_.closed);
+
+  delete reader;
+  EXPECT_EQ(2, log_.closed);
+}
+
+TEST_F(VolumeReaderArchiveEntryTest, Seek) {
+  VolumeReaderArchiveEntry* reader = CreateReader(true, false);
+  int64_t size = entry_data_.size();
+
+  EXPECT_EQ(100, reader->Seek(100, SEEK_SET));
+  EXPECT_EQ(150, reader->Seek(50, SEEK_CUR));
+  EXPECT_EQ(size - 10, reader->Seek(-10, SEEK_END));
+  EXPECT_EQ(size, reader->Seek(0, SEEK_END));
+
+  EXPECT_EQ(ARCHIVE_FATAL, reader->Seek(-1, SEEK_SET));
+  EXPECT_EQ(ARCHIVE_FATAL, reader->Seek(1, SEEK_END));
+  EXPECT_EQ(size, reader->offset());
+
+  // Reading at the end of the entry doesn't open the outer archive.
+  const void* buffer = NULL;
+  EXPECT_EQ(0, reader->Read(100, &buffer));
+  EXPECT_EQ(0, log_.opened);
+
+  delete reader;
+}
+
+TEST_F(VolumeReaderArchiveEntryTest, Skip) {
+  VolumeReaderArchiveEntry* reader = CreateReader(true, false);
+  int64_t size = entry_data_.size();
+
+  EXPECT_EQ(100, reader->Skip(100));
+  EXPECT_EQ(0, reader->Skip(size));
+  EXPECT_EQ(0, reader->Skip(-1));
+  EXPECT_EQ(100, reader->offset());
+
+  const void* buffer = NULL;
+  EXPECT_EQ(50, reader->Read(50, &buffer));
+  ExpectEntryData(buffer, 100, 50);
+
+  delete reader;
+}
+
+TEST_F(VolumeReaderArchiveEntryTest, PassphraseFromOuterArchive) {
+  VolumeReaderArchiveEntry* reader = CreateReader(true, false);
+  EXPECT_STREQ(kPassphrase, reader->Passphrase());
+  delete reader;
+}
+
+TEST_F(VolumeReaderArchiveEntryTest, ReadStoredEntry) {
+  stored_ = true;
+  VolumeReaderArchiveEntry* reader = CreateReader(true, false);
+
+  const void* buffer = NULL;
+  int64_t offset = 0;
+  int64_t read_bytes = 0;
+  while ((read_bytes = reader->Read(300, &buffer)) > 0) {
+    ExpectEntryData(buffer, offset, read_bytes);
+    offset += read_bytes;
+  }
+  EXPECT_EQ(0, read_bytes);
+  EXPECT_EQ(static_cast<int64_t>(entry_data_.size()), offset);
+
+  // The data is read directly from the reader of the outer archive.
+  EXPECT_EQ(0, log_.read_data_calls);
+  EXPECT_EQ(static_cast<int64_t>(entry_data_.size()), log_.reader_bytes);
+
+  delete reader;
+}
+
+TEST_F(VolumeReaderArchiveEntryTest, SeekBackwardsInStoredEntry) {
+  stored_ = true;
+  VolumeReaderArchiveEntry* reader = CreateReader(false, false);
+
+  const void* buffer = NULL;
+  EXPECT_EQ(500, reader->Read(500, &buffer));
+  EXPECT_EQ(10, reader->Seek(10, SEEK_SET));
+  EXPECT_EQ(100, reader->Read(100, &buffer));
+  ExpectEntryData(buffer, 10, 100);
+
+  // The entry is not read again from its beginning, even though the outer
+  // archive has no index.
+  EXPECT_EQ(1, log_.opened);
+  EXPECT_EQ(0, log_.closed);
+  EXPECT_EQ(0, log_.read_data_calls);
+  EXPECT_EQ(600, log_.reader_bytes);
+
+  delete reader;
+}
@@ -0,0 +1,248 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "volume_reader_multi_part.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+const char kPassphrase[] = "secret";
+const char kRequestId[] = "7";
+
+// What the parts were asked for, shared by the parts of a reader.
+struct PartLog {
+  std::vector<size_t> read_ahead_parts;  // The parts read ahead, in order.
+  std::vector<std::string> request_ids;  // The request id of every part.
+};
+
+// A part of an archive kept in memory.
+class FakePart : public VolumeReader {
+ public:
+  FakePart(const char* data, int64_t size, size_t index, PartLog* log)
+      : data_(data), size_(size), index_(index), offset_(0), fail_(false),
+        log_(log) {}
+
+  virtual int64_t Read(int64_t bytes_to_read, const void** destination_buffer) {
+    if (fail_)
+      return ARCHIVE_FATAL;
+    int64_t read_bytes = std::min(bytes_to_read, size_ - offset_);
+    *destination_buffer = data_ + offset_;
+    offset_ += read_bytes;
+    return read_bytes;
+  }
+
+  virtual int64_t Skip(int64_t bytes_to_skip) { return 0; }
+
+  virtual int64_t Seek(int64_t offset, int whence) {
+    EXPECT_EQ(SEEK_SET, whence);
+    if (offset < 0 || offset > size_)
+      return ARCHIVE_FATAL;
+    offset_ = offset;
+    return offset;
+  }
+
+  virtual const char* Passphrase() { return index_ == 0 ? kPassphrase : NULL; }
+
+  virtual void ReadAhead(int64_t bytes_to_read) {
+    EXPECT_EQ(0, offset_);  // Only the beginning of the parts is read ahead.
+    log_->read_ahead_parts.push_back(index_);
+  }
+
+  virtual void SetRequestId(const std::string& request_id) {
+    log_->request_ids[index_] = request_id;
+  }
+
+  void set_fail(bool fail) { fail_ = fail; }
+
+ private:
+  const char* data_;
+  const int64_t size_;
+  const size_t index_;
+  int64_t offset_;
+  bool fail_;
+  PartLog* log_;
+};
+
+}  // namespace
+
+class VolumeReaderMultiPartTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    data_.resize(1000);
+    for (size_t i = 0; i < data_.size(); ++i)
+      data_[i] = static_cast<char>(i % 251);
+  }
+
+  // Creates a reader of data_ split into parts with part_sizes.
+  VolumeReaderMultiPart* CreateReader(const std::vector<int64_t>& part_sizes) {
+    std::vector<VolumeReader*> parts;
+    int64_t offset = 0;
+    for (size_t i = 0; i < part_sizes.size(); ++i) {
+      parts.push_back(new FakePart(&data_[offset], part_sizes[i], i, &log_));
+      offset += part_sizes[i];
+    }
+    EXPECT_EQ(static_cast<int64_t>(data_.size()), offset);
+    log_.request_ids.resize(part_sizes.size());
+    return new VolumeReaderMultiPart(parts, part_sizes);
+  }
+
+  // Splits data_ into 3 parts of 400, 400 and 200 bytes.
+  VolumeReaderMultiPart* CreateThreePartReader() {
+    std::vector<int64_t> part_sizes;
+    part_sizes.push_back(400);
+    part_sizes.push_back(400);
+    part_sizes.push_back(200);
+    return CreateReader(part_sizes);
+  }
+
+  // Checks that length bytes were read without copying from offset.
+  void ExpectData(const void* buffer, int64_t offset, int64_t length) {
+    EXPECT_EQ(0, memcmp(&data_[offset], buffer, length));
+  }
+
+  std::vector<char> data_;
+  PartLog log_;
+};
+
+TEST_F(VolumeReaderMultiPartTest, ReadWholeArchive) {
+  VolumeReaderMultiPart* reader = CreateThreePartReader();
+
+  const void* buffer = NULL;
+  int64_t offset = 0;
+  int64_t read_bytes = 0;
+  while ((read_bytes = reader->Read(300, &buffer)) > 0) {
+    ExpectData(buffer, offset, read_bytes);
+    offset += read_bytes;
+    EXPECT_EQ(offset, reader->offset());
+  }
+  EXPECT_EQ(0, read_bytes);
+  EXPECT_EQ(static_cast<int64_t>(data_.size()), offset);
+
+  delete reader;
+}
+
+TEST_F(VolumeReaderMultiPartTest, ReadStopsAtEndOfPart) {
+  VolumeReaderMultiPart* reader = CreateThreePartReader();
+
+  const void* buffer = NULL;
+  EXPECT_EQ(300, reader->Read(300, &buffer));
+  EXPECT_EQ(100, reader->Read(300, &buffer));
+  ExpectData(buffer, 300, 100);
+  EXPECT_EQ(300, reader->Read(300, &buffer));
+  ExpectData(buffer, 400, 300);
+
+  delete reader;
+}
+
+TEST_F(VolumeReaderMultiPartTest, ReadAheadNextPart) {
+  VolumeReaderMultiPart* reader = CreateThreePartReader();
+
+  const void* buffer = NULL;
+  EXPECT_EQ(300, reader->Read(300, &buffer));
+  EXPECT_TRUE(log_.read_ahead_parts.empty());
+
+  // The end of the first part is reached, so the second one is fetched.
+  EXPECT_EQ(100, reader->Read(300, &buffer));
+  ASSERT_EQ(1u, log_.read_ahead_parts.size());
+  EXPECT_EQ(1u, log_.read_ahead_parts[0]);
+
+  // Nothing is read ahead after the last part.
+  EXPECT_EQ(400, reader->Read(400, &buffer));
+  EXPECT_EQ(200, reader->Read(400, &buffer));
+  ASSERT_EQ(2u, log_.read_ahead_parts.size());
+  EXPECT_EQ(2u, log_.read_ahead_parts[1]);
+
+  delete reader;
+}
+
+TEST_F(VolumeReaderMultiPartTest, EmptyPartsAreSkipped) {
+  std::vector<int64_t> part_sizes;
+  part_sizes.push_back(500);
+  part_sizes.push_back(0);
+  part_sizes.push_back(500);
+  VolumeReaderMultiPart* reader = CreateReader(part_sizes);
+
+  const void* buffer = NULL;
+  EXPECT_EQ(500, reader->Read(600, &buffer));
+  ASSERT_EQ(1u, log_.read_ahead_parts.size());
+  EXPECT_EQ(2u, log_.read_ahead_parts[0]);
+
+  EXPECT_EQ(500, reader->Read(600, &buffer));
+  ExpectData(buffer, 500, 500);
+
+  delete reader;
+}
+
+TEST_F(VolumeReaderMultiPartTest, Seek) {
+  VolumeReaderMultiPart* reader = CreateThreePartReader();
+  int64_t size = data_.size();
+
+  EXPECT_EQ(100, reader->Seek(100, SEEK_SET));
+  EXPECT_EQ(550, reader->Seek(450, SEEK_CUR));
+  EXPECT_EQ(size - 10, reader->Seek(-10, SEEK_END));
+  EXPECT_EQ(size, reader->Seek(0, SEEK_END));
+
+  EXPECT_EQ(ARCHIVE_FATAL, reader->Seek(-1, SEEK_SET));
+  EXPECT_EQ(ARCHIVE_FATAL, reader->Seek(1, SEEK_END));
+  EXPECT_EQ(size, reader->offset());
+
+  const void* buffer = NULL;
+  EXPECT_EQ(0, reader->Read(100, &buffer));
+
+  // Seek backwards into another part.
+  EXPECT_EQ(350, reader->Seek(350, SEEK_SET));
+  EXPECT_EQ(50, reader->Read(100, &buffer));
+  ExpectData(buffer, 350, 50);
+
+  delete reader;
+}
+
+TEST_F(VolumeReaderMultiPartTest, Skip) {
+  VolumeReaderMultiPart* reader = CreateThreePartReader();
+  int64_t size = data_.size();
+
+  EXPECT_EQ(700, reader->Skip(700));
+  EXPECT_EQ(0, reader->Skip(size));
+  EXPECT_EQ(0, reader->Skip(-1));
+  EXPECT_EQ(700, reader->offset());
+
+  const void* buffer = NULL;
+  EXPECT_EQ(100, reader->Read(200, &buffer));
+  ExpectData(buffer, 700, 100);
+
+  delete reader;
+}
+
+TEST_F(VolumeReaderMultiPartTest, ReadFailsIfPartFails) {
+  VolumeReaderMultiPart* reader = CreateThreePartReader();
+  static_cast<FakePart*>(reader->part(1))->set_fail(true);
+
+  const void* buffer = NULL;
+  EXPECT_EQ(400, reader->Read(400, &buffer));
+  EXPECT_EQ(ARCHIVE_FATAL, reader->Read(400, &buffer));
+
+  delete reader;
+}
+
+TEST_F(VolumeReaderMultiPartTest, PassphraseFromFirstPart) {
+  VolumeReaderMultiPart* reader = CreateThreePartReader();
+  EXPECT_STREQ(kPassphrase, reader->Passphrase());
+  delete reader;
+}
+
+TEST_F(VolumeReaderMultiPartTest, SetRequestIdForAllParts) {
+  VolumeReaderMultiPart* reader = CreateThreePartReader();
+  reader->SetRequestId(kRequestId);
+  ASSERT_EQ(3u, log_.request_ids.size());
+  for (size_t i = 0; i < log_.request_ids.size(); ++i)
+    EXPECT_EQ(kRequestId, log_.request_ids[i]);
+  delete reader;
+}
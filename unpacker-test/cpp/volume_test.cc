@@ -4,28 +4,111 @@
 
 #include "volume.h"
 
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+
 #include "gtest/gtest.h"
+#include "ppapi/cpp/var_array.h"
 #include "ppapi_simple/ps_main.h"
 
+#include "fake_volume_reader.h"
 #include "request.h"
+#include "volume_entry_table.h"
 
 namespace {
 
 // A file system id used at the creation of Volume.
 const char kFileSystemId[] = "fileSystemId";
 
+// The encoding and the size of the fake archive.
+const char kEncoding[] = "CP1250";
+const int64_t kArchiveSize = 1000;
+
+// The maximum number of bytes returned by FakeVolumeArchive::ReadData, small
+// so the entries are read in many chunks.
+const int64_t kFakeChunkSize = 2;
+
+// The size of the chunks sent by READ_FILE and READ_FILES, as in volume.cc.
+const int64_t kReadFileChunkSize = 512 * 1024;
+
+// The time a test waits for a response of the volume before failing.
+const int kResponseTimeoutSeconds = 10;
+
+// Converts the data of an array buffer to a string.
+std::string ArrayBufferToString(const pp::VarArrayBuffer& array_buffer) {
+  pp::VarArrayBuffer buffer(array_buffer);
+  std::string data;
+  if (buffer.ByteLength() > 0) {
+    data.assign(static_cast<const char*>(buffer.Map()), buffer.ByteLength());
+    buffer.Unmap();
+  }
+  return data;
+}
+
 // A fake implementation of JavaScriptMessageSender used for testing purposes.
+// The responses are recorded as strings, so the tests can wait for them and
+// compare them. They are sent from the jobs of Volume, on the worker threads.
 class FakeJavaScriptMessageSender : public JavaScriptMessageSenderInterface {
  public:
+  FakeJavaScriptMessageSender() {
+    pthread_mutex_init(&lock_, NULL);
+    pthread_cond_init(&cond_, NULL);
+  }
+
+  virtual ~FakeJavaScriptMessageSender() {
+    pthread_cond_destroy(&cond_);
+    pthread_mutex_destroy(&lock_);
+  }
+
+  // Waits until response is recorded. Returns false on timeout.
+  bool WaitForResponse(const std::string& response) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    struct timespec deadline;
+    deadline.tv_sec = now.tv_sec + kResponseTimeoutSeconds;
+    deadline.tv_nsec = now.tv_usec * 1000;
+
+    pthread_mutex_lock(&lock_);
+    bool found = false;
+    for (;;) {
+      found = std::find(responses_.begin(), responses_.end(), response) !=
+              responses_.end();
+      if (found ||
+          pthread_cond_timedwait(&cond_, &lock_, &deadline) == ETIMEDOUT) {
+        break;
+      }
+    }
+    pthread_mutex_unlock(&lock_);
+    return found;
+  }
+
+  // Returns the responses recorded so far, in order.
+  std::vector<std::string> responses() {
+    pthread_mutex_lock(&lock_);
+    std::vector<std::string> responses(responses_);
+    pthread_mutex_unlock(&lock_);
+    return responses;
+  }
+
   virtual void SendFileSystemError(const std::string& file_system_id,
                                    const std::string& request_id,
-                                   const std::string& message) {}
+                                   const std::string& message) {
+    AddResponse("ERROR " + request_id + " " + message);
+  }
 
   virtual void SendCompressorError(int compressor_id,
                                    const std::string& message) {};
 
   virtual void SendFileChunkRequest(const std::string& file_system_id,
                                     const std::string& request_id,
+                                    int part_index,
                                     int64_t offset,
                                     int64_t bytes_to_read) {}
 
@@ -34,19 +117,66 @@ class FakeJavaScriptMessageSender : public JavaScriptMessageSenderInterface {
 
   virtual void SendReadMetadataDone(const std::string& file_system_id,
                                     const std::string& request_id,
-                                    const pp::VarDictionary& metadata) {}
+                                    const pp::VarDictionary& metadata) {
+    AddResponse("READ_METADATA_DONE " + request_id);
+  }
 
   virtual void SendOpenFileDone(const std::string& file_system_id,
-                                const std::string& request_id) {}
+                                const std::string& request_id) {
+    AddResponse("OPEN_FILE_DONE " + request_id);
+  }
 
   virtual void SendCloseFileDone(const std::string& file_system_id,
                                  const std::string& request_id,
-                                 const std::string& open_request_id) {}
+                                 const std::string& open_request_id) {
+    AddResponse("CLOSE_FILE_DONE " + request_id + " " + open_request_id);
+  }
 
   virtual void SendReadFileDone(const std::string& file_system_id,
                                 const std::string& request_id,
                                 const pp::VarArrayBuffer& array_buffer,
-                                bool has_more_data) {}
+                                bool has_more_data) {
+    AddResponse("READ_FILE_DONE " + request_id + " \"" +
+                ArrayBufferToString(array_buffer) + "\"" +
+                (has_more_data ? " more" : " last"));
+  }
+
+  virtual void SendReadFilesDone(const std::string& file_system_id,
+                                 const std::string& request_id,
+                                 int64_t index,
+                                 const pp::VarArrayBuffer& array_buffer,
+                                 bool has_more_data) {
+    std::stringstream response;
+    response << "READ_FILES_DONE " << request_id << " " << index << " \""
+             << ArrayBufferToString(array_buffer) << "\""
+             << (has_more_data ? " more" : " last");
+    AddResponse(response.str());
+  }
+
+  virtual void SendSearchDone(const std::string& file_system_id,
+                              const std::string& request_id,
+                              const pp::VarArray& hits,
+                              bool has_more_data) {}
+
+  virtual void SendHashEntriesDone(const std::string& file_system_id,
+                                   const std::string& request_id,
+                                   const pp::VarArray& digests,
+                                   bool has_more_data) {
+    std::stringstream response;
+    response << "HASH_ENTRIES_DONE " << request_id << " "
+             << digests.GetLength() << (has_more_data ? " more" : " last");
+    AddResponse(response.str());
+  }
+
+  virtual void SendStatPathDone(const std::string& file_system_id,
+                                const std::string& request_id,
+                                const pp::VarDictionary& metadata) {}
+
+  virtual void SendGetStatsDone(const std::string& request_id,
+                                const pp::VarDictionary& stats) {}
+
+  virtual void SendGetTraceDone(const std::string& request_id,
+                                const std::string& trace) {}
 
   virtual void SendConsoleLog(const std::string& file_system_id,
                               const std::string& request_id,
@@ -58,40 +188,258 @@ class FakeJavaScriptMessageSender : public JavaScriptMessageSenderInterface {
   virtual void SendCreateArchiveDone(int compressor_id) {};
 
   virtual void SendReadFileChunk(int compressor_id_,
-                                 int64_t file_size) {};
+                                 int64_t offset,
+                                 int64_t length) {};
 
   virtual void SendWriteChunk(int compressor_id,
                               const pp::VarArrayBuffer& array_buffer,
-                              int64_t length) {};
+                              int64_t length,
+                              int64_t offset) {};
+
+  virtual void SendReadArchiveChunk(int compressor_id,
+                                    int64_t offset,
+                                    int64_t length) {};
+
+  virtual void SendAppendToArchiveDone(int compressor_id) {};
 
   virtual void SendAddToArchiveDone(int compressor_id) {};
+  virtual void SendAddEntriesToArchiveDone(int compressor_id) {};
 
   virtual void SendCloseArchiveDone(int compressor_id) {};
+
+ private:
+  void AddResponse(const std::string& response) {
+    pthread_mutex_lock(&lock_);
+    responses_.push_back(response);
+    pthread_cond_broadcast(&cond_);
+    pthread_mutex_unlock(&lock_);
+  }
+
+  pthread_mutex_t lock_;
+  pthread_cond_t cond_;
+  std::vector<std::string> responses_;  // Guarded by lock_.
+};
+
+// An entry of FakeVolumeArchive.
+struct FakeArchiveEntry {
+  const char* path_name;
+  const char* data;
+};
+
+// The contents of the archive read by FakeVolumeArchive, shared by all the
+// instances created by Volume.
+struct FakeArchiveContents {
+  FakeArchiveContents() : on_read_data(NULL), on_read_data_user_data(NULL) {}
+
+  std::vector<FakeArchiveEntry> entries;
+
+  // Called once, on the next FakeVolumeArchive::ReadData, if not NULL. Used
+  // to send requests to the volume in the middle of another request.
+  void (*on_read_data)(void* user_data);
+  void* on_read_data_user_data;
+};
+
+// A fake VolumeArchive for a streaming format, which reads the entries of
+// FakeArchiveContents from memory.
+class FakeVolumeArchive : public VolumeArchive {
+ public:
+  FakeVolumeArchive(VolumeReader* reader, FakeArchiveContents* contents)
+      : VolumeArchive(reader), contents_(contents), current_entry_(-1) {}
+
+  virtual bool Init(const std::string& encoding, bool raw) {
+    curr_index = 0;
+    raw_ = raw;
+    return true;
+  }
+
+  virtual Result GetNextHeader() {
+    const char* path_name = NULL;
+    int64_t size = 0;
+    bool is_directory = false;
+    time_t modification_time = 0;
+    return GetNextHeader(&path_name, &size, &is_directory,
+                         &modification_time);
+  }
+
+  virtual Result GetNextHeader(const char** path_name,
+                               int64_t* size,
+                               bool* is_directory,
+                               time_t* modification_time) {
+    if (curr_index >= static_cast<int64_t>(contents_->entries.size()))
+      return RESULT_EOF;
+    current_entry_ = curr_index++;
+    *path_name = contents_->entries[current_entry_].path_name;
+    *size = strlen(contents_->entries[current_entry_].data);
+    *is_directory = false;
+    *modification_time = 0;
+    return RESULT_SUCCESS;
+  }
+
+  virtual bool SeekHeader(int64_t index) { return false; }
+
+  virtual int64_t ReadData(int64_t offset,
+                           int64_t length,
+                           const char** buffer) {
+    if (contents_->on_read_data) {
+      void (*on_read_data)(void*) = contents_->on_read_data;
+      contents_->on_read_data = NULL;
+      on_read_data(contents_->on_read_data_user_data);
+    }
+
+    const char* data = contents_->entries[current_entry_].data;
+    int64_t size = strlen(data);
+    if (offset >= size)
+      return 0;
+    *buffer = data + offset;
+    return std::min(std::min(length, size - offset), kFakeChunkSize);
+  }
+
+  virtual int64_t ReadDataInto(int64_t offset,
+                               int64_t length,
+                               char* destination) {
+    int64_t read_bytes = 0;
+    while (read_bytes < length) {
+      const char* buffer = NULL;
+      int64_t chunk_bytes =
+          ReadData(offset + read_bytes, length - read_bytes, &buffer);
+      if (chunk_bytes <= 0)
+        break;
+      memcpy(destination + read_bytes, buffer, chunk_bytes);
+      read_bytes += chunk_bytes;
+    }
+    return read_bytes;
+  }
+
+  virtual void MaybeDecompressAhead() {}
+
+  virtual int64_t GetStoredDataOffset() { return -1; }
+
+  virtual bool Cleanup() {
+    CleanupReader();
+    return true;
+  }
+
+ private:
+  FakeArchiveContents* contents_;  // Not owned.
+  int64_t current_entry_;  // The entry of the last header, -1 if none.
+};
+
+class FakeVolumeArchiveFactory : public VolumeArchiveFactoryInterface {
+ public:
+  explicit FakeVolumeArchiveFactory(FakeArchiveContents* contents)
+      : contents_(contents) {}
+
+  virtual VolumeArchive* Create(VolumeReader* reader) {
+    return new FakeVolumeArchive(reader, contents_);
+  }
+
+ private:
+  FakeArchiveContents* contents_;  // Not owned.
+};
+
+class FakeVolumeReaderFactory : public VolumeReaderFactoryInterface {
+ public:
+  virtual VolumeReader* Create(int64_t archive_size) {
+    return new FakeVolumeReader();
+  }
 };
 
+// Creates the dictionary of a READ_FILES request for the first max_bytes of
+// the files with the given indexes.
+pp::VarDictionary CreateReadFilesDictionary(
+    const std::vector<int64_t>& indexes,
+    int64_t max_bytes) {
+  pp::VarArray files;
+  for (size_t i = 0; i < indexes.size(); ++i) {
+    std::stringstream index;
+    index << indexes[i];
+    std::stringstream length;
+    length << max_bytes;
+    pp::VarDictionary file;
+    file.Set(request::key::kIndex, index.str());
+    file.Set(request::key::kLength, length.str());
+    files.Set(i, file);
+  }
+
+  std::stringstream archive_size;
+  archive_size << kArchiveSize;
+  pp::VarDictionary dictionary;
+  dictionary.Set(request::key::kFiles, files);
+  dictionary.Set(request::key::kEncoding, kEncoding);
+  dictionary.Set(request::key::kArchiveSize, archive_size.str());
+  return dictionary;
+}
+
+// Creates the dictionary of a HASH_ENTRIES request for the CRC32C digests of
+// the files with the given indexes.
+pp::VarDictionary CreateHashEntriesDictionary(
+    const std::vector<int64_t>& indexes) {
+  pp::VarArray indexes_array;
+  for (size_t i = 0; i < indexes.size(); ++i) {
+    std::stringstream index;
+    index << indexes[i];
+    indexes_array.Set(i, index.str());
+  }
+
+  std::stringstream archive_size;
+  archive_size << kArchiveSize;
+  pp::VarDictionary dictionary;
+  dictionary.Set(request::key::kIndexes, indexes_array);
+  dictionary.Set(request::key::kAlgorithm, "crc32c");
+  dictionary.Set(request::key::kEncoding, kEncoding);
+  dictionary.Set(request::key::kArchiveSize, archive_size.str());
+  return dictionary;
+}
+
 }  // namespace
 
 // Class used by TEST_F macro to initialize the environment for testing
 // Volume methods.
 class VolumeTest : public testing::Test {
  protected:
-  VolumeTest() : message_sender(NULL), volume(NULL) {}
+  VolumeTest() : worker_pool(NULL), message_sender(NULL), volume(NULL) {}
 
   virtual void SetUp() {
+    worker_pool = new WorkerPool(pp::InstanceHandle(PSGetInstanceId()),
+                                 WorkerPool::DefaultThreadCount());
     message_sender = new FakeJavaScriptMessageSender();
-    // TODO(cmihail): Use the constructor with custom factories for
-    // VolumeArchive and VolumeReader.
-    volume = new Volume(
-        pp::InstanceHandle(PSGetInstanceId()), kFileSystemId, message_sender);
+    volume = new Volume(worker_pool, kFileSystemId, message_sender,
+                        new FakeVolumeArchiveFactory(&archive_contents),
+                        new FakeVolumeReaderFactory());
   }
 
   virtual void TearDown() {
-    delete message_sender;
-    message_sender = NULL;
+    // Waits for the jobs of the volume, which use the message sender.
     delete volume;
     volume = NULL;
+    delete message_sender;
+    message_sender = NULL;
+    delete worker_pool;
+    worker_pool = NULL;
+  }
+
+  // Adds an entry to the fake archive. Must be called before ReadMetadata.
+  void AddEntry(const char* path_name, const char* data) {
+    FakeArchiveEntry entry = {path_name, data};
+    archive_contents.entries.push_back(entry);
+  }
+
+  // Starts the volume and reads the metadata of the fake archive.
+  void ReadMetadata() {
+    ASSERT_TRUE(volume->Init());
+    volume->ReadMetadata("1", kEncoding, kArchiveSize);
+    ASSERT_TRUE(message_sender->WaitForResponse("READ_METADATA_DONE 1"));
+  }
+
+  // Opens the second entry of the fake archive with request id "3". Used as
+  // FakeArchiveContents::on_read_data.
+  static void OpenFileOnReadData(void* user_data) {
+    Volume* volume = static_cast<VolumeTest*>(user_data)->volume;
+    volume->OpenFile("3", 1, kEncoding, kArchiveSize);
   }
 
+  FakeArchiveContents archive_contents;
+  WorkerPool* worker_pool;
   FakeJavaScriptMessageSender* message_sender;
   Volume* volume;
 };
@@ -100,4 +448,139 @@ TEST_F(VolumeTest, Init) {
   EXPECT_TRUE(volume->Init());
 }
 
+TEST_F(VolumeTest, ReadFilesSendsEmptyFiles) {
+  AddEntry("a.txt", "abc");
+  AddEntry("empty.txt", "");
+  AddEntry("b.txt", "defg");
+  AddEntry("last_empty.txt", "");
+  ReadMetadata();
+
+  std::vector<int64_t> indexes;
+  indexes.push_back(0);
+  indexes.push_back(1);
+  indexes.push_back(2);
+  indexes.push_back(3);
+  volume->ReadFiles("2", CreateReadFilesDictionary(indexes, 100));
+  ASSERT_TRUE(message_sender->WaitForResponse(
+      "READ_FILES_DONE 2 3 \"\" last"));
+
+  std::vector<std::string> expected;
+  expected.push_back("READ_METADATA_DONE 1");
+  expected.push_back("READ_FILES_DONE 2 0 \"abc\" more");
+  expected.push_back("READ_FILES_DONE 2 1 \"\" more");
+  expected.push_back("READ_FILES_DONE 2 2 \"defg\" more");
+  expected.push_back("READ_FILES_DONE 2 3 \"\" last");
+  EXPECT_EQ(expected, message_sender->responses());
+}
+
+TEST_F(VolumeTest, OpenFileWhileReadingFiles) {
+  std::string first_chunk(kReadFileChunkSize, 'a');
+  std::string data = first_chunk + "cde";
+  AddEntry("a.txt", data.c_str());
+  AddEntry("b.txt", "xyz");
+  ReadMetadata();
+
+  // The file is opened while the first chunk of READ_FILES is read. The
+  // request yields to the OPEN_FILE after that chunk and continues once the
+  // file is closed.
+  archive_contents.on_read_data = &VolumeTest::OpenFileOnReadData;
+  archive_contents.on_read_data_user_data = this;
+  std::vector<int64_t> indexes;
+  indexes.push_back(0);
+  volume->ReadFiles("2",
+                    CreateReadFilesDictionary(indexes, data.size()));
+  ASSERT_TRUE(message_sender->WaitForResponse("OPEN_FILE_DONE 3"));
+
+  pp::VarDictionary read_file;
+  read_file.Set(request::key::kOpenRequestId, "3");
+  read_file.Set(request::key::kOffset, "0");
+  read_file.Set(request::key::kLength, "3");
+  volume->ReadFile("4", read_file);
+  ASSERT_TRUE(message_sender->WaitForResponse("READ_FILE_DONE 4 \"xyz\" last"));
+
+  volume->CloseFile("5", "3");
+  ASSERT_TRUE(message_sender->WaitForResponse(
+      "READ_FILES_DONE 2 0 \"\" last"));
+
+  std::vector<std::string> expected;
+  expected.push_back("READ_METADATA_DONE 1");
+  expected.push_back("READ_FILES_DONE 2 0 \"" + first_chunk + "\" more");
+  expected.push_back("OPEN_FILE_DONE 3");
+  expected.push_back("READ_FILE_DONE 4 \"xyz\" last");
+  expected.push_back("CLOSE_FILE_DONE 5 3");
+  expected.push_back("READ_FILES_DONE 2 0 \"cde\" more");
+  expected.push_back("READ_FILES_DONE 2 0 \"\" last");
+  EXPECT_EQ(expected, message_sender->responses());
+}
+
+TEST_F(VolumeTest, ReadFilesIsIllegalWhileReadingFiles) {
+  std::string data = std::string(kReadFileChunkSize, 'a') + "cde";
+  AddEntry("a.txt", data.c_str());
+  AddEntry("b.txt", "xyz");
+  ReadMetadata();
+
+  // A file is opened while READ_FILES yields, so it waits for the file to be
+  // closed. Another READ_FILES can't run meanwhile.
+  archive_contents.on_read_data = &VolumeTest::OpenFileOnReadData;
+  archive_contents.on_read_data_user_data = this;
+  std::vector<int64_t> indexes;
+  indexes.push_back(0);
+  volume->ReadFiles("2",
+                    CreateReadFilesDictionary(indexes, data.size()));
+  ASSERT_TRUE(message_sender->WaitForResponse("OPEN_FILE_DONE 3"));
+
+  volume->ReadFiles("4", CreateReadFilesDictionary(indexes, 100));
+  ASSERT_TRUE(message_sender->WaitForResponse("ERROR 4 ILLEGAL"));
+
+  volume->CloseFile("5", "3");
+  EXPECT_TRUE(message_sender->WaitForResponse(
+      "READ_FILES_DONE 2 0 \"\" last"));
+}
+
+TEST_F(VolumeTest, HashEntriesRejectsUnknownIndexes) {
+  AddEntry("a.txt", "abc");
+  AddEntry("dir/b.txt", "defg");
+  ReadMetadata();
+
+  // The index is out of range.
+  std::vector<int64_t> indexes;
+  indexes.push_back(0);
+  indexes.push_back(2);
+  volume->HashEntries("2", CreateHashEntriesDictionary(indexes));
+  ASSERT_TRUE(message_sender->WaitForResponse("ERROR 2 FAILED"));
+
+  // The index of the "dir" directory, which has no header in the archive.
+  indexes.clear();
+  indexes.push_back(-1);
+  volume->HashEntries("3", CreateHashEntriesDictionary(indexes));
+  ASSERT_TRUE(message_sender->WaitForResponse("ERROR 3 FAILED"));
+
+  indexes.clear();
+  indexes.push_back(0);
+  indexes.push_back(1);
+  volume->HashEntries("4", CreateHashEntriesDictionary(indexes));
+  EXPECT_TRUE(message_sender->WaitForResponse("HASH_ENTRIES_DONE 4 2 last"));
+}
+
+TEST_F(VolumeTest, GetStatsReportsEntryTable) {
+  AddEntry("a.txt", "abc");
+  AddEntry("dir/b.txt", "defg");
+
+  // Nothing is reported before the metadata is read.
+  EXPECT_FALSE(volume->GetStats().HasKey("entry_count"));
+  ReadMetadata();
+
+  // The volume keeps the same table, with the "dir" directory.
+  VolumeEntryTable entry_table;
+  entry_table.AddEntry("a.txt", 0, false, 3, 0);
+  entry_table.AddEntry("dir/b.txt", 1, false, 4, 0);
+  entry_table.Compact();
+  std::stringstream entry_table_bytes;
+  entry_table_bytes << entry_table.MemoryUsage();
+
+  pp::VarDictionary stats = volume->GetStats();
+  EXPECT_EQ("3", stats.Get("entry_count").AsString());
+  EXPECT_EQ(entry_table_bytes.str(), stats.Get("entry_table_bytes").AsString());
+}
+
 // TODO(cmihail): Write the actual tests (see crbug.com/417973).
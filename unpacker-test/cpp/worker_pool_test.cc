@@ -0,0 +1,130 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "worker_pool.h"
+
+#include <pthread.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "ppapi/cpp/instance_handle.h"
+#include "ppapi_simple/ps_main.h"
+
+namespace {
+
+// Records the order in which the jobs of a strand run.
+struct JobLog {
+  JobLog() { pthread_mutex_init(&lock, NULL); }
+  ~JobLog() { pthread_mutex_destroy(&lock); }
+
+  pthread_mutex_t lock;
+  std::vector<int> jobs;
+};
+
+struct LoggedJob {
+  JobLog* log;
+  int id;
+};
+
+void RunLoggedJob(void* user_data, int32_t /*result*/) {
+  LoggedJob* job = static_cast<LoggedJob*>(user_data);
+  pthread_mutex_lock(&job->log->lock);
+  job->log->jobs.push_back(job->id);
+  pthread_mutex_unlock(&job->log->lock);
+}
+
+// An event a job waits for, signaled by a job of another strand.
+struct Event {
+  Event() : is_signaled(false) {
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&cond, NULL);
+  }
+  ~Event() {
+    pthread_cond_destroy(&cond);
+    pthread_mutex_destroy(&lock);
+  }
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  bool is_signaled;
+};
+
+void WaitForEvent(void* user_data, int32_t /*result*/) {
+  Event* event = static_cast<Event*>(user_data);
+  pthread_mutex_lock(&event->lock);
+  WorkerPool::BeginBlockingCall();
+  while (!event->is_signaled)
+    pthread_cond_wait(&event->cond, &event->lock);
+  WorkerPool::EndBlockingCall();
+  pthread_mutex_unlock(&event->lock);
+}
+
+void SignalEvent(void* user_data, int32_t /*result*/) {
+  Event* event = static_cast<Event*>(user_data);
+  pthread_mutex_lock(&event->lock);
+  event->is_signaled = true;
+  pthread_cond_signal(&event->cond);
+  pthread_mutex_unlock(&event->lock);
+}
+
+}  // namespace
+
+TEST(WorkerPoolTest, StrandRunsJobsInOrder) {
+  const int kJobs = 100;
+  const int kStrands = 4;
+  WorkerPool worker_pool(pp::InstanceHandle(PSGetInstanceId()), 4);
+  ASSERT_TRUE(worker_pool.Start());
+
+  JobLog logs[kStrands];
+  std::vector<LoggedJob> jobs(kJobs * kStrands);
+  WorkerPool::Strand* strands[kStrands];
+  for (int i = 0; i < kStrands; ++i)
+    strands[i] = worker_pool.CreateStrand();
+
+  for (int id = 0; id < kJobs; ++id) {
+    for (int i = 0; i < kStrands; ++i) {
+      LoggedJob* job = &jobs[id * kStrands + i];
+      job->log = &logs[i];
+      job->id = id;
+      worker_pool.Post(strands[i], pp::CompletionCallback(&RunLoggedJob, job));
+    }
+  }
+
+  for (int i = 0; i < kStrands; ++i) {
+    worker_pool.DestroyStrand(strands[i]);
+    ASSERT_EQ(static_cast<size_t>(kJobs), logs[i].jobs.size());
+    for (int id = 0; id < kJobs; ++id)
+      EXPECT_EQ(id, logs[i].jobs[id]);
+  }
+}
+
+// With a single worker, the job waiting for the event would block the job
+// that signals it, unless another worker is started for the blocked job.
+TEST(WorkerPoolTest, BlockedJobDoesNotBlockOtherStrands) {
+  WorkerPool worker_pool(pp::InstanceHandle(PSGetInstanceId()), 1);
+  ASSERT_TRUE(worker_pool.Start());
+
+  Event event;
+  WorkerPool::Strand* waiting_strand = worker_pool.CreateStrand();
+  WorkerPool::Strand* signaling_strand = worker_pool.CreateStrand();
+  worker_pool.Post(waiting_strand,
+                   pp::CompletionCallback(&WaitForEvent, &event));
+  worker_pool.Post(signaling_strand,
+                   pp::CompletionCallback(&SignalEvent, &event));
+
+  worker_pool.DestroyStrand(waiting_strand);
+  worker_pool.DestroyStrand(signaling_strand);
+  EXPECT_TRUE(event.is_signaled);
+}
+
+TEST(WorkerPoolTest, DestroyStrandOfPoolNotStarted) {
+  WorkerPool worker_pool(pp::InstanceHandle(PSGetInstanceId()), 1);
+  JobLog log;
+  LoggedJob job = {&log, 0};
+
+  WorkerPool::Strand* strand = worker_pool.CreateStrand();
+  worker_pool.Post(strand, pp::CompletionCallback(&RunLoggedJob, &job));
+  worker_pool.DestroyStrand(strand);
+  EXPECT_TRUE(log.jobs.empty());
+}
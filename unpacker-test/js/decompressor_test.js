@@ -142,7 +142,7 @@ describe('Decompressor', function() {
            function(done) {
              var expectedResponse =
                  unpacker.request.createReadChunkDoneResponse(
-                     FILE_SYSTEM_ID, METADATA_REQUEST_ID, blobContents, 0);
+                     FILE_SYSTEM_ID, METADATA_REQUEST_ID, blobContents, 0, 0);
              data[unpacker.request.Key.OFFSET] =
                  '0';  // Received as string from NaCl.
              data[unpacker.request.Key.LENGTH] = BLOB.size / 2;
@@ -162,7 +162,7 @@ describe('Decompressor', function() {
            function(done) {
              var expectedResponse =
                  unpacker.request.createReadChunkDoneResponse(
-                     FILE_SYSTEM_ID, METADATA_REQUEST_ID, blobContents, 0);
+                     FILE_SYSTEM_ID, METADATA_REQUEST_ID, blobContents, 0, 0);
              data[unpacker.request.Key.OFFSET] =
                  '0';  // Received as string from NaCl.
              data[unpacker.request.Key.LENGTH] = BLOB.size * 2;
@@ -35,6 +35,11 @@ describe('On calling', function() {
    */
   var CHUNK_OFFSET = 150;
 
+  /**
+   * @const {number}
+   */
+  var PART_INDEX = 1;
+
   /**
    * @const {string}
    */
@@ -50,6 +55,11 @@ describe('On calling', function() {
    */
   var OPEN_REQUEST_ID = 7;
 
+  /**
+   * @const {string}
+   */
+  var PATH = '/dir/file.txt';
+
   /**
    * @const {number}
    */
@@ -99,7 +109,7 @@ describe('On calling', function() {
     var readChunkDoneReponse;
     beforeEach(function() {
       readChunkDoneReponse = unpacker.request.createReadChunkDoneResponse(
-          FILE_SYSTEM_ID, REQUEST_ID, CHUNK_BUFFER, CHUNK_OFFSET);
+          FILE_SYSTEM_ID, REQUEST_ID, CHUNK_BUFFER, CHUNK_OFFSET, PART_INDEX);
     });
 
     it('with READ_CHUNK_DONE as operation', function() {
@@ -126,6 +136,11 @@ describe('On calling', function() {
       expect(readChunkDoneReponse[unpacker.request.Key.OFFSET])
           .to.equal(CHUNK_OFFSET.toString());
     });
+
+    it('with correct part index', function() {
+      expect(readChunkDoneReponse[unpacker.request.Key.PART_INDEX])
+          .to.equal(PART_INDEX);
+    });
   });
 
   describe('request.createReadChunkErrorResponse should create a response',
@@ -133,7 +148,7 @@ describe('On calling', function() {
     var readChunkErrorReponse;
     beforeEach(function() {
       readChunkErrorReponse = unpacker.request.createReadChunkErrorResponse(
-          FILE_SYSTEM_ID, REQUEST_ID, CHUNK_BUFFER);
+          FILE_SYSTEM_ID, REQUEST_ID, PART_INDEX);
     });
 
     it('with READ_CHUNK_ERROR as operation', function() {
@@ -150,6 +165,11 @@ describe('On calling', function() {
       expect(readChunkErrorReponse[unpacker.request.Key.REQUEST_ID])
           .to.equal(REQUEST_ID.toString());
     });
+
+    it('with correct part index', function() {
+      expect(readChunkErrorReponse[unpacker.request.Key.PART_INDEX])
+          .to.equal(PART_INDEX);
+    });
   });
 
   describe('request.createCloseVolumeRequest should create a request',
@@ -213,6 +233,277 @@ describe('On calling', function() {
     });
   });
 
+  describe('request.createOpenFileByPathRequest should create a request',
+           function() {
+    var openFileRequest;
+    beforeEach(function() {
+      openFileRequest = unpacker.request.createOpenFileByPathRequest(
+          FILE_SYSTEM_ID, REQUEST_ID, PATH, ENCODING, ARCHIVE_SIZE);
+    });
+
+    it('with OPEN_FILE_BY_PATH as operation', function() {
+      expect(openFileRequest[unpacker.request.Key.OPERATION])
+          .to.equal(unpacker.request.Operation.OPEN_FILE_BY_PATH);
+    });
+
+    it('with correct file system id', function() {
+      expect(openFileRequest[unpacker.request.Key.FILE_SYSTEM_ID])
+          .to.equal(FILE_SYSTEM_ID);
+    });
+
+    it('with correct request id', function() {
+      expect(openFileRequest[unpacker.request.Key.REQUEST_ID])
+          .to.equal(REQUEST_ID.toString());
+    });
+
+    it('with correct file path', function() {
+      expect(openFileRequest[unpacker.request.Key.PATH]).to.equal(PATH);
+    });
+
+    it('with correct encoding', function() {
+      expect(openFileRequest[unpacker.request.Key.ENCODING]).to.equal(ENCODING);
+    });
+
+    it('with correct archive size', function() {
+      expect(openFileRequest[unpacker.request.Key.ARCHIVE_SIZE])
+          .to.equal(ARCHIVE_SIZE.toString());
+    });
+
+    it('that is not a pack request', function() {
+      expect(unpacker.request.isPackRequest(
+          openFileRequest[unpacker.request.Key.OPERATION])).to.be.false;
+    });
+  });
+
+  describe('request.createReadFilesRequest should create a request',
+           function() {
+    var readFilesRequest;
+    beforeEach(function() {
+      readFilesRequest = unpacker.request.createReadFilesRequest(
+          FILE_SYSTEM_ID, REQUEST_ID, [{index: INDEX, maxBytes: LENGTH}],
+          ENCODING, ARCHIVE_SIZE);
+    });
+
+    it('with READ_FILES as operation', function() {
+      expect(readFilesRequest[unpacker.request.Key.OPERATION])
+          .to.equal(unpacker.request.Operation.READ_FILES);
+    });
+
+    it('with correct file system id', function() {
+      expect(readFilesRequest[unpacker.request.Key.FILE_SYSTEM_ID])
+          .to.equal(FILE_SYSTEM_ID);
+    });
+
+    it('with correct request id', function() {
+      expect(readFilesRequest[unpacker.request.Key.REQUEST_ID])
+          .to.equal(REQUEST_ID.toString());
+    });
+
+    it('with correct files', function() {
+      var files = readFilesRequest[unpacker.request.Key.FILES];
+      expect(files.length).to.equal(1);
+      expect(files[0][unpacker.request.Key.INDEX]).to.equal(INDEX.toString());
+      expect(files[0][unpacker.request.Key.LENGTH]).to.equal(LENGTH.toString());
+    });
+
+    it('with correct encoding', function() {
+      expect(readFilesRequest[unpacker.request.Key.ENCODING])
+          .to.equal(ENCODING);
+    });
+
+    it('with correct archive size', function() {
+      expect(readFilesRequest[unpacker.request.Key.ARCHIVE_SIZE])
+          .to.equal(ARCHIVE_SIZE.toString());
+    });
+  });
+
+  describe('request.createStatPathRequest should create a request',
+           function() {
+    var statPathRequest;
+    beforeEach(function() {
+      statPathRequest = unpacker.request.createStatPathRequest(
+          FILE_SYSTEM_ID, REQUEST_ID, PATH);
+    });
+
+    it('with STAT_PATH as operation', function() {
+      expect(statPathRequest[unpacker.request.Key.OPERATION])
+          .to.equal(unpacker.request.Operation.STAT_PATH);
+    });
+
+    it('with correct file system id', function() {
+      expect(statPathRequest[unpacker.request.Key.FILE_SYSTEM_ID])
+          .to.equal(FILE_SYSTEM_ID);
+    });
+
+    it('with correct request id', function() {
+      expect(statPathRequest[unpacker.request.Key.REQUEST_ID])
+          .to.equal(REQUEST_ID.toString());
+    });
+
+    it('with correct path', function() {
+      expect(statPathRequest[unpacker.request.Key.PATH]).to.equal(PATH);
+    });
+  });
+
+  describe('request.createSearchRequest should create a request',
+           function() {
+    var PATTERNS = ['needle', 'pin'];
+    var MAX_HITS = 100;
+    var searchRequest;
+    beforeEach(function() {
+      searchRequest = unpacker.request.createSearchRequest(
+          FILE_SYSTEM_ID, REQUEST_ID, PATTERNS, ENCODING, ARCHIVE_SIZE,
+          MAX_HITS);
+    });
+
+    it('with SEARCH as operation', function() {
+      expect(searchRequest[unpacker.request.Key.OPERATION])
+          .to.equal(unpacker.request.Operation.SEARCH);
+    });
+
+    it('with correct request id', function() {
+      expect(searchRequest[unpacker.request.Key.REQUEST_ID])
+          .to.equal(REQUEST_ID.toString());
+    });
+
+    it('with correct patterns', function() {
+      expect(searchRequest[unpacker.request.Key.PATTERNS])
+          .to.deep.equal(PATTERNS);
+    });
+
+    it('with correct archive size', function() {
+      expect(searchRequest[unpacker.request.Key.ARCHIVE_SIZE])
+          .to.equal(ARCHIVE_SIZE.toString());
+    });
+
+    it('with correct maximum number of hits', function() {
+      expect(searchRequest[unpacker.request.Key.MAX_HITS])
+          .to.equal(MAX_HITS.toString());
+    });
+  });
+
+  describe('request.createHashEntriesRequest should create a request',
+           function() {
+    var INDEXES = [3, 1];
+    var ALGORITHM = 'blake3';
+    var hashEntriesRequest;
+    beforeEach(function() {
+      hashEntriesRequest = unpacker.request.createHashEntriesRequest(
+          FILE_SYSTEM_ID, REQUEST_ID, INDEXES, ALGORITHM, ENCODING,
+          ARCHIVE_SIZE);
+    });
+
+    it('with HASH_ENTRIES as operation', function() {
+      expect(hashEntriesRequest[unpacker.request.Key.OPERATION])
+          .to.equal(unpacker.request.Operation.HASH_ENTRIES);
+    });
+
+    it('with correct request id', function() {
+      expect(hashEntriesRequest[unpacker.request.Key.REQUEST_ID])
+          .to.equal(REQUEST_ID.toString());
+    });
+
+    it('with correct indexes', function() {
+      expect(hashEntriesRequest[unpacker.request.Key.INDEXES])
+          .to.deep.equal(['3', '1']);
+    });
+
+    it('with correct algorithm', function() {
+      expect(hashEntriesRequest[unpacker.request.Key.ALGORITHM])
+          .to.equal(ALGORITHM);
+    });
+  });
+
+  describe('request.createGetStatsRequest should create a request',
+           function() {
+    var getStatsRequest;
+    beforeEach(function() {
+      getStatsRequest = unpacker.request.createGetStatsRequest(REQUEST_ID);
+    });
+
+    it('with GET_STATS as operation', function() {
+      expect(getStatsRequest[unpacker.request.Key.OPERATION])
+          .to.equal(unpacker.request.Operation.GET_STATS);
+    });
+
+    it('with correct request id', function() {
+      expect(getStatsRequest[unpacker.request.Key.REQUEST_ID])
+          .to.equal(REQUEST_ID.toString());
+    });
+
+    it('without file system id', function() {
+      expect(getStatsRequest[unpacker.request.Key.FILE_SYSTEM_ID])
+          .to.be.undefined;
+    });
+
+    it('that is a module request', function() {
+      var operation = getStatsRequest[unpacker.request.Key.OPERATION];
+      expect(unpacker.request.isModuleRequest(operation)).to.be.true;
+      expect(unpacker.request.isPackRequest(operation)).to.be.false;
+    });
+  });
+
+  describe('request.createSetTracingRequest should create a request',
+           function() {
+    var CAPACITY = 1000;
+    var setTracingRequest;
+    beforeEach(function() {
+      setTracingRequest = unpacker.request.createSetTracingRequest(
+          REQUEST_ID, true, CAPACITY);
+    });
+
+    it('with SET_TRACING as operation', function() {
+      expect(setTracingRequest[unpacker.request.Key.OPERATION])
+          .to.equal(unpacker.request.Operation.SET_TRACING);
+    });
+
+    it('with correct request id', function() {
+      expect(setTracingRequest[unpacker.request.Key.REQUEST_ID])
+          .to.equal(REQUEST_ID.toString());
+    });
+
+    it('with correct enabled and capacity', function() {
+      expect(setTracingRequest[unpacker.request.Key.ENABLED]).to.be.true;
+      expect(setTracingRequest[unpacker.request.Key.CAPACITY])
+          .to.equal(CAPACITY);
+    });
+
+    it('without capacity if not provided', function() {
+      var disableRequest =
+          unpacker.request.createSetTracingRequest(REQUEST_ID, false);
+      expect(disableRequest[unpacker.request.Key.ENABLED]).to.be.false;
+      expect(disableRequest[unpacker.request.Key.CAPACITY]).to.be.undefined;
+    });
+
+    it('that is a module request', function() {
+      var operation = setTracingRequest[unpacker.request.Key.OPERATION];
+      expect(unpacker.request.isModuleRequest(operation)).to.be.true;
+    });
+  });
+
+  describe('request.createGetTraceRequest should create a request',
+           function() {
+    var getTraceRequest;
+    beforeEach(function() {
+      getTraceRequest = unpacker.request.createGetTraceRequest(REQUEST_ID);
+    });
+
+    it('with GET_TRACE as operation', function() {
+      expect(getTraceRequest[unpacker.request.Key.OPERATION])
+          .to.equal(unpacker.request.Operation.GET_TRACE);
+    });
+
+    it('with correct request id', function() {
+      expect(getTraceRequest[unpacker.request.Key.REQUEST_ID])
+          .to.equal(REQUEST_ID.toString());
+    });
+
+    it('that is a module request', function() {
+      var operation = getTraceRequest[unpacker.request.Key.OPERATION];
+      expect(unpacker.request.isModuleRequest(operation)).to.be.true;
+    });
+  });
+
   describe('request.createCloseFileRequest should create a request',
       function() {
     var closeFileRequest;
@@ -279,4 +570,180 @@ describe('On calling', function() {
           .to.equal(LENGTH.toString());
     });
   });
+
+  describe('request.createCreateArchiveRequest should create a request',
+           function() {
+    var COMPRESSOR_ID = 3;
+    var createArchiveRequest;
+    beforeEach(function() {
+      createArchiveRequest = unpacker.request.createCreateArchiveRequest(
+          COMPRESSOR_ID, {
+            format: unpacker.request.Format.TAR_XZ,
+            compressionLevel: 9,
+            threadCount: 4,
+            deduplicate: true
+          });
+    });
+
+    it('with CREATE_ARCHIVE as operation', function() {
+      expect(createArchiveRequest[unpacker.request.Key.OPERATION])
+          .to.equal(unpacker.request.Operation.CREATE_ARCHIVE);
+    });
+
+    it('with correct compressor id', function() {
+      expect(createArchiveRequest[unpacker.request.Key.COMPRESSOR_ID])
+          .to.equal(COMPRESSOR_ID);
+    });
+
+    it('with correct format, compression level and thread count', function() {
+      expect(createArchiveRequest[unpacker.request.Key.FORMAT])
+          .to.equal('tar.xz');
+      expect(createArchiveRequest[unpacker.request.Key.COMPRESSION_LEVEL])
+          .to.equal(9);
+      expect(createArchiveRequest[unpacker.request.Key.THREAD_COUNT])
+          .to.equal(4);
+    });
+
+    it('with correct deduplicate', function() {
+      expect(createArchiveRequest[unpacker.request.Key.DEDUPLICATE])
+          .to.be.true;
+    });
+
+    it('without the options not provided', function() {
+      var defaultRequest =
+          unpacker.request.createCreateArchiveRequest(COMPRESSOR_ID);
+      expect(defaultRequest[unpacker.request.Key.FORMAT]).to.be.undefined;
+      expect(defaultRequest[unpacker.request.Key.PARALLEL]).to.be.undefined;
+      expect(createArchiveRequest[unpacker.request.Key.READ_AHEAD_DEPTH])
+          .to.be.undefined;
+    });
+
+    it('that is a pack request', function() {
+      var operation = createArchiveRequest[unpacker.request.Key.OPERATION];
+      expect(unpacker.request.isPackRequest(operation)).to.be.true;
+    });
+  });
+
+  describe('request.createAddEntriesToArchiveRequest should create a request',
+           function() {
+    var COMPRESSOR_ID = 3;
+    var BUFFER = new ArrayBuffer(5);
+    var addEntriesRequest;
+    beforeEach(function() {
+      addEntriesRequest = unpacker.request.createAddEntriesToArchiveRequest(
+          COMPRESSOR_ID, [
+            {
+              pathname: 'dir/',
+              fileSize: 0,
+              modificationTime: '1/2/2017 3:4:5',
+              isDirectory: true
+            },
+            {
+              pathname: 'dir/file',
+              fileSize: 5,
+              modificationTime: '1/2/2017 3:4:6',
+              isDirectory: false
+            }
+          ], BUFFER);
+    });
+
+    it('with ADD_ENTRIES_TO_ARCHIVE as operation', function() {
+      expect(addEntriesRequest[unpacker.request.Key.OPERATION])
+          .to.equal(unpacker.request.Operation.ADD_ENTRIES_TO_ARCHIVE);
+    });
+
+    it('with correct compressor id', function() {
+      expect(addEntriesRequest[unpacker.request.Key.COMPRESSOR_ID])
+          .to.equal(COMPRESSOR_ID);
+    });
+
+    it('with correct entries', function() {
+      var entries = addEntriesRequest[unpacker.request.Key.ENTRIES];
+      expect(entries.length).to.equal(2);
+      expect(entries[0][unpacker.request.Key.IS_DIRECTORY]).to.be.true;
+      expect(entries[1][unpacker.request.Key.PATHNAME]).to.equal('dir/file');
+      expect(entries[1][unpacker.request.Key.FILE_SIZE]).to.equal('5');
+      expect(entries[1][unpacker.request.Key.MODIFICATION_TIME])
+          .to.equal('1/2/2017 3:4:6');
+    });
+
+    it('with correct buffer', function() {
+      expect(addEntriesRequest[unpacker.request.Key.CHUNK_BUFFER])
+          .to.equal(BUFFER);
+    });
+
+    it('that is a pack request', function() {
+      var operation = addEntriesRequest[unpacker.request.Key.OPERATION];
+      expect(unpacker.request.isPackRequest(operation)).to.be.true;
+    });
+  });
+
+  describe('request.createAppendToArchiveRequest should create a request',
+           function() {
+    var COMPRESSOR_ID = 3;
+    var ARCHIVE_SIZE = Math.pow(2, 40);
+    var appendRequest;
+    beforeEach(function() {
+      appendRequest = unpacker.request.createAppendToArchiveRequest(
+          COMPRESSOR_ID, ARCHIVE_SIZE, {compressionLevel: 9, threadCount: 4});
+    });
+
+    it('with APPEND_TO_ARCHIVE as operation', function() {
+      expect(appendRequest[unpacker.request.Key.OPERATION])
+          .to.equal(unpacker.request.Operation.APPEND_TO_ARCHIVE);
+    });
+
+    it('with correct compressor id', function() {
+      expect(appendRequest[unpacker.request.Key.COMPRESSOR_ID])
+          .to.equal(COMPRESSOR_ID);
+    });
+
+    it('with correct archive size', function() {
+      expect(appendRequest[unpacker.request.Key.ARCHIVE_SIZE])
+          .to.equal(ARCHIVE_SIZE.toString());
+    });
+
+    it('with correct compression level and thread count', function() {
+      expect(appendRequest[unpacker.request.Key.COMPRESSION_LEVEL])
+          .to.equal(9);
+      expect(appendRequest[unpacker.request.Key.THREAD_COUNT]).to.equal(4);
+      expect(appendRequest[unpacker.request.Key.FORMAT]).to.be.undefined;
+    });
+
+    it('that is a pack request', function() {
+      var operation = appendRequest[unpacker.request.Key.OPERATION];
+      expect(unpacker.request.isPackRequest(operation)).to.be.true;
+    });
+  });
+
+  describe('request.createReadArchiveChunkDoneResponse should create a ' +
+               'response',
+           function() {
+    var COMPRESSOR_ID = 3;
+    var BUFFER = new ArrayBuffer(5);
+    var readArchiveChunkDoneResponse;
+    beforeEach(function() {
+      readArchiveChunkDoneResponse =
+          unpacker.request.createReadArchiveChunkDoneResponse(
+              COMPRESSOR_ID, 5, BUFFER);
+    });
+
+    it('with READ_ARCHIVE_CHUNK_DONE as operation', function() {
+      expect(readArchiveChunkDoneResponse[unpacker.request.Key.OPERATION])
+          .to.equal(unpacker.request.Operation.READ_ARCHIVE_CHUNK_DONE);
+    });
+
+    it('with correct length and buffer', function() {
+      expect(readArchiveChunkDoneResponse[unpacker.request.Key.LENGTH])
+          .to.equal('5');
+      expect(readArchiveChunkDoneResponse[unpacker.request.Key.CHUNK_BUFFER])
+          .to.equal(BUFFER);
+    });
+
+    it('that is a pack request', function() {
+      var operation =
+          readArchiveChunkDoneResponse[unpacker.request.Key.OPERATION];
+      expect(unpacker.request.isPackRequest(operation)).to.be.true;
+    });
+  });
 });
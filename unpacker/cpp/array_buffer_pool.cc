@@ -0,0 +1,34 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "array_buffer_pool.h"
+
+ArrayBufferPool::ArrayBufferPool(int64_t max_pooled_bytes)
+    : max_pooled_bytes_(max_pooled_bytes), pooled_bytes_(0) {}
+
+pp::VarArrayBuffer ArrayBufferPool::Acquire(uint32_t size) {
+  std::map<uint32_t, std::vector<pp::VarArrayBuffer> >::iterator it =
+      buffers_.find(size);
+  if (it == buffers_.end() || it->second.empty())
+    return pp::VarArrayBuffer(size);
+
+  pp::VarArrayBuffer array_buffer = it->second.back();
+  it->second.pop_back();
+  pooled_bytes_ -= size;
+  return array_buffer;
+}
+
+void ArrayBufferPool::Release(const pp::VarArrayBuffer& array_buffer) {
+  uint32_t size = array_buffer.ByteLength();
+  if (size == 0 || pooled_bytes_ + size > max_pooled_bytes_)
+    return;
+
+  buffers_[size].push_back(array_buffer);
+  pooled_bytes_ += size;
+}
+
+void ArrayBufferPool::Clear() {
+  buffers_.clear();
+  pooled_bytes_ = 0;
+}
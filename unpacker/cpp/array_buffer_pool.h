@@ -0,0 +1,45 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef ARRAY_BUFFER_POOL_H_
+#define ARRAY_BUFFER_POOL_H_
+
+#include <map>
+#include <stdint.h>
+#include <vector>
+
+#include "ppapi/cpp/var_array_buffer.h"
+
+// Keeps released pp::VarArrayBuffer instances, so sending data to JavaScript
+// doesn't allocate a new buffer for every chunk. PostMessage copies the data
+// of the buffer, so a buffer can be released as soon as it was posted.
+//
+// Not thread safe. A pool must be used by a single thread.
+class ArrayBufferPool {
+ public:
+  // The pool keeps at most max_pooled_bytes in released buffers. Buffers
+  // released above that limit are freed.
+  explicit ArrayBufferPool(int64_t max_pooled_bytes);
+
+  // Returns a buffer of exactly size bytes, either reused or new one.
+  pp::VarArrayBuffer Acquire(uint32_t size);
+
+  // Returns the buffer to the pool. The buffer must not be modified by the
+  // caller afterwards.
+  void Release(const pp::VarArrayBuffer& array_buffer);
+
+  // Frees all the pooled buffers.
+  void Clear();
+
+  int64_t pooled_bytes() const { return pooled_bytes_; }
+
+ private:
+  const int64_t max_pooled_bytes_;
+  int64_t pooled_bytes_;
+
+  // The released buffers indexed by their size.
+  std::map<uint32_t, std::vector<pp::VarArrayBuffer> > buffers_;
+};
+
+#endif  // ARRAY_BUFFER_POOL_H_
@@ -0,0 +1,114 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "compressibility.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "zlib.h"
+
+namespace {
+
+// The magic bytes of a compressed file format, at offset in the file.
+struct Magic {
+  int64_t offset;
+  const char* bytes;
+  size_t length;
+};
+
+const Magic kCompressedFormats[] = {
+    {0, "\xff\xd8\xff", 3},                   // JPEG.
+    {0, "\x89PNG\r\n\x1a\n", 8},              // PNG.
+    {0, "GIF8", 4},                           // GIF.
+    {8, "WEBP", 4},                           // WebP, after "RIFF" and size.
+    {4, "ftyp", 4},                           // MP4, MOV, HEIC and M4A.
+    {0, "\x1a\x45\xdf\xa3", 4},               // Matroska and WebM.
+    {0, "ID3", 3},                            // MP3.
+    {0, "OggS", 4},                           // Ogg.
+    {0, "fLaC", 4},                           // FLAC.
+    {0, "PK\x03\x04", 4},                     // Zip, JAR, DOCX and APK.
+    {0, "\x1f\x8b", 2},                       // Gzip.
+    {0, "BZh", 3},                            // Bzip2.
+    {0, "\xfd" "7zXZ\x00", 6},                // Xz.
+    {0, "7z\xbc\xaf\x27\x1c", 6},             // 7z.
+    {0, "\x28\xb5\x2f\xfd", 4},               // Zstandard.
+    {0, "Rar!\x1a\x07", 6},                   // RAR.
+};
+
+// Samples with an entropy below this, in bits per byte, are compressible.
+const double kMaximumCompressibleEntropy = 7.0;
+
+// Samples that the trial compression doesn't make smaller than this ratio
+// of their size are incompressible.
+const double kMaximumCompressedRatio = 0.95;
+
+bool HasCompressedFormatMagic(const char* data, int64_t length) {
+  for (size_t i = 0; i < sizeof(kCompressedFormats) / sizeof(Magic); ++i) {
+    const Magic& magic = kCompressedFormats[i];
+    if (magic.offset + static_cast<int64_t>(magic.length) <= length &&
+        memcmp(data + magic.offset, magic.bytes, magic.length) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns the Shannon entropy of the bytes of data, in bits per byte.
+double Entropy(const char* data, int64_t length) {
+  int64_t counts[256] = {0};
+  for (int64_t i = 0; i < length; ++i)
+    ++counts[static_cast<unsigned char>(data[i])];
+
+  double entropy = 0;
+  for (int i = 0; i < 256; ++i) {
+    if (counts[i] == 0)
+      continue;
+    double probability = static_cast<double>(counts[i]) / length;
+    entropy -= probability * std::log(probability);
+  }
+  return entropy / std::log(2.0);
+}
+
+// Returns the size of data deflated at the fastest level, or length if
+// deflate fails.
+int64_t TrialCompressedSize(const char* data, int64_t length) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  if (deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, -MAX_WBITS,
+                   8 /* memLevel */, Z_DEFAULT_STRATEGY) != Z_OK) {
+    return length;
+  }
+
+  std::vector<Bytef> deflated(deflateBound(&stream, length));
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+  stream.avail_in = length;
+  stream.next_out = &deflated[0];
+  stream.avail_out = deflated.size();
+  int64_t compressed_size =
+      deflate(&stream, Z_FINISH) == Z_STREAM_END ? stream.total_out : length;
+  deflateEnd(&stream);
+  return compressed_size;
+}
+
+}  // namespace
+
+bool compressibility::IsIncompressible(const char* data, int64_t length) {
+  if (length < kMinimumSampleSize)
+    return false;
+  length = std::min(length, kSampleSize);
+
+  if (HasCompressedFormatMagic(data, length))
+    return true;
+
+  // The entropy is cheaper than a trial compression, but only tells when
+  // the bytes are skewed enough for Huffman coding alone to save space.
+  if (Entropy(data, length) < kMaximumCompressibleEntropy)
+    return false;
+
+  return TrialCompressedSize(data, length) >=
+         kMaximumCompressedRatio * length;
+}
@@ -0,0 +1,31 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef COMPRESSIBILITY_H_
+#define COMPRESSIBILITY_H_
+
+#include <stdint.h>
+
+// Guesses whether entries are worth compressing from their beginning, so
+// already compressed files like photos, videos and archives can be stored
+// instead of burning CPU on deflating them for nothing.
+namespace compressibility {
+
+// The number of bytes from the beginning of an entry IsIncompressible looks
+// at. More data is ignored.
+const int64_t kSampleSize = 64 * 1024;
+
+// Samples shorter than this are never considered incompressible, as
+// deflating them costs little.
+const int64_t kMinimumSampleSize = 4 * 1024;
+
+// Returns true if an entry starting with the length bytes of data is not
+// expected to get smaller with deflate. Checks in turn the magic bytes of
+// compressed file formats, the entropy of the bytes and a trial compression
+// of the sample at the fastest level.
+bool IsIncompressible(const char* data, int64_t length);
+
+}  // namespace compressibility
+
+#endif  // COMPRESSIBILITY_H_
@@ -8,12 +8,33 @@
 #include <ctime>
 #include <sstream>
 
+#include "ppapi/cpp/var_array.h"
+
 #include "request.h"
 #include "compressor_io_javascript_stream.h"
 #include "compressor_archive_libarchive.h"
+#include "compressor_archive_parallel_zip.h"
+#include "tracer.h"
 
 namespace {
 
+// Returns the kCompressionLevel of dictionary, or -1 for the default level of
+// the format.
+int GetCompressionLevel(const pp::VarDictionary& dictionary) {
+  if (dictionary.Get(request::key::kCompressionLevel).is_int())
+    return dictionary.Get(request::key::kCompressionLevel).AsInt();
+  return -1;
+}
+
+// Returns the kThreadCount of dictionary, or all the threads by default.
+int GetThreadCount(const pp::VarDictionary& dictionary) {
+  if (dictionary.Get(request::key::kThreadCount).is_int() &&
+      dictionary.Get(request::key::kThreadCount).AsInt() > 0) {
+    return dictionary.Get(request::key::kThreadCount).AsInt();
+  }
+  return WorkerPool::DefaultThreadCount();
+}
+
 // An internal implementation of JavaScriptCompressorRequestorInterface.
 class JavaScriptCompressorRequestor : public JavaScriptCompressorRequestorInterface {
  public:
@@ -21,14 +42,20 @@ class JavaScriptCompressorRequestor : public JavaScriptCompressorRequestorInterf
       compressor_(compressor) {}
 
   virtual void WriteChunkRequest(int64_t length,
-                                 const pp::VarArrayBuffer& buffer) {
+                                 const pp::VarArrayBuffer& buffer,
+                                 int64_t offset) {
     compressor_->message_sender()->SendWriteChunk(
-        compressor_->compressor_id(), buffer, length);
+        compressor_->compressor_id(), buffer, length, offset);
   }
 
-  virtual void ReadFileChunkRequest(int64_t length) {
+  virtual void ReadFileChunkRequest(int64_t offset, int64_t length) {
     compressor_->message_sender()->SendReadFileChunk(
-        compressor_->compressor_id(), length);
+        compressor_->compressor_id(), offset, length);
+  }
+
+  virtual void ReadArchiveChunkRequest(int64_t offset, int64_t length) {
+    compressor_->message_sender()->SendReadArchiveChunk(
+        compressor_->compressor_id(), offset, length);
   }
 
  private:
@@ -37,43 +64,165 @@ class JavaScriptCompressorRequestor : public JavaScriptCompressorRequestorInterf
 
 }  // namespace
 
-Compressor::Compressor(const pp::InstanceHandle& instance_handle,
+Compressor::Compressor(WorkerPool* worker_pool,
                        int compressor_id,
                        JavaScriptMessageSenderInterface* message_sender)
     : compressor_id_(compressor_id),
       message_sender_(message_sender),
-      worker_(instance_handle),
+      worker_pool_(worker_pool),
+      strand_(worker_pool->CreateStrand()),
       callback_factory_(this) {
   requestor_ = new JavaScriptCompressorRequestor(this);
   compressor_stream_ =
       new CompressorIOJavaScriptStream(requestor_);
-  compressor_archive_ =
-      new CompressorArchiveLibarchive(compressor_stream_);
+  compressor_stream_->set_stats(&stats_);
+  // Created by CreateArchive, depending on the request.
+  compressor_archive_ = NULL;
 }
 
 Compressor::~Compressor() {
-  worker_.Join();
+  worker_pool_->DestroyStrand(strand_);
   delete compressor_archive_;
   delete compressor_stream_;
   delete requestor_;
 }
 
 bool Compressor::Init() {
-  return worker_.Start();
+  return worker_pool_->Start();
+}
+
+void Compressor::SetStreamOptions(const pp::VarDictionary& dictionary) {
+  if (dictionary.Get(request::key::kReadAheadDepth).is_int()) {
+    compressor_stream_->set_read_ahead_depth(
+        dictionary.Get(request::key::kReadAheadDepth).AsInt());
+  }
+  if (dictionary.Get(request::key::kWriteBehindDepth).is_int()) {
+    compressor_stream_->set_write_behind_depth(
+        dictionary.Get(request::key::kWriteBehindDepth).AsInt());
+  }
 }
 
-void Compressor::CreateArchive() {
-  compressor_archive_->CreateArchive();
+void Compressor::CreateArchive(const pp::VarDictionary& dictionary) {
+  SetStreamOptions(dictionary);
+
+  std::string format = request::format::kZipDeflate;
+  if (dictionary.Get(request::key::kFormat).is_string())
+    format = dictionary.Get(request::key::kFormat).AsString();
+  int compression_level = GetCompressionLevel(dictionary);
+  int thread_count = GetThreadCount(dictionary);
+  bool deduplicate = dictionary.Get(request::key::kDeduplicate).is_bool() &&
+                     dictionary.Get(request::key::kDeduplicate).AsBool();
+
+  PP_DCHECK(!compressor_archive_);
+  bool is_zip = format == request::format::kZipDeflate ||
+                format == request::format::kZipStore;
+  if (is_zip && dictionary.Get(request::key::kParallel).is_bool() &&
+      dictionary.Get(request::key::kParallel).AsBool()) {
+    compressor_archive_ = new CompressorArchiveParallelZip(
+        compressor_stream_, worker_pool_, thread_count,
+        format == request::format::kZipStore ? 0 : compression_level);
+  } else {
+    compressor_archive_ = new CompressorArchiveLibarchive(
+        compressor_stream_, format, compression_level, deduplicate);
+  }
+  compressor_archive_->set_stats(&stats_);
+
+  if (!compressor_archive_->CreateArchive()) {
+    delete compressor_archive_;
+    compressor_archive_ = NULL;
+    message_sender_->SendCompressorError(compressor_id_,
+                                         "Unsupported archive format.");
+    return;
+  }
   message_sender_->SendCreateArchiveDone(compressor_id_);
 }
 
+void Compressor::AppendToArchive(const pp::VarDictionary& dictionary) {
+  SetStreamOptions(dictionary);
+
+  PP_DCHECK(dictionary.Get(request::key::kArchiveSize).is_string());
+  int64_t archive_size =
+      request::GetInt64FromString(dictionary, request::key::kArchiveSize);
+
+  // Only the zip archives written by CompressorArchiveParallelZip can be
+  // appended to.
+  PP_DCHECK(!compressor_archive_);
+  compressor_archive_ = new CompressorArchiveParallelZip(
+      compressor_stream_, worker_pool_, GetThreadCount(dictionary),
+      GetCompressionLevel(dictionary));
+  compressor_archive_->set_stats(&stats_);
+
+  // Reading the central directory waits for JavaScript.
+  worker_pool_->Post(strand_, callback_factory_.NewCallback(
+      &Compressor::AppendToArchiveCallback, archive_size));
+}
+
+void Compressor::AppendToArchiveCallback(int32_t, int64_t archive_size) {
+  Tracer::ScopedEvent trace_event("job", "AppendToArchive");
+  if (!compressor_archive_->OpenArchive(archive_size)) {
+    message_sender_->SendCompressorError(
+        compressor_id_, "Could not read the central directory of the archive.");
+    return;
+  }
+  message_sender_->SendAppendToArchiveDone(compressor_id_);
+}
+
 void Compressor::AddToArchive(const pp::VarDictionary& dictionary) {
-  worker_.message_loop().PostWork(callback_factory_.NewCallback(
+  worker_pool_->Post(strand_, callback_factory_.NewCallback(
       &Compressor::AddToArchiveCallback, dictionary));
 }
 
 void Compressor::AddToArchiveCallback(int32_t,
                                       const pp::VarDictionary& dictionary) {
+  Tracer::ScopedEvent trace_event("job", "AddToArchive");
+  AddEntry(dictionary);
+  message_sender_->SendAddToArchiveDone(compressor_id_);
+}
+
+void Compressor::AddEntriesToArchive(const pp::VarDictionary& dictionary) {
+  worker_pool_->Post(strand_, callback_factory_.NewCallback(
+      &Compressor::AddEntriesToArchiveCallback, dictionary));
+}
+
+void Compressor::AddEntriesToArchiveCallback(
+    int32_t,
+    const pp::VarDictionary& dictionary) {
+  Tracer::ScopedEvent trace_event("job", "AddEntriesToArchive");
+  PP_DCHECK(dictionary.Get(request::key::kEntries).is_array());
+  pp::VarArray entries(dictionary.Get(request::key::kEntries));
+
+  PP_DCHECK(dictionary.Get(request::key::kChunkBuffer).is_array_buffer());
+  pp::VarArrayBuffer data(dictionary.Get(request::key::kChunkBuffer));
+  int64_t data_size = data.ByteLength();
+  stats_.Add(Stats::BYTES_READ, data_size);
+  stats_.Add(Stats::ENTRY_BATCHES, 1);
+
+  // The data of every file follows the data of the previous one.
+  int64_t data_offset = 0;
+  for (uint32_t i = 0; i < entries.GetLength(); ++i) {
+    PP_DCHECK(entries.Get(i).is_dictionary());
+    pp::VarDictionary entry(entries.Get(i));
+
+    PP_DCHECK(entry.Get(request::key::kIsDirectory).is_bool());
+    int64_t file_size =
+        entry.Get(request::key::kIsDirectory).AsBool()
+            ? 0
+            : request::GetInt64FromString(entry, request::key::kFileSize);
+    if (file_size > 0) {
+      if (data_offset + file_size > data_size) {
+        message_sender_->SendCompressorError(
+            compressor_id_, "Missing data for the batch of entries.");
+        return;
+      }
+      compressor_stream_->SetNextEntryData(data, data_offset);
+      data_offset += file_size;
+    }
+    AddEntry(entry);
+  }
+  message_sender_->SendAddEntriesToArchiveDone(compressor_id_);
+}
+
+void Compressor::AddEntry(const pp::VarDictionary& dictionary) {
   PP_DCHECK(dictionary.Get(request::key::kPathname).is_string());
   std::string pathname =
       dictionary.Get(request::key::kPathname).AsString();
@@ -94,12 +243,19 @@ void Compressor::AddToArchiveCallback(int32_t,
   strptime(strtime.c_str(), "%m/%d/%Y %T", &tm);
   time_t modification_time = mktime(&tm);
 
-  compressor_archive_->AddToArchive(
-      pathname, file_size, modification_time, is_directory);
-  message_sender_->SendAddToArchiveDone(compressor_id_);
+  {
+    Stats::ScopedTimer timer(&stats_, Stats::ADD_TO_ARCHIVE_US);
+    compressor_archive_->AddToArchive(
+        pathname, file_size, modification_time, is_directory);
+  }
+  stats_.Add(Stats::ENTRIES_ADDED, 1);
 }
 
 void Compressor::ReadFileChunkDone(const pp::VarDictionary& dictionary) {
+  PP_DCHECK(dictionary.Get(request::key::kOffset).is_string());
+  int64_t offset =
+      request::GetInt64FromString(dictionary, request::key::kOffset);
+
   PP_DCHECK(dictionary.Get(request::key::kLength).is_string());
   int64_t read_bytes =
       request::GetInt64FromString(dictionary, request::key::kLength);
@@ -107,7 +263,21 @@ void Compressor::ReadFileChunkDone(const pp::VarDictionary& dictionary) {
   PP_DCHECK(dictionary.Get(request::key::kChunkBuffer).is_array_buffer());
   pp::VarArrayBuffer array_buffer(dictionary.Get(request::key::kChunkBuffer));
 
-  compressor_stream_->ReadFileChunkDone(read_bytes, &array_buffer);
+  // A negative length is an error in JavaScript.
+  if (read_bytes > 0)
+    stats_.Add(Stats::BYTES_READ, read_bytes);
+  compressor_stream_->ReadFileChunkDone(offset, read_bytes, array_buffer);
+}
+
+void Compressor::ReadArchiveChunkDone(const pp::VarDictionary& dictionary) {
+  PP_DCHECK(dictionary.Get(request::key::kLength).is_string());
+  int64_t read_bytes =
+      request::GetInt64FromString(dictionary, request::key::kLength);
+
+  PP_DCHECK(dictionary.Get(request::key::kChunkBuffer).is_array_buffer());
+  pp::VarArrayBuffer array_buffer(dictionary.Get(request::key::kChunkBuffer));
+
+  compressor_stream_->ReadArchiveChunkDone(read_bytes, array_buffer);
 }
 
 void Compressor::WriteChunkDone(const pp::VarDictionary& dictionary) {
@@ -115,6 +285,8 @@ void Compressor::WriteChunkDone(const pp::VarDictionary& dictionary) {
   int64_t written_bytes =
       request::GetInt64FromString(dictionary, request::key::kLength);
 
+  if (written_bytes > 0)
+    stats_.Add(Stats::BYTES_WRITTEN, written_bytes);
   compressor_stream_->WriteChunkDone(written_bytes);
 }
 
@@ -126,15 +298,25 @@ void Compressor::CloseArchive(const pp::VarDictionary& dictionary) {
   // If an error has occurred, no more write chunk requests are sent and
   // CloseArchive() can be safely called in the main thread.
   if (has_error) {
-    compressor_archive_->CloseArchive(has_error);
+    // The archive may fail before it is created.
+    if (compressor_archive_)
+      compressor_archive_->CloseArchive(has_error);
     message_sender_->SendCloseArchiveDone(compressor_id_);
   } else {
-    worker_.message_loop().PostWork(callback_factory_.NewCallback(
+    worker_pool_->Post(strand_, callback_factory_.NewCallback(
         &Compressor::CloseArchiveCallback, has_error));
   }
 }
 
 void Compressor::CloseArchiveCallback(int32_t, bool has_error) {
+  Tracer::ScopedEvent trace_event("job", "CloseArchive");
   compressor_archive_->CloseArchive(has_error);
+
+  // The archive is complete only once the chunks written behind are written.
+  if (compressor_stream_->Flush() < 0) {
+    message_sender_->SendCompressorError(compressor_id_,
+                                         "Failed to write the archive.");
+    return;
+  }
   message_sender_->SendCloseArchiveDone(compressor_id_);
 }
@@ -9,22 +9,22 @@
 #include <pthread.h>
 
 #include "archive.h"
-#include "ppapi/cpp/instance_handle.h"
 #include "ppapi/cpp/var_array_buffer.h"
 #include "ppapi/cpp/var_dictionary.h"
 #include "ppapi/utility/completion_callback_factory.h"
-#include "ppapi/utility/threading/simple_thread.h"
 
 #include "compressor_archive.h"
-#include "compressor_stream.h"
+#include "compressor_io_javascript_stream.h"
 #include "javascript_compressor_requestor_interface.h"
 #include "javascript_message_sender_interface.h"
+#include "stats.h"
+#include "worker_pool.h"
 
 // Handles all packing operations like creating archive objects and writing data
 // onto the archive.
 class Compressor {
  public:
-  Compressor(const pp::InstanceHandle& instance_handle /* Used for workers. */,
+  Compressor(WorkerPool* worker_pool /* Used for jobs. */,
              int compressor_id,
              JavaScriptMessageSenderInterface* message_sender);
 
@@ -33,15 +33,41 @@ class Compressor {
   // Initializes the compressor.
   bool Init();
 
-  // Creates an archive object.
-  void CreateArchive();
+  // Creates an archive object. dictionary is the CREATE_ARCHIVE request, with
+  // optional kReadAheadDepth, the number of chunks of an entry read from
+  // JavaScript while the previous chunk is compressed, and kWriteBehindDepth,
+  // the number of compressed chunks left to be written by JavaScript,
+  // kFormat, one of the request::format values, zip-deflate by default,
+  // kCompressionLevel, kParallel, to deflate the entries of zip archives in
+  // parallel with CompressorArchiveParallelZip instead of libarchive,
+  // kThreadCount, the number of threads deflating them, all of them by
+  // default, and kDeduplicate, to write the files of tar archives
+  // identical to a previous one as hard links to it.
+  void CreateArchive(const pp::VarDictionary& dictionary);
+
+  // Opens the existing zip archive of kArchiveSize bytes to add entries to it,
+  // instead of creating an archive. The new entries are written over the
+  // central directory of the archive, followed by the new central directory,
+  // so the data of the existing entries is neither read nor written again.
+  // dictionary is the APPEND_TO_ARCHIVE request, with the options of
+  // CreateArchive except kFormat, kParallel and kDeduplicate.
+  void AppendToArchive(const pp::VarDictionary& dictionary);
 
   // Adds an entry to the archive.
   void AddToArchive(const pp::VarDictionary& dictionary);
 
+  // Adds the batch of entries of dictionary[kEntries] to the archive in a
+  // single job. The data of their files is in dictionary[kChunkBuffer], one
+  // after the other in the order of the entries, so no chunk is requested
+  // from JavaScript.
+  void AddEntriesToArchive(const pp::VarDictionary& dictionary);
+
   // Processes a file chunk sent from JavaScript.
   void ReadFileChunkDone(const pp::VarDictionary& dictionary);
 
+  // Processes a chunk of the archive appended to sent from JavaScript.
+  void ReadArchiveChunkDone(const pp::VarDictionary& dictionary);
+
   // Receives a write chunk response from JavaScript.
   void WriteChunkDone(const pp::VarDictionary& dictionary);
 
@@ -57,11 +83,31 @@ class Compressor {
   // A getter function for the compressor id.
   int compressor_id() { return compressor_id_; }
 
+  // Returns the stats of the compressor for GET_STATS. Can be called from any
+  // thread.
+  pp::VarDictionary GetStats() const { return stats_.ToVarDictionary(); }
+
  private:
 
+  // Sets the kReadAheadDepth and kWriteBehindDepth options of dictionary to
+  // the stream.
+  void SetStreamOptions(const pp::VarDictionary& dictionary);
+
+  // A callback helper for AppendToArchive.
+  void AppendToArchiveCallback(int32_t, int64_t archive_size);
+
   // A callback helper for AddToArchive.
   void AddToArchiveCallback(int32_t, const pp::VarDictionary& dictionary);
 
+  // A callback helper for AddEntriesToArchive.
+  void AddEntriesToArchiveCallback(int32_t,
+                                   const pp::VarDictionary& dictionary);
+
+  // Adds the entry described by dictionary, with kPathname, kFileSize,
+  // kIsDirectory and kModificationTime, to the archive. Must not be called in
+  // the main thread.
+  void AddEntry(const pp::VarDictionary& dictionary);
+
   // A callback helper for CloseArchive.
   void CloseArchiveCallback(int32_t, bool has_error);
 
@@ -71,23 +117,31 @@ class Compressor {
   // An object that sends messages to JavaScript.
   JavaScriptMessageSenderInterface* message_sender_;
 
-  // A worker for jobs that require blocking operations or a lot of processing
-  // time. Those shouldn't be done on the main thread. The jobs submitted to
-  // this thread are executed in order, so a new job must wait for the last job
-  // to finish.
-  pp::SimpleThread worker_;
+  // The module wide pool of workers for jobs that require blocking operations
+  // or a lot of processing time. Those shouldn't be done on the main thread.
+  // Not owned.
+  WorkerPool* worker_pool_;
 
-  // Callback factory used to submit jobs to worker_.
+  // The strand of worker_pool_ for the jobs of this compressor. The jobs
+  // submitted to it are executed in order, so a new job must wait for the
+  // last job to finish.
+  WorkerPool::Strand* strand_;
+
+  // Callback factory used to submit jobs to strand_.
   pp::CompletionCallbackFactory<Compressor> callback_factory_;
 
   // A requestor for making calls to JavaScript.
   JavaScriptCompressorRequestorInterface* requestor_;
 
-  // Libarchive wrapper instance per compressor, shared across all operations.
+  // The archive instance per compressor, shared across all operations.
+  // Created by CreateArchive.
   CompressorArchive* compressor_archive_;
 
   // An instance that takes care of all IO operations.
-  CompressorStream* compressor_stream_;
+  CompressorIOJavaScriptStream* compressor_stream_;
+
+  // The counters and histograms of the compressor.
+  Stats stats_;
 };
 
 #endif  /// COMPRESSOR_H_
@@ -6,19 +6,27 @@
 #define COMPRESSSOR_ARCHIVE_H_
 
 #include "compressor_io_javascript_stream.h"
+#include "stats.h"
 
 // Defines a wrapper for packing operations executed on an archive. API is not
 // meant to be thread safe and its methods shouldn't be called in parallel.
 class CompressorArchive {
  public:
   explicit CompressorArchive(CompressorStream* compressor_stream)
-    : compressor_stream_(compressor_stream) {}
+    : compressor_stream_(compressor_stream), stats_(NULL) {}
 
   virtual ~CompressorArchive() {}
 
   // Creates an archive object. This method does not call CustomArchiveWrite, so
-  // this is synchronous.
-  virtual void CreateArchive() = 0;
+  // this is synchronous. Returns false if the format of the archive is not
+  // supported.
+  virtual bool CreateArchive() = 0;
+
+  // Opens the existing archive of archive_size bytes to append entries to it,
+  // instead of CreateArchive. Reads the archive through the stream, so this
+  // method must not be called in the main thread. Returns false if the
+  // archive can't be appended to, which is the default.
+  virtual bool OpenArchive(int64_t archive_size) { return false; }
 
   // Releases all resources obtained by libarchive.
   // This method also writes metadata about the archive itself onto the end of
@@ -43,12 +51,37 @@ class CompressorArchive {
   // A getter function for compressor_stream_.
   CompressorStream* compressor_stream() const { return compressor_stream_; }
 
+  // Sets the stats where the entries stored without compression and the
+  // deduplicated ones are counted. stats can be NULL. Not owned.
+  void set_stats(Stats* stats) { stats_ = stats; }
+
+ protected:
+  // Counts an entry of entry_size bytes stored because it looked
+  // incompressible.
+  void RecordStoredEntry(int64_t entry_size) {
+    if (!stats_)
+      return;
+    stats_->Add(Stats::ENTRIES_STORED, 1);
+    stats_->Add(Stats::BYTES_STORED, entry_size);
+  }
+
+  // Counts an entry of entry_size bytes written as a hard link to an
+  // identical one instead of writing its data again.
+  void RecordDeduplicatedEntry(int64_t entry_size) {
+    if (!stats_)
+      return;
+    stats_->Add(Stats::ENTRIES_DEDUPLICATED, 1);
+    stats_->Add(Stats::BYTES_DEDUPLICATED, entry_size);
+  }
+
  private:
   // The libarchive correspondent archive object.
   struct archive* archive_;
 
   // An instance that takes care of all IO operations.
   CompressorStream* compressor_stream_;
+
+  Stats* stats_;
 };
 
 #endif  // COMPRESSSOR_ARCHIVE_H_
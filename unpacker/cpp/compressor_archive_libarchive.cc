@@ -6,10 +6,14 @@
 
 #include <cerrno>
 #include <cstring>
+#include <sstream>
 
 #include "archive_entry.h"
 #include "ppapi/cpp/logging.h"
 
+#include "compressibility.h"
+#include "request.h"
+
 namespace {
   // Nothing to do here because JavaScript takes care of file open operations.
   int CustomArchiveOpen(archive* archive_object, void* client_data) {
@@ -17,8 +21,8 @@ namespace {
   }
 
   // Called when any data chunk must be written on the archive. It copies data
-  // from the given buffer processed by libarchive to an array buffer and passes
-  // it to compressor_stream.
+  // from the given buffer processed by libarchive to an array buffer recycled
+  // by compressor_stream and passes it to compressor_stream.
   ssize_t CustomArchiveWrite(archive* archive_object, void* client_data,
       const void* buffer, size_t length) {
     CompressorArchiveLibarchive* compressor_libarchive =
@@ -28,7 +32,8 @@ namespace {
 
     // Copy the data in buffer to array_buffer.
     PP_DCHECK(length > 0);
-    pp::VarArrayBuffer array_buffer(length);
+    pp::VarArrayBuffer array_buffer =
+        compressor_libarchive->compressor_stream()->AcquireWriteBuffer(length);
     char* array_buffer_data = static_cast<char*>(array_buffer.Map());
     memcpy(array_buffer_data, char_buffer, length);
     array_buffer.Unmap();
@@ -54,20 +59,52 @@ namespace {
 }
 
 CompressorArchiveLibarchive::CompressorArchiveLibarchive(
-    CompressorStream* compressor_stream)
+    CompressorStream* compressor_stream,
+    const std::string& format,
+    int compression_level,
+    bool deduplicate)
     : CompressorArchive(compressor_stream),
-      compressor_stream_(compressor_stream) {
-  destination_buffer_ =
-      new char[compressor_archive_constants::kMaximumDataChunkSize];
+      compressor_stream_(compressor_stream),
+      archive_(NULL),
+      format_(format),
+      compression_level_(format == request::format::kZipStore
+                             ? 0
+                             : compression_level),
+      is_zip_(format == request::format::kZipDeflate ||
+              format == request::format::kZipStore),
+      hasher_(NULL) {
+  // Zip archives have no hard links.
+  if (deduplicate && !is_zip_)
+    hasher_ = Hasher::Create("blake3");
 }
 
 CompressorArchiveLibarchive::~CompressorArchiveLibarchive() {
-  delete destination_buffer_;
+  delete hasher_;
 }
 
-void CompressorArchiveLibarchive::CreateArchive() {
+bool CompressorArchiveLibarchive::CreateArchive() {
   archive_ = archive_write_new();
-  archive_write_set_format_zip(archive_);
+
+  int result = ARCHIVE_FATAL;
+  if (is_zip_) {
+    result = archive_write_set_format_zip(archive_);
+  } else if (format_ == request::format::kTar ||
+             format_ == request::format::kTarGzip ||
+             format_ == request::format::kTarXz) {
+    // The restricted pax format adds extended headers only for the entries
+    // ustar can't describe, like the ones with long or non-ASCII pathnames.
+    result = archive_write_set_format_pax_restricted(archive_);
+    if (result == ARCHIVE_OK && format_ == request::format::kTarGzip)
+      result = archive_write_add_filter_by_name(archive_, "gzip");
+    else if (result == ARCHIVE_OK && format_ == request::format::kTarXz)
+      result = archive_write_add_filter_by_name(archive_, "xz");
+  }
+  if (result != ARCHIVE_OK) {
+    archive_write_free(archive_);
+    archive_ = NULL;
+    return false;
+  }
+  SetOptions();
 
   // Passing 1 as the second argument causes the final chunk not to be padded.
   archive_write_set_bytes_in_last_block(archive_, 1);
@@ -75,6 +112,25 @@ void CompressorArchiveLibarchive::CreateArchive() {
      archive_, compressor_archive_constants::kMaximumDataChunkSize);
   archive_write_open(archive_, this, CustomArchiveOpen,
                      CustomArchiveWrite, CustomArchiveClose);
+  return true;
+}
+
+void CompressorArchiveLibarchive::SetOptions() {
+  if (compression_level_ > 0) {
+    std::stringstream level;
+    level << compression_level_;
+    if (is_zip_) {
+      archive_write_set_format_option(
+          archive_, "zip", "compression-level", level.str().c_str());
+    } else if (format_ != request::format::kTar) {
+      archive_write_set_filter_option(
+          archive_, NULL, "compression-level", level.str().c_str());
+    }
+  }
+
+  // The options libarchive does not know leave an error, which would fail the
+  // first entry.
+  archive_clear_error(archive_);
 }
 
 void CompressorArchiveLibarchive::AddToArchive(
@@ -97,48 +153,144 @@ void CompressorArchiveLibarchive::AddToArchive(
     archive_entry_set_perm(
         entry, compressor_archive_constants::kFilePermission);
   }
+  // The first chunk of a file is read before the header, as it decides
+  // whether the file is deflated or stored. The chunks are read in place, so
+  // libarchive compresses the buffers received from JavaScript.
+  int64_t read_bytes = 0;
+  const char* data = NULL;
+  std::string digest;  // Set before the header if the file is hashed first.
+  if (!is_directory && file_size > 0) {
+    // The stream reads the next chunks ahead while the current one is
+    // compressed.
+    compressor_stream_->StartEntry(file_size);
+
+    if (hasher_ && file_sizes_.count(file_size)) {
+      if (!HashEntry(file_size, &digest)) {
+        CloseArchive(true /* hasError */);
+        archive_entry_free(entry);
+        return;
+      }
+      std::map<std::pair<int64_t, std::string>, std::string>::const_iterator
+          original = pathnames_.find(std::make_pair(file_size, digest));
+      if (original != pathnames_.end()) {
+        // A hard link has no data.
+        archive_entry_set_size(entry, 0);
+        archive_entry_set_hardlink(entry, original->second.c_str());
+        archive_write_header(archive_, entry);
+        if (archive_errno(archive_) != 0)
+          CloseArchive(true /* hasError */);
+        else
+          RecordDeduplicatedEntry(file_size);
+        archive_entry_free(entry);
+        return;
+      }
+      compressor_stream_->RewindEntry();
+    }
+
+    read_bytes = compressor_stream_->ReadInPlace(
+        std::min(file_size,
+                 compressor_archive_constants::kMaximumDataChunkSize),
+        &data);
+    // Negative read_bytes indicates an error occurred when reading chunks.
+    if (read_bytes < 0) {
+      CloseArchive(true /* hasError */);
+      archive_entry_free(entry);
+      return;
+    }
+  }
+
+  // The compression of tar archives applies to the whole archive instead.
+  if (is_zip_) {
+    if (compression_level_ == 0) {
+      archive_write_zip_set_compression_store(archive_);
+    } else if (compressibility::IsIncompressible(data, read_bytes)) {
+      archive_write_zip_set_compression_store(archive_);
+      RecordStoredEntry(file_size);
+    } else {
+      archive_write_zip_set_compression_deflate(archive_);
+    }
+  }
+
   archive_write_header(archive_, entry);
   // If archive_errno() returns 0, the header was written correctly.
   if (archive_errno(archive_) != 0) {
     CloseArchive(true /* hasError */);
+    archive_entry_free(entry);
     return;
   }
 
-  if (!is_directory) {
-    int64_t remaining_size = file_size;
-    while (remaining_size > 0) {
+  // The files not hashed yet are hashed while they are written.
+  bool hash_data = hasher_ && !is_directory && file_size > 0 && digest.empty();
+  if (hash_data)
+    hasher_->Reset();
+
+  int64_t remaining_size = is_directory ? 0 : file_size;
+  while (remaining_size > 0) {
+    if (read_bytes == 0) {
       int64_t chunk_size = std::min(remaining_size,
           compressor_archive_constants::kMaximumDataChunkSize);
       PP_DCHECK(chunk_size > 0);
 
-      int64_t read_bytes =
-          compressor_stream_->Read(chunk_size, destination_buffer_);
+      read_bytes = compressor_stream_->ReadInPlace(chunk_size, &data);
       // Negative read_bytes indicates an error occurred when reading chunks.
       if (read_bytes < 0) {
         CloseArchive(true /* hasError */);
         break;
       }
+    }
 
-      int64_t written_bytes =
-          archive_write_data(archive_, destination_buffer_, read_bytes);
-      // If archive_errno() returns 0, the buffer was written correctly.
-      if (archive_errno(archive_) != 0) {
-        CloseArchive(true /* hasError */);
-        break;
-      }
-      PP_DCHECK(written_bytes > 0);
-
-      remaining_size -= written_bytes;
+    if (hash_data)
+      hasher_->Update(data, read_bytes);
+    int64_t written_bytes =
+        archive_write_data(archive_, data, read_bytes);
+    // If archive_errno() returns 0, the buffer was written correctly.
+    if (archive_errno(archive_) != 0) {
+      CloseArchive(true /* hasError */);
+      break;
     }
+    PP_DCHECK(written_bytes > 0);
+
+    remaining_size -= written_bytes;
+    read_bytes = 0;
+  }
+
+  // Only the files written completely can be linked to.
+  if (hasher_ && !is_directory && file_size > 0 && remaining_size == 0 &&
+      archive_) {
+    if (hash_data)
+      digest = hasher_->Finish();
+    file_sizes_.insert(file_size);
+    pathnames_.insert(
+        std::make_pair(std::make_pair(file_size, digest), filename));
   }
 
   archive_entry_free(entry);
 }
 
+bool CompressorArchiveLibarchive::HashEntry(int64_t file_size,
+                                            std::string* digest) {
+  hasher_->Reset();
+  int64_t remaining_size = file_size;
+  while (remaining_size > 0) {
+    const char* data = NULL;
+    int64_t read_bytes = compressor_stream_->ReadInPlace(
+        std::min(remaining_size,
+                 compressor_archive_constants::kMaximumDataChunkSize),
+        &data);
+    // The file may be shorter than expected, or reading it failed.
+    if (read_bytes <= 0)
+      return false;
+    hasher_->Update(data, read_bytes);
+    remaining_size -= read_bytes;
+  }
+  *digest = hasher_->Finish();
+  return true;
+}
+
 void CompressorArchiveLibarchive::CloseArchive(bool has_error) {
   // If has_error is true, mark the archive object as being unusable and
   // release resources without writing no more data on the archive.
-  if (has_error)
+  if (has_error && archive_)
     archive_write_fail(archive_);
   if (archive_) {
     archive_write_free(archive_);
@@ -5,12 +5,16 @@
 #ifndef COMPRESSOR_ARCHIVE_LIBARCHIVE_H_
 #define COMPRESSOR_ARCHIVE_LIBARCHIVE_H_
 
+#include <map>
+#include <set>
 #include <string>
+#include <utility>
 
 #include "archive.h"
 
 #include "compressor_archive.h"
 #include "compressor_stream.h"
+#include "hasher.h"
 
 // A namespace with constants used by CompressorArchiveLibarchive.
 namespace compressor_archive_constants {
@@ -21,12 +25,22 @@ const int kDirectoryPermission = 760;
 
 class CompressorArchiveLibarchive : public CompressorArchive {
  public:
-  explicit CompressorArchiveLibarchive(CompressorStream* compressor_stream);
+  // format is one of the request::format values. compression_level is the
+  // level of the deflate, gzip or xz compression, or -1 for the default
+  // level of libarchive. 0 stores the entries of zip archives. If
+  // deduplicate is true, the files of tar archives identical to a file
+  // written before are written as hard links to it. The xz filter of the
+  // bundled libarchive compresses on a single thread.
+  CompressorArchiveLibarchive(CompressorStream* compressor_stream,
+                              const std::string& format,
+                              int compression_level,
+                              bool deduplicate);
 
   virtual ~CompressorArchiveLibarchive();
 
-  // Creates an archive object.
-  virtual void CreateArchive();
+  // Creates an archive object. Returns false if format is unknown or its
+  // filter is not supported by libarchive.
+  virtual bool CreateArchive();
 
   // Releases all resources obtained by libarchive.
   virtual void CloseArchive(bool has_error);
@@ -44,6 +58,14 @@ class CompressorArchiveLibarchive : public CompressorArchive {
   CompressorStream* compressor_stream() const { return compressor_stream_; }
 
  private:
+  // Sets the compression level option of the archive.
+  // The options libarchive does not support are ignored.
+  void SetOptions();
+
+  // Reads the current entry of file_size bytes from the stream and sets
+  // digest to its hash. Returns false if reading failed.
+  bool HashEntry(int64_t file_size, std::string* digest);
+
   // An instance that takes care of all IO operations.
   CompressorStream* compressor_stream_;
 
@@ -54,8 +76,24 @@ class CompressorArchiveLibarchive : public CompressorArchive {
   // processed.
   struct archive_entry* entry;
 
-  // The buffer used to store the data read from JavaScript.
-  char* destination_buffer_;
+  // The format of the archive and its options, as passed to the constructor,
+  // except for zip-store, which has a compression level of 0.
+  const std::string format_;
+  const int compression_level_;
+
+  // True for the zip formats, false for the tar ones.
+  bool is_zip_;
+
+  // Hashes the files to find the duplicates, or NULL if the archive is not
+  // deduplicated.
+  Hasher* hasher_;
+
+  // The sizes of the files written, and the pathname of the first file
+  // written for every size and digest. A file is hashed before its header
+  // only if a file of the same size was written, as only then it can be a
+  // duplicate. The other files are hashed while they are written.
+  std::set<int64_t> file_sizes_;
+  std::map<std::pair<int64_t, std::string>, std::string> pathnames_;
 };
 
 #endif  // COMPRESSOR_ARCHIVE_LIBARCHIVE_H_
@@ -0,0 +1,799 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "compressor_archive_parallel_zip.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "ppapi/cpp/logging.h"
+#include "ppapi/cpp/var_array_buffer.h"
+#include "zlib.h"
+
+#include "compressibility.h"
+#include "compressor_archive_libarchive.h"
+#include "tracer.h"
+
+namespace {
+
+// The signatures of the zip records.
+const uint32_t kLocalFileHeaderSignature = 0x04034b50;
+const uint32_t kDataDescriptorSignature = 0x08074b50;
+const uint32_t kCentralDirectoryHeaderSignature = 0x02014b50;
+const uint32_t kZip64EndOfCentralDirectorySignature = 0x06064b50;
+const uint32_t kZip64EndOfCentralDirectoryLocatorSignature = 0x07064b50;
+const uint32_t kEndOfCentralDirectorySignature = 0x06054b50;
+
+// The id of the zip64 extended information extra field.
+const uint16_t kZip64ExtraFieldId = 0x0001;
+
+// The versions needed to extract the entries.
+const uint16_t kVersionDeflate = 20;
+const uint16_t kVersionZip64 = 45;
+
+// The version made by is the version needed on a UNIX host, so the external
+// attributes hold the permissions.
+const uint16_t kHostUnix = 3 << 8;
+
+// The general purpose bit flags.
+const uint16_t kDataDescriptorFlag = 1 << 3;
+const uint16_t kUtf8Flag = 1 << 11;
+
+// The compression methods.
+const uint16_t kMethodStored = 0;
+const uint16_t kMethodDeflated = 8;
+
+// The MS-DOS directory attribute of the external attributes.
+const uint32_t kDosDirectoryAttribute = 0x10;
+
+// Sizes and offsets from this value on need zip64 records.
+const int64_t kZip64Limit = 0xffffffffLL;
+
+// Streamed entries from this size on use zip64 records, as their compressed
+// size is not known when writing the local header. Leaves room for the worst
+// case expansion of deflate.
+const int64_t kZip64StreamedEntrySize = 0xf0000000LL;
+
+// The sizes of the fixed parts of the records read by OpenArchive.
+const int64_t kCentralDirectoryHeaderSize = 46;
+const int64_t kZip64EndOfCentralDirectorySize = 56;
+const int64_t kZip64EndOfCentralDirectoryLocatorSize = 20;
+const int64_t kEndOfCentralDirectorySize = 22;
+
+// The maximum length of the comment of an archive.
+const int64_t kMaximumCommentLength = 0xffff;
+
+// The size of the deflate window, which is the most a block can use of the
+// previous one.
+const size_t kDictionarySize = 32 * 1024;
+
+void AppendUint16(std::vector<char>* buffer, uint16_t value) {
+  buffer->push_back(static_cast<char>(value & 0xff));
+  buffer->push_back(static_cast<char>(value >> 8));
+}
+
+void AppendUint32(std::vector<char>* buffer, uint32_t value) {
+  AppendUint16(buffer, static_cast<uint16_t>(value & 0xffff));
+  AppendUint16(buffer, static_cast<uint16_t>(value >> 16));
+}
+
+void AppendUint64(std::vector<char>* buffer, uint64_t value) {
+  AppendUint32(buffer, static_cast<uint32_t>(value & 0xffffffff));
+  AppendUint32(buffer, static_cast<uint32_t>(value >> 32));
+}
+
+// Appends value, or 0xffffffff if it needs a zip64 record.
+void AppendUint32OrZip64(std::vector<char>* buffer, int64_t value) {
+  AppendUint32(buffer, static_cast<uint32_t>(std::min(value, kZip64Limit)));
+}
+
+uint16_t ReadUint16(const char* buffer) {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(buffer);
+  return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+}
+
+uint32_t ReadUint32(const char* buffer) {
+  return ReadUint16(buffer) |
+         (static_cast<uint32_t>(ReadUint16(buffer + 2)) << 16);
+}
+
+uint64_t ReadUint64(const char* buffer) {
+  return ReadUint32(buffer) |
+         (static_cast<uint64_t>(ReadUint32(buffer + 4)) << 32);
+}
+
+// Returns the MS-DOS time and date of time, in local time like
+// libarchive. Times before 1980 can't be represented and are clamped.
+void ToDosTime(time_t time, uint16_t* dos_time, uint16_t* dos_date) {
+  tm local;
+  localtime_r(&time, &local);
+  if (local.tm_year < 80) {
+    *dos_time = 0;
+    *dos_date = (1 << 5) | 1;  // 1980-01-01.
+    return;
+  }
+  *dos_time = static_cast<uint16_t>((local.tm_hour << 11) |
+                                    (local.tm_min << 5) | (local.tm_sec / 2));
+  *dos_date = static_cast<uint16_t>(((local.tm_year - 80) << 9) |
+                                    ((local.tm_mon + 1) << 5) | local.tm_mday);
+}
+
+// Initializes stream for a raw deflate stream at level, as zip archives have
+// no zlib headers.
+bool InitDeflate(z_stream* stream, int level) {
+  memset(stream, 0, sizeof(*stream));
+  return deflateInit2(stream, level, Z_DEFLATED, -MAX_WBITS, 8 /* memLevel */,
+                      Z_DEFAULT_STRATEGY) == Z_OK;
+}
+
+}  // namespace
+
+const int64_t CompressorArchiveParallelZip::kMaximumBufferedEntrySize;
+const int64_t CompressorArchiveParallelZip::kMaximumPendingBytes;
+const int64_t CompressorArchiveParallelZip::kBlockSize;
+
+CompressorArchiveParallelZip::Entry::Entry()
+    : dos_time(0),
+      dos_date(0),
+      is_directory(false),
+      flags(kUtf8Flag),
+      method(kMethodStored),
+      zip64(false),
+      crc(0),
+      uncompressed_size(0),
+      compressed_size(0),
+      local_header_offset(0),
+      ready(false) {}
+
+CompressorArchiveParallelZip::Block::Block()
+    : uncompressed_size(0), crc(0), last(false), level(0), ready(false) {}
+
+CompressorArchiveParallelZip::CompressorArchiveParallelZip(
+    CompressorStream* compressor_stream,
+    WorkerPool* worker_pool,
+    int job_count,
+    int compression_level)
+    : CompressorArchive(compressor_stream),
+      worker_pool_(worker_pool),
+      compression_level_(
+          compression_level < 0
+              ? Z_DEFAULT_COMPRESSION
+              : std::min(compression_level, Z_BEST_COMPRESSION)),
+      next_strand_(0),
+      pending_bytes_(0),
+      existing_entry_count_(0),
+      output_data_(NULL),
+      output_size_(0),
+      offset_(0),
+      failed_(false) {
+  PP_DCHECK(job_count > 0);
+  pthread_mutex_init(&lock_, NULL);
+  pthread_cond_init(&ready_cond_, NULL);
+  for (int i = 0; i < job_count; ++i)
+    strands_.push_back(worker_pool_->CreateStrand());
+}
+
+CompressorArchiveParallelZip::~CompressorArchiveParallelZip() {
+  // Wait for the entries being deflated before deleting them.
+  for (size_t i = 0; i < strands_.size(); ++i)
+    worker_pool_->DestroyStrand(strands_[i]);
+  for (size_t i = 0; i < pending_entries_.size(); ++i)
+    delete pending_entries_[i];
+  for (size_t i = 0; i < written_entries_.size(); ++i)
+    delete written_entries_[i];
+  if (output_data_)
+    output_buffer_.Unmap();
+  pthread_cond_destroy(&ready_cond_);
+  pthread_mutex_destroy(&lock_);
+}
+
+bool CompressorArchiveParallelZip::CreateArchive() {
+  // Nothing is written before the first entry.
+  offset_ = 0;
+  failed_ = false;
+  return true;
+}
+
+bool CompressorArchiveParallelZip::OpenArchive(int64_t archive_size) {
+  failed_ = false;
+  existing_central_directory_.clear();
+  existing_entry_count_ = 0;
+  if (archive_size < kEndOfCentralDirectorySize)
+    return false;
+
+  // The end of central directory record is at the end of the archive, before
+  // the comment, preceded by the zip64 locator if any.
+  const int64_t tail_size =
+      std::min(archive_size, kZip64EndOfCentralDirectoryLocatorSize +
+                                 kEndOfCentralDirectorySize +
+                                 kMaximumCommentLength);
+  const int64_t tail_offset = archive_size - tail_size;
+  std::vector<char> tail(tail_size);
+  if (!ReadArchive(tail_offset, tail_size, &tail[0]))
+    return false;
+
+  int64_t end = tail_size - kEndOfCentralDirectorySize;
+  while (end >= 0 &&
+         (ReadUint32(&tail[end]) != kEndOfCentralDirectorySignature ||
+          end + kEndOfCentralDirectorySize + ReadUint16(&tail[end + 20]) !=
+              tail_size)) {
+    --end;
+  }
+  if (end < 0)
+    return false;
+  if (ReadUint16(&tail[end + 4]) != 0 || ReadUint16(&tail[end + 6]) != 0)
+    return false;  // Split archives are not supported.
+
+  int64_t entry_count = ReadUint16(&tail[end + 10]);
+  int64_t central_directory_size = ReadUint32(&tail[end + 12]);
+  int64_t central_directory_offset = ReadUint32(&tail[end + 16]);
+  int64_t end_records_offset = tail_offset + end;
+
+  const int64_t locator = end - kZip64EndOfCentralDirectoryLocatorSize;
+  if (locator >= 0 &&
+      ReadUint32(&tail[locator]) ==
+          kZip64EndOfCentralDirectoryLocatorSignature) {
+    end_records_offset = ReadUint64(&tail[locator + 8]);
+    if (end_records_offset < 0 ||
+        end_records_offset + kZip64EndOfCentralDirectorySize >
+            tail_offset + locator) {
+      return false;
+    }
+    char zip64_end[kZip64EndOfCentralDirectorySize];
+    if (!ReadArchive(end_records_offset, sizeof(zip64_end), zip64_end) ||
+        ReadUint32(zip64_end) != kZip64EndOfCentralDirectorySignature ||
+        ReadUint32(zip64_end + 16) != 0 || ReadUint32(zip64_end + 20) != 0) {
+      return false;
+    }
+    entry_count = ReadUint64(zip64_end + 32);
+    central_directory_size = ReadUint64(zip64_end + 40);
+    central_directory_offset = ReadUint64(zip64_end + 48);
+  }
+
+  // The new entries are written over the central directory and the end
+  // records, so nothing else may be there.
+  if (entry_count < 0 || central_directory_size < 0 ||
+      central_directory_offset < 0 ||
+      central_directory_offset != end_records_offset - central_directory_size) {
+    return false;
+  }
+
+  existing_central_directory_.resize(central_directory_size);
+  if (central_directory_size > 0 &&
+      !ReadArchive(central_directory_offset, central_directory_size,
+                   &existing_central_directory_[0])) {
+    return false;
+  }
+
+  // The records are kept verbatim, so only their sizes are checked.
+  int64_t record = 0;
+  int64_t record_count = 0;
+  while (record < central_directory_size) {
+    if (record + kCentralDirectoryHeaderSize > central_directory_size)
+      return false;
+    const char* header = &existing_central_directory_[record];
+    if (ReadUint32(header) != kCentralDirectoryHeaderSignature)
+      return false;
+    record += kCentralDirectoryHeaderSize + ReadUint16(header + 28) +
+              ReadUint16(header + 30) + ReadUint16(header + 32);
+    ++record_count;
+  }
+  if (record != central_directory_size || record_count != entry_count)
+    return false;
+
+  existing_entry_count_ = entry_count;
+  offset_ = central_directory_offset;
+  compressor_stream()->SetWriteOffset(central_directory_offset);
+  return true;
+}
+
+void CompressorArchiveParallelZip::CloseArchive(bool has_error) {
+  // The pending entries may still be deflated, so they are deleted by the
+  // destructor.
+  if (has_error) {
+    failed_ = true;
+    return;
+  }
+
+  WriteReadyEntries(0);
+  if (!failed_)
+    WriteCentralDirectory();
+  FlushOutput();
+}
+
+void CompressorArchiveParallelZip::AddToArchive(const std::string& filename,
+                                                int64_t file_size,
+                                                time_t modification_time,
+                                                bool is_directory) {
+  if (failed_)
+    return;
+
+  Entry* entry = new Entry;
+  entry->pathname = filename;
+  // Directories are recognized by the trailing slash.
+  if (is_directory && (filename.empty() || *filename.rbegin() != '/'))
+    entry->pathname += '/';
+  ToDosTime(modification_time, &entry->dos_time, &entry->dos_date);
+  entry->is_directory = is_directory;
+  entry->uncompressed_size = is_directory ? 0 : file_size;
+
+  // Empty entries are stored without data.
+  if (entry->uncompressed_size == 0) {
+    entry->ready = true;
+    pthread_mutex_lock(&lock_);
+    pending_entries_.push_back(entry);
+    pthread_mutex_unlock(&lock_);
+    WriteReadyEntries(kMaximumPendingBytes);
+    return;
+  }
+
+  if (entry->uncompressed_size <= kMaximumBufferedEntrySize) {
+    AddBufferedEntry(entry);
+    return;
+  }
+
+  WriteReadyEntries(0);
+  AddStreamedEntry(entry);
+}
+
+// static
+void CompressorArchiveParallelZip::RunDeflateJob(void* job, int32_t) {
+  DeflateJob* deflate_job = static_cast<DeflateJob*>(job);
+  if (deflate_job->entry)
+    deflate_job->archive->DeflateEntry(deflate_job->entry);
+  else
+    deflate_job->archive->DeflateBlock(deflate_job->block);
+  delete deflate_job;
+}
+
+void CompressorArchiveParallelZip::PostDeflateJob(Entry* entry,
+                                                  Block* block) {
+  DeflateJob* job = new DeflateJob;
+  job->archive = this;
+  job->entry = entry;
+  job->block = block;
+  worker_pool_->Post(strands_[next_strand_],
+                     pp::CompletionCallback(&RunDeflateJob, job));
+  next_strand_ = (next_strand_ + 1) % strands_.size();
+}
+
+void CompressorArchiveParallelZip::DeflateEntry(Entry* entry) {
+  Tracer::ScopedEvent trace_event("job", "DeflateEntry");
+  const Bytef* data = reinterpret_cast<const Bytef*>(&entry->data[0]);
+  entry->crc = crc32(crc32(0L, Z_NULL, 0), data, entry->data.size());
+
+  // The entry is stored if it looks incompressible or in case deflate fails.
+  bool stored = compression_level_ == 0;
+  if (!stored && compressibility::IsIncompressible(&entry->data[0],
+                                                   entry->data.size())) {
+    stored = true;
+    RecordStoredEntry(entry->uncompressed_size);
+  }
+  z_stream stream;
+  if (!stored && InitDeflate(&stream, compression_level_)) {
+    std::vector<char> deflated(deflateBound(&stream, entry->data.size()));
+    stream.next_in = const_cast<Bytef*>(data);
+    stream.avail_in = entry->data.size();
+    stream.next_out = reinterpret_cast<Bytef*>(&deflated[0]);
+    stream.avail_out = deflated.size();
+    // Deflated data bigger than the entry is dropped too.
+    if (deflate(&stream, Z_FINISH) == Z_STREAM_END &&
+        stream.total_out < entry->data.size()) {
+      deflated.resize(stream.total_out);
+      entry->data.swap(deflated);
+      entry->method = kMethodDeflated;
+    }
+    deflateEnd(&stream);
+  }
+  entry->compressed_size = entry->data.size();
+
+  pthread_mutex_lock(&lock_);
+  entry->ready = true;
+  pthread_cond_broadcast(&ready_cond_);
+  pthread_mutex_unlock(&lock_);
+}
+
+void CompressorArchiveParallelZip::DeflateBlock(Block* block) {
+  Tracer::ScopedEvent trace_event("job", "DeflateBlock");
+  Bytef* data = reinterpret_cast<Bytef*>(&block->data[0]);
+  block->crc = crc32(crc32(0L, Z_NULL, 0), data, block->data.size());
+
+  // Unlike an entry, a block can't be stored on failure, as it is part of a
+  // deflate stream. It is left empty instead, which fails the archive.
+  std::vector<char> deflated;
+  z_stream stream;
+  if (InitDeflate(&stream, block->level)) {
+    if (block->dictionary.empty() ||
+        deflateSetDictionary(
+            &stream, reinterpret_cast<Bytef*>(&block->dictionary[0]),
+            block->dictionary.size()) == Z_OK) {
+      // The sync flush ends the block on a byte boundary with an empty stored
+      // block, so the next block can be appended to it. The bound leaves room
+      // for that stored block.
+      deflated.resize(deflateBound(&stream, block->data.size()) + 16);
+      stream.next_in = data;
+      stream.avail_in = block->data.size();
+      stream.next_out = reinterpret_cast<Bytef*>(&deflated[0]);
+      stream.avail_out = deflated.size();
+      int result = deflate(&stream, block->last ? Z_FINISH : Z_SYNC_FLUSH);
+      bool finished = block->last ? result == Z_STREAM_END
+                                  : result == Z_OK && stream.avail_in == 0 &&
+                                        stream.avail_out > 0;
+      deflated.resize(finished ? stream.total_out : 0);
+    }
+    deflateEnd(&stream);
+  }
+  block->data.swap(deflated);
+  std::vector<char>().swap(block->dictionary);
+
+  pthread_mutex_lock(&lock_);
+  block->ready = true;
+  pthread_cond_broadcast(&ready_cond_);
+  pthread_mutex_unlock(&lock_);
+}
+
+bool CompressorArchiveParallelZip::ReadEntryData(int64_t length,
+                                                 char* buffer) {
+  int64_t offset = 0;
+  while (offset < length) {
+    int64_t chunk_size =
+        std::min(length - offset,
+                 compressor_archive_constants::kMaximumDataChunkSize);
+    int64_t read_bytes = compressor_stream()->Read(chunk_size, buffer + offset);
+    // Negative read_bytes indicates an error occurred when reading chunks.
+    if (read_bytes <= 0) {
+      failed_ = true;
+      return false;
+    }
+    offset += read_bytes;
+  }
+  return true;
+}
+
+void CompressorArchiveParallelZip::AddBufferedEntry(Entry* entry) {
+  // Make room for the entry before reading it.
+  WriteReadyEntries(kMaximumPendingBytes - entry->uncompressed_size);
+
+  entry->data.resize(entry->uncompressed_size);
+  compressor_stream()->StartEntry(entry->uncompressed_size);
+  if (!ReadEntryData(entry->uncompressed_size, &entry->data[0])) {
+    delete entry;
+    return;
+  }
+
+  pthread_mutex_lock(&lock_);
+  pending_entries_.push_back(entry);
+  pending_bytes_ += entry->uncompressed_size;
+  pthread_mutex_unlock(&lock_);
+
+  PostDeflateJob(entry, NULL);
+  WriteReadyEntries(kMaximumPendingBytes);
+}
+
+void CompressorArchiveParallelZip::AddStreamedEntry(Entry* entry) {
+  if (failed_) {
+    delete entry;
+    return;
+  }
+
+  entry->flags |= kDataDescriptorFlag;
+  entry->method = kMethodDeflated;
+  entry->zip64 = entry->uncompressed_size >= kZip64StreamedEntrySize;
+  entry->local_header_offset = offset_;
+  entry->crc = crc32(0L, Z_NULL, 0);
+
+  // Two blocks per strand keep the strands busy while the blocks are read.
+  const size_t max_pending_blocks = strands_.size() * 2;
+  int level = compression_level_;
+  std::deque<Block*> blocks;
+  std::vector<char> dictionary;  // The end of the last block read.
+  int64_t remaining_size = entry->uncompressed_size;
+  compressor_stream()->StartEntry(entry->uncompressed_size);
+  while (remaining_size > 0 && !failed_) {
+    Block* block = new Block;
+    block->uncompressed_size = std::min(remaining_size, kBlockSize);
+    block->data.resize(block->uncompressed_size);
+    if (!ReadEntryData(block->uncompressed_size, &block->data[0])) {
+      delete block;
+      break;
+    }
+    // The first block decides the deflate level of the entry. An entry that
+    // looks incompressible is deflated at level 0, which only wraps its data
+    // in stored blocks. It can't use the stored method, as zip readers reject
+    // stored entries with a data descriptor.
+    if (remaining_size == entry->uncompressed_size) {
+      if (level != Z_NO_COMPRESSION &&
+          compressibility::IsIncompressible(&block->data[0],
+                                            block->uncompressed_size)) {
+        level = Z_NO_COMPRESSION;
+        RecordStoredEntry(entry->uncompressed_size);
+      }
+      WriteLocalHeader(*entry);
+    }
+    remaining_size -= block->uncompressed_size;
+    block->last = remaining_size == 0;
+    block->level = level;
+
+    block->dictionary.swap(dictionary);
+    dictionary.assign(
+        block->data.end() - std::min(block->data.size(), kDictionarySize),
+        block->data.end());
+
+    blocks.push_back(block);
+    PostDeflateJob(NULL, block);
+    WriteReadyBlocks(&blocks, max_pending_blocks, entry);
+  }
+  // The blocks posted must be deflated before they are deleted, even after a
+  // failure.
+  WriteReadyBlocks(&blocks, 0, entry);
+
+  if (failed_) {
+    delete entry;
+    return;
+  }
+
+  std::vector<char> descriptor;
+  AppendUint32(&descriptor, kDataDescriptorSignature);
+  AppendUint32(&descriptor, entry->crc);
+  if (entry->zip64) {
+    AppendUint64(&descriptor, entry->compressed_size);
+    AppendUint64(&descriptor, entry->uncompressed_size);
+  } else {
+    AppendUint32(&descriptor, static_cast<uint32_t>(entry->compressed_size));
+    AppendUint32(&descriptor, static_cast<uint32_t>(entry->uncompressed_size));
+  }
+  Output(descriptor);
+
+  written_entries_.push_back(entry);
+}
+
+void CompressorArchiveParallelZip::WriteReadyBlocks(
+    std::deque<Block*>* blocks,
+    size_t max_pending_blocks,
+    Entry* entry) {
+  while (!blocks->empty()) {
+    Block* block = blocks->front();
+    pthread_mutex_lock(&lock_);
+    if (!block->ready) {
+      if (blocks->size() <= max_pending_blocks) {
+        pthread_mutex_unlock(&lock_);
+        break;
+      }
+      WorkerPool::BeginBlockingCall();
+      while (!block->ready)
+        pthread_cond_wait(&ready_cond_, &lock_);
+      WorkerPool::EndBlockingCall();
+    }
+    pthread_mutex_unlock(&lock_);
+    blocks->pop_front();
+
+    // A deflated block is never empty, even with no data.
+    if (block->data.empty())
+      failed_ = true;
+    if (!failed_) {
+      entry->crc = crc32_combine(entry->crc, block->crc,
+                                 block->uncompressed_size);
+      entry->compressed_size += block->data.size();
+      Output(block->data);
+    }
+    delete block;
+  }
+}
+
+void CompressorArchiveParallelZip::WriteReadyEntries(
+    int64_t max_pending_bytes) {
+  pthread_mutex_lock(&lock_);
+  while (!pending_entries_.empty()) {
+    Entry* entry = pending_entries_.front();
+    if (!entry->ready) {
+      if (pending_bytes_ <= max_pending_bytes)
+        break;
+      WorkerPool::BeginBlockingCall();
+      while (!entry->ready)
+        pthread_cond_wait(&ready_cond_, &lock_);
+      WorkerPool::EndBlockingCall();
+    }
+    pending_entries_.pop_front();
+    pending_bytes_ -= entry->uncompressed_size;
+
+    // Writing may wait for JavaScript, so the deflate jobs must not wait for
+    // the lock meanwhile.
+    pthread_mutex_unlock(&lock_);
+    WriteEntry(entry);
+    pthread_mutex_lock(&lock_);
+  }
+  pthread_mutex_unlock(&lock_);
+}
+
+void CompressorArchiveParallelZip::WriteEntry(Entry* entry) {
+  if (failed_) {
+    delete entry;
+    return;
+  }
+
+  entry->local_header_offset = offset_;
+  WriteLocalHeader(*entry);
+  Output(entry->data);
+  std::vector<char>().swap(entry->data);
+  written_entries_.push_back(entry);
+}
+
+void CompressorArchiveParallelZip::WriteLocalHeader(const Entry& entry) {
+  // The sizes of streamed entries are in their data descriptor.
+  bool streamed = entry.flags & kDataDescriptorFlag;
+
+  std::vector<char> header;
+  AppendUint32(&header, kLocalFileHeaderSignature);
+  AppendUint16(&header, entry.zip64 ? kVersionZip64 : kVersionDeflate);
+  AppendUint16(&header, entry.flags);
+  AppendUint16(&header, entry.method);
+  AppendUint16(&header, entry.dos_time);
+  AppendUint16(&header, entry.dos_date);
+  AppendUint32(&header, streamed ? 0 : entry.crc);
+  if (entry.zip64) {
+    AppendUint32(&header, 0xffffffff);
+    AppendUint32(&header, 0xffffffff);
+  } else {
+    AppendUint32(&header, streamed ? 0 : entry.compressed_size);
+    AppendUint32(&header, streamed ? 0 : entry.uncompressed_size);
+  }
+  AppendUint16(&header, entry.pathname.size());
+  AppendUint16(&header, entry.zip64 ? 20 : 0);
+  header.insert(header.end(), entry.pathname.begin(), entry.pathname.end());
+  if (entry.zip64) {
+    AppendUint16(&header, kZip64ExtraFieldId);
+    AppendUint16(&header, 16);
+    AppendUint64(&header, streamed ? 0 : entry.uncompressed_size);
+    AppendUint64(&header, streamed ? 0 : entry.compressed_size);
+  }
+  Output(header);
+}
+
+void CompressorArchiveParallelZip::WriteCentralDirectory() {
+  const int64_t central_directory_offset = offset_;
+  Output(existing_central_directory_);
+  for (size_t i = 0; i < written_entries_.size(); ++i) {
+    const Entry& entry = *written_entries_[i];
+    bool zip64_sizes = entry.zip64 ||
+                       entry.uncompressed_size >= kZip64Limit ||
+                       entry.compressed_size >= kZip64Limit;
+    bool zip64_offset = entry.local_header_offset >= kZip64Limit;
+
+    // The zip64 extra field holds only the values that don't fit.
+    std::vector<char> extra;
+    if (zip64_sizes || zip64_offset) {
+      AppendUint16(&extra, kZip64ExtraFieldId);
+      AppendUint16(&extra, (zip64_sizes ? 16 : 0) + (zip64_offset ? 8 : 0));
+      if (zip64_sizes) {
+        AppendUint64(&extra, entry.uncompressed_size);
+        AppendUint64(&extra, entry.compressed_size);
+      }
+      if (zip64_offset)
+        AppendUint64(&extra, entry.local_header_offset);
+    }
+
+    uint16_t version = extra.empty() ? kVersionDeflate : kVersionZip64;
+    uint32_t mode =
+        entry.is_directory
+            ? S_IFDIR | compressor_archive_constants::kDirectoryPermission
+            : S_IFREG | compressor_archive_constants::kFilePermission;
+
+    std::vector<char> header;
+    AppendUint32(&header, kCentralDirectoryHeaderSignature);
+    AppendUint16(&header, kHostUnix | version);
+    AppendUint16(&header, version);
+    AppendUint16(&header, entry.flags);
+    AppendUint16(&header, entry.method);
+    AppendUint16(&header, entry.dos_time);
+    AppendUint16(&header, entry.dos_date);
+    AppendUint32(&header, entry.crc);
+    AppendUint32(&header, zip64_sizes ? 0xffffffff : entry.compressed_size);
+    AppendUint32(&header, zip64_sizes ? 0xffffffff : entry.uncompressed_size);
+    AppendUint16(&header, entry.pathname.size());
+    AppendUint16(&header, extra.size());
+    AppendUint16(&header, 0);  // The comment length.
+    AppendUint16(&header, 0);  // The disk number.
+    AppendUint16(&header, 0);  // The internal attributes.
+    const uint32_t dos_attributes =
+        entry.is_directory ? kDosDirectoryAttribute : 0;
+    AppendUint32(&header, (mode << 16) | dos_attributes);
+    AppendUint32OrZip64(&header, entry.local_header_offset);
+    header.insert(header.end(), entry.pathname.begin(), entry.pathname.end());
+    header.insert(header.end(), extra.begin(), extra.end());
+    Output(header);
+  }
+
+  const int64_t central_directory_size = offset_ - central_directory_offset;
+  const int64_t entry_count =
+      existing_entry_count_ + static_cast<int64_t>(written_entries_.size());
+
+  std::vector<char> end;
+  if (entry_count >= 0xffff || central_directory_offset >= kZip64Limit ||
+      central_directory_size >= kZip64Limit) {
+    const int64_t zip64_end_offset = offset_;
+    AppendUint32(&end, kZip64EndOfCentralDirectorySignature);
+    AppendUint64(&end, 44);  // The size of the rest of the record.
+    AppendUint16(&end, kHostUnix | kVersionZip64);
+    AppendUint16(&end, kVersionZip64);
+    AppendUint32(&end, 0);  // The number of this disk.
+    AppendUint32(&end, 0);  // The disk of the central directory.
+    AppendUint64(&end, entry_count);
+    AppendUint64(&end, entry_count);
+    AppendUint64(&end, central_directory_size);
+    AppendUint64(&end, central_directory_offset);
+
+    AppendUint32(&end, kZip64EndOfCentralDirectoryLocatorSignature);
+    AppendUint32(&end, 0);  // The disk of the zip64 end record.
+    AppendUint64(&end, zip64_end_offset);
+    AppendUint32(&end, 1);  // The number of disks.
+  }
+
+  AppendUint32(&end, kEndOfCentralDirectorySignature);
+  AppendUint16(&end, 0);  // The number of this disk.
+  AppendUint16(&end, 0);  // The disk of the central directory.
+  AppendUint16(&end, std::min<int64_t>(entry_count, 0xffff));
+  AppendUint16(&end, std::min<int64_t>(entry_count, 0xffff));
+  AppendUint32OrZip64(&end, central_directory_size);
+  AppendUint32OrZip64(&end, central_directory_offset);
+  AppendUint16(&end, 0);  // The comment length.
+  Output(end);
+}
+
+bool CompressorArchiveParallelZip::ReadArchive(int64_t offset,
+                                               int64_t length,
+                                               char* buffer) {
+  while (length > 0) {
+    int64_t read_bytes = compressor_stream()->ReadArchive(
+        offset,
+        std::min(length, compressor_archive_constants::kMaximumDataChunkSize),
+        buffer);
+    if (read_bytes <= 0)
+      return false;
+    offset += read_bytes;
+    buffer += read_bytes;
+    length -= read_bytes;
+  }
+  return true;
+}
+
+void CompressorArchiveParallelZip::Output(const char* data, int64_t length) {
+  offset_ += length;
+  while (length > 0) {
+    // The data is copied once, straight into the buffer sent to JavaScript.
+    if (!output_data_) {
+      output_buffer_ = compressor_stream()->AcquireWriteBuffer(
+          compressor_archive_constants::kMaximumDataChunkSize);
+      output_data_ = static_cast<char*>(output_buffer_.Map());
+    }
+    int64_t size = std::min(
+        length,
+        compressor_archive_constants::kMaximumDataChunkSize - output_size_);
+    memcpy(output_data_ + output_size_, data, size);
+    output_size_ += size;
+    data += size;
+    length -= size;
+    if (output_size_ == compressor_archive_constants::kMaximumDataChunkSize)
+      FlushOutput();
+  }
+}
+
+void CompressorArchiveParallelZip::Output(const std::vector<char>& data) {
+  if (!data.empty())
+    Output(&data[0], data.size());
+}
+
+void CompressorArchiveParallelZip::FlushOutput() {
+  if (!output_data_)
+    return;
+
+  output_buffer_.Unmap();
+  output_data_ = NULL;
+  // Negative written bytes represent an error. A chunk flushed before it is
+  // full, like the last one of the archive, is sent in a bigger buffer.
+  if (!failed_ && compressor_stream()->Write(output_size_, output_buffer_) < 0)
+    failed_ = true;
+  output_size_ = 0;
+}
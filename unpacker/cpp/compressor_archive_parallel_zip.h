@@ -0,0 +1,236 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef COMPRESSOR_ARCHIVE_PARALLEL_ZIP_H_
+#define COMPRESSOR_ARCHIVE_PARALLEL_ZIP_H_
+
+#include <deque>
+#include <pthread.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "compressor_archive.h"
+#include "compressor_stream.h"
+#include "worker_pool.h"
+
+// A CompressorArchive that writes zip archives itself instead of through
+// libarchive, so the entries are deflated in parallel on a WorkerPool.
+//
+// Entries up to kMaximumBufferedEntrySize are read into memory and deflated
+// by jobs of their own, while the next entries are read. Bigger entries are
+// written once the entries added before them are, split into blocks of
+// kBlockSize deflated in parallel like pigz does. Every block is deflated with
+// the end of the previous block as dictionary, and all but the last one end
+// with a sync flush, so the blocks form a single deflate stream. The entries
+// are written in the order they were added, followed by the central
+// directory, so the result is a standard zip archive. Zip64 records are used
+// only when needed.
+//
+// Entries that look incompressible from their beginning are stored
+// instead of deflated, as counted by the stats. The big entries are deflated
+// at level 0 instead, as they have a data descriptor.
+//
+// OpenArchive appends entries to an existing zip archive instead. The new
+// entries overwrite its central directory, which is kept and written again
+// before the central directory of the new entries.
+//
+// Like CompressorArchiveLibarchive, AddToArchive and CloseArchive must be
+// called from the same worker thread, except for CloseArchive with has_error.
+class CompressorArchiveParallelZip : public CompressorArchive {
+ public:
+  // Entries up to this size are deflated in parallel.
+  static const int64_t kMaximumBufferedEntrySize = 4 * 1024 * 1024;
+
+  // AddToArchive waits for the entries being deflated once they take more
+  // memory than this.
+  static const int64_t kMaximumPendingBytes = 64 * 1024 * 1024;
+
+  // The size of the blocks of the bigger entries deflated in parallel.
+  static const int64_t kBlockSize = 1024 * 1024;
+
+  // job_count is the number of entries deflated at the same time.
+  // compression_level is the deflate level, or -1 for the default level of
+  // zlib. 0 stores all the entries, but the big ones are deflated at level 0.
+  // CompressorArchiveParallelZip does not own the worker_pool pointer.
+  CompressorArchiveParallelZip(CompressorStream* compressor_stream,
+                               WorkerPool* worker_pool,
+                               int job_count,
+                               int compression_level);
+
+  virtual ~CompressorArchiveParallelZip();
+
+  // See compressor_archive.h for description.
+  virtual bool CreateArchive();
+
+  // See compressor_archive.h for description. Reads the end records and the
+  // central directory of the archive. Fails for archives split on several
+  // disks or with data after the central directory other than its end
+  // records. The comment of the archive is dropped.
+  virtual bool OpenArchive(int64_t archive_size);
+
+  // See compressor_archive.h for description. Writes the entries that are
+  // still being deflated and the central directory. In case of has_error, it
+  // only drops the archive, so it can be called from the main thread.
+  virtual void CloseArchive(bool has_error);
+
+  // See compressor_archive.h for description. Returns once the entry is read,
+  // before it is deflated and written, unless it is a big one.
+  virtual void AddToArchive(const std::string& filename,
+                            int64_t file_size,
+                            time_t modification_time,
+                            bool is_directory);
+
+ private:
+  // An entry added to the archive.
+  struct Entry {
+    Entry();
+
+    std::string pathname;
+    uint16_t dos_time;
+    uint16_t dos_date;
+    bool is_directory;
+    uint16_t flags;   // The general purpose bit flag.
+    uint16_t method;  // Stored or deflated.
+    bool zip64;       // True if the sizes need zip64 records.
+    uint32_t crc;
+    int64_t uncompressed_size;
+    int64_t compressed_size;
+    int64_t local_header_offset;
+
+    // The data of a buffered entry, replaced by the deflated data by
+    // DeflateEntry. Released once written.
+    std::vector<char> data;
+
+    // True once the entry can be written. Guarded by lock_.
+    bool ready;
+  };
+
+  // A block of a streamed entry.
+  struct Block {
+    Block();
+
+    // The end of the previous block, used as dictionary.
+    std::vector<char> dictionary;
+
+    // The data of the block, replaced by the deflated data by DeflateBlock.
+    std::vector<char> data;
+
+    int64_t uncompressed_size;
+    uint32_t crc;  // The CRC-32 of the uncompressed data.
+    bool last;     // True for the last block of the entry.
+    int level;     // The deflate level of the entry.
+
+    // True once the block can be written. Guarded by lock_.
+    bool ready;
+  };
+
+  // A job deflating an entry or a block of an entry.
+  struct DeflateJob {
+    CompressorArchiveParallelZip* archive;
+    Entry* entry;  // NULL for a block.
+    Block* block;  // NULL for an entry.
+  };
+
+  // Runs a DeflateJob on the worker pool.
+  static void RunDeflateJob(void* job, int32_t /*result*/);
+
+  // Posts a DeflateJob for entry or block to the next strand.
+  void PostDeflateJob(Entry* entry, Block* block);
+
+  // Deflates the data of a buffered entry and marks it as ready.
+  void DeflateEntry(Entry* entry);
+
+  // Deflates the data of a block and marks it as ready.
+  void DeflateBlock(Block* block);
+
+  // Reads the next length bytes of the current entry to buffer. Returns false
+  // and sets failed_ if reading failed.
+  bool ReadEntryData(int64_t length, char* buffer);
+
+  // Reads a buffered entry and posts a job to deflate it.
+  void AddBufferedEntry(Entry* entry);
+
+  // Writes an entry while reading and deflating its blocks, with a data
+  // descriptor after its data. The entries added before must have been
+  // written.
+  void AddStreamedEntry(Entry* entry);
+
+  // Writes the blocks at the front of blocks that are ready, and updates the
+  // CRC-32 and compressed size of entry. Waits for the blocks that are not,
+  // until at most max_pending_blocks blocks are left.
+  void WriteReadyBlocks(std::deque<Block*>* blocks,
+                        size_t max_pending_blocks,
+                        Entry* entry);
+
+  // Writes the entries at the front of pending_entries_ that are ready. Waits
+  // for the entries that are not, until at most max_pending_bytes of entries
+  // are left. 0 writes all the pending entries.
+  void WriteReadyEntries(int64_t max_pending_bytes);
+
+  // Writes the local header and the data of a ready entry.
+  void WriteEntry(Entry* entry);
+
+  void WriteLocalHeader(const Entry& entry);
+  void WriteCentralDirectory();
+
+  // Reads length bytes of the archive opened by OpenArchive at offset to
+  // buffer. Returns false if reading failed or reached the end of the archive.
+  bool ReadArchive(int64_t offset, int64_t length, char* buffer);
+
+  // Appends data to the archive. The data is sent to JavaScript in chunks of
+  // compressor_archive_constants::kMaximumDataChunkSize.
+  void Output(const char* data, int64_t length);
+  void Output(const std::vector<char>& data);
+
+  // Sends the data appended by Output and not sent yet.
+  void FlushOutput();
+
+  WorkerPool* worker_pool_;
+
+  // The deflate level, Z_DEFAULT_COMPRESSION, or 0 if all the entries are
+  // stored.
+  const int compression_level_;
+
+  // The strands of worker_pool_ deflating the entries, used in turns.
+  std::vector<WorkerPool::Strand*> strands_;
+  size_t next_strand_;
+
+  // Guards pending_entries_, pending_bytes_, Entry::ready and Block::ready.
+  pthread_mutex_t lock_;
+
+  // Signaled when an entry or a block is ready.
+  pthread_cond_t ready_cond_;
+
+  // The entries added but not written yet, in the order they were added.
+  std::deque<Entry*> pending_entries_;
+
+  // The size of the data of pending_entries_.
+  int64_t pending_bytes_;
+
+  // The entries written to the archive, for the central directory.
+  std::vector<Entry*> written_entries_;
+
+  // The central directory of the archive opened by OpenArchive, written
+  // before the records of written_entries_, and the number of its records.
+  std::vector<char> existing_central_directory_;
+  int64_t existing_entry_count_;
+
+  // The buffer the data appended to the archive is written into until it is
+  // sent to JavaScript, acquired from the stream. output_data_ is its mapped
+  // data, or NULL if no buffer is acquired, and output_size_ the number of
+  // bytes in it.
+  pp::VarArrayBuffer output_buffer_;
+  char* output_data_;
+  int64_t output_size_;
+
+  // The size of the archive, including the data in output_buffer_.
+  int64_t offset_;
+
+  // True once reading an entry or writing the archive failed. Nothing more
+  // is written then.
+  bool failed_;
+};
+
+#endif  // COMPRESSOR_ARCHIVE_PARALLEL_ZIP_H_
@@ -4,81 +4,343 @@
 
 #include "compressor_io_javascript_stream.h"
 
+#include <algorithm>
+#include <cstring>
 #include <limits>
-#include <thread>
 
 #include "archive.h"
 #include "ppapi/cpp/logging.h"
 
+#include "compressor_archive_libarchive.h"
+#include "tracer.h"
+#include "worker_pool.h"
+
+const int CompressorIOJavaScriptStream::kDefaultReadAheadDepth;
+const int CompressorIOJavaScriptStream::kMaximumReadAheadDepth;
+const int CompressorIOJavaScriptStream::kDefaultWriteBehindDepth;
+const int CompressorIOJavaScriptStream::kMaximumWriteBehindDepth;
+
+namespace {
+
+// The maximum size of the buffers kept for AcquireWriteBuffer. Every buffer
+// is reused as soon as it is sent, so the pool rarely needs more than one.
+const int64_t kMaxPooledWriteBufferBytes =
+    2 * compressor_archive_constants::kMaximumDataChunkSize;
+
+}  // namespace
+
 CompressorIOJavaScriptStream::CompressorIOJavaScriptStream(
     JavaScriptCompressorRequestorInterface* requestor)
-    : requestor_(requestor) {
+    : requestor_(requestor),
+      pending_writes_(0),
+      write_error_(false),
+      write_behind_depth_(kDefaultWriteBehindDepth),
+      write_offset_(-1),
+      write_buffer_pool_(kMaxPooledWriteBufferBytes),
+      entry_size_(0),
+      read_offset_(0),
+      request_offset_(0),
+      read_ahead_depth_(kDefaultReadAheadDepth),
+      next_entry_data_offset_(-1),
+      entry_data_offset_(-1),
+      read_buffer_mapped_(false),
+      stats_(NULL) {
   pthread_mutex_init(&shared_state_lock_, NULL);
   pthread_cond_init(&available_data_cond_, NULL);
   pthread_cond_init(&data_written_cond_, NULL);
-
-  pthread_mutex_lock(&shared_state_lock_);
-  available_data_ = false;
-  pthread_mutex_unlock(&shared_state_lock_);
 }
 
 CompressorIOJavaScriptStream::~CompressorIOJavaScriptStream() {
+  UnmapReadBuffer();
   pthread_cond_destroy(&data_written_cond_);
   pthread_cond_destroy(&available_data_cond_);
   pthread_mutex_destroy(&shared_state_lock_);
 };
 
-int64_t CompressorIOJavaScriptStream::Write(int64_t byte_to_write,
+int64_t CompressorIOJavaScriptStream::Write(int64_t bytes_to_write,
     const pp::VarArrayBuffer& buffer) {
   pthread_mutex_lock(&shared_state_lock_);
-  requestor_->WriteChunkRequest(byte_to_write, buffer);
+  // Report the failure of a chunk written behind.
+  if (write_error_) {
+    pthread_mutex_unlock(&shared_state_lock_);
+    return -1;
+  }
+
+  ++pending_writes_;
+  requestor_->WriteChunkRequest(bytes_to_write, buffer, write_offset_);
+  write_offset_ = -1;
+  // The message holds a copy of the data, so the buffer can be reused.
+  write_buffer_pool_.Release(buffer);
 
-  pthread_cond_wait(&data_written_cond_, &shared_state_lock_);
+  // Wait only if too many chunks are left to be written, so JavaScript writes
+  // them while the next chunks are compressed.
+  if (pending_writes_ > write_behind_depth_) {
+    Stats::ScopedTimer timer(stats_, Stats::WRITE_CHUNK_WAIT_US);
+    WorkerPool::BeginBlockingCall();
+    while (pending_writes_ > write_behind_depth_ && !write_error_) {
+      pthread_cond_wait(&data_written_cond_, &shared_state_lock_);
+    }
+    WorkerPool::EndBlockingCall();
+  }
 
-  int64_t written_bytes = written_bytes_;
+  int64_t written_bytes = write_error_ ? -1 : bytes_to_write;
   pthread_mutex_unlock(&shared_state_lock_);
 
   return written_bytes;
 }
 
+pp::VarArrayBuffer CompressorIOJavaScriptStream::AcquireWriteBuffer(
+    uint32_t size) {
+  pthread_mutex_lock(&shared_state_lock_);
+  pp::VarArrayBuffer buffer = write_buffer_pool_.Acquire(size);
+  pthread_mutex_unlock(&shared_state_lock_);
+  return buffer;
+}
+
 void CompressorIOJavaScriptStream::WriteChunkDone(int64_t written_bytes) {
   pthread_mutex_lock(&shared_state_lock_);
-  written_bytes_ = written_bytes;
+  PP_DCHECK(pending_writes_ > 0);
+  --pending_writes_;
+  // A negative value means an error occurred when writing a chunk in
+  // JavaScript.
+  if (written_bytes < 0)
+    write_error_ = true;
   pthread_cond_signal(&data_written_cond_);
   pthread_mutex_unlock(&shared_state_lock_);
 }
 
+void CompressorIOJavaScriptStream::SetWriteOffset(int64_t offset) {
+  PP_DCHECK(offset >= 0);
+
+  pthread_mutex_lock(&shared_state_lock_);
+  write_offset_ = offset;
+  pthread_mutex_unlock(&shared_state_lock_);
+}
+
+int64_t CompressorIOJavaScriptStream::Flush() {
+  pthread_mutex_lock(&shared_state_lock_);
+  // JavaScript may not respond to the remaining chunks after an error, so
+  // don't wait for them.
+  if (pending_writes_ > 0 && !write_error_) {
+    Stats::ScopedTimer timer(stats_, Stats::WRITE_CHUNK_WAIT_US);
+    WorkerPool::BeginBlockingCall();
+    while (pending_writes_ > 0 && !write_error_) {
+      pthread_cond_wait(&data_written_cond_, &shared_state_lock_);
+    }
+    WorkerPool::EndBlockingCall();
+  }
+
+  int64_t result = write_error_ ? -1 : 0;
+  pthread_mutex_unlock(&shared_state_lock_);
+  return result;
+}
+
+void CompressorIOJavaScriptStream::StartEntry(int64_t entry_size) {
+  PP_DCHECK(entry_size >= 0);
+
+  pthread_mutex_lock(&shared_state_lock_);
+  UnmapReadBuffer();
+  // Drop the chunks read ahead for the previous entry, in case it failed
+  // before reading all of them.
+  chunks_.clear();
+  entry_size_ = entry_size;
+  read_offset_ = 0;
+  request_offset_ = 0;
+  // The buffer is kept until the next entry, as other entries of the batch
+  // are likely in it too.
+  entry_data_ = next_entry_data_;
+  entry_data_offset_ = next_entry_data_offset_;
+  next_entry_data_offset_ = -1;
+  pthread_mutex_unlock(&shared_state_lock_);
+}
+
+void CompressorIOJavaScriptStream::RewindEntry() {
+  pthread_mutex_lock(&shared_state_lock_);
+  UnmapReadBuffer();
+  // The data sent with the entry is kept, while its chunks are requested
+  // again.
+  chunks_.clear();
+  read_offset_ = 0;
+  request_offset_ = 0;
+  pthread_mutex_unlock(&shared_state_lock_);
+}
+
+void CompressorIOJavaScriptStream::SetNextEntryData(
+    const pp::VarArrayBuffer& buffer,
+    int64_t offset) {
+  PP_DCHECK(offset >= 0);
+
+  pthread_mutex_lock(&shared_state_lock_);
+  next_entry_data_ = buffer;
+  next_entry_data_offset_ = offset;
+  pthread_mutex_unlock(&shared_state_lock_);
+}
+
 int64_t CompressorIOJavaScriptStream::Read(int64_t bytes_to_read,
                                            char* destination_buffer) {
+  const char* data = NULL;
+  int64_t read_bytes = ReadInPlace(bytes_to_read, &data);
+  if (read_bytes > 0)
+    memcpy(destination_buffer, data, read_bytes);
+  return read_bytes;
+}
+
+int64_t CompressorIOJavaScriptStream::ReadInPlace(int64_t bytes_to_read,
+                                                  const char** data) {
+  PP_DCHECK(bytes_to_read > 0);
+
   pthread_mutex_lock(&shared_state_lock_);
+  UnmapReadBuffer();
+
+  // The data of the entry was sent by JavaScript with the entry.
+  if (entry_data_offset_ >= 0) {
+    int64_t read_bytes = std::min(bytes_to_read, entry_size_ - read_offset_);
+    PP_DCHECK(entry_data_offset_ + entry_size_ <= entry_data_.ByteLength());
+    read_buffer_ = entry_data_;
+    read_buffer_mapped_ = true;
+    *data = static_cast<const char*>(read_buffer_.Map()) + entry_data_offset_ +
+            read_offset_;
+    read_offset_ += read_bytes;
+    pthread_mutex_unlock(&shared_state_lock_);
+    return read_bytes;
+  }
+
+  // Request the chunk unless it was read ahead, e.g. for the first Read of the
+  // entry.
+  if (chunks_.find(read_offset_) == chunks_.end())
+    RequestChunk(read_offset_, bytes_to_read);
+
+  // Keep read_ahead_depth_ chunks after this one in flight, so JavaScript
+  // reads them while this one is compressed. Every Read except the last one
+  // of the entry is for the same number of bytes, so the chunks read ahead
+  // match the next calls.
+  while (static_cast<int>(chunks_.size()) <= read_ahead_depth_ &&
+         request_offset_ < entry_size_) {
+    RequestChunk(request_offset_,
+                 std::min(bytes_to_read, entry_size_ - request_offset_));
+  }
 
-  destination_buffer_ = destination_buffer;
-  requestor_->ReadFileChunkRequest(bytes_to_read);
+  // Pointers to the elements of a std::map stay valid while other elements
+  // are inserted or erased.
+  const int64_t offset = read_offset_;
+  Chunk* chunk = &chunks_[offset];
+  if (!chunk->available) {
+    // Wait for data from JavaScript. Other jobs can run in the meantime.
+    Stats::ScopedTimer timer(stats_, Stats::READ_CHUNK_WAIT_US);
+    WorkerPool::BeginBlockingCall();
+    while (!chunk->available) {
+      pthread_cond_wait(&available_data_cond_, &shared_state_lock_);
+    }
+    WorkerPool::EndBlockingCall();
+  }
 
-  while (!available_data_) {
-    pthread_cond_wait(&available_data_cond_, &shared_state_lock_);
+  int64_t read_bytes = chunk->read_bytes;
+  if (read_bytes > 0) {
+    PP_DCHECK(read_bytes <= bytes_to_read);
+    read_bytes = std::min(read_bytes, bytes_to_read);
+    // The buffer outlives the chunk, so the data is not copied.
+    read_buffer_ = chunk->buffer;
+    read_buffer_mapped_ = true;
+    *data = static_cast<const char*>(read_buffer_.Map());
+    read_offset_ += read_bytes;
   }
+  chunks_.erase(offset);
 
-  int64_t read_bytes = read_bytes_;
-  available_data_ = false;
   pthread_mutex_unlock(&shared_state_lock_);
   return read_bytes;
 }
 
-void CompressorIOJavaScriptStream::ReadFileChunkDone(int64_t read_bytes,
-      pp::VarArrayBuffer* array_buffer) {
+void CompressorIOJavaScriptStream::ReadFileChunkDone(
+    int64_t offset,
+    int64_t read_bytes,
+    const pp::VarArrayBuffer& array_buffer) {
+  Tracer::EndAsync("io", "ReadFileChunk", Tracer::AsyncId(this, offset));
+
+  pthread_mutex_lock(&shared_state_lock_);
+  std::map<int64_t, Chunk>::iterator it = chunks_.find(offset);
+  if (it != chunks_.end() && !it->second.available) {
+    // JavaScript sets a negative value in read_bytes if an error occurred
+    // while reading a chunk. The buffer is kept without copying, and read in
+    // place on the worker thread.
+    it->second.available = true;
+    it->second.read_bytes = read_bytes;
+    it->second.buffer = array_buffer;
+    pthread_cond_signal(&available_data_cond_);
+  }
+  pthread_mutex_unlock(&shared_state_lock_);
+}
+
+int64_t CompressorIOJavaScriptStream::ReadArchive(int64_t offset,
+                                                  int64_t length,
+                                                  char* destination_buffer) {
+  PP_DCHECK(length > 0);
+
   pthread_mutex_lock(&shared_state_lock_);
+  archive_chunk_ = Chunk();
+  requestor_->ReadArchiveChunkRequest(offset, length);
+
+  {
+    Stats::ScopedTimer timer(stats_, Stats::READ_CHUNK_WAIT_US);
+    WorkerPool::BeginBlockingCall();
+    while (!archive_chunk_.available) {
+      pthread_cond_wait(&available_data_cond_, &shared_state_lock_);
+    }
+    WorkerPool::EndBlockingCall();
+  }
 
-  // JavaScript sets a negative value in read_bytes if an error occurred while
-  // reading a chunk.
-  if (read_bytes >= 0) {
-    char* array_buffer_data = static_cast<char*>(array_buffer->Map());
-    memcpy(destination_buffer_, array_buffer_data, read_bytes);
-    array_buffer->Unmap();
+  int64_t read_bytes = std::min(archive_chunk_.read_bytes, length);
+  if (read_bytes > 0) {
+    memcpy(destination_buffer, archive_chunk_.buffer.Map(), read_bytes);
+    archive_chunk_.buffer.Unmap();
   }
+  archive_chunk_ = Chunk();
 
-  read_bytes_ = read_bytes;
-  available_data_ = true;
-  pthread_cond_signal(&available_data_cond_);
   pthread_mutex_unlock(&shared_state_lock_);
+  return read_bytes;
+}
+
+void CompressorIOJavaScriptStream::ReadArchiveChunkDone(
+    int64_t read_bytes,
+    const pp::VarArrayBuffer& buffer) {
+  pthread_mutex_lock(&shared_state_lock_);
+  archive_chunk_.available = true;
+  archive_chunk_.read_bytes = read_bytes;
+  archive_chunk_.buffer = buffer;
+  // Read() may wait for a file chunk on the same condition.
+  pthread_cond_broadcast(&available_data_cond_);
+  pthread_mutex_unlock(&shared_state_lock_);
+}
+
+void CompressorIOJavaScriptStream::set_read_ahead_depth(int read_ahead_depth) {
+  pthread_mutex_lock(&shared_state_lock_);
+  read_ahead_depth_ =
+      std::max(0, std::min(read_ahead_depth, kMaximumReadAheadDepth));
+  pthread_mutex_unlock(&shared_state_lock_);
+}
+
+void CompressorIOJavaScriptStream::set_write_behind_depth(
+    int write_behind_depth) {
+  pthread_mutex_lock(&shared_state_lock_);
+  write_behind_depth_ =
+      std::max(0, std::min(write_behind_depth, kMaximumWriteBehindDepth));
+  pthread_mutex_unlock(&shared_state_lock_);
+}
+
+void CompressorIOJavaScriptStream::UnmapReadBuffer() {
+  if (!read_buffer_mapped_)
+    return;
+  read_buffer_.Unmap();
+  read_buffer_mapped_ = false;
+}
+
+void CompressorIOJavaScriptStream::RequestChunk(int64_t offset,
+                                                int64_t length) {
+  chunks_[offset] = Chunk();
+  request_offset_ = offset + length;
+
+  if (stats_)
+    stats_->Add(Stats::READ_CHUNK_REQUESTS, 1);
+  Tracer::BeginAsync("io", "ReadFileChunk", Tracer::AsyncId(this, offset),
+                     "length", length);
+  requestor_->ReadFileChunkRequest(offset, length);
 }
@@ -5,6 +5,7 @@
 #ifndef COMPRESSOR_IO_JAVSCRIPT_STREAM_H_
 #define COMPRESSOR_IO_JAVSCRIPT_STREAM_H_
 
+#include <map>
 #include <pthread.h>
 #include <string>
 
@@ -15,27 +16,102 @@
 #include "ppapi/utility/threading/lock.h"
 #include "ppapi/utility/threading/simple_thread.h"
 
+#include "array_buffer_pool.h"
 #include "compressor_stream.h"
 #include "javascript_compressor_requestor_interface.h"
+#include "stats.h"
 
+// A CompressorStream that reads the entries and writes the archive through
+// JavaScript. While a chunk of an entry is compressed, the next chunks are
+// already requested from JavaScript, and the previous compressed chunks are
+// still being written, so the IO of JavaScript overlaps with compressing.
 class CompressorIOJavaScriptStream : public CompressorStream {
  public:
+  // The default and the maximum number of chunks requested ahead of the chunk
+  // being read. 0 disables reading ahead.
+  static const int kDefaultReadAheadDepth = 2;
+  static const int kMaximumReadAheadDepth = 16;
+
+  // The default and the maximum number of chunks Write leaves to be written
+  // by JavaScript. 0 makes Write wait for every chunk.
+  static const int kDefaultWriteBehindDepth = 4;
+  static const int kMaximumWriteBehindDepth = 16;
+
   CompressorIOJavaScriptStream(
       JavaScriptCompressorRequestorInterface* requestor);
 
   virtual ~CompressorIOJavaScriptStream();
 
-  virtual int64_t Write(int64_t bytes_to_read,
+  virtual int64_t Write(int64_t bytes_to_write,
                         const pp::VarArrayBuffer& buffer);
 
+  virtual pp::VarArrayBuffer AcquireWriteBuffer(uint32_t size);
+
   virtual void WriteChunkDone(int64_t write_bytes);
 
+  virtual void SetWriteOffset(int64_t offset);
+
+  virtual int64_t Flush();
+
+  virtual void StartEntry(int64_t entry_size);
+
+  virtual void RewindEntry();
+
+  virtual void SetNextEntryData(const pp::VarArrayBuffer& buffer,
+                                int64_t offset);
+
   virtual int64_t Read(int64_t bytes_to_read, char* destination_buffer);
 
-  virtual void ReadFileChunkDone(int64_t read_bytes,
-                                 pp::VarArrayBuffer* buffer);
+  virtual int64_t ReadInPlace(int64_t bytes_to_read, const char** data);
+
+  virtual void ReadFileChunkDone(int64_t offset,
+                                 int64_t read_bytes,
+                                 const pp::VarArrayBuffer& buffer);
+
+  virtual int64_t ReadArchive(int64_t offset,
+                              int64_t length,
+                              char* destination_buffer);
+
+  virtual void ReadArchiveChunkDone(int64_t read_bytes,
+                                    const pp::VarArrayBuffer& buffer);
+
+  // Sets the number of chunks requested ahead, clamped to
+  // [0, kMaximumReadAheadDepth]. Every chunk takes up to
+  // compressor_archive_constants::kMaximumDataChunkSize bytes of memory.
+  void set_read_ahead_depth(int read_ahead_depth);
+
+  // Sets the number of chunks left to be written, clamped to
+  // [0, kMaximumWriteBehindDepth]. The chunks are kept by JavaScript until
+  // written.
+  void set_write_behind_depth(int write_behind_depth);
+
+  // Sets the stats updated with the chunks requested from JavaScript. NULL
+  // by default, so nothing is counted. CompressorIOJavaScriptStream does not
+  // own the stats pointer.
+  void set_stats(Stats* stats) { stats_ = stats; }
 
 private:
+  // A chunk of the current entry requested from JavaScript.
+  struct Chunk {
+    Chunk() : available(false), read_bytes(0) {}
+
+    bool available;  // True once ReadFileChunkDone() received the chunk.
+
+    // The bytelength of the data read from the entry. If this value is
+    // negative, some error occurred when reading the chunk in JavaScript.
+    int64_t read_bytes;
+
+    pp::VarArrayBuffer buffer;
+  };
+
+  // Requests length bytes at offset of the current entry from JavaScript.
+  // Should be run within shared_state_lock_.
+  void RequestChunk(int64_t offset, int64_t length);
+
+  // Unmaps the buffer of the data returned by the last ReadInPlace. Should be
+  // run within shared_state_lock_.
+  void UnmapReadBuffer();
+
   // A requestor that makes calls to JavaScript to read and write chunks.
   JavaScriptCompressorRequestorInterface* requestor_;
 
@@ -43,21 +119,53 @@ private:
   pthread_cond_t available_data_cond_;
   pthread_cond_t data_written_cond_;
 
-  // The bytelength of the data written onto the archive for the last write
-  // chunk request. If this value is negative, some error occurred when writing
-  // a chunk in JavaScript.
-  int64_t written_bytes_;
+  // The number of write chunk requests JavaScript did not respond to yet.
+  int pending_writes_;
+
+  // True once JavaScript failed to write a chunk. Reported by the next Write
+  // or by Flush.
+  bool write_error_;
+
+  int write_behind_depth_;  // See set_write_behind_depth.
+
+  // The offset of the archive the next Write writes at, or -1 to write after
+  // the last chunk. See SetWriteOffset.
+  int64_t write_offset_;
+
+  // The buffers sent by Write, for AcquireWriteBuffer. PostMessage copies the
+  // data of the buffers, so they are reused as soon as they are sent.
+  ArrayBufferPool write_buffer_pool_;
+
+  // The chunks of the current entry requested from JavaScript and not read
+  // yet, by offset. Chunks received for other offsets, e.g. read ahead for an
+  // entry that failed, are dropped.
+  std::map<int64_t, Chunk> chunks_;
+
+  int64_t entry_size_;      // The size of the current entry.
+  int64_t read_offset_;     // The offset of the chunk returned by next Read.
+  int64_t request_offset_;  // The offset of the next chunk to request.
+
+  int read_ahead_depth_;  // See set_read_ahead_depth.
+
+  // The buffers holding the data of the next entry and of the current one,
+  // set by SetNextEntryData. The offsets of the data in them are negative if
+  // the chunks of the entry are requested from JavaScript instead.
+  pp::VarArrayBuffer next_entry_data_;
+  int64_t next_entry_data_offset_;
+  pp::VarArrayBuffer entry_data_;
+  int64_t entry_data_offset_;
 
-  // The bytelength of the data read from the entry for the last read file chunk
-  // request. If this value is negative, some error occurred when reading a
-  // chunk in JavaScript.
-  int64_t read_bytes_;
+  // The buffer holding the data returned by the last ReadInPlace, mapped
+  // until the next read.
+  pp::VarArrayBuffer read_buffer_;
+  bool read_buffer_mapped_;
 
-  // True if destination_buffer_ is available.
-  bool available_data_;
+  // The chunk of the archive requested by ReadArchive, available once
+  // ReadArchiveChunkDone() received it.
+  Chunk archive_chunk_;
 
-  // Stores the data read from JavaScript.
-  char* destination_buffer_;
+  // The stats of the compressor. Can be NULL.
+  Stats* stats_;
 };
 
 #endif  // COMPRESSOR_IO_JAVSCRIPT_STREAM_H_
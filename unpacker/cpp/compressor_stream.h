@@ -8,35 +8,89 @@
 #include <string>
 
 // A IO class that reads and writes data from and to files through JavaScript.
-// Currently, Read() and Write() methods are not called at the same time.
-// To improve the performance, these should be called in parallel by preparing
-// two buffers and calling them with these buffers alternatively.
+// Read() and Write() are not called at the same time, but the chunks of the
+// entry being added can be read ahead while the previous ones are compressed
+// and written.
 class CompressorStream {
  public:
   virtual ~CompressorStream() {}
 
   // Writes the given buffer onto the archive. After sending a write chunk
-  // request to JavaScript, it waits until WriteChunkDone() is called in the
-  // main thread. Thus, This method must not be called in the main thread.
+  // request to JavaScript, it may wait until WriteChunkDone() is called in the
+  // main thread for some of the chunks sent before. Thus, This method must not
+  // be called in the main thread. Returns a negative value if writing this or
+  // a previous chunk failed. The buffer is recycled by the stream once sent,
+  // so it must not be used by the caller afterwards.
   virtual int64_t Write(int64_t bytes_to_write,
                         const pp::VarArrayBuffer& buffer) = 0;
 
+  // Returns a buffer of size bytes to fill with the data of the next Write.
+  // The buffers passed to Write are reused, so writing the archive doesn't
+  // allocate a new buffer for every chunk.
+  virtual pp::VarArrayBuffer AcquireWriteBuffer(uint32_t size) = 0;
+
   // Called when write chunk done response arrives from JavaScript. Sends a
   // signal to invoke Write function in another thread again.
   virtual void WriteChunkDone(int64_t write_bytes) = 0;
 
-  // Reads a file chunk from the entry that is currently being processed. After
-  // sending a read file chunk request to JavaScript, it waits until
-  // ReadFileChunkDone() is called in the main thread. Thus, This method must
-  // not be called in the main thread.
+  // Makes the next Write() write its chunk at offset of the archive and drop
+  // the data of the archive after it, instead of writing it after the last
+  // chunk. The chunks written after it follow it. Used to write new entries
+  // over the central directory of a zip archive appended to.
+  virtual void SetWriteOffset(int64_t offset) = 0;
+
+  // Waits until all the chunks passed to Write() are written onto the archive.
+  // Returns a negative value if writing any of them failed. Must not be called
+  // in the main thread.
+  virtual int64_t Flush() = 0;
+
+  // Starts reading a new entry of entry_size bytes from its beginning. Must be
+  // called before the first Read() of every entry.
+  virtual void StartEntry(int64_t entry_size) = 0;
+
+  // Starts reading the current entry from its beginning again, e.g. after
+  // reading it once to hash it.
+  virtual void RewindEntry() = 0;
+
+  // Makes the next entry started by StartEntry read from buffer, where its
+  // data starts at offset, instead of requesting chunks from JavaScript.
+  // JavaScript sends the data of small files together with the entries, so
+  // adding them costs no round trip. buffer must hold the whole entry.
+  virtual void SetNextEntryData(const pp::VarArrayBuffer& buffer,
+                                int64_t offset) = 0;
+
+  // Reads the next file chunk from the entry that is currently being
+  // processed. If the chunk was not read ahead yet, it sends a read file chunk
+  // request to JavaScript and waits until ReadFileChunkDone() is called in the
+  // main thread. Thus, This method must not be called in the main thread.
   virtual int64_t Read(int64_t bytes_to_read, char* destination_buffer) = 0;
 
-  // Called when read file chunk done response arrives from JavaScript. Copies
-  // the binary data in the given buffer to destination_buffer_ and Sends a
-  // signal to invoke Read function in another thread again. buffer must not be
-  // const because buffer.Map() and buffer.Unmap() can not be called with const.
-  virtual void ReadFileChunkDone(int64_t read_bytes,
-                                 pp::VarArrayBuffer* buffer) = 0;
+  // Same as Read, but sets data to the bytes read in the chunk received from
+  // JavaScript instead of copying them. data stays valid until the next call
+  // to Read, ReadInPlace or StartEntry.
+  virtual int64_t ReadInPlace(int64_t bytes_to_read, const char** data) = 0;
+
+  // Called when read file chunk done response arrives from JavaScript with the
+  // chunk at offset of the current entry. Keeps the given buffer until Read
+  // reaches the chunk and sends a signal to invoke Read function in another
+  // thread again.
+  virtual void ReadFileChunkDone(int64_t offset,
+                                 int64_t read_bytes,
+                                 const pp::VarArrayBuffer& buffer) = 0;
+
+  // Reads length bytes at offset of the existing archive being appended to
+  // into destination_buffer. It sends a read archive chunk request to
+  // JavaScript and waits until ReadArchiveChunkDone() is called in the main
+  // thread. Thus, This method must not be called in the main thread. Returns
+  // the number of bytes read, or a negative value if reading failed.
+  virtual int64_t ReadArchive(int64_t offset,
+                              int64_t length,
+                              char* destination_buffer) = 0;
+
+  // Called when read archive chunk done response arrives from JavaScript.
+  // read_bytes is negative if reading failed.
+  virtual void ReadArchiveChunkDone(int64_t read_bytes,
+                                    const pp::VarArrayBuffer& buffer) = 0;
 };
 
 #endif  // COMPRESSOR_STREAM_H_
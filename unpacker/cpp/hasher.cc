@@ -0,0 +1,465 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "hasher.h"
+
+#include <openssl/sha.h>
+#include <pthread.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Returns bytes as lowercase hex.
+std::string ToHex(const uint8_t* bytes, size_t length) {
+  static const char kHexDigits[] = "0123456789abcdef";
+  std::string hex;
+  for (size_t i = 0; i < length; ++i) {
+    hex += kHexDigits[bytes[i] >> 4];
+    hex += kHexDigits[bytes[i] & 0xf];
+  }
+  return hex;
+}
+
+// SHA-256 from OpenSSL, which uses the SHA and vector extensions of the CPU
+// where the build allows them.
+class Sha256Hasher : public Hasher {
+ public:
+  Sha256Hasher() { Reset(); }
+
+  virtual void Reset() { SHA256_Init(&context_); }
+
+  virtual void Update(const char* data, int64_t length) {
+    SHA256_Update(&context_, data, length);
+  }
+
+  virtual std::string Finish() {
+    uint8_t digest[SHA256_DIGEST_LENGTH];
+    SHA256_Final(digest, &context_);
+    return ToHex(digest, sizeof(digest));
+  }
+
+ private:
+  SHA256_CTX context_;
+};
+
+// The tables of CRC32C for slicing by 8 bytes. crc32c_tables[0] is the usual
+// table for a byte, and crc32c_tables[i] is the CRC of a byte followed by i
+// zero bytes.
+uint32_t crc32c_tables[8][256];
+pthread_once_t crc32c_tables_once = PTHREAD_ONCE_INIT;
+
+void InitCrc32cTables() {
+  const uint32_t kPolynomial = 0x82f63b78;  // Castagnoli, reversed.
+  for (uint32_t byte = 0; byte < 256; ++byte) {
+    uint32_t crc = byte;
+    for (int bit = 0; bit < 8; ++bit)
+      crc = crc & 1 ? (crc >> 1) ^ kPolynomial : crc >> 1;
+    crc32c_tables[0][byte] = crc;
+  }
+  for (uint32_t byte = 0; byte < 256; ++byte) {
+    for (int i = 1; i < 8; ++i) {
+      uint32_t crc = crc32c_tables[i - 1][byte];
+      crc32c_tables[i][byte] = (crc >> 8) ^ crc32c_tables[0][crc & 0xff];
+    }
+  }
+}
+
+// CRC32C (Castagnoli) computed 8 bytes at a time with lookup tables, as the
+// CRC32 instructions of the CPU are not available to portable code.
+class Crc32cHasher : public Hasher {
+ public:
+  Crc32cHasher() {
+    pthread_once(&crc32c_tables_once, InitCrc32cTables);
+    Reset();
+  }
+
+  virtual void Reset() { crc_ = 0xffffffff; }
+
+  virtual void Update(const char* data, int64_t length) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    uint32_t crc = crc_;
+    for (; length >= 8; bytes += 8, length -= 8) {
+      // The bytes are combined one by one, so the result doesn't depend on
+      // the endianness of the CPU.
+      uint32_t low = crc ^ (bytes[0] | bytes[1] << 8 | bytes[2] << 16 |
+                            static_cast<uint32_t>(bytes[3]) << 24);
+      crc = crc32c_tables[7][low & 0xff] ^
+            crc32c_tables[6][(low >> 8) & 0xff] ^
+            crc32c_tables[5][(low >> 16) & 0xff] ^
+            crc32c_tables[4][low >> 24] ^
+            crc32c_tables[3][bytes[4]] ^
+            crc32c_tables[2][bytes[5]] ^
+            crc32c_tables[1][bytes[6]] ^
+            crc32c_tables[0][bytes[7]];
+    }
+    for (; length > 0; ++bytes, --length)
+      crc = (crc >> 8) ^ crc32c_tables[0][(crc ^ *bytes) & 0xff];
+    crc_ = crc;
+  }
+
+  virtual std::string Finish() {
+    uint32_t crc = ~crc_;
+    uint8_t digest[4] = {static_cast<uint8_t>(crc >> 24),
+                         static_cast<uint8_t>(crc >> 16),
+                         static_cast<uint8_t>(crc >> 8),
+                         static_cast<uint8_t>(crc)};
+    return ToHex(digest, sizeof(digest));
+  }
+
+ private:
+  uint32_t crc_;
+};
+
+// 4 words, one per chunk compressed at once by Blake3Hasher. The generic
+// vector extensions of the compiler are portable, and PNaCl translates them
+// to the SIMD instructions of the target.
+typedef uint32_t Words4 __attribute__((vector_size(16)));
+
+// BLAKE3 with the default 32 bytes output, following the reference
+// implementation. Like the hash_many of the reference implementation, whole
+// chunks followed by more data are compressed 4 at a time with vectors of
+// 4 words. The other chunks are compressed one at a time.
+class Blake3Hasher : public Hasher {
+ public:
+  Blake3Hasher() { Reset(); }
+
+  virtual void Reset() {
+    chunk_.Reset(kIv, 0);
+    cv_stack_length_ = 0;
+  }
+
+  virtual void Update(const char* data, int64_t length) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    while (length > 0) {
+      // The chunk is complete, and there is more input, so it is not the
+      // root.
+      if (chunk_.length() == kChunkLength) {
+        uint32_t chunk_cv[8];
+        chunk_.GetOutput().GetChainingValue(chunk_cv);
+        uint64_t total_chunks = chunk_.counter() + 1;
+        AddChunkChainingValue(chunk_cv, total_chunks);
+        chunk_.Reset(kIv, total_chunks);
+      }
+
+      // The next 4 chunks are complete, and there is more input, so none of
+      // them is the root.
+      while (chunk_.length() == 0 && length > 4 * kChunkLength) {
+        uint32_t chunk_cvs[4][8];
+        GetFourChunkChainingValues(bytes, chunk_.counter(), chunk_cvs);
+        for (int i = 0; i < 4; ++i)
+          AddChunkChainingValue(chunk_cvs[i], chunk_.counter() + i + 1);
+        chunk_.Reset(kIv, chunk_.counter() + 4);
+        bytes += 4 * kChunkLength;
+        length -= 4 * kChunkLength;
+      }
+
+      int64_t take = std::min(length, kChunkLength - chunk_.length());
+      chunk_.Update(bytes, take);
+      bytes += take;
+      length -= take;
+    }
+  }
+
+  virtual std::string Finish() {
+    // Merge the chaining values of the stack from the top, where the newest
+    // subtrees are.
+    Output output = chunk_.GetOutput();
+    for (size_t i = cv_stack_length_; i > 0; --i) {
+      uint32_t right_cv[8];
+      output.GetChainingValue(right_cv);
+      output = GetParentOutput(cv_stack_[i - 1], right_cv);
+    }
+
+    uint32_t words[16];
+    output.Compress(kRoot, words);
+    uint8_t digest[32];
+    for (int i = 0; i < 8; ++i) {
+      for (int j = 0; j < 4; ++j)
+        digest[i * 4 + j] = static_cast<uint8_t>(words[i] >> (8 * j));
+    }
+    return ToHex(digest, sizeof(digest));
+  }
+
+ private:
+  static const int64_t kChunkLength = 1024;
+  static const uint32_t kBlockLength = 64;
+
+  // Domain separation flags.
+  static const uint32_t kChunkStart = 1 << 0;
+  static const uint32_t kChunkEnd = 1 << 1;
+  static const uint32_t kParent = 1 << 2;
+  static const uint32_t kRoot = 1 << 3;
+
+  static const uint32_t kIv[8];
+  static const uint8_t kMessagePermutation[16];
+
+  // Word is uint32_t, or Words4 for 4 chunks at once.
+  template <typename Word>
+  static Word RotateRight(Word value, int bits) {
+    return (value >> bits) | (value << (32 - bits));
+  }
+
+  template <typename Word>
+  static void G(Word* state, int a, int b, int c, int d, Word mx, Word my) {
+    state[a] = state[a] + state[b] + mx;
+    state[d] = RotateRight(state[d] ^ state[a], 16);
+    state[c] = state[c] + state[d];
+    state[b] = RotateRight(state[b] ^ state[c], 12);
+    state[a] = state[a] + state[b] + my;
+    state[d] = RotateRight(state[d] ^ state[a], 8);
+    state[c] = state[c] + state[d];
+    state[b] = RotateRight(state[b] ^ state[c], 7);
+  }
+
+  // Compresses a block into out. The first 8 words of out are the chaining
+  // value of the block.
+  static void Compress(const uint32_t* cv,
+                       const uint32_t* block_words,
+                       uint64_t counter,
+                       uint32_t block_length,
+                       uint32_t flags,
+                       uint32_t* out) {
+    uint32_t state[16] = {cv[0], cv[1], cv[2], cv[3],
+                          cv[4], cv[5], cv[6], cv[7],
+                          kIv[0], kIv[1], kIv[2], kIv[3],
+                          static_cast<uint32_t>(counter),
+                          static_cast<uint32_t>(counter >> 32),
+                          block_length, flags};
+    Rounds(state, block_words);
+
+    for (int i = 0; i < 8; ++i) {
+      out[i] = state[i] ^ state[i + 8];
+      out[i + 8] = state[i + 8] ^ cv[i];
+    }
+  }
+
+  // Runs the 7 rounds of the compression of block_words on state.
+  template <typename Word>
+  static void Rounds(Word* state, const Word* block_words) {
+    Word block[16];
+    memcpy(block, block_words, sizeof(block));
+
+    for (int round = 0; round < 7; ++round) {
+      // Mix the columns, then the diagonals.
+      G(state, 0, 4, 8, 12, block[0], block[1]);
+      G(state, 1, 5, 9, 13, block[2], block[3]);
+      G(state, 2, 6, 10, 14, block[4], block[5]);
+      G(state, 3, 7, 11, 15, block[6], block[7]);
+      G(state, 0, 5, 10, 15, block[8], block[9]);
+      G(state, 1, 6, 11, 12, block[10], block[11]);
+      G(state, 2, 7, 8, 13, block[12], block[13]);
+      G(state, 3, 4, 9, 14, block[14], block[15]);
+
+      Word permuted[16];
+      for (int i = 0; i < 16; ++i)
+        permuted[i] = block[kMessagePermutation[i]];
+      memcpy(block, permuted, sizeof(block));
+    }
+  }
+
+  // Reads 4 bytes as a little endian word.
+  static uint32_t ReadWord(const uint8_t* bytes) {
+    return bytes[0] | bytes[1] << 8 | bytes[2] << 16 |
+           static_cast<uint32_t>(bytes[3]) << 24;
+  }
+
+  static Words4 Splat(uint32_t word) {
+    Words4 words = {word, word, word, word};
+    return words;
+  }
+
+  // Sets chunk_cvs to the chaining values of the 4 whole chunks of bytes
+  // starting from the chunk with index counter, none of which is the root.
+  // The chunks are compressed at once, one per word of Words4.
+  static void GetFourChunkChainingValues(const uint8_t* bytes,
+                                         uint64_t counter,
+                                         uint32_t chunk_cvs[4][8]) {
+    Words4 cv[8];
+    for (int i = 0; i < 8; ++i)
+      cv[i] = Splat(kIv[i]);
+    Words4 counter_low = {static_cast<uint32_t>(counter),
+                          static_cast<uint32_t>(counter + 1),
+                          static_cast<uint32_t>(counter + 2),
+                          static_cast<uint32_t>(counter + 3)};
+    Words4 counter_high = {static_cast<uint32_t>(counter >> 32),
+                           static_cast<uint32_t>((counter + 1) >> 32),
+                           static_cast<uint32_t>((counter + 2) >> 32),
+                           static_cast<uint32_t>((counter + 3) >> 32)};
+
+    const int blocks_per_chunk = kChunkLength / kBlockLength;
+    for (int block = 0; block < blocks_per_chunk; ++block) {
+      Words4 block_words[16];
+      for (int i = 0; i < 16; ++i) {
+        const uint8_t* word = bytes + block * kBlockLength + i * 4;
+        Words4 words = {ReadWord(word), ReadWord(word + kChunkLength),
+                        ReadWord(word + 2 * kChunkLength),
+                        ReadWord(word + 3 * kChunkLength)};
+        block_words[i] = words;
+      }
+      uint32_t flags = (block == 0 ? kChunkStart : 0) |
+                       (block == blocks_per_chunk - 1 ? kChunkEnd : 0);
+
+      Words4 state[16] = {cv[0], cv[1], cv[2], cv[3],
+                          cv[4], cv[5], cv[6], cv[7],
+                          Splat(kIv[0]), Splat(kIv[1]),
+                          Splat(kIv[2]), Splat(kIv[3]),
+                          counter_low, counter_high,
+                          Splat(kBlockLength), Splat(flags)};
+      Rounds(state, block_words);
+      for (int i = 0; i < 8; ++i)
+        cv[i] = state[i] ^ state[i + 8];
+    }
+
+    for (int chunk = 0; chunk < 4; ++chunk) {
+      for (int i = 0; i < 8; ++i) {
+        uint32_t words[4];
+        memcpy(words, &cv[i], sizeof(words));
+        chunk_cvs[chunk][i] = words[chunk];
+      }
+    }
+  }
+
+  // The input of the compression of the last block of a node, which is
+  // compressed differently if the node is the root.
+  struct Output {
+    uint32_t input_cv[8];
+    uint32_t block_words[16];
+    uint64_t counter;
+    uint32_t block_length;
+    uint32_t flags;
+
+    void Compress(uint32_t extra_flags, uint32_t* out) const {
+      Blake3Hasher::Compress(input_cv, block_words, counter, block_length,
+                             flags | extra_flags, out);
+    }
+
+    void GetChainingValue(uint32_t* cv) const {
+      uint32_t out[16];
+      Compress(0, out);
+      memcpy(cv, out, 8 * sizeof(uint32_t));
+    }
+  };
+
+  // A chunk of 1 KB being hashed.
+  class ChunkState {
+   public:
+    void Reset(const uint32_t* key, uint64_t counter) {
+      memcpy(cv_, key, sizeof(cv_));
+      counter_ = counter;
+      block_length_ = 0;
+      blocks_compressed_ = 0;
+    }
+
+    int64_t length() const {
+      return kBlockLength * blocks_compressed_ + block_length_;
+    }
+
+    uint64_t counter() const { return counter_; }
+
+    void Update(const uint8_t* bytes, int64_t length) {
+      while (length > 0) {
+        // The block is full, and there is more input, so it is not the last
+        // block of the chunk.
+        if (block_length_ == kBlockLength) {
+          uint32_t block_words[16];
+          GetBlockWords(block_words);
+          uint32_t out[16];
+          Blake3Hasher::Compress(cv_, block_words, counter_, kBlockLength,
+                                 GetStartFlag(), out);
+          memcpy(cv_, out, sizeof(cv_));
+          ++blocks_compressed_;
+          block_length_ = 0;
+        }
+
+        uint32_t take = std::min(static_cast<int64_t>(kBlockLength -
+                                                      block_length_),
+                                 length);
+        memcpy(block_ + block_length_, bytes, take);
+        block_length_ += take;
+        bytes += take;
+        length -= take;
+      }
+    }
+
+    Output GetOutput() const {
+      Output output;
+      memcpy(output.input_cv, cv_, sizeof(cv_));
+      GetBlockWords(output.block_words);
+      output.counter = counter_;
+      output.block_length = block_length_;
+      output.flags = GetStartFlag() | kChunkEnd;
+      return output;
+    }
+
+   private:
+    uint32_t GetStartFlag() const {
+      return blocks_compressed_ == 0 ? kChunkStart : 0;
+    }
+
+    // Reads the block as little endian words, padded with zeros.
+    void GetBlockWords(uint32_t* words) const {
+      uint8_t block[kBlockLength] = {0};
+      memcpy(block, block_, block_length_);
+      for (int i = 0; i < 16; ++i)
+        words[i] = ReadWord(block + i * 4);
+    }
+
+    uint32_t cv_[8];
+    uint64_t counter_;
+    uint8_t block_[kBlockLength];
+    uint32_t block_length_;
+    uint32_t blocks_compressed_;
+  };
+
+  static Output GetParentOutput(const uint32_t* left_cv,
+                                const uint32_t* right_cv) {
+    Output output;
+    memcpy(output.input_cv, kIv, sizeof(output.input_cv));
+    memcpy(output.block_words, left_cv, 8 * sizeof(uint32_t));
+    memcpy(output.block_words + 8, right_cv, 8 * sizeof(uint32_t));
+    output.counter = 0;
+    output.block_length = kBlockLength;
+    output.flags = kParent;
+    return output;
+  }
+
+  // Adds the chaining value of a complete chunk to the stack, merging the
+  // subtrees which are complete. The number of complete subtrees is the
+  // number of trailing zero bits of total_chunks.
+  void AddChunkChainingValue(const uint32_t* chunk_cv, uint64_t total_chunks) {
+    uint32_t cv[8];
+    memcpy(cv, chunk_cv, sizeof(cv));
+    for (; (total_chunks & 1) == 0; total_chunks >>= 1) {
+      uint32_t out[16];
+      GetParentOutput(cv_stack_[--cv_stack_length_], cv).Compress(0, out);
+      memcpy(cv, out, sizeof(cv));
+    }
+    memcpy(cv_stack_[cv_stack_length_++], cv, sizeof(cv));
+  }
+
+  ChunkState chunk_;
+  uint32_t cv_stack_[54][8];  // Enough for 2^64 bytes.
+  size_t cv_stack_length_;
+};
+
+const uint32_t Blake3Hasher::kIv[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372,
+                                       0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                       0x1f83d9ab, 0x5be0cd19};
+
+const uint8_t Blake3Hasher::kMessagePermutation[16] = {
+    2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8};
+
+}  // namespace
+
+Hasher* Hasher::Create(const std::string& algorithm) {
+  if (algorithm == "sha256")
+    return new Sha256Hasher();
+  if (algorithm == "crc32c")
+    return new Crc32cHasher();
+  if (algorithm == "blake3")
+    return new Blake3Hasher();
+  return NULL;
+}
@@ -0,0 +1,32 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef HASHER_H_
+#define HASHER_H_
+
+#include <stdint.h>
+#include <string>
+
+// Computes the digest of a stream of data passed in chunks of any size.
+class Hasher {
+ public:
+  // Creates a hasher for the algorithm with the given name, which is one of
+  // "sha256", "crc32c" and "blake3". Returns NULL for other names.
+  static Hasher* Create(const std::string& algorithm);
+
+  virtual ~Hasher() {}
+
+  // Forgets the data passed so far, so a new stream can be hashed.
+  virtual void Reset() = 0;
+
+  // Hashes the next length bytes of the stream.
+  virtual void Update(const char* data, int64_t length) = 0;
+
+  // Returns the digest of the data passed since the last Reset as lowercase
+  // hex, big endian for CRC32C. The hasher must be reset before it is used
+  // again.
+  virtual std::string Finish() = 0;
+};
+
+#endif  // HASHER_H_
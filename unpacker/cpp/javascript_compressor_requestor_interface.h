@@ -12,10 +12,17 @@ class JavaScriptCompressorRequestorInterface {
  public:
   virtual ~JavaScriptCompressorRequestorInterface() {}
 
+  // Requests JavaScript to write length bytes of buffer at offset of the
+  // archive, dropping the data after it, or after the last chunk if offset is
+  // negative.
   virtual void WriteChunkRequest(int64_t length,
-                                 const pp::VarArrayBuffer& buffer) = 0;
+                                 const pp::VarArrayBuffer& buffer,
+                                 int64_t offset) = 0;
 
-  virtual void ReadFileChunkRequest(int64_t length) = 0;
+  virtual void ReadFileChunkRequest(int64_t offset, int64_t length) = 0;
+
+  // Requests length bytes at offset of the archive being appended to.
+  virtual void ReadArchiveChunkRequest(int64_t offset, int64_t length) = 0;
 };
 
 #endif  // JAVASCRIPT_COMPRESSOR_REQUESTOR_INTERFACE_H_
@@ -21,6 +21,7 @@ class JavaScriptMessageSenderInterface {
 
   virtual void SendFileChunkRequest(const std::string& file_system_id,
                                     const std::string& request_id,
+                                    int part_index,
                                     int64_t offset,
                                     int64_t bytes_to_read) = 0;
 
@@ -43,6 +44,32 @@ class JavaScriptMessageSenderInterface {
                                 const pp::VarArrayBuffer& array_buffer,
                                 bool has_more_data) = 0;
 
+  virtual void SendReadFilesDone(const std::string& file_system_id,
+                                 const std::string& request_id,
+                                 int64_t index,
+                                 const pp::VarArrayBuffer& array_buffer,
+                                 bool has_more_data) = 0;
+
+  virtual void SendSearchDone(const std::string& file_system_id,
+                              const std::string& request_id,
+                              const pp::VarArray& hits,
+                              bool has_more_data) = 0;
+
+  virtual void SendHashEntriesDone(const std::string& file_system_id,
+                                   const std::string& request_id,
+                                   const pp::VarArray& digests,
+                                   bool has_more_data) = 0;
+
+  virtual void SendStatPathDone(const std::string& file_system_id,
+                                const std::string& request_id,
+                                const pp::VarDictionary& metadata) = 0;
+
+  virtual void SendGetStatsDone(const std::string& request_id,
+                                const pp::VarDictionary& stats) = 0;
+
+  virtual void SendGetTraceDone(const std::string& request_id,
+                                const std::string& trace) = 0;
+
   virtual void SendConsoleLog(const std::string& file_system_id,
                               const std::string& request_id,
                               const std::string& src_file,
@@ -53,14 +80,24 @@ class JavaScriptMessageSenderInterface {
   virtual void SendCreateArchiveDone(int compressor_id) = 0;
 
   virtual void SendReadFileChunk(int compressor_id_,
-                                 int64_t file_size) = 0;
+                                 int64_t offset,
+                                 int64_t length) = 0;
 
   virtual void SendWriteChunk(int compressor_id,
                               const pp::VarArrayBuffer& array_buffer,
-                              int64_t length) = 0;
+                              int64_t length,
+                              int64_t offset) = 0;
+
+  virtual void SendReadArchiveChunk(int compressor_id,
+                                    int64_t offset,
+                                    int64_t length) = 0;
+
+  virtual void SendAppendToArchiveDone(int compressor_id) = 0;
 
   virtual void SendAddToArchiveDone(int compressor_id) = 0;
 
+  virtual void SendAddEntriesToArchiveDone(int compressor_id) = 0;
+
   virtual void SendCloseArchiveDone(int compressor_id) = 0;
 };
 
@@ -0,0 +1,93 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "job_scheduler.h"
+
+#include <algorithm>
+
+#include "ppapi/cpp/logging.h"
+
+#include "stats.h"
+
+const int JobScheduler::kPriorityCount;
+
+JobScheduler::JobScheduler(WorkerPool* worker_pool)
+    : worker_pool_(worker_pool), strand_(worker_pool->CreateStrand()) {}
+
+JobScheduler::~JobScheduler() {
+  Join();
+}
+
+void JobScheduler::Join() {
+  if (strand_) {
+    worker_pool_->DestroyStrand(strand_);
+    strand_ = NULL;
+  }
+}
+
+void JobScheduler::PostJob(Priority priority,
+                           const pp::CompletionCallback& callback) {
+  Post(priority, callback, false /* front */);
+}
+
+void JobScheduler::PostJobFront(Priority priority,
+                                const pp::CompletionCallback& callback) {
+  Post(priority, callback, true /* front */);
+}
+
+bool JobScheduler::HasJobsAbove(Priority priority) {
+  bool has_jobs = false;
+  lock_.Acquire();
+  for (int i = 0; i < priority && !has_jobs; ++i)
+    has_jobs = !queues_[i].empty();
+  lock_.Release();
+  return has_jobs;
+}
+
+JobScheduler::WaitStats JobScheduler::GetWaitStats(Priority priority) {
+  lock_.Acquire();
+  WaitStats wait_stats = wait_stats_[priority];
+  lock_.Release();
+  return wait_stats;
+}
+
+void JobScheduler::Post(Priority priority,
+                        const pp::CompletionCallback& callback,
+                        bool front) {
+  PP_DCHECK(priority >= 0 && priority < kPriorityCount);
+  Job job(callback, Stats::NowInMicroseconds());
+  lock_.Acquire();
+  if (front)
+    queues_[priority].push_front(job);
+  else
+    queues_[priority].push_back(job);
+  lock_.Release();
+
+  PP_DCHECK(strand_);
+  worker_pool_->Post(strand_,
+                     pp::CompletionCallback(&JobScheduler::RunNextJob, this));
+}
+
+// static
+void JobScheduler::RunNextJob(void* scheduler, int32_t /*result*/) {
+  JobScheduler* self = static_cast<JobScheduler*>(scheduler);
+
+  self->lock_.Acquire();
+  int priority = 0;
+  while (priority < kPriorityCount && self->queues_[priority].empty())
+    ++priority;
+  PP_DCHECK(priority < kPriorityCount);
+
+  Job job = self->queues_[priority].front();
+  self->queues_[priority].pop_front();
+
+  int64_t wait_us = Stats::NowInMicroseconds() - job.post_time_us;
+  WaitStats* stats = &self->wait_stats_[priority];
+  ++stats->jobs;
+  stats->total_wait_us += wait_us;
+  stats->max_wait_us = std::max(stats->max_wait_us, wait_us);
+  self->lock_.Release();
+
+  job.callback.Run(PP_OK);
+}
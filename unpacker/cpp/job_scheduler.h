@@ -0,0 +1,90 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef JOB_SCHEDULER_H_
+#define JOB_SCHEDULER_H_
+
+#include <deque>
+#include <stdint.h>
+
+#include "ppapi/cpp/completion_callback.h"
+#include "ppapi/utility/threading/lock.h"
+
+#include "worker_pool.h"
+
+// Runs jobs one at a time on a strand of a WorkerPool, in priority order. Jobs
+// with the same priority run in the order they were posted. Long jobs can check
+// HasJobsAbove between their steps and repost the rest of their work with
+// PostJobFront, so jobs with a higher priority don't wait for them to finish.
+//
+// PostJob and PostJobFront can be called from any thread.
+class JobScheduler {
+ public:
+  // Smaller values have a higher priority.
+  enum Priority {
+    PRIORITY_INTERACTIVE = 0,  // Requests the user is waiting for.
+    PRIORITY_METADATA = 1,     // Reading the headers of an archive.
+    PRIORITY_BULK = 2          // Batched reads and prefetching.
+  };
+
+  static const int kPriorityCount = 3;
+
+  // Statistics about the time jobs spent in the queue before running.
+  struct WaitStats {
+    WaitStats() : jobs(0), total_wait_us(0), max_wait_us(0) {}
+
+    int64_t jobs;
+    int64_t total_wait_us;
+    int64_t max_wait_us;
+  };
+
+  // JobScheduler does not own the pool. The pool must outlive the scheduler.
+  explicit JobScheduler(WorkerPool* worker_pool);
+
+  ~JobScheduler();
+
+  // Waits for all the posted jobs to run. No jobs can be posted afterwards.
+  void Join();
+
+  // Posts a job after all the jobs with the same priority.
+  void PostJob(Priority priority, const pp::CompletionCallback& callback);
+
+  // Posts a job before all the jobs with the same priority. Used by jobs that
+  // yield, so they continue before other jobs with the same priority.
+  void PostJobFront(Priority priority, const pp::CompletionCallback& callback);
+
+  // Returns true if there are pending jobs with a higher priority than
+  // priority.
+  bool HasJobsAbove(Priority priority);
+
+  // Returns the wait statistics of the jobs that already run with the given
+  // priority.
+  WaitStats GetWaitStats(Priority priority);
+
+ private:
+  struct Job {
+    Job(const pp::CompletionCallback& callback, int64_t post_time_us)
+        : callback(callback), post_time_us(post_time_us) {}
+
+    pp::CompletionCallback callback;
+    int64_t post_time_us;
+  };
+
+  // Adds the job to its queue and posts a RunNextJob call to the strand.
+  void Post(Priority priority,
+            const pp::CompletionCallback& callback,
+            bool front);
+
+  // Runs the job with the highest priority. Exactly one call is posted to the
+  // strand for every job, so there is always a job to run.
+  static void RunNextJob(void* scheduler, int32_t result);
+
+  WorkerPool* worker_pool_;
+  WorkerPool::Strand* strand_;  // NULL after Join.
+  pp::Lock lock_;  // Guards queues_ and wait_stats_.
+  std::deque<Job> queues_[kPriorityCount];
+  WaitStats wait_stats_[kPriorityCount];
+};
+
+#endif  // JOB_SCHEDULER_H_
@@ -4,6 +4,7 @@
 
 #include <clocale>
 #include <sstream>
+#include <vector>
 
 #include "ppapi/cpp/instance.h"
 #include "ppapi/cpp/instance_handle.h"
@@ -11,11 +12,12 @@
 #include "ppapi/cpp/module.h"
 #include "ppapi/cpp/var_dictionary.h"
 #include "ppapi/utility/threading/lock.h"
-#include "ppapi/utility/threading/simple_thread.h"
 
 #include "compressor.h"
 #include "request.h"
+#include "tracer.h"
 #include "volume.h"
+#include "worker_pool.h"
 
 namespace {
 
@@ -47,12 +49,13 @@ class JavaScriptMessageSender : public JavaScriptMessageSenderInterface {
 
   virtual void SendFileChunkRequest(const std::string& file_system_id,
                                     const std::string& request_id,
+                                    int part_index,
                                     int64_t offset,
                                     int64_t bytes_to_read) {
     PP_DCHECK(offset >= 0);
     PP_DCHECK(bytes_to_read > 0);
     JavaScriptPostMessage(request::CreateReadChunkRequest(
-        file_system_id, request_id, offset, bytes_to_read));
+        file_system_id, request_id, part_index, offset, bytes_to_read));
   }
 
   virtual void SendPassphraseRequest(const std::string& file_system_id,
@@ -89,6 +92,50 @@ class JavaScriptMessageSender : public JavaScriptMessageSenderInterface {
         file_system_id, request_id, array_buffer, has_more_data));
   }
 
+  virtual void SendReadFilesDone(const std::string& file_system_id,
+                                 const std::string& request_id,
+                                 int64_t index,
+                                 const pp::VarArrayBuffer& array_buffer,
+                                 bool has_more_data) {
+    JavaScriptPostMessage(request::CreateReadFilesDoneResponse(
+        file_system_id, request_id, index, array_buffer, has_more_data));
+  }
+
+  virtual void SendSearchDone(const std::string& file_system_id,
+                              const std::string& request_id,
+                              const pp::VarArray& hits,
+                              bool has_more_data) {
+    JavaScriptPostMessage(request::CreateSearchDoneResponse(
+        file_system_id, request_id, hits, has_more_data));
+  }
+
+  virtual void SendHashEntriesDone(const std::string& file_system_id,
+                                   const std::string& request_id,
+                                   const pp::VarArray& digests,
+                                   bool has_more_data) {
+    JavaScriptPostMessage(request::CreateHashEntriesDoneResponse(
+        file_system_id, request_id, digests, has_more_data));
+  }
+
+  virtual void SendStatPathDone(const std::string& file_system_id,
+                                const std::string& request_id,
+                                const pp::VarDictionary& metadata) {
+    JavaScriptPostMessage(request::CreateStatPathDoneResponse(
+        file_system_id, request_id, metadata));
+  }
+
+  virtual void SendGetStatsDone(const std::string& request_id,
+                                const pp::VarDictionary& stats) {
+    JavaScriptPostMessage(request::CreateGetStatsDoneResponse(request_id,
+                                                              stats));
+  }
+
+  virtual void SendGetTraceDone(const std::string& request_id,
+                                const std::string& trace) {
+    JavaScriptPostMessage(request::CreateGetTraceDoneResponse(request_id,
+                                                              trace));
+  }
+
   virtual void SendConsoleLog(const std::string& file_system_id,
                               const std::string& request_id,
                               const std::string& src_file,
@@ -104,16 +151,31 @@ class JavaScriptMessageSender : public JavaScriptMessageSenderInterface {
         compressor_id));
   }
 
-  virtual void SendReadFileChunk(int compressor_id, int64_t length) {
+  virtual void SendReadFileChunk(int compressor_id,
+                                 int64_t offset,
+                                 int64_t length) {
     JavaScriptPostMessage(request::CreateReadFileChunkRequest(
-        compressor_id, length));
+        compressor_id, offset, length));
   }
 
   virtual void SendWriteChunk(int compressor_id,
       const pp::VarArrayBuffer& array_buffer,
-      int64_t length) {
+      int64_t length,
+      int64_t offset) {
     JavaScriptPostMessage(request::CreateWriteChunkRequest(
-        compressor_id, array_buffer, length));
+        compressor_id, array_buffer, length, offset));
+  }
+
+  virtual void SendReadArchiveChunk(int compressor_id,
+                                    int64_t offset,
+                                    int64_t length) {
+    JavaScriptPostMessage(request::CreateReadArchiveChunkRequest(
+        compressor_id, offset, length));
+  }
+
+  virtual void SendAppendToArchiveDone(int compressor_id) {
+    JavaScriptPostMessage(request::CreateAppendToArchiveDoneResponse(
+        compressor_id));
   }
 
   virtual void SendAddToArchiveDone(int compressor_id) {
@@ -121,6 +183,11 @@ class JavaScriptMessageSender : public JavaScriptMessageSenderInterface {
         compressor_id));
   }
 
+  virtual void SendAddEntriesToArchiveDone(int compressor_id) {
+    JavaScriptPostMessage(request::CreateAddEntriesToArchiveDoneResponse(
+        compressor_id));
+  }
+
   virtual void SendCloseArchiveDone(int compressor_id) {
     JavaScriptPostMessage(request::CreateCloseArchiveDoneResponse(
         compressor_id));
@@ -144,12 +211,17 @@ class NaclArchiveInstance : public pp::Instance {
  public:
   explicit NaclArchiveInstance(PP_Instance instance)
       : pp::Instance(instance),
-        instance_handle_(instance),
+        worker_pool_(pp::InstanceHandle(instance),
+                     WorkerPool::DefaultThreadCount()),
         message_sender_(this) {}
 
   virtual ~NaclArchiveInstance() {
-    for (volume_iterator iterator = volumes_.begin();
-         iterator != volumes_.end();
+    // Volumes nested in other volumes are closed before them by CloseVolume.
+    while (!volumes_.empty())
+      CloseVolume(volumes_.begin()->first);
+    // The strands of the compressors must be destroyed before worker_pool_.
+    for (compressor_iterator iterator = compressors_.begin();
+         iterator != compressors_.end();
          ++iterator) {
       delete iterator->second;
     }
@@ -163,7 +235,9 @@ class NaclArchiveInstance : public pp::Instance {
     PP_DCHECK(var_dict.Get(request::key::kOperation).is_int());
     int operation = var_dict.Get(request::key::kOperation).AsInt();
 
-    if (request::IsPackRequest(operation))
+    if (request::IsModuleRequest(operation))
+      HandleModuleMessage(var_dict, operation);
+    else if (request::IsPackRequest(operation))
       HandlePackMessage(var_dict, operation);
     else
       HandleUnpackMessage(var_dict, operation);
@@ -171,6 +245,30 @@ class NaclArchiveInstance : public pp::Instance {
 
  private:
 
+  // Processes the messages related to the whole module.
+  void HandleModuleMessage(const pp::VarDictionary& var_dict,
+                           const int operation) {
+    PP_DCHECK(var_dict.Get(request::key::kRequestId).is_string());
+    std::string request_id = var_dict.Get(request::key::kRequestId).AsString();
+
+    switch (operation) {
+      case request::GET_STATS:
+        GetStats(request_id);
+        break;
+
+      case request::SET_TRACING:
+        SetTracing(var_dict);
+        break;
+
+      case request::GET_TRACE:
+        message_sender_.SendGetTraceDone(request_id, Tracer::DumpJson());
+        break;
+
+      default:
+        PP_NOTREACHED();
+    }
+  }
+
   // Processes unpack messages.
   void HandleUnpackMessage(const pp::VarDictionary& var_dict,
       const int operation) {
@@ -194,7 +292,7 @@ class NaclArchiveInstance : public pp::Instance {
         break;
 
       case request::READ_CHUNK_ERROR:
-        ReadChunkError(file_system_id, request_id);
+        ReadChunkError(var_dict, file_system_id, request_id);
         break;
 
       case request::READ_PASSPHRASE_DONE:
@@ -217,13 +315,30 @@ class NaclArchiveInstance : public pp::Instance {
         ReadFile(var_dict, file_system_id, request_id);
         break;
 
-      case request::CLOSE_VOLUME: {
-        volume_iterator iterator = volumes_.find(file_system_id);
-        PP_DCHECK(iterator != volumes_.end());
-        delete iterator->second;
-        volumes_.erase(file_system_id);
+      case request::OPEN_FILE_BY_PATH:
+        OpenFileByPath(var_dict, file_system_id, request_id);
+        break;
+
+      case request::STAT_PATH:
+        StatPath(var_dict, file_system_id, request_id);
+        break;
+
+      case request::READ_FILES:
+        ReadFiles(var_dict, file_system_id, request_id);
+        break;
+
+      case request::SEARCH:
+        Search(var_dict, file_system_id, request_id);
+        break;
+
+      case request::HASH_ENTRIES:
+        HashEntries(var_dict, file_system_id, request_id);
+        break;
+
+      case request::CLOSE_VOLUME:
+        PP_DCHECK(volumes_.find(file_system_id) != volumes_.end());
+        CloseVolume(file_system_id);
         break;
-      }
 
       default:
         PP_NOTREACHED();
@@ -239,7 +354,12 @@ class NaclArchiveInstance : public pp::Instance {
 
     switch (operation) {
       case request::CREATE_ARCHIVE: {
-        CreateArchive(compressor_id);
+        CreateArchive(var_dict, compressor_id, false /* append */);
+        break;
+      }
+
+      case request::APPEND_TO_ARCHIVE: {
+        CreateArchive(var_dict, compressor_id, true /* append */);
         break;
       }
 
@@ -248,11 +368,21 @@ class NaclArchiveInstance : public pp::Instance {
         break;
       }
 
+      case request::ADD_ENTRIES_TO_ARCHIVE: {
+        AddEntriesToArchive(var_dict, compressor_id);
+        break;
+      }
+
       case request::READ_FILE_CHUNK_DONE: {
         ReadFileChunkDone(var_dict, compressor_id);
         break;
       }
 
+      case request::READ_ARCHIVE_CHUNK_DONE: {
+        ReadArchiveChunkDone(var_dict, compressor_id);
+        break;
+      }
+
       case request::WRITE_CHUNK_DONE: {
         WriteChunkDone(var_dict, compressor_id);
         break;
@@ -282,18 +412,50 @@ class NaclArchiveInstance : public pp::Instance {
     // Should not call ReadMetadata for a Volume already present in NaCl.
     PP_DCHECK(volumes_.find(file_system_id) == volumes_.end());
 
-    Volume* volume =
-        new Volume(instance_handle_, file_system_id, &message_sender_);
+    // An archive nested in an entry of another volume is read directly from
+    // that volume. archive_size is the size of the entry then.
+    Volume* volume = NULL;
+    if (var_dict.Get(request::key::kOuterFileSystemId).is_string()) {
+      std::string outer_file_system_id =
+          var_dict.Get(request::key::kOuterFileSystemId).AsString();
+      volume_iterator outer_volume = volumes_.find(outer_file_system_id);
+      if (outer_volume == volumes_.end()) {
+        message_sender_.SendFileSystemError(
+            file_system_id,
+            request_id,
+            "No outer volume for: " + file_system_id + ".");
+        return;
+      }
+
+      PP_DCHECK(var_dict.Get(request::key::kOuterRequestId).is_string());
+      PP_DCHECK(var_dict.Get(request::key::kIndex).is_string());
+      volume = new Volume(
+          &worker_pool_, file_system_id, &message_sender_,
+          outer_volume->second,
+          var_dict.Get(request::key::kOuterRequestId).AsString(),
+          request::GetInt64FromString(var_dict, request::key::kIndex));
+      outer_file_system_ids_[file_system_id] = outer_file_system_id;
+    } else {
+      volume = new Volume(&worker_pool_, file_system_id, &message_sender_);
+    }
+
     if (!volume->Init()) {
       message_sender_.SendFileSystemError(
           file_system_id,
           request_id,
           "Could not create a volume for: " + file_system_id + ".");
       delete volume;
+      outer_file_system_ids_.erase(file_system_id);
       return;
     }
     volumes_[file_system_id] = volume;
 
+    // A split archive is read part by part from JavaScript.
+    if (var_dict.Get(request::key::kPartSizes).is_array()) {
+      volume->SetPartSizes(request::GetInt64ArrayFromStrings(
+          var_dict, request::key::kPartSizes));
+    }
+
     PP_DCHECK(var_dict.Get(request::key::kEncoding).is_string());
     PP_DCHECK(var_dict.Get(request::key::kArchiveSize).is_string());
 
@@ -303,6 +465,28 @@ class NaclArchiveInstance : public pp::Instance {
         request::GetInt64FromString(var_dict, request::key::kArchiveSize));
   }
 
+  // Closes the volume for file_system_id. The volumes nested in it are closed
+  // first, as they read their archives through it.
+  void CloseVolume(const std::string& file_system_id) {
+    std::vector<std::string> nested_file_system_ids;
+    for (std::map<std::string, std::string>::const_iterator iterator =
+             outer_file_system_ids_.begin();
+         iterator != outer_file_system_ids_.end();
+         ++iterator) {
+      if (iterator->second == file_system_id)
+        nested_file_system_ids.push_back(iterator->first);
+    }
+    for (size_t i = 0; i < nested_file_system_ids.size(); ++i)
+      CloseVolume(nested_file_system_ids[i]);
+
+    volume_iterator iterator = volumes_.find(file_system_id);
+    if (iterator != volumes_.end()) {
+      delete iterator->second;
+      volumes_.erase(file_system_id);
+    }
+    outer_file_system_ids_.erase(file_system_id);
+  }
+
   void ReadChunkDone(const pp::VarDictionary& var_dict,
                      const std::string& file_system_id,
                      const std::string& request_id) {
@@ -318,17 +502,27 @@ class NaclArchiveInstance : public pp::Instance {
     // Possible scenario for read ahead.
     if (iterator == volumes_.end())
       return;
-    iterator->second->ReadChunkDone(request_id, array_buffer, read_offset);
+    iterator->second->ReadChunkDone(request_id, array_buffer, read_offset,
+                                    GetPartIndex(var_dict));
   }
 
-  void ReadChunkError(const std::string& file_system_id,
+  void ReadChunkError(const pp::VarDictionary& var_dict,
+                      const std::string& file_system_id,
                       const std::string& request_id) {
     volume_iterator iterator = volumes_.find(file_system_id);
     // Volume was unmounted so ignore the read chunk operation.
     // Possible scenario for read ahead.
     if (iterator == volumes_.end())
       return;
-    iterator->second->ReadChunkError(request_id);
+    iterator->second->ReadChunkError(request_id, GetPartIndex(var_dict));
+  }
+
+  // Returns the part of a split archive a chunk was read from. Archives which
+  // are not split have only the part 0.
+  int GetPartIndex(const pp::VarDictionary& var_dict) {
+    if (!var_dict.Get(request::key::kPartIndex).is_int())
+      return 0;
+    return var_dict.Get(request::key::kPartIndex).AsInt();
   }
 
   void ReadPassphraseDone(const pp::VarDictionary& var_dict,
@@ -373,6 +567,37 @@ class NaclArchiveInstance : public pp::Instance {
     iterator->second->OpenFile(request_id, index, encoding, archive_size);
   }
 
+  void OpenFileByPath(const pp::VarDictionary& var_dict,
+                      const std::string& file_system_id,
+                      const std::string& request_id) {
+    PP_DCHECK(var_dict.Get(request::key::kPath).is_string());
+    std::string path(var_dict.Get(request::key::kPath).AsString());
+
+    PP_DCHECK(var_dict.Get(request::key::kEncoding).is_string());
+    std::string encoding(var_dict.Get(request::key::kEncoding).AsString());
+
+    PP_DCHECK(var_dict.Get(request::key::kArchiveSize).is_string());
+    int64_t archive_size =
+        request::GetInt64FromString(var_dict, request::key::kArchiveSize);
+
+    volume_iterator iterator = volumes_.find(file_system_id);
+    PP_DCHECK(iterator != volumes_.end());  // Should call OpenFileByPath after
+                                            // ReadMetadata.
+    iterator->second->OpenFileByPath(request_id, path, encoding, archive_size);
+  }
+
+  void StatPath(const pp::VarDictionary& var_dict,
+                const std::string& file_system_id,
+                const std::string& request_id) {
+    PP_DCHECK(var_dict.Get(request::key::kPath).is_string());
+    std::string path(var_dict.Get(request::key::kPath).AsString());
+
+    volume_iterator iterator = volumes_.find(file_system_id);
+    PP_DCHECK(iterator != volumes_.end());  // Should call StatPath after
+                                            // ReadMetadata.
+    iterator->second->StatPath(request_id, path);
+  }
+
   void CloseFile(const pp::VarDictionary& var_dict,
                  const std::string& file_system_id,
                  const std::string& request_id) {
@@ -404,10 +629,102 @@ class NaclArchiveInstance : public pp::Instance {
     iterator->second->ReadFile(request_id, var_dict);
   }
 
-  // Requests libarchive to create an archive object for the given compressor_id.
-  void CreateArchive(int compressor_id) {
+  void ReadFiles(const pp::VarDictionary& var_dict,
+                 const std::string& file_system_id,
+                 const std::string& request_id) {
+    PP_DCHECK(var_dict.Get(request::key::kFiles).is_array());
+    PP_DCHECK(var_dict.Get(request::key::kEncoding).is_string());
+    PP_DCHECK(var_dict.Get(request::key::kArchiveSize).is_string());
+
+    volume_iterator iterator = volumes_.find(file_system_id);
+    PP_DCHECK(iterator != volumes_.end());  // Should call ReadFiles after
+                                            // ReadMetadata.
+
+    // Passing the entire dictionary for the same reason as in ReadFile.
+    iterator->second->ReadFiles(request_id, var_dict);
+  }
+
+  void Search(const pp::VarDictionary& var_dict,
+              const std::string& file_system_id,
+              const std::string& request_id) {
+    PP_DCHECK(var_dict.Get(request::key::kPatterns).is_array());
+    PP_DCHECK(var_dict.Get(request::key::kEncoding).is_string());
+    PP_DCHECK(var_dict.Get(request::key::kArchiveSize).is_string());
+
+    volume_iterator iterator = volumes_.find(file_system_id);
+    PP_DCHECK(iterator != volumes_.end());  // Should call Search after
+                                            // ReadMetadata.
+
+    // Passing the entire dictionary for the same reason as in ReadFile.
+    iterator->second->Search(request_id, var_dict);
+  }
+
+  void HashEntries(const pp::VarDictionary& var_dict,
+                   const std::string& file_system_id,
+                   const std::string& request_id) {
+    PP_DCHECK(var_dict.Get(request::key::kIndexes).is_array());
+    PP_DCHECK(var_dict.Get(request::key::kAlgorithm).is_string());
+    PP_DCHECK(var_dict.Get(request::key::kEncoding).is_string());
+    PP_DCHECK(var_dict.Get(request::key::kArchiveSize).is_string());
+
+    volume_iterator iterator = volumes_.find(file_system_id);
+    PP_DCHECK(iterator != volumes_.end());  // Should call HashEntries after
+                                            // ReadMetadata.
+
+    // Passing the entire dictionary for the same reason as in ReadFile.
+    iterator->second->HashEntries(request_id, var_dict);
+  }
+
+  // Sends back the stats of all the volumes and compressors. The stats are
+  // updated atomically by the workers, so they are read without waiting for
+  // the jobs.
+  void GetStats(const std::string& request_id) {
+    pp::VarDictionary volume_stats;
+    for (volume_iterator iterator = volumes_.begin();
+         iterator != volumes_.end();
+         ++iterator) {
+      volume_stats.Set(iterator->first, iterator->second->GetStats());
+    }
+
+    pp::VarDictionary compressor_stats;
+    for (compressor_iterator iterator = compressors_.begin();
+         iterator != compressors_.end();
+         ++iterator) {
+      std::stringstream ss;
+      ss << iterator->first;
+      compressor_stats.Set(ss.str(), iterator->second->GetStats());
+    }
+
+    pp::VarDictionary stats;
+    stats.Set(request::key::kVolumes, volume_stats);
+    stats.Set(request::key::kCompressors, compressor_stats);
+    message_sender_.SendGetStatsDone(request_id, stats);
+  }
+
+  // Enables or disables recording the timeline of the jobs. Enabling drops
+  // the events recorded before.
+  void SetTracing(const pp::VarDictionary& var_dict) {
+    PP_DCHECK(var_dict.Get(request::key::kEnabled).is_bool());
+    if (!var_dict.Get(request::key::kEnabled).AsBool()) {
+      Tracer::Disable();
+      return;
+    }
+
+    int capacity = Tracer::kDefaultCapacity;
+    if (var_dict.Get(request::key::kCapacity).is_int() &&
+        var_dict.Get(request::key::kCapacity).AsInt() > 0) {
+      capacity = var_dict.Get(request::key::kCapacity).AsInt();
+    }
+    Tracer::Enable(capacity);
+  }
+
+  // Requests libarchive to create an archive object for the given
+  // compressor_id, or to append to an existing zip archive if append is true.
+  void CreateArchive(const pp::VarDictionary& var_dict,
+                     int compressor_id,
+                     bool append) {
     Compressor* compressor =
-        new Compressor(instance_handle_, compressor_id, &message_sender_);
+        new Compressor(&worker_pool_, compressor_id, &message_sender_);
     if (!compressor->Init()) {
       std::stringstream ss;
       ss << compressor_id;
@@ -419,7 +736,10 @@ class NaclArchiveInstance : public pp::Instance {
     }
     compressors_[compressor_id] = compressor;
 
-    compressor->CreateArchive();
+    if (append)
+      compressor->AppendToArchive(var_dict);
+    else
+      compressor->CreateArchive(var_dict);
   }
 
   void AddToArchive(const pp::VarDictionary& var_dict,
@@ -430,6 +750,14 @@ class NaclArchiveInstance : public pp::Instance {
     iterator->second->AddToArchive(var_dict);
   }
 
+  void AddEntriesToArchive(const pp::VarDictionary& var_dict,
+                           int compressor_id) {
+    compressor_iterator iterator = compressors_.find(compressor_id);
+    PP_DCHECK(iterator != compressors_.end());
+
+    iterator->second->AddEntriesToArchive(var_dict);
+  }
+
   void ReadFileChunkDone(const pp::VarDictionary& var_dict,
                          const int compressor_id) {
     compressor_iterator iterator = compressors_.find(compressor_id);
@@ -438,6 +766,14 @@ class NaclArchiveInstance : public pp::Instance {
     iterator->second->ReadFileChunkDone(var_dict);
   }
 
+  void ReadArchiveChunkDone(const pp::VarDictionary& var_dict,
+                            const int compressor_id) {
+    compressor_iterator iterator = compressors_.find(compressor_id);
+    PP_DCHECK(iterator != compressors_.end());
+
+    iterator->second->ReadArchiveChunkDone(var_dict);
+  }
+
   void WriteChunkDone(const pp::VarDictionary& var_dict,
                       int compressor_id) {
     compressor_iterator iterator = compressors_.find(compressor_id);
@@ -454,16 +790,21 @@ class NaclArchiveInstance : public pp::Instance {
       iterator->second->CloseArchive(var_dict);
   }
 
+  // The workers shared by all the volumes and compressors. Declared before
+  // them, so it is destroyed after them.
+  WorkerPool worker_pool_;
+
   // A map that holds for every opened archive its instance. The key is the file
   // system id of the archive.
   std::map<std::string, Volume*> volumes_;
 
+  // The file system ids of the volumes containing the archives of nested
+  // volumes, by the file system id of the nested volume.
+  std::map<std::string, std::string> outer_file_system_ids_;
+
   // A map from compressor ids to compressors.
   std::map<int, Compressor*> compressors_;
 
-  // An pp::InstanceHandle used to create pp::SimpleThread in Volume.
-  pp::InstanceHandle instance_handle_;
-
   // An object used to send messages to JavaScript.
   JavaScriptMessageSender message_sender_;
 };
@@ -0,0 +1,176 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "pattern_matcher.h"
+
+#include <cstddef>
+#include <cstring>
+#include <queue>
+
+namespace {
+
+// 16 bytes of data. The generic vector extensions of the compiler are
+// portable, and PNaCl translates them to the SIMD instructions of the target.
+typedef int8_t ByteVector __attribute__((vector_size(16)));
+
+// Returns true if a byte of vector is not zero.
+bool AnyByte(ByteVector vector) {
+  uint64_t halves[2];
+  memcpy(halves, &vector, sizeof(halves));
+  return (halves[0] | halves[1]) != 0;
+}
+
+}  // namespace
+
+const PatternMatcher::State PatternMatcher::kRootState;
+const size_t PatternMatcher::kMaximumVectorFirstBytes;
+
+PatternMatcher::PatternMatcher(const std::vector<std::string>& patterns)
+    : first_byte_(-1), state_(kRootState), stream_offset_(0) {
+  memset(starts_pattern_, 0, sizeof(starts_pattern_));
+
+  // Build the trie of the patterns. Missing transitions are -1 until the
+  // failure links are computed.
+  transitions_.assign(256, -1);
+  outputs_.resize(1);
+  int first_byte_count = 0;
+  for (size_t i = 0; i < patterns.size(); ++i) {
+    const std::string& pattern = patterns[i];
+    pattern_lengths_.push_back(pattern.size());
+    if (pattern.empty())
+      continue;
+
+    State state = kRootState;
+    for (size_t j = 0; j < pattern.size(); ++j) {
+      unsigned char byte = pattern[j];
+      if (transition(state, byte) == -1) {
+        transition(state, byte) = outputs_.size();
+        transitions_.resize(transitions_.size() + 256, -1);
+        outputs_.resize(outputs_.size() + 1);
+      }
+      state = transition(state, byte);
+    }
+    outputs_[state].push_back(i);
+
+    unsigned char first_byte = pattern[0];
+    if (!starts_pattern_[first_byte]) {
+      starts_pattern_[first_byte] = true;
+      first_byte_ = first_byte;
+      first_bytes_.push_back(first_byte);
+      ++first_byte_count;
+    }
+  }
+  if (first_byte_count != 1)
+    first_byte_ = -1;
+  if (first_bytes_.size() < 2 ||
+      first_bytes_.size() > kMaximumVectorFirstBytes) {
+    first_bytes_.clear();
+  }
+
+  // Turn the trie into an automaton, visiting the states breadth first so the
+  // failure state of every state is complete before the state is visited.
+  std::vector<State> failures(outputs_.size(), kRootState);
+  std::queue<State> states;
+  for (int byte = 0; byte < 256; ++byte) {
+    State next = transition(kRootState, byte);
+    if (next == -1) {
+      transition(kRootState, byte) = kRootState;
+    } else {
+      states.push(next);
+    }
+  }
+
+  while (!states.empty()) {
+    State state = states.front();
+    states.pop();
+    State failure = failures[state];
+    outputs_[state].insert(outputs_[state].end(), outputs_[failure].begin(),
+                           outputs_[failure].end());
+
+    for (int byte = 0; byte < 256; ++byte) {
+      State next = transition(state, byte);
+      if (next == -1) {
+        transition(state, byte) = transition(failure, byte);
+      } else {
+        failures[next] = transition(failure, byte);
+        states.push(next);
+      }
+    }
+  }
+}
+
+void PatternMatcher::Reset() {
+  state_ = kRootState;
+  stream_offset_ = 0;
+}
+
+const unsigned char* PatternMatcher::SkipToFirstBytes(
+    const unsigned char* position,
+    const unsigned char* end) const {
+  ByteVector first_bytes[kMaximumVectorFirstBytes];
+  for (size_t i = 0; i < first_bytes_.size(); ++i)
+    memset(&first_bytes[i], first_bytes_[i], sizeof(ByteVector));
+
+  while (end - position >= static_cast<ptrdiff_t>(sizeof(ByteVector))) {
+    ByteVector bytes;
+    memcpy(&bytes, position, sizeof(bytes));
+    ByteVector found = bytes == first_bytes[0];
+    for (size_t i = 1; i < first_bytes_.size(); ++i)
+      found |= bytes == first_bytes[i];
+    if (AnyByte(found))
+      break;
+    position += sizeof(bytes);
+  }
+
+  // Find the byte within the 16 bytes, or in the last bytes of the data.
+  while (position < end && !starts_pattern_[*position])
+    ++position;
+  return position;
+}
+
+void PatternMatcher::Find(const char* data,
+                          int64_t length,
+                          std::vector<Match>* matches) {
+  const unsigned char* begin = reinterpret_cast<const unsigned char*>(data);
+  const unsigned char* end = begin + length;
+  const unsigned char* position = begin;
+  State state = state_;
+
+  while (position < end) {
+    // No pattern is partially matched, so skip to the next byte that starts
+    // one. memchr is vectorized by the C library.
+    if (state == kRootState) {
+      if (first_byte_ != -1) {
+        position = static_cast<const unsigned char*>(
+            memchr(position, first_byte_, end - position));
+        if (!position)
+          break;
+      } else if (!first_bytes_.empty()) {
+        position = SkipToFirstBytes(position, end);
+        if (position == end)
+          break;
+      } else {
+        while (position < end && !starts_pattern_[*position])
+          ++position;
+        if (position == end)
+          break;
+      }
+    }
+
+    state = transition(state, *position);
+    ++position;
+
+    const std::vector<size_t>& outputs = outputs_[state];
+    for (size_t i = 0; i < outputs.size(); ++i) {
+      Match match;
+      match.pattern = outputs[i];
+      match.offset = stream_offset_ + (position - begin) -
+                     static_cast<int64_t>(pattern_lengths_[outputs[i]]);
+      matches->push_back(match);
+    }
+  }
+
+  state_ = state;
+  stream_offset_ += length;
+}
@@ -0,0 +1,89 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef PATTERN_MATCHER_H_
+#define PATTERN_MATCHER_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Finds all the occurrences of several literal patterns in a stream of data,
+// in a single pass. The patterns are compiled into an Aho-Corasick automaton
+// with a transition per state and byte, so every byte of the data costs one
+// table lookup whatever the number of patterns. Bytes that can't start a
+// pattern are skipped while no pattern is partially matched: with memchr if
+// the patterns start with the same byte, 16 bytes at a time with vector
+// compares if they start with a few different bytes, or with a lookup table
+// otherwise.
+//
+// The stream can be passed in chunks of any size, as matches spanning chunks
+// are found too. Matching is case sensitive.
+class PatternMatcher {
+ public:
+  // An occurrence of a pattern.
+  struct Match {
+    size_t pattern;  // The index of the pattern.
+    int64_t offset;  // The offset in the stream where the occurrence starts.
+  };
+
+  // Empty patterns are never matched.
+  explicit PatternMatcher(const std::vector<std::string>& patterns);
+
+  // Forgets the data passed so far, so a new stream can be searched.
+  void Reset();
+
+  // Searches the next length bytes of the stream. The matches ending in data
+  // are appended to matches, ordered by their end. Overlapping matches are all
+  // reported.
+  void Find(const char* data, int64_t length, std::vector<Match>* matches);
+
+  // The number of bytes passed to Find since the last Reset.
+  int64_t stream_offset() const { return stream_offset_; }
+
+ private:
+  typedef int32_t State;
+
+  static const State kRootState = 0;
+
+  // The maximum number of different bytes starting the patterns for which the
+  // bytes that can't start a pattern are skipped with vector compares. Above
+  // it, the lookup table is faster.
+  static const size_t kMaximumVectorFirstBytes = 8;
+
+  // Returns the first position from position to end holding a byte that
+  // starts a pattern, or end if there is none. Compares 16 bytes at a time
+  // with every byte of first_bytes_.
+  const unsigned char* SkipToFirstBytes(const unsigned char* position,
+                                        const unsigned char* end) const;
+
+  // Returns a reference to the transition from state with byte.
+  State& transition(State state, unsigned char byte) {
+    return transitions_[state * 256 + byte];
+  }
+
+  // The length of every pattern.
+  std::vector<size_t> pattern_lengths_;
+
+  // The transitions of the automaton, 256 per state.
+  std::vector<State> transitions_;
+
+  // The patterns matched when reaching a state, by state.
+  std::vector<std::vector<size_t> > outputs_;
+
+  // Whether a byte starts a pattern.
+  bool starts_pattern_[256];
+
+  // The only byte starting the patterns, or -1 if there are several.
+  int first_byte_;
+
+  // The bytes starting the patterns if there are several, but at most
+  // kMaximumVectorFirstBytes of them. Empty otherwise.
+  std::vector<unsigned char> first_bytes_;
+
+  State state_;            // The state after the data passed so far.
+  int64_t stream_offset_;  // See stream_offset().
+};
+
+#endif  // PATTERN_MATCHER_H_
@@ -23,10 +23,16 @@ pp::VarDictionary CreateBasicRequest(const int operation,
 
 // Return true if the given operation is related to packing.
 bool request::IsPackRequest(int operation) {
-  return request::MINIMUM_PACK_REQUEST_VALUE <= operation ||
+  return (request::MINIMUM_PACK_REQUEST_VALUE <= operation &&
+          operation <= request::MAXIMUM_PACK_REQUEST_VALUE) ||
          operation == request::COMPRESSOR_ERROR;
 }
 
+// Return true if the given operation is related to the whole module.
+bool request::IsModuleRequest(int operation) {
+  return operation >= request::MINIMUM_MODULE_REQUEST_VALUE;
+}
+
 pp::VarDictionary request::CreateReadMetadataDoneResponse(
     const std::string& file_system_id,
     const std::string& request_id,
@@ -40,10 +46,12 @@ pp::VarDictionary request::CreateReadMetadataDoneResponse(
 pp::VarDictionary request::CreateReadChunkRequest(
     const std::string& file_system_id,
     const std::string& request_id,
+    int part_index,
     int64_t offset,
     int64_t length) {
   pp::VarDictionary request =
       CreateBasicRequest(READ_CHUNK, file_system_id, request_id);
+  request.Set(request::key::kPartIndex, part_index);
 
   std::stringstream ss_offset;
   ss_offset << offset;
@@ -91,6 +99,78 @@ pp::VarDictionary request::CreateReadFileDoneResponse(
   return response;
 }
 
+pp::VarDictionary request::CreateReadFilesDoneResponse(
+    const std::string& file_system_id,
+    const std::string& request_id,
+    int64_t index,
+    const pp::VarArrayBuffer& array_buffer,
+    bool has_more_data) {
+  pp::VarDictionary response =
+      CreateBasicRequest(READ_FILES_DONE, file_system_id, request_id);
+
+  std::stringstream ss_index;
+  ss_index << index;
+  response.Set(request::key::kIndex, ss_index.str());
+
+  response.Set(request::key::kReadFileData, array_buffer);
+  response.Set(request::key::kHasMoreData, has_more_data);
+  return response;
+}
+
+pp::VarDictionary request::CreateSearchDoneResponse(
+    const std::string& file_system_id,
+    const std::string& request_id,
+    const pp::VarArray& hits,
+    bool has_more_data) {
+  pp::VarDictionary response =
+      CreateBasicRequest(SEARCH_DONE, file_system_id, request_id);
+  response.Set(request::key::kHits, hits);
+  response.Set(request::key::kHasMoreData, has_more_data);
+  return response;
+}
+
+pp::VarDictionary request::CreateHashEntriesDoneResponse(
+    const std::string& file_system_id,
+    const std::string& request_id,
+    const pp::VarArray& digests,
+    bool has_more_data) {
+  pp::VarDictionary response =
+      CreateBasicRequest(HASH_ENTRIES_DONE, file_system_id, request_id);
+  response.Set(request::key::kDigests, digests);
+  response.Set(request::key::kHasMoreData, has_more_data);
+  return response;
+}
+
+pp::VarDictionary request::CreateStatPathDoneResponse(
+    const std::string& file_system_id,
+    const std::string& request_id,
+    const pp::VarDictionary& metadata) {
+  pp::VarDictionary response =
+      CreateBasicRequest(STAT_PATH_DONE, file_system_id, request_id);
+  response.Set(request::key::kMetadata, metadata);
+  return response;
+}
+
+pp::VarDictionary request::CreateGetStatsDoneResponse(
+    const std::string& request_id,
+    const pp::VarDictionary& stats) {
+  pp::VarDictionary response;
+  response.Set(request::key::kOperation, GET_STATS_DONE);
+  response.Set(request::key::kRequestId, request_id);
+  response.Set(request::key::kStats, stats);
+  return response;
+}
+
+pp::VarDictionary request::CreateGetTraceDoneResponse(
+    const std::string& request_id,
+    const std::string& trace) {
+  pp::VarDictionary response;
+  response.Set(request::key::kOperation, GET_TRACE_DONE);
+  response.Set(request::key::kRequestId, request_id);
+  response.Set(request::key::kTrace, trace);
+  return response;
+}
+
 pp::VarDictionary request::CreateCreateArchiveDoneResponse(
     const int compressor_id) {
   pp::VarDictionary request;
@@ -101,11 +181,16 @@ pp::VarDictionary request::CreateCreateArchiveDoneResponse(
 
 pp::VarDictionary request::CreateReadFileChunkRequest(
     const int compressor_id,
+    const int64_t offset,
     const int64_t length) {
   pp::VarDictionary request;
   request.Set(request::key::kOperation, READ_FILE_CHUNK);
   request.Set(request::key::kCompressorId, compressor_id);
 
+  std::stringstream ss_offset;
+  ss_offset << offset;
+  request.Set(request::key::kOffset, ss_offset.str());
+
   std::stringstream ss_length;
   ss_length << length;
   request.Set(request::key::kLength, ss_length.str());
@@ -115,7 +200,8 @@ pp::VarDictionary request::CreateReadFileChunkRequest(
 pp::VarDictionary request::CreateWriteChunkRequest(
     int compressor_id,
     const pp::VarArrayBuffer& array_buffer,
-    int64_t length) {
+    int64_t length,
+    int64_t offset) {
   pp::VarDictionary request;
   request.Set(request::key::kOperation, WRITE_CHUNK);
   request.Set(request::key::kCompressorId, compressor_id);
@@ -124,6 +210,39 @@ pp::VarDictionary request::CreateWriteChunkRequest(
   std::stringstream ss_length;
   ss_length << length;
   request.Set(request::key::kLength, ss_length.str());
+
+  // The chunks without offset are written after the previous one.
+  if (offset >= 0) {
+    std::stringstream ss_offset;
+    ss_offset << offset;
+    request.Set(request::key::kOffset, ss_offset.str());
+  }
+  return request;
+}
+
+pp::VarDictionary request::CreateReadArchiveChunkRequest(
+    int compressor_id,
+    int64_t offset,
+    int64_t length) {
+  pp::VarDictionary request;
+  request.Set(request::key::kOperation, READ_ARCHIVE_CHUNK);
+  request.Set(request::key::kCompressorId, compressor_id);
+
+  std::stringstream ss_offset;
+  ss_offset << offset;
+  request.Set(request::key::kOffset, ss_offset.str());
+
+  std::stringstream ss_length;
+  ss_length << length;
+  request.Set(request::key::kLength, ss_length.str());
+  return request;
+}
+
+pp::VarDictionary request::CreateAppendToArchiveDoneResponse(
+    int compressor_id) {
+  pp::VarDictionary request;
+  request.Set(request::key::kOperation, APPEND_TO_ARCHIVE_DONE);
+  request.Set(request::key::kCompressorId, compressor_id);
   return request;
 }
 
@@ -134,6 +253,14 @@ pp::VarDictionary request::CreateAddToArchiveDoneResponse(int compressor_id) {
   return request;
 }
 
+pp::VarDictionary request::CreateAddEntriesToArchiveDoneResponse(
+    int compressor_id) {
+  pp::VarDictionary request;
+  request.Set(request::key::kOperation, ADD_ENTRIES_TO_ARCHIVE_DONE);
+  request.Set(request::key::kCompressorId, compressor_id);
+  return request;
+}
+
 pp::VarDictionary request::CreateCloseArchiveDoneResponse(int compressor_id) {
   pp::VarDictionary request;
   request.Set(request::key::kOperation, CLOSE_ARCHIVE_DONE);
@@ -184,3 +311,17 @@ int64_t request::GetInt64FromString(const pp::VarDictionary& dictionary,
   ss_int64 >> int64_value;
   return int64_value;
 }
+
+std::vector<int64_t> request::GetInt64ArrayFromStrings(
+    const pp::VarDictionary& dictionary,
+    const std::string& request_key) {
+  pp::VarArray array(dictionary.Get(request_key));
+  std::vector<int64_t> values;
+  for (uint32_t i = 0; i < array.GetLength(); ++i) {
+    std::stringstream ss_int64(array.Get(i).AsString());
+    int64_t int64_value;
+    ss_int64 >> int64_value;
+    values.push_back(int64_value);
+  }
+  return values;
+}
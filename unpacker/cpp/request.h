@@ -5,6 +5,9 @@
 #ifndef REQUEST_H_
 #define REQUEST_H_
 
+#include <vector>
+
+#include "ppapi/cpp/var_array.h"
 #include "ppapi/cpp/var_array_buffer.h"
 #include "ppapi/cpp/var_dictionary.h"
 
@@ -34,6 +37,42 @@ const char kReadFileData[] = "read_file_data";    // Should be a
                                                   // pp::VarArrayBuffer.
 const char kHasMoreData[] = "has_more_data";      // Should be a bool.
 const char kPassphrase[] = "passphrase";          // Should be a string.
+const char kPath[] = "path";                      // Should be a string.
+const char kFiles[] = "files";  // Should be a pp::VarArray of
+                                // pp::VarDictionary, each with kIndex and
+                                // kLength (the maximum bytes to read).
+const char kOuterFileSystemId[] =
+    "outer_file_system_id";  // Should be a string.
+const char kOuterRequestId[] = "outer_request_id";  // Should be a string.
+const char kPartSizes[] = "part_sizes";  // Should be a pp::VarArray of strings,
+                                         // as int64_t is not supported by
+                                         // pp::Var.
+const char kPartIndex[] = "part_index";  // Should be an int.
+const char kPatterns[] = "patterns";  // Should be a pp::VarArray of strings.
+const char kMaxHits[] = "max_hits";  // Should be a string as int64_t is not
+                                     // supported by pp::Var.
+const char kHits[] = "hits";  // Should be a pp::VarArray of pp::VarDictionary,
+                              // each with kIndex, kOffset and kPatternIndex.
+const char kPatternIndex[] = "pattern_index";  // Should be an int.
+const char kIndexes[] = "indexes";  // Should be a pp::VarArray of strings, as
+                                   // int64_t is not supported by pp::Var.
+const char kAlgorithm[] = "algorithm";  // Should be a string.
+const char kDigests[] = "digests";  // Should be a pp::VarArray of
+                                    // pp::VarDictionary, each with kIndex and
+                                    // kDigest.
+const char kDigest[] = "digest";  // Should be a string.
+
+// Optional keys unique to module operations.
+const char kStats[] = "stats";  // Should be a pp::VarDictionary with
+                                // kVolumes and kCompressors.
+const char kVolumes[] = "volumes";  // Should be a pp::VarDictionary of stats
+                                    // by file system id.
+const char kCompressors[] = "compressors";  // Should be a pp::VarDictionary of
+                                            // stats by compressor id.
+const char kEnabled[] = "enabled";    // Should be a bool.
+const char kCapacity[] = "capacity";  // Should be an int.
+const char kTrace[] = "trace";  // Should be a string with the JSON of Chrome
+                                // trace events.
 
 // Mandatory keys for all packing requests.
 const char kCompressorId[] = "compressor_id";         // Should be an int.
@@ -46,6 +85,17 @@ const char kIsDirectory[] = "is_directory";           // Should be a bool.
 const char kModificationTime[] = "modification_time"; // Should be a string
                                                       // (mm/dd/yy h:m:s).
 const char kHasError[] = "has_error";                 // Should be a bool.
+const char kReadAheadDepth[] = "read_ahead_depth";    // Should be an int.
+const char kWriteBehindDepth[] = "write_behind_depth";  // Should be an int.
+const char kParallel[] = "parallel";                  // Should be a bool.
+const char kFormat[] = "format";  // Should be a request::format value.
+const char kCompressionLevel[] = "compression_level";  // Should be an int.
+const char kThreadCount[] = "thread_count";           // Should be an int.
+const char kDeduplicate[] = "deduplicate";            // Should be a bool.
+const char kEntries[] = "entries";  // Should be a pp::VarArray of
+                                    // pp::VarDictionary, each with kPathname,
+                                    // kFileSize, kIsDirectory and
+                                    // kModificationTime.
 
 // Optional keys used for both packing and unpacking operations.
 const char kError[] = "error";        // Should be a string.
@@ -60,6 +110,16 @@ const char kSrcFunc[] = "src_func";               // Should be a string.
 const char kMessage[] = "message";                // Should be a string.
 }  // namespace key
 
+// Defines the archive formats of key::kFormat, with their compression. These
+// should be the same as the formats on the JavaScript side.
+namespace format {
+const char kZipDeflate[] = "zip-deflate";
+const char kZipStore[] = "zip-store";
+const char kTar[] = "tar";
+const char kTarGzip[] = "tar.gz";
+const char kTarXz[] = "tar.xz";
+}  // namespace format
+
 // Defines request operations. These operations should be the same as the
 // operations on the JavaScript side.
 enum Operation {
@@ -90,25 +150,57 @@ enum Operation {
   WRITE_CHUNK_DONE = 24,
   CLOSE_ARCHIVE = 25,
   CLOSE_ARCHIVE_DONE = 26,
+  ADD_ENTRIES_TO_ARCHIVE = 27,
+  ADD_ENTRIES_TO_ARCHIVE_DONE = 28,
+  APPEND_TO_ARCHIVE = 29,
+  APPEND_TO_ARCHIVE_DONE = 30,
+  READ_ARCHIVE_CHUNK = 31,
+  READ_ARCHIVE_CHUNK_DONE = 32,
+  OPEN_FILE_BY_PATH = 100,
+  STAT_PATH = 101,
+  STAT_PATH_DONE = 102,
+  READ_FILES = 103,
+  READ_FILES_DONE = 104,
+  SEARCH = 105,
+  SEARCH_DONE = 106,
+  HASH_ENTRIES = 107,
+  HASH_ENTRIES_DONE = 108,
+  GET_STATS = 200,
+  GET_STATS_DONE = 201,
+  SET_TRACING = 202,
+  GET_TRACE = 203,
+  GET_TRACE_DONE = 204,
   FILE_SYSTEM_ERROR = -1,  // Errors specific to a file system.
   COMPRESSOR_ERROR = -2    // Errors specific to a compressor.
 };
 
-// Operations greater than or equal to this value are for packing.
+// Operations between these values, inclusive, are for packing. Unpacking
+// operations added later start after MAXIMUM_PACK_REQUEST_VALUE.
 const int MINIMUM_PACK_REQUEST_VALUE = 17;
+const int MAXIMUM_PACK_REQUEST_VALUE = 99;
+
+// Operations starting from this value are not related to a volume or a
+// compressor, but to the whole module. They have only kRequestId.
+const int MINIMUM_MODULE_REQUEST_VALUE = 200;
 
 // Return true if the given operation is related to packing.
 bool IsPackRequest(int operation);
 
+// Return true if the given operation is related to the whole module.
+bool IsModuleRequest(int operation);
+
 // Creates a response to READ_METADATA request.
 pp::VarDictionary CreateReadMetadataDoneResponse(
     const std::string& file_system_id,
     const std::string& request_id,
     const pp::VarDictionary& metadata);
 
-// Creates a request for a file chunk from JavaScript.
+// Creates a request for a file chunk from JavaScript. part_index is the index
+// of the part for split archives, and 0 otherwise. offset is relative to the
+// beginning of the part.
 pp::VarDictionary CreateReadChunkRequest(const std::string& file_system_id,
                                          const std::string& request_id,
+                                         int part_index,
                                          int64_t offset,
                                          int64_t length);
 
@@ -133,17 +225,74 @@ pp::VarDictionary CreateReadFileDoneResponse(
     const pp::VarArrayBuffer& array_buffer,
     bool has_more_data);
 
+// Creates a response to READ_FILES request with a chunk of the file with the
+// given index. has_more_data is false only for the last response.
+pp::VarDictionary CreateReadFilesDoneResponse(
+    const std::string& file_system_id,
+    const std::string& request_id,
+    int64_t index,
+    const pp::VarArrayBuffer& array_buffer,
+    bool has_more_data);
+
+// Creates a response to SEARCH request with the hits found since the previous
+// response. has_more_data is false only for the last response.
+pp::VarDictionary CreateSearchDoneResponse(const std::string& file_system_id,
+                                           const std::string& request_id,
+                                           const pp::VarArray& hits,
+                                           bool has_more_data);
+
+// Creates a response to HASH_ENTRIES request with the digests computed since
+// the previous response. has_more_data is false only for the last response.
+pp::VarDictionary CreateHashEntriesDoneResponse(
+    const std::string& file_system_id,
+    const std::string& request_id,
+    const pp::VarArray& digests,
+    bool has_more_data);
+
+// Creates a response to STAT_PATH request.
+pp::VarDictionary CreateStatPathDoneResponse(const std::string& file_system_id,
+                                             const std::string& request_id,
+                                             const pp::VarDictionary& metadata);
+
+// Creates a response to GET_STATS request. stats should contain kVolumes and
+// kCompressors.
+pp::VarDictionary CreateGetStatsDoneResponse(const std::string& request_id,
+                                             const pp::VarDictionary& stats);
+
+// Creates a response to GET_TRACE request. trace is the JSON of the recorded
+// Chrome trace events.
+pp::VarDictionary CreateGetTraceDoneResponse(const std::string& request_id,
+                                             const std::string& trace);
+
 pp::VarDictionary CreateCreateArchiveDoneResponse(int compressor_id);
 
+// Creates a request for length bytes at offset of the entry that is being
+// added to the archive.
 pp::VarDictionary CreateReadFileChunkRequest(int compressor_id,
+                                             int64_t offset,
                                              int64_t length);
 
+// Creates a request to write length bytes of array_buffer at offset of the
+// archive, or after the last chunk if offset is negative.
 pp::VarDictionary CreateWriteChunkRequest(int compressor_id,
                                           const pp::VarArrayBuffer& array_buffer,
-                                          int64_t length);
+                                          int64_t length,
+                                          int64_t offset);
+
+// Creates a request for length bytes at offset of the archive being appended
+// to.
+pp::VarDictionary CreateReadArchiveChunkRequest(int compressor_id,
+                                                int64_t offset,
+                                                int64_t length);
+
+pp::VarDictionary CreateAppendToArchiveDoneResponse(int compressor_id);
 
 pp::VarDictionary CreateAddToArchiveDoneResponse(int compressor_id);
 
+// Creates a response to ADD_ENTRIES_TO_ARCHIVE, sent once all the entries of
+// the batch are added.
+pp::VarDictionary CreateAddEntriesToArchiveDoneResponse(int compressor_id);
+
 pp::VarDictionary CreateCloseArchiveDoneResponse(int compressor_id);
 
 // Creates a file system error.
@@ -168,6 +317,12 @@ pp::VarDictionary CreateCompressorError(int compressor_id,
 int64_t GetInt64FromString(const pp::VarDictionary& dictionary,
                            const std::string& request_key);
 
+// Obtains int64_t values from an array of strings inside dictionary based on
+// a request::Key.
+std::vector<int64_t> GetInt64ArrayFromStrings(
+    const pp::VarDictionary& dictionary,
+    const std::string& request_key);
+
 }  // namespace request
 
 #endif  // REQUEST_H_
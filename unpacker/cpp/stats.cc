@@ -0,0 +1,151 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "stats.h"
+
+#include <cstring>
+#include <sstream>
+#include <time.h>
+
+#include "ppapi/cpp/logging.h"
+#include "ppapi/cpp/var_array.h"
+
+namespace {
+
+// The names of the counters and histograms reported to JavaScript, in the
+// order of Stats::Counter and Stats::Histogram.
+const char* const kCounterNames[] = {
+    "read_chunk_requests",
+    "bytes_fetched",
+    "discarded_chunks",
+    "bytes_decompressed",
+    "bytes_skipped",
+    "bytes_from_reorder_buffer",
+    "archive_reinitializations",
+    "headers_skipped",
+    "read_file_requests",
+    "read_file_batches",
+    "merged_read_requests",
+    "entries_added",
+    "bytes_read",
+    "bytes_written",
+    "entry_batches",
+    "entries_stored",
+    "bytes_stored",
+    "entries_deduplicated",
+    "bytes_deduplicated"};
+
+const char* const kHistogramNames[] = {
+    "read_chunk_wait_us",
+    "decompress_data_us",
+    "add_to_archive_us",
+    "write_chunk_wait_us"};
+
+// Reads value atomically, as 64 bit loads are not atomic on all the
+// architectures NaCl runs on.
+int64_t AtomicLoad(const int64_t* value) {
+  return __sync_fetch_and_add(const_cast<int64_t*>(value), 0);
+}
+
+std::string Int64ToString(int64_t value) {
+  std::stringstream ss;
+  ss << value;
+  return ss.str();
+}
+
+}  // namespace
+
+const int Stats::kHistogramBucketCount;
+
+Stats::ScopedTimer::ScopedTimer(Stats* stats, Histogram histogram)
+    : stats_(stats),
+      histogram_(histogram),
+      start_us_(stats ? NowInMicroseconds() : 0) {}
+
+Stats::ScopedTimer::~ScopedTimer() {
+  if (stats_)
+    stats_->Record(histogram_, NowInMicroseconds() - start_us_);
+}
+
+Stats::Stats() {
+  PP_DCHECK(sizeof(kCounterNames) / sizeof(kCounterNames[0]) ==
+            COUNTER_COUNT);
+  PP_DCHECK(sizeof(kHistogramNames) / sizeof(kHistogramNames[0]) ==
+            HISTOGRAM_COUNT);
+  memset(counters_, 0, sizeof(counters_));
+  memset(histogram_counts_, 0, sizeof(histogram_counts_));
+  memset(histogram_sums_, 0, sizeof(histogram_sums_));
+  memset(histogram_buckets_, 0, sizeof(histogram_buckets_));
+}
+
+void Stats::Add(Counter counter, int64_t value) {
+  __sync_fetch_and_add(&counters_[counter], value);
+}
+
+void Stats::Record(Histogram histogram, int64_t value) {
+  __sync_fetch_and_add(&histogram_counts_[histogram], 1);
+  __sync_fetch_and_add(&histogram_sums_[histogram], value);
+  __sync_fetch_and_add(&histogram_buckets_[histogram][BucketOf(value)], 1);
+}
+
+int64_t Stats::Get(Counter counter) const {
+  return AtomicLoad(&counters_[counter]);
+}
+
+int64_t Stats::GetCount(Histogram histogram) const {
+  return AtomicLoad(&histogram_counts_[histogram]);
+}
+
+int64_t Stats::GetSum(Histogram histogram) const {
+  return AtomicLoad(&histogram_sums_[histogram]);
+}
+
+int64_t Stats::GetBucket(Histogram histogram, int bucket) const {
+  PP_DCHECK(0 <= bucket && bucket < kHistogramBucketCount);
+  return AtomicLoad(&histogram_buckets_[histogram][bucket]);
+}
+
+pp::VarDictionary Stats::ToVarDictionary() const {
+  pp::VarDictionary dictionary;
+  for (int i = 0; i < COUNTER_COUNT; ++i) {
+    int64_t value = Get(static_cast<Counter>(i));
+    if (value != 0)
+      dictionary.Set(kCounterNames[i], Int64ToString(value));
+  }
+
+  for (int i = 0; i < HISTOGRAM_COUNT; ++i) {
+    Histogram histogram = static_cast<Histogram>(i);
+    int64_t count = GetCount(histogram);
+    if (count == 0)
+      continue;
+
+    int last_bucket = kHistogramBucketCount - 1;
+    while (last_bucket > 0 && GetBucket(histogram, last_bucket) == 0)
+      --last_bucket;
+    pp::VarArray buckets;
+    for (int bucket = 0; bucket <= last_bucket; ++bucket)
+      buckets.Set(bucket, Int64ToString(GetBucket(histogram, bucket)));
+
+    pp::VarDictionary histogram_dictionary;
+    histogram_dictionary.Set("count", Int64ToString(count));
+    histogram_dictionary.Set("sum", Int64ToString(GetSum(histogram)));
+    histogram_dictionary.Set("buckets", buckets);
+    dictionary.Set(kHistogramNames[i], histogram_dictionary);
+  }
+  return dictionary;
+}
+
+int Stats::BucketOf(int64_t value) {
+  if (value < 1)
+    return 0;
+  // The number of significant bits of value.
+  int bucket = 64 - __builtin_clzll(static_cast<uint64_t>(value));
+  return bucket < kHistogramBucketCount ? bucket : kHistogramBucketCount - 1;
+}
+
+int64_t Stats::NowInMicroseconds() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
@@ -0,0 +1,116 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef STATS_H_
+#define STATS_H_
+
+#include <stdint.h>
+
+#include "ppapi/cpp/var_dictionary.h"
+
+// Counters and histograms about the work done for a volume or a compressor,
+// reported to JavaScript with GET_STATS. They are updated with atomic
+// operations, so any thread can update them without taking a lock. Every
+// value is read atomically, but the values are not a snapshot taken at the
+// same moment.
+class Stats {
+ public:
+  enum Counter {
+    // VolumeReaderJavaScriptStream.
+    READ_CHUNK_REQUESTS = 0,  // READ_CHUNK requests sent to JavaScript.
+    BYTES_FETCHED,            // Bytes received with READ_CHUNK_DONE.
+    DISCARDED_CHUNKS,         // Chunks received for an obsolete offset.
+
+    // VolumeArchiveLibarchive.
+    BYTES_DECOMPRESSED,      // All the bytes returned by libarchive.
+    BYTES_SKIPPED,           // Bytes decompressed into the dummy buffer.
+    BYTES_FROM_REORDER_BUFFER,  // Bytes read from the reorder buffer.
+
+    // Volume.
+    ARCHIVE_REINITIALIZATIONS,  // Archives opened again to seek backwards.
+    HEADERS_SKIPPED,            // Headers read to reach an entry.
+    READ_FILE_REQUESTS,         // All the served READ_FILE requests.
+    READ_FILE_BATCHES,          // Decompression passes serving them.
+    MERGED_READ_REQUESTS,       // Requests served by the pass of another.
+
+    // Compressor.
+    ENTRIES_ADDED,  // Entries added, alone or in batches.
+    BYTES_READ,     // Bytes received with READ_FILE_CHUNK_DONE or batches.
+    BYTES_WRITTEN,  // Bytes written with WRITE_CHUNK.
+    ENTRY_BATCHES,  // ADD_ENTRIES_TO_ARCHIVE requests.
+
+    // CompressorArchive.
+    ENTRIES_STORED,  // Entries stored as they looked incompressible.
+    BYTES_STORED,    // The size of those entries.
+    ENTRIES_DEDUPLICATED,  // Files written as hard links to identical ones.
+    BYTES_DEDUPLICATED,    // The size of those files.
+
+    COUNTER_COUNT
+  };
+
+  enum Histogram {
+    READ_CHUNK_WAIT_US = 0,  // Time Read waited for chunks from JavaScript.
+    DECOMPRESS_DATA_US,      // Time spent in DecompressData.
+    ADD_TO_ARCHIVE_US,       // Time spent adding an entry to an archive.
+    WRITE_CHUNK_WAIT_US,     // Time Write waited for JavaScript to write.
+
+    HISTOGRAM_COUNT
+  };
+
+  // The bucket 0 counts the values smaller than 1, and the bucket i the values
+  // in [2^(i-1), 2^i). The last bucket counts all the bigger values too.
+  static const int kHistogramBucketCount = 40;
+
+  // Measures the time from its construction to its destruction and records
+  // it in a histogram, in microseconds. Does nothing if stats is NULL.
+  class ScopedTimer {
+   public:
+    // ScopedTimer does not own the stats pointer.
+    ScopedTimer(Stats* stats, Histogram histogram);
+    ~ScopedTimer();
+
+   private:
+    Stats* stats_;
+    const Histogram histogram_;
+    const int64_t start_us_;
+  };
+
+  Stats();
+
+  // Adds value to counter.
+  void Add(Counter counter, int64_t value);
+
+  // Records value in histogram.
+  void Record(Histogram histogram, int64_t value);
+
+  // Returns the value of counter.
+  int64_t Get(Counter counter) const;
+
+  // Returns the number and the sum of the values recorded in histogram.
+  int64_t GetCount(Histogram histogram) const;
+  int64_t GetSum(Histogram histogram) const;
+
+  // Returns the number of values recorded in a bucket of histogram.
+  int64_t GetBucket(Histogram histogram, int bucket) const;
+
+  // Returns the non zero counters and histograms by name. int64_t values are
+  // sent as strings, as they are not supported by pp::Var. A histogram is a
+  // dictionary with "count", "sum" and "buckets", an array with the number of
+  // values of every bucket up to the last one that is not empty.
+  pp::VarDictionary ToVarDictionary() const;
+
+  // Returns the bucket of value.
+  static int BucketOf(int64_t value);
+
+  // Returns a monotonic time in microseconds.
+  static int64_t NowInMicroseconds();
+
+ private:
+  int64_t counters_[COUNTER_COUNT];
+  int64_t histogram_counts_[HISTOGRAM_COUNT];
+  int64_t histogram_sums_[HISTOGRAM_COUNT];
+  int64_t histogram_buckets_[HISTOGRAM_COUNT][kHistogramBucketCount];
+};
+
+#endif  // STATS_H_
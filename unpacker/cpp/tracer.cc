@@ -0,0 +1,171 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "tracer.h"
+
+#include <algorithm>
+#include <pthread.h>
+#include <sstream>
+#include <vector>
+
+#include "ppapi/cpp/logging.h"
+
+#include "stats.h"
+
+namespace {
+
+// An event of the Chrome trace event format.
+struct TraceEvent {
+  char phase;  // 'X' for complete events, 'b' and 'e' for async events.
+  const char* category;
+  const char* name;
+  int64_t timestamp_us;
+  int64_t duration_us;  // Only for complete events.
+  uint64_t id;          // Only for async events.
+  int thread_id;
+  const char* arg_name;  // NULL if the event has no argument.
+  int64_t arg_value;
+};
+
+// The ring buffer of the events, guarded by events_lock. next_event is the
+// slot of the next event. The buffer is full once event_count equals its
+// size, and then next_event is also the oldest event.
+pthread_mutex_t events_lock = PTHREAD_MUTEX_INITIALIZER;
+std::vector<TraceEvent> events;
+size_t next_event = 0;
+size_t event_count = 0;
+
+// The ids of the threads, assigned in the order they record their first
+// event.
+int last_thread_id = 0;
+__thread int current_thread_id = 0;
+
+int CurrentThreadId() {
+  if (current_thread_id == 0)
+    current_thread_id = __sync_add_and_fetch(&last_thread_id, 1);
+  return current_thread_id;
+}
+
+TraceEvent CreateEvent(char phase, const char* category, const char* name) {
+  TraceEvent event;
+  event.phase = phase;
+  event.category = category;
+  event.name = name;
+  event.timestamp_us = Stats::NowInMicroseconds();
+  event.duration_us = 0;
+  event.id = 0;
+  event.thread_id = CurrentThreadId();
+  event.arg_name = NULL;
+  event.arg_value = 0;
+  return event;
+}
+
+void AddEvent(const TraceEvent& event) {
+  pthread_mutex_lock(&events_lock);
+  // The buffer is empty if tracing was never enabled.
+  if (!events.empty()) {
+    events[next_event] = event;
+    next_event = (next_event + 1) % events.size();
+    if (event_count < events.size())
+      ++event_count;
+  }
+  pthread_mutex_unlock(&events_lock);
+}
+
+void WriteEvent(const TraceEvent& event, std::stringstream* json) {
+  *json << "{\"ph\":\"" << event.phase << "\",\"cat\":\"" << event.category
+        << "\",\"name\":\"" << event.name << "\",\"ts\":"
+        << event.timestamp_us << ",\"pid\":1,\"tid\":" << event.thread_id;
+  if (event.phase == 'X')
+    *json << ",\"dur\":" << event.duration_us;
+  else
+    *json << ",\"id\":\"0x" << std::hex << event.id << std::dec << "\"";
+  if (event.arg_name) {
+    *json << ",\"args\":{\"" << event.arg_name << "\":" << event.arg_value
+          << "}";
+  }
+  *json << "}";
+}
+
+}  // namespace
+
+const int Tracer::kDefaultCapacity;
+const int Tracer::kMaximumCapacity;
+
+volatile bool Tracer::enabled_ = false;
+
+Tracer::ScopedEvent::ScopedEvent(const char* category, const char* name)
+    : category_(category),
+      name_(name),
+      start_us_(enabled_ ? Stats::NowInMicroseconds() : -1) {}
+
+Tracer::ScopedEvent::~ScopedEvent() {
+  if (start_us_ < 0 || !enabled_)
+    return;
+
+  TraceEvent event = CreateEvent('X', category_, name_);
+  event.duration_us = event.timestamp_us - start_us_;
+  event.timestamp_us = start_us_;
+  AddEvent(event);
+}
+
+void Tracer::Enable(int capacity) {
+  PP_DCHECK(capacity > 0);
+  pthread_mutex_lock(&events_lock);
+  std::vector<TraceEvent>(std::min(capacity, kMaximumCapacity)).swap(events);
+  next_event = 0;
+  event_count = 0;
+  enabled_ = true;
+  pthread_mutex_unlock(&events_lock);
+}
+
+void Tracer::Disable() {
+  enabled_ = false;
+}
+
+void Tracer::BeginAsync(const char* category,
+                        const char* name,
+                        uint64_t id,
+                        const char* arg_name,
+                        int64_t arg_value) {
+  if (!enabled_)
+    return;
+
+  TraceEvent event = CreateEvent('b', category, name);
+  event.id = id;
+  event.arg_name = arg_name;
+  event.arg_value = arg_value;
+  AddEvent(event);
+}
+
+void Tracer::EndAsync(const char* category, const char* name, uint64_t id) {
+  if (!enabled_)
+    return;
+
+  TraceEvent event = CreateEvent('e', category, name);
+  event.id = id;
+  AddEvent(event);
+}
+
+uint64_t Tracer::AsyncId(const void* owner, int64_t key) {
+  // Multiplying by an odd constant spreads the keys over the 64 bits, so
+  // they rarely collide with the bits of the address of another owner.
+  return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(owner)) ^
+         (static_cast<uint64_t>(key) * 0x9e3779b97f4a7c15ULL);
+}
+
+std::string Tracer::DumpJson() {
+  std::stringstream json;
+  json << "{\"traceEvents\":[";
+  pthread_mutex_lock(&events_lock);
+  size_t first = event_count < events.size() ? 0 : next_event;
+  for (size_t i = 0; i < event_count; ++i) {
+    if (i > 0)
+      json << ",";
+    WriteEvent(events[(first + i) % events.size()], &json);
+  }
+  pthread_mutex_unlock(&events_lock);
+  json << "],\"displayTimeUnit\":\"ms\"}";
+  return json.str();
+}
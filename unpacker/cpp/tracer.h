@@ -0,0 +1,75 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef TRACER_H_
+#define TRACER_H_
+
+#include <stdint.h>
+#include <string>
+
+// Records the timeline of the jobs of the module in a ring buffer, which can
+// be dumped in the Chrome trace event format and loaded into a trace viewer,
+// like chrome://tracing. Tracing is disabled by default, and every method
+// only checks a flag in that case, so the events can be recorded on hot
+// paths.
+//
+// The names and argument names of the events must be string literals, as
+// only their pointers are kept. All the methods can be called from any
+// thread.
+class Tracer {
+ public:
+  // Records the time from its construction to its destruction as a complete
+  // event, in case tracing is enabled at construction.
+  class ScopedEvent {
+   public:
+    ScopedEvent(const char* category, const char* name);
+    ~ScopedEvent();
+
+   private:
+    const char* const category_;
+    const char* const name_;
+    const int64_t start_us_;  // -1 if tracing was disabled.
+  };
+
+  // The default and the maximum number of events kept in the ring buffer.
+  // An event takes about 64 bytes.
+  static const int kDefaultCapacity = 64 * 1024;
+  static const int kMaximumCapacity = 1024 * 1024;
+
+  // Starts recording events, keeping the last capacity events, at most
+  // kMaximumCapacity. The events recorded before are dropped.
+  static void Enable(int capacity);
+
+  // Stops recording events. The recorded events are kept until the next
+  // Enable, so they can still be dumped.
+  static void Disable();
+
+  static bool IsEnabled() { return enabled_; }
+
+  // Records the beginning and the end of an asynchronous operation, like a
+  // request sent to JavaScript. The events of the same operation must have
+  // the same category, name and id. See AsyncId. The arguments are recorded
+  // only for the beginning, and only if arg_name is not NULL.
+  static void BeginAsync(const char* category,
+                         const char* name,
+                         uint64_t id,
+                         const char* arg_name,
+                         int64_t arg_value);
+  static void EndAsync(const char* category, const char* name, uint64_t id);
+
+  // Returns an id for the asynchronous operation with the given key of the
+  // owner object, e.g. the offset of a chunk requested by a reader.
+  static uint64_t AsyncId(const void* owner, int64_t key);
+
+  // Returns the recorded events in the JSON object format of Chrome trace
+  // events, oldest first.
+  static std::string DumpJson();
+
+ private:
+  // Read without a lock, so disabled tracing costs a single load. An event
+  // racing with Enable or Disable may be dropped.
+  static volatile bool enabled_;
+};
+
+#endif  // TRACER_H_
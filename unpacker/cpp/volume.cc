@@ -4,12 +4,21 @@
 
 #include "volume.h"
 
+#include <algorithm>
 #include <cstring>
+#include <limits>
 #include <sstream>
+#include <utility>
+#include <vector>
+
+#include "ppapi/cpp/var_array.h"
 
 #include "request.h"
+#include "tracer.h"
 #include "volume_archive_libarchive.h"
+#include "volume_reader_archive_entry.h"
 #include "volume_reader_javascript_stream.h"
+#include "volume_reader_multi_part.h"
 
 namespace {
 
@@ -23,7 +32,25 @@ namespace {
 typedef std::map<std::string, VolumeArchive*>::const_iterator
     volume_archive_iterator;
 
-const char kPathDelimiter[] = "/";
+// The maximum size of the array buffers sent for a READ_FILE request.
+const int64_t kReadFileChunkSize = 512 * 1024;  // 512 KB.
+
+// The maximum number of hits sent in a single SEARCH_DONE response.
+const uint32_t kSearchHitsPerResponse = 1024;
+
+// The maximum number of digests sent in a single HASH_ENTRIES_DONE response.
+const uint32_t kDigestsPerResponse = 1024;
+
+// The maximum size of all the patterns of a SEARCH request. The automaton of
+// the patterns takes 1 KB per byte of the patterns.
+const size_t kMaxSearchPatternBytes = 4096;
+
+// The maximum size of the array buffers kept for reuse by a volume.
+const int64_t kMaxPooledArrayBufferBytes = 4 * kReadFileChunkSize;
+
+// The names of the job priorities in logs and stats, in the order of
+// JobScheduler::Priority.
+const char* const kPriorityNames[] = {"interactive", "metadata", "bulk"};
 
 // size is int64_t and modification_time is time_t because this is how
 // libarchive is going to pass them to us.
@@ -54,79 +81,152 @@ pp::VarDictionary CreateEntry(int64_t index,
   return entry_metadata;
 }
 
-void ConstructMetadata(int64_t index,
-                       const std::string& entry_complete_path,
-                       int64_t size,
-                       bool is_directory,
-                       time_t modification_time,
-                       pp::VarDictionary* parent_metadata) {
-  if (entry_complete_path.empty())
-    return;
+// Constructs the metadata of the volume from its entry table. As the id of a
+// parent is always smaller than the ids of its children, the entries are
+// visited backwards so every directory is complete when it is added to its
+// parent.
+pp::VarDictionary ConstructMetadata(const VolumeEntryTable& entry_table) {
+  // The contents of the directories visited so far, indexed by entry id.
+  // pp::Var is used as it is undefined by default, so no dictionaries are
+  // created for files.
+  std::vector<pp::Var> directory_entries(entry_table.size());
+
+  for (VolumeEntryTable::EntryId id = entry_table.size() - 1;
+       id != VolumeEntryTable::kRootId; --id) {
+    pp::VarDictionary entry_metadata =
+        CreateEntry(entry_table.archive_index(id),
+                    entry_table.name(id),
+                    entry_table.is_directory(id),
+                    entry_table.file_size(id),
+                    entry_table.modification_time(id));
+    if (!directory_entries[id].is_undefined()) {
+      entry_metadata.Set("entries", directory_entries[id]);
+      directory_entries[id] = pp::Var();  // Release the memory.
+    }
 
-  // If the path starts with ./ then skip it.  The FSP layers can't handle this
-  // scenario and just keep doing ././././.  The libarchive layers can handle
-  // this fine though.
-  std::string entry_path = entry_complete_path;
-  while (entry_path.compare(0, 2, "./") == 0)
-    entry_path.erase(0, 2);
+    VolumeEntryTable::EntryId parent_id = entry_table.parent_id(id);
+    if (directory_entries[parent_id].is_undefined())
+      directory_entries[parent_id] = pp::VarDictionary();
+    pp::VarDictionary(directory_entries[parent_id])
+        .Set(entry_table.name(id), entry_metadata);
+  }
 
-  pp::VarDictionary parent_entries =
-      pp::VarDictionary(parent_metadata->Get("entries"));
+  pp::VarDictionary root_metadata = CreateEntry(-1, "" /* name */, true, 0, 0);
+  if (!directory_entries[VolumeEntryTable::kRootId].is_undefined())
+    root_metadata.Set("entries", directory_entries[VolumeEntryTable::kRootId]);
+  return root_metadata;
+}
 
-  unsigned int position = entry_path.find(kPathDelimiter);
-  pp::VarDictionary entry_metadata;
-  std::string entry_name;
-
-  if (position == std::string::npos) {  // The entry itself.
-    entry_name = entry_path;
-    entry_metadata =
-        CreateEntry(index, entry_name, is_directory, size, modification_time);
-
-    // Update directory information. Required as sometimes the directory itself
-    // is returned after the files inside it.
-    pp::Var old_entry_metadata_var = parent_entries.Get(entry_name);
-    if (!old_entry_metadata_var.is_undefined()) {
-      pp::VarDictionary old_entry_metadata =
-          pp::VarDictionary(old_entry_metadata_var);
-      PP_DCHECK(old_entry_metadata.Get("isDirectory").AsBool());
-      entry_metadata.Set("entries", old_entry_metadata.Get("entries"));
+// Copies length bytes from data to a new array buffer.
+pp::VarArrayBuffer CreateArrayBuffer(const char* data, int64_t length) {
+  pp::VarArrayBuffer array_buffer(length);
+  if (length > 0) {
+    char* array_buffer_data = static_cast<char*>(array_buffer.Map());
+    memcpy(array_buffer_data, data, length);
+    array_buffer.Unmap();
+  }
+  return array_buffer;
+}
+
+// Searches the data of entries for patterns and sends the hits to JavaScript
+// as SEARCH_DONE responses, in batches.
+class SearchHitSender : public EntryDataConsumerInterface {
+ public:
+  // SearchHitSender does not own the message_sender, matcher and hit_count
+  // pointers. hit_count is the number of hits found so far by the request,
+  // which stops at max_hits, or never if max_hits is -1.
+  SearchHitSender(JavaScriptMessageSenderInterface* message_sender,
+                  const std::string& file_system_id,
+                  const std::string& request_id,
+                  PatternMatcher* matcher,
+                  int64_t max_hits,
+                  int64_t* hit_count)
+      : message_sender_(message_sender),
+        file_system_id_(file_system_id),
+        request_id_(request_id),
+        matcher_(matcher),
+        max_hits_(max_hits),
+        hit_count_(hit_count),
+        index_(-1) {}
+
+  virtual void Consume(const char* data, int64_t length) {
+    matches_.clear();
+    matcher_->Find(data, length, &matches_);
+
+    std::stringstream ss_index;
+    ss_index << index_;
+    for (size_t i = 0; i < matches_.size() && !IsDone(); ++i) {
+      pp::VarDictionary hit;
+      hit.Set(request::key::kIndex, ss_index.str());
+      std::stringstream ss_offset;
+      ss_offset << matches_[i].offset;
+      hit.Set(request::key::kOffset, ss_offset.str());
+      hit.Set(request::key::kPatternIndex,
+              static_cast<int32_t>(matches_[i].pattern));
+      hits_.Set(hits_.GetLength(), hit);
+      ++*hit_count_;
+
+      if (hits_.GetLength() >= kSearchHitsPerResponse)
+        Send(true /* has_more_data */);
     }
-  } else {  // Get next parent on the way to the entry.
-    entry_name = entry_path.substr(0, position);
+  }
 
-    // Get next parent metadata. If none, create a new directory entry for it.
-    // Some archives don't have directory information inside and for some the
-    // information is returned later than the files inside it.
-    pp::Var entry_metadata_var = parent_entries.Get(entry_name);
-    if (entry_metadata_var.is_undefined())
-      entry_metadata = CreateEntry(-1, entry_name, true, 0, modification_time);
-    else
-      entry_metadata = pp::VarDictionary(parent_entries.Get(entry_name));
+  virtual bool IsDone() const {
+    return max_hits_ != -1 && *hit_count_ >= max_hits_;
+  }
 
-    // Continue to construct metadata for all directories on the path to the
-    // to the entry and for the entry itself.
-    std::string entry_path_without_next_parent = entry_path.substr(
-        position + sizeof(kPathDelimiter) - 1 /* Last char is '\0'. */);
+  // Sets the index of the entry passed to Consume.
+  void set_index(int64_t index) { index_ = index; }
 
-    ConstructMetadata(index,
-                      entry_path_without_next_parent,
-                      size,
-                      is_directory,
-                      modification_time,
-                      &entry_metadata);
+  // Sends the hits which weren't sent yet, if any.
+  void Flush() {
+    if (hits_.GetLength() > 0)
+      Send(true /* has_more_data */);
   }
 
-  // Recreate parent_metadata. This is necessary because pp::VarDictionary::Get
-  // returns a Var, not a Var& or Var* to directly modify the result.
-  parent_entries.Set(entry_name, entry_metadata);
-  parent_metadata->Set("entries", parent_entries);
-}
+  // Sends the hits which weren't sent yet, marking the end of the request.
+  void Finish() { Send(false /* has_more_data */); }
+
+ private:
+  void Send(bool has_more_data) {
+    message_sender_->SendSearchDone(file_system_id_, request_id_, hits_,
+                                    has_more_data);
+    hits_ = pp::VarArray();
+  }
+
+  JavaScriptMessageSenderInterface* message_sender_;
+  const std::string file_system_id_;
+  const std::string request_id_;
+  PatternMatcher* matcher_;
+  const int64_t max_hits_;
+  int64_t* hit_count_;
+  int64_t index_;
+  std::vector<PatternMatcher::Match> matches_;  // Reused between chunks.
+  pp::VarArray hits_;  // The hits not sent yet.
+};
+
+// Passes the data of an entry to a hasher.
+class HashUpdater : public EntryDataConsumerInterface {
+ public:
+  // HashUpdater does not own the hasher pointer.
+  explicit HashUpdater(Hasher* hasher) : hasher_(hasher) {}
+
+  virtual void Consume(const char* data, int64_t length) {
+    hasher_->Update(data, length);
+  }
+
+ private:
+  Hasher* hasher_;
+};
 
 // An internal implementation of JavaScriptRequestorInterface.
 class JavaScriptRequestor : public JavaScriptRequestorInterface {
  public:
-  // JavaScriptRequestor does not own the volume pointer.
-  explicit JavaScriptRequestor(Volume* volume) : volume_(volume) {}
+  // JavaScriptRequestor does not own the volume pointer. part_index is the
+  // part of a split archive the chunks are requested from, and 0 for archives
+  // that are not split.
+  JavaScriptRequestor(Volume* volume, int part_index)
+      : volume_(volume), part_index_(part_index) {}
 
   virtual void RequestFileChunk(const std::string& request_id,
                                 int64_t offset,
@@ -134,7 +234,8 @@ class JavaScriptRequestor : public JavaScriptRequestorInterface {
     PP_DCHECK(offset >= 0);
     PP_DCHECK(bytes_to_read > 0);
     volume_->message_sender()->SendFileChunkRequest(
-        volume_->file_system_id(), request_id, offset, bytes_to_read);
+        volume_->file_system_id(), request_id, part_index_, offset,
+        bytes_to_read);
   }
 
   virtual void RequestPassphrase(const std::string& request_id) {
@@ -144,15 +245,24 @@ class JavaScriptRequestor : public JavaScriptRequestorInterface {
 
  private:
   Volume* volume_;
+  const int part_index_;
 };
 
 // An internal implementation of VolumeArchiveFactoryInterface for default
 // Volume constructor.
 class VolumeArchiveFactory : public VolumeArchiveFactoryInterface {
  public:
+  // VolumeArchiveFactory does not own the stats pointer.
+  explicit VolumeArchiveFactory(Stats* stats) : stats_(stats) {}
+
   virtual VolumeArchive* Create(VolumeReader* reader) {
-    return new VolumeArchiveLibarchive(reader);
+    VolumeArchiveLibarchive* archive = new VolumeArchiveLibarchive(reader);
+    archive->set_stats(stats_);
+    return archive;
   }
+
+ private:
+  Stats* stats_;
 };
 
 // An internal implementation of VolumeReaderFactoryInterface for default Volume
@@ -163,13 +273,75 @@ class VolumeReaderFactory : public VolumeReaderFactoryInterface {
   explicit VolumeReaderFactory(Volume* volume) : volume_(volume) {}
 
   virtual VolumeReader* Create(int64_t archive_size) {
-    return new VolumeReaderJavaScriptStream(archive_size, volume_->requestor());
+    const std::vector<int64_t>& part_sizes = volume_->part_sizes();
+    if (part_sizes.empty()) {
+      VolumeReaderJavaScriptStream* reader = new VolumeReaderJavaScriptStream(
+          archive_size, volume_->requestor());
+      reader->set_stats(volume_->stats());
+      return reader;
+    }
+
+    // Every part of a split archive is requested separately from JavaScript.
+    std::vector<VolumeReader*> parts;
+    for (size_t i = 0; i < part_sizes.size(); ++i) {
+      VolumeReaderJavaScriptStream* part = new VolumeReaderJavaScriptStream(
+          part_sizes[i], volume_->part_requestor(i));
+      part->set_stats(volume_->stats());
+      parts.push_back(part);
+    }
+    return new VolumeReaderMultiPart(parts, part_sizes);
   }
 
  private:
   Volume* volume_;
 };
 
+// An implementation of ArchiveOpenerInterface that opens the archive of a
+// volume for a volume nested in one of its entries.
+class NestedArchiveOpener : public ArchiveOpenerInterface {
+ public:
+  // NestedArchiveOpener does not own the volume pointer.
+  NestedArchiveOpener(Volume* volume, const std::string& reader_request_id)
+      : volume_(volume), reader_request_id_(reader_request_id) {}
+
+  virtual VolumeArchive* Open() {
+    return volume_->OpenArchiveForReader(reader_request_id_);
+  }
+
+  virtual void Close(VolumeArchive* archive) {
+    volume_->CloseArchiveForReader(reader_request_id_, archive);
+  }
+
+ private:
+  Volume* volume_;
+  const std::string reader_request_id_;
+};
+
+// An implementation of VolumeReaderFactoryInterface for volumes nested in an
+// entry of another volume.
+class NestedVolumeReaderFactory : public VolumeReaderFactoryInterface {
+ public:
+  // NestedVolumeReaderFactory does not own the outer_volume pointer.
+  NestedVolumeReaderFactory(Volume* outer_volume,
+                            const std::string& outer_request_id,
+                            int64_t outer_index)
+      : outer_volume_(outer_volume),
+        outer_request_id_(outer_request_id),
+        outer_index_(outer_index) {}
+
+  // archive_size is the size of the entry of outer_volume_.
+  virtual VolumeReader* Create(int64_t archive_size) {
+    return new VolumeReaderArchiveEntry(
+        new NestedArchiveOpener(outer_volume_, outer_request_id_),
+        outer_index_, archive_size);
+  }
+
+ private:
+  Volume* outer_volume_;
+  const std::string outer_request_id_;
+  const int64_t outer_index_;
+};
+
 }  // namespace
 
 struct Volume::OpenFileArgs {
@@ -186,56 +358,182 @@ struct Volume::OpenFileArgs {
   const int64_t archive_size;
 };
 
-Volume::Volume(const pp::InstanceHandle& instance_handle,
+struct Volume::OpenFileByPathArgs {
+  OpenFileByPathArgs(const std::string& request_id,
+                     const std::string& path,
+                     const std::string& encoding,
+                     int64_t archive_size) : request_id(request_id),
+                                             path(path),
+                                             encoding(encoding),
+                                             archive_size(archive_size) {}
+  const std::string request_id;
+  const std::string path;
+  const std::string encoding;
+  const int64_t archive_size;
+};
+
+struct Volume::SearchArgs {
+  SearchArgs(const std::string& request_id,
+             const std::string& encoding,
+             int64_t archive_size,
+             int64_t max_hits) : request_id(request_id),
+                                 encoding(encoding),
+                                 archive_size(archive_size),
+                                 max_hits(max_hits),
+                                 next_file(0),
+                                 offset(0),
+                                 hit_count(0) {}
+  const std::string request_id;
+  const std::string encoding;
+  const int64_t archive_size;
+  const int64_t max_hits;  // -1 if the hits are not limited.
+  std::vector<int64_t> files;  // The indexes of the files, sorted.
+  size_t next_file;   // The file that is searched or should be searched next.
+  int64_t offset;     // The offset inside next_file, in case the job yielded
+                      // in the middle of the file.
+  int64_t hit_count;  // The hits found so far.
+};
+
+struct Volume::HashEntriesArgs {
+  HashEntriesArgs(const std::string& request_id,
+                  const std::string& encoding,
+                  int64_t archive_size) : request_id(request_id),
+                                          encoding(encoding),
+                                          archive_size(archive_size),
+                                          next_file(0),
+                                          offset(0) {}
+  const std::string request_id;
+  const std::string encoding;
+  const int64_t archive_size;
+  std::vector<int64_t> files;  // The indexes of the files, sorted, without
+                               // duplicates.
+  size_t next_file;  // The file that is hashed or should be hashed next.
+  int64_t offset;    // The offset inside next_file, in case the job yielded
+                     // in the middle of the file.
+};
+
+struct Volume::ReadFilesArgs {
+  ReadFilesArgs(const std::string& request_id,
+                const std::string& encoding,
+                int64_t archive_size) : request_id(request_id),
+                                        encoding(encoding),
+                                        archive_size(archive_size),
+                                        next_file(0),
+                                        offset(0),
+                                        last_index(-1) {}
+  const std::string request_id;
+  const std::string encoding;
+  const int64_t archive_size;
+  // Pairs of (index, max bytes) sorted by index, without duplicates.
+  std::vector<std::pair<int64_t, int64_t> > files;
+  size_t next_file;    // The file that is read or should be read next.
+  int64_t offset;      // The offset inside next_file, in case the job yielded
+                       // in the middle of the file.
+  int64_t last_index;  // The index of the last file that was read.
+};
+
+Volume::Volume(WorkerPool* worker_pool,
                const std::string& file_system_id,
                JavaScriptMessageSenderInterface* message_sender)
     : volume_archive_(NULL),
       file_system_id_(file_system_id),
+      array_buffer_pool_(kMaxPooledArrayBufferBytes),
       message_sender_(message_sender),
-      worker_(instance_handle),
-      callback_factory_(this) {
-  requestor_ = new JavaScriptRequestor(this);
-  volume_archive_factory_ = new VolumeArchiveFactory();
+      worker_pool_(worker_pool),
+      scheduler_(worker_pool),
+      callback_factory_(this),
+      yielded_reader_moved_(false),
+      has_reader_waiting_job_(false),
+      archive_size_(-1),
+      archive_raw_(false),
+      entry_count_(0),
+      entry_table_bytes_(0),
+      search_matcher_(NULL),
+      entry_hasher_(NULL) {
+  requestor_ = new JavaScriptRequestor(this, 0);
+  volume_archive_factory_ = new VolumeArchiveFactory(&stats_);
   volume_reader_factory_ = new VolumeReaderFactory(this);
   // Delegating constructors only from c++11.
 }
 
-Volume::Volume(const pp::InstanceHandle& instance_handle,
+Volume::Volume(WorkerPool* worker_pool,
                const std::string& file_system_id,
                JavaScriptMessageSenderInterface* message_sender,
                VolumeArchiveFactoryInterface* volume_archive_factory,
                VolumeReaderFactoryInterface* volume_reader_factory)
     : volume_archive_(NULL),
       file_system_id_(file_system_id),
+      array_buffer_pool_(kMaxPooledArrayBufferBytes),
       message_sender_(message_sender),
-      worker_(instance_handle),
+      worker_pool_(worker_pool),
+      scheduler_(worker_pool),
       callback_factory_(this),
+      yielded_reader_moved_(false),
+      has_reader_waiting_job_(false),
+      archive_size_(-1),
+      archive_raw_(false),
+      entry_count_(0),
+      entry_table_bytes_(0),
+      search_matcher_(NULL),
+      entry_hasher_(NULL),
       volume_archive_factory_(volume_archive_factory),
       volume_reader_factory_(volume_reader_factory) {
-  requestor_ = new JavaScriptRequestor(this);
+  requestor_ = new JavaScriptRequestor(this, 0);
+}
+
+Volume::Volume(WorkerPool* worker_pool,
+               const std::string& file_system_id,
+               JavaScriptMessageSenderInterface* message_sender,
+               Volume* outer_volume,
+               const std::string& outer_request_id,
+               int64_t outer_index)
+    : volume_archive_(NULL),
+      file_system_id_(file_system_id),
+      array_buffer_pool_(kMaxPooledArrayBufferBytes),
+      message_sender_(message_sender),
+      worker_pool_(worker_pool),
+      scheduler_(worker_pool),
+      callback_factory_(this),
+      yielded_reader_moved_(false),
+      has_reader_waiting_job_(false),
+      archive_size_(-1),
+      archive_raw_(false),
+      entry_count_(0),
+      entry_table_bytes_(0),
+      search_matcher_(NULL),
+      entry_hasher_(NULL) {
+  requestor_ = new JavaScriptRequestor(this, 0);
+  volume_archive_factory_ = new VolumeArchiveFactory(&stats_);
+  volume_reader_factory_ = new NestedVolumeReaderFactory(
+      outer_volume, outer_request_id, outer_index);
 }
 
 Volume::~Volume() {
-  worker_.Join();
+  scheduler_.Join();
 
   if (volume_archive_) {
     volume_archive_->Cleanup();
     delete volume_archive_;
   }
 
+  delete search_matcher_;
+  delete entry_hasher_;
   delete requestor_;
+  for (size_t i = 0; i < part_requestors_.size(); ++i)
+    delete part_requestors_[i];
   delete volume_archive_factory_;
   delete volume_reader_factory_;
 }
 
 bool Volume::Init() {
-  return worker_.Start();
+  return worker_pool_->Start();
 }
 
 void Volume::ReadMetadata(const std::string& request_id,
                           const std::string& encoding,
                           int64_t archive_size) {
-  worker_.message_loop().PostWork(callback_factory_.NewCallback(
+  scheduler_.PostJob(JobScheduler::PRIORITY_METADATA,
+                     callback_factory_.NewCallback(
       &Volume::ReadMetadataCallback, request_id, encoding, archive_size));
 }
 
@@ -243,39 +541,105 @@ void Volume::OpenFile(const std::string& request_id,
                       int64_t index,
                       const std::string& encoding,
                       int64_t archive_size) {
-  worker_.message_loop().PostWork(callback_factory_.NewCallback(
+  scheduler_.PostJob(JobScheduler::PRIORITY_INTERACTIVE,
+                     callback_factory_.NewCallback(
       &Volume::OpenFileCallback, OpenFileArgs(request_id, index, encoding,
       archive_size)));
 }
 
+void Volume::OpenFileByPath(const std::string& request_id,
+                            const std::string& path,
+                            const std::string& encoding,
+                            int64_t archive_size) {
+  // The path is resolved by a job, as entry_table_ is accessed only there.
+  scheduler_.PostJob(JobScheduler::PRIORITY_INTERACTIVE,
+                     callback_factory_.NewCallback(
+      &Volume::OpenFileByPathCallback, OpenFileByPathArgs(request_id, path,
+      encoding, archive_size)));
+}
+
+void Volume::StatPath(const std::string& request_id, const std::string& path) {
+  scheduler_.PostJob(JobScheduler::PRIORITY_INTERACTIVE,
+                     callback_factory_.NewCallback(
+      &Volume::StatPathCallback, request_id, path));
+}
+
 void Volume::CloseFile(const std::string& request_id,
                        const std::string& open_request_id) {
-  // Though close file could be executed on main thread, we send it to worker_
-  // in order to ensure thread safety.
-  worker_.message_loop().PostWork(callback_factory_.NewCallback(
+  // Though close file could be executed on main thread, we send it to
+  // scheduler_ in order to ensure thread safety.
+  scheduler_.PostJob(JobScheduler::PRIORITY_INTERACTIVE,
+                     callback_factory_.NewCallback(
       &Volume::CloseFileCallback, request_id, open_request_id));
 }
 
 void Volume::ReadFile(const std::string& request_id,
                       const pp::VarDictionary& dictionary) {
-  worker_.message_loop().PostWork(callback_factory_.NewCallback(
-      &Volume::ReadFileCallback, request_id, dictionary));
+  PendingRead read;
+  read.request_id = request_id;
+  read.open_request_id =
+      dictionary.Get(request::key::kOpenRequestId).AsString();
+  read.offset = request::GetInt64FromString(dictionary, request::key::kOffset);
+  read.length = request::GetInt64FromString(dictionary, request::key::kLength);
+  PP_DCHECK(read.length > 0);  // JavaScript must not make requests with
+                               // length <= 0.
+
+  job_lock_.Acquire();
+  pending_reads_.push_back(read);
+  job_lock_.Release();
+
+  // Reads of an opened file must run in the order they were requested, as
+  // reading backwards is not supported. That's why they all have the same
+  // priority and never yield to each other.
+  scheduler_.PostJob(JobScheduler::PRIORITY_INTERACTIVE,
+                     callback_factory_.NewCallback(
+      &Volume::ReadFileCallback, request_id));
+}
+
+void Volume::ReadFiles(const std::string& request_id,
+                       const pp::VarDictionary& dictionary) {
+  scheduler_.PostJob(JobScheduler::PRIORITY_BULK,
+                     callback_factory_.NewCallback(
+      &Volume::ReadFilesCallback, request_id, dictionary));
+}
+
+void Volume::Search(const std::string& request_id,
+                    const pp::VarDictionary& dictionary) {
+  scheduler_.PostJob(JobScheduler::PRIORITY_BULK,
+                     callback_factory_.NewCallback(
+      &Volume::SearchCallback, request_id, dictionary));
+}
+
+void Volume::HashEntries(const std::string& request_id,
+                         const pp::VarDictionary& dictionary) {
+  scheduler_.PostJob(JobScheduler::PRIORITY_BULK,
+                     callback_factory_.NewCallback(
+      &Volume::HashEntriesCallback, request_id, dictionary));
 }
 
 void Volume::ReadChunkDone(const std::string& request_id,
                            const pp::VarArrayBuffer& array_buffer,
-                           int64_t read_offset) {
+                           int64_t read_offset,
+                           int part_index) {
   PP_DCHECK(volume_archive_);
 
-  static_cast<VolumeReaderJavaScriptStream*>(volume_archive_->reader())->
-      SetBufferAndSignal(array_buffer, read_offset);
+  job_lock_.Acquire();
+  VolumeReaderJavaScriptStream* stream =
+      GetPartStream(FindReader(request_id), part_index);
+  if (stream)
+    stream->SetBufferAndSignal(array_buffer, read_offset);
+  job_lock_.Release();
 }
 
-void Volume::ReadChunkError(const std::string& request_id) {
+void Volume::ReadChunkError(const std::string& request_id, int part_index) {
   PP_DCHECK(volume_archive_);
 
-  static_cast<VolumeReaderJavaScriptStream*>(volume_archive_->reader())->
-      ReadErrorSignal();
+  job_lock_.Acquire();
+  VolumeReaderJavaScriptStream* stream =
+      GetPartStream(FindReader(request_id), part_index);
+  if (stream)
+    stream->ReadErrorSignal();
+  job_lock_.Release();
 }
 
 void Volume::ReadPassphraseDone(const std::string& request_id,
@@ -283,8 +647,10 @@ void Volume::ReadPassphraseDone(const std::string& request_id,
   PP_DCHECK(volume_archive_);
 
   job_lock_.Acquire();
-  if (request_id == reader_request_id_) {
-    static_cast<VolumeReaderJavaScriptStream*>(volume_archive_->reader())->
+  if (request_id == reader_request_id_ ||
+      nested_archive_readers_.count(request_id)) {
+    // The passphrase is always requested by the first part.
+    GetPartStream(FindReader(request_id), 0)->
         SetPassphraseAndSignal(passphrase);
   }
   job_lock_.Release();
@@ -294,17 +660,89 @@ void Volume::ReadPassphraseError(const std::string& request_id) {
   PP_DCHECK(volume_archive_);
 
   job_lock_.Acquire();
-  if (request_id == reader_request_id_) {
-    static_cast<VolumeReaderJavaScriptStream*>(volume_archive_->reader())->
-        PassphraseErrorSignal();
+  if (request_id == reader_request_id_ ||
+      nested_archive_readers_.count(request_id)) {
+    GetPartStream(FindReader(request_id), 0)->PassphraseErrorSignal();
   }
   job_lock_.Release();
 }
 
+void Volume::SetPartSizes(const std::vector<int64_t>& part_sizes) {
+  PP_DCHECK(part_sizes_.empty());
+  if (part_sizes.size() < 2)
+    return;  // Not split.
+
+  part_sizes_ = part_sizes;
+  for (size_t i = 0; i < part_sizes.size(); ++i)
+    part_requestors_.push_back(new JavaScriptRequestor(this, i));
+}
+
+VolumeReader* Volume::FindReader(const std::string& request_id) {
+  std::map<std::string, VolumeReader*>::iterator nested_reader =
+      nested_archive_readers_.find(request_id);
+  if (nested_reader != nested_archive_readers_.end())
+    return nested_reader->second;
+  return volume_archive_->reader();
+}
+
+VolumeReaderJavaScriptStream* Volume::GetPartStream(VolumeReader* reader,
+                                                    int part_index) {
+  if (part_sizes_.empty()) {
+    return part_index == 0 ? static_cast<VolumeReaderJavaScriptStream*>(reader)
+                           : NULL;
+  }
+
+  VolumeReaderMultiPart* multi_part_reader =
+      static_cast<VolumeReaderMultiPart*>(reader);
+  if (part_index < 0 ||
+      static_cast<size_t>(part_index) >= multi_part_reader->part_count()) {
+    return NULL;
+  }
+  return static_cast<VolumeReaderJavaScriptStream*>(
+      multi_part_reader->part(part_index));
+}
+
+VolumeArchive* Volume::OpenArchiveForReader(
+    const std::string& reader_request_id) {
+  job_lock_.Acquire();
+  int64_t archive_size = archive_size_;
+  std::string encoding = archive_encoding_;
+  bool raw = archive_raw_;
+  job_lock_.Release();
+
+  if (archive_size < 0)
+    return NULL;  // The metadata wasn't read yet.
+
+  VolumeReader* reader = volume_reader_factory_->Create(archive_size);
+  reader->SetRequestId(reader_request_id);
+  job_lock_.Acquire();
+  nested_archive_readers_[reader_request_id] = reader;
+  job_lock_.Release();
+
+  VolumeArchive* archive = volume_archive_factory_->Create(reader);
+  if (!archive->Init(encoding, raw)) {
+    CloseArchiveForReader(reader_request_id, archive);
+    return NULL;
+  }
+  return archive;
+}
+
+void Volume::CloseArchiveForReader(const std::string& reader_request_id,
+                                   VolumeArchive* archive) {
+  // No more chunks are passed to the reader once it is removed.
+  job_lock_.Acquire();
+  nested_archive_readers_.erase(reader_request_id);
+  job_lock_.Release();
+
+  archive->Cleanup();
+  delete archive;
+}
+
 void Volume::ReadMetadataCallback(int32_t /*result*/,
                                   const std::string& request_id,
                                   const std::string& encoding,
                                   int64_t archive_size) {
+  Tracer::ScopedEvent trace_event("job", "ReadMetadata");
   if (volume_archive_) {
      message_sender_->SendFileSystemError(
          file_system_id_, request_id, "ALREADY_OPENED");
@@ -313,8 +751,7 @@ void Volume::ReadMetadataCallback(int32_t /*result*/,
   job_lock_.Acquire();
   volume_archive_ = volume_archive_factory_->Create(
       volume_reader_factory_->Create(archive_size));
-  static_cast<VolumeReaderJavaScriptStream*>(volume_archive_->reader())->
-      SetRequestId(request_id);
+  volume_archive_->reader()->SetRequestId(request_id);
   reader_request_id_ = request_id;
   job_lock_.Release();
 
@@ -324,8 +761,7 @@ void Volume::ReadMetadataCallback(int32_t /*result*/,
     delete volume_archive_;
     volume_archive_ = volume_archive_factory_->Create(
         volume_reader_factory_->Create(archive_size));
-    static_cast<VolumeReaderJavaScriptStream*>(volume_archive_->reader())->
-        SetRequestId(reader_request_id_);
+    volume_archive_->reader()->SetRequestId(reader_request_id_);
 
     // If that failed, retry with the raw format.
     if (!volume_archive_->Init(encoding, true)) {
@@ -340,8 +776,8 @@ void Volume::ReadMetadataCallback(int32_t /*result*/,
     }
   }
 
-  // Read and construct metadata.
-  pp::VarDictionary root_metadata = CreateEntry(-1, "" /* name */, true, 0, 0);
+  // Read metadata.
+  entry_table_.Clear();
 
   const char* path_name = NULL;
   int64_t size = 0;
@@ -376,156 +812,879 @@ void Volume::ReadMetadataCallback(int32_t /*result*/,
       path_name = new_path_name.c_str();
     }
 
-    ConstructMetadata(index, path_name, size, is_directory, modification_time,
-        &root_metadata);
+    entry_table_.AddEntry(path_name, index, is_directory, size,
+                          modification_time);
 
     ++index;
   }
 
   ClearJob();
 
+  entry_table_.Compact();
+
+  job_lock_.Acquire();
+  archive_size_ = archive_size;
+  archive_encoding_ = encoding;
+  archive_raw_ = volume_archive_->raw_;
+  // The root is not an entry of the archive.
+  entry_count_ = entry_table_.size() - 1;
+  entry_table_bytes_ = entry_table_.MemoryUsage();
+  job_lock_.Release();
+
   // Send metadata back to JavaScript.
   message_sender_->SendReadMetadataDone(
-      file_system_id_, request_id, root_metadata);
+      file_system_id_, request_id, ConstructMetadata(entry_table_));
 }
 
 void Volume::OpenFileCallback(int32_t /*result*/,
                               const OpenFileArgs& args) {
+  Tracer::ScopedEvent trace_event("job", "OpenFile");
   if (!volume_archive_) {
      message_sender_->SendFileSystemError(
          file_system_id_, args.request_id, "NOT_OPENED");
      return;
   }
 
-  job_lock_.Acquire();
-  if (!reader_request_id_.empty()) {
-    // It is illegal to open a file while another operation is in progress or
-    // another file is opened.
+  // A file can be opened while a bulk request yields.
+  if (!AcquireReader(args.request_id, false /* is_bulk */))
+    return;
+
+  if (!SeekEntry(args.request_id, args.index, args.encoding, args.archive_size))
+    return;
+
+  // Send successful opened file response to NaCl.
+  message_sender_->SendOpenFileDone(file_system_id_, args.request_id);
+}
+
+void Volume::OpenFileByPathCallback(int32_t result,
+                                    const OpenFileByPathArgs& args) {
+  Tracer::ScopedEvent trace_event("job", "OpenFileByPath");
+  if (!volume_archive_) {
+     message_sender_->SendFileSystemError(
+         file_system_id_, args.request_id, "NOT_OPENED");
+     return;
+  }
+
+  VolumeEntryTable::EntryId id = entry_table_.FindEntry(args.path);
+  if (id == VolumeEntryTable::kInvalidId || entry_table_.is_directory(id)) {
     message_sender_->SendFileSystemError(
-        file_system_id_, args.request_id, "ILLEGAL");
-    job_lock_.Release();
+        file_system_id_, args.request_id, "NOT_FOUND");
     return;
   }
-  static_cast<VolumeReaderJavaScriptStream*>(volume_archive_->reader())->
-      SetRequestId(args.request_id);
-  reader_request_id_ = args.request_id;
-  job_lock_.Release();
 
-  if (!volume_archive_->SeekHeader(args.index)) {
-    // Maybe we're dealing with a streaming archive format (e.g. tar).
-    // We need to re-read this thing everytime.
-    bool raw = volume_archive_->raw_;
-    if (volume_archive_->curr_index > args.index || raw) {
-      volume_archive_->Cleanup();
-      delete volume_archive_;
-      volume_archive_ = volume_archive_factory_->Create(
-          volume_reader_factory_->Create(args.archive_size));
-      static_cast<VolumeReaderJavaScriptStream*>(volume_archive_->reader())->
-          SetRequestId(reader_request_id_);
-      if (!volume_archive_->Init(args.encoding, raw)) {
-        message_sender_->SendFileSystemError(
-            file_system_id_, args.request_id, volume_archive_->error_message());
-        ClearJob();
-        return;
-      }
-    }
+  OpenFileCallback(result, OpenFileArgs(args.request_id,
+                                        entry_table_.archive_index(id),
+                                        args.encoding,
+                                        args.archive_size));
+}
+
+void Volume::StatPathCallback(int32_t /*result*/,
+                              const std::string& request_id,
+                              const std::string& path) {
+  Tracer::ScopedEvent trace_event("job", "StatPath");
+  if (!volume_archive_) {
+     message_sender_->SendFileSystemError(
+         file_system_id_, request_id, "NOT_OPENED");
+     return;
   }
 
-  do {
-  if (volume_archive_->GetNextHeader() == VolumeArchive::RESULT_FAIL) {
+  VolumeEntryTable::EntryId id = entry_table_.FindEntry(path);
+  if (id == VolumeEntryTable::kInvalidId) {
     message_sender_->SendFileSystemError(
-        file_system_id_, args.request_id, volume_archive_->error_message());
-    ClearJob();
+        file_system_id_, request_id, "NOT_FOUND");
     return;
   }
-  } while (volume_archive_->curr_index <= args.index);
 
-  // Send successful opened file response to NaCl.
-  message_sender_->SendOpenFileDone(file_system_id_, args.request_id);
+  pp::VarDictionary entry_metadata =
+      CreateEntry(entry_table_.archive_index(id),
+                  entry_table_.name(id),
+                  entry_table_.is_directory(id),
+                  entry_table_.file_size(id),
+                  entry_table_.modification_time(id));
+  entry_metadata.Delete("entries");
+  message_sender_->SendStatPathDone(file_system_id_, request_id,
+                                    entry_metadata);
 }
 
 void Volume::CloseFileCallback(int32_t /*result*/,
                                const std::string& request_id,
                                const std::string& open_request_id) {
-  job_lock_.Acquire();
-  reader_request_id_ = "";
-  job_lock_.Release();
+  Tracer::ScopedEvent trace_event("job", "CloseFile");
+  ClearJob();
+
+  // Release the buffers kept for reading the file.
+  array_buffer_pool_.Clear();
 
   message_sender_->SendCloseFileDone(
       file_system_id_, request_id, open_request_id);
 }
 
 void Volume::ReadFileCallback(int32_t /*result*/,
-                              const std::string& request_id,
-                              const pp::VarDictionary& dictionary) {
+                              const std::string& request_id) {
+  Tracer::ScopedEvent trace_event("job", "ReadFile");
+  // Take all the queued reads of the opened file, so adjacent and overlapping
+  // reads are served by a single decompression pass. Reads of other files
+  // stay queued for their own jobs, as their file might be opened by a job
+  // that runs before them.
+  std::vector<PendingRead> reads;
+  std::vector<PendingRead> other_reads;
+  bool is_file_opened = true;
+  job_lock_.Acquire();
+  for (size_t i = 0; i < pending_reads_.size(); ++i) {
+    if (volume_archive_ &&
+        pending_reads_[i].open_request_id == reader_request_id_) {
+      reads.push_back(pending_reads_[i]);
+    } else if (pending_reads_[i].request_id == request_id) {
+      is_file_opened = false;
+    } else {
+      other_reads.push_back(pending_reads_[i]);
+    }
+  }
+  pending_reads_.swap(other_reads);
+  job_lock_.Release();
+
+  if (!is_file_opened) {
+    message_sender_->SendFileSystemError(
+        file_system_id_,
+        request_id,
+        volume_archive_ ? "FILE_NOT_OPENED" : "NOT_OPENED");
+  }
+
+  // The reads could have been served already by the job of an earlier read.
+  if (reads.empty())
+    return;
+
+  // Serve the reads by offset, as reading backwards is not supported. Reads
+  // with the same offset keep the order they were requested in.
+  std::stable_sort(reads.begin(), reads.end(), &Volume::IsPendingReadBefore);
+  stats_.Add(Stats::READ_FILE_REQUESTS, reads.size());
+
+  size_t first = 0;
+  while (first < reads.size()) {
+    // Extend the span with all the reads that start inside it or right after
+    // its end.
+    size_t last = first + 1;
+    int64_t span_end = reads[first].offset + reads[first].length;
+    while (last < reads.size() && reads[last].offset <= span_end) {
+      span_end = std::max(span_end, reads[last].offset + reads[last].length);
+      ++last;
+    }
+    stats_.Add(Stats::READ_FILE_BATCHES, 1);
+    stats_.Add(Stats::MERGED_READ_REQUESTS, last - first - 1);
+
+    if (!ReadFileSpan(reads, first, last, span_end)) {
+      // Error messages should be sent to the read requests, not open request,
+      // as the last one has finished. Should not cleanup VolumeArchive as
+      // Volume::CloseFile will be called in case of failure.
+      for (size_t i = first; i < reads.size(); ++i) {
+        message_sender_->SendFileSystemError(
+            file_system_id_, reads[i].request_id,
+            volume_archive_->error_message());
+      }
+      return;
+    }
+    first = last;
+  }
+
+  // Prefetch the next chunk only if no other jobs wait for the worker.
+  scheduler_.PostJob(JobScheduler::PRIORITY_BULK,
+                     callback_factory_.NewCallback(
+      &Volume::DecompressAheadCallback, reads.front().open_request_id));
+}
+
+// static
+bool Volume::IsPendingReadBefore(const PendingRead& first,
+                                 const PendingRead& second) {
+  return first.offset < second.offset;
+}
+
+bool Volume::ReadFileSpan(const std::vector<PendingRead>& reads,
+                          size_t first,
+                          size_t last,
+                          int64_t span_end) {
+  // Decompress data directly into the array buffers sent to JavaScript.
+  // Sending data is done in chunks of at most kReadFileChunkSize bytes. In
+  // case a chunk is needed by more reads, or only in part, every read gets a
+  // copy of its part of the chunk.
+  int64_t offset = reads[first].offset;
+  while (offset < span_end) {
+    int64_t chunk_length = std::min(span_end - offset, kReadFileChunkSize);
+    // Only full size chunks are pooled. The last chunk of a span has any size,
+    // so it would only take the room of the buffers which are reused.
+    bool is_pooled = chunk_length == kReadFileChunkSize;
+    pp::VarArrayBuffer array_buffer =
+        is_pooled ? array_buffer_pool_.Acquire(chunk_length)
+                  : pp::VarArrayBuffer(chunk_length);
+    char* data = static_cast<char*>(array_buffer.Map());
+    int64_t read_bytes =
+        volume_archive_->ReadDataInto(offset, chunk_length, data);
+
+    if (read_bytes < 0) {
+      array_buffer.Unmap();
+      if (is_pooled)
+        array_buffer_pool_.Release(array_buffer);
+      return false;
+    }
+
+    int64_t chunk_end = offset + read_bytes;
+    for (size_t i = first; i < last; ++i) {
+      int64_t read_end = reads[i].offset + reads[i].length;
+      int64_t part_begin = std::max(offset, reads[i].offset);
+      int64_t part_end = std::min(chunk_end, read_end);
+      if (part_begin >= part_end)
+        continue;  // The read doesn't need data from this chunk.
+
+      pp::VarArrayBuffer part_array_buffer =
+          part_begin == offset && part_end - part_begin == chunk_length
+              ? array_buffer
+              : CreateArrayBuffer(data + (part_begin - offset),
+                                  part_end - part_begin);
+      message_sender_->SendReadFileDone(
+          file_system_id_, reads[i].request_id, part_array_buffer,
+          part_end < read_end /* has_more_data */);
+    }
+
+    // The message holds a copy of the data, so the buffer can be reused.
+    array_buffer.Unmap();
+    if (is_pooled)
+      array_buffer_pool_.Release(array_buffer);
+
+    if (read_bytes < chunk_length) {
+      // The end of the file was reached. Mark the end of the reads which
+      // expected more data.
+      for (size_t i = first; i < last; ++i) {
+        if (reads[i].offset + reads[i].length > chunk_end) {
+          message_sender_->SendReadFileDone(file_system_id_,
+                                            reads[i].request_id,
+                                            pp::VarArrayBuffer(0),
+                                            false /* has_more_data */);
+        }
+      }
+      break;
+    }
+
+    offset = chunk_end;
+  }
+  return true;
+}
+
+void Volume::DecompressAheadCallback(int32_t /*result*/,
+                                     const std::string& open_request_id) {
+  Tracer::ScopedEvent trace_event("job", "DecompressAhead");
+  job_lock_.Acquire();
+  bool is_opened =
+      volume_archive_ && open_request_id == reader_request_id_;
+  job_lock_.Release();
+
+  // The file could have been closed in the meantime.
+  if (is_opened)
+    volume_archive_->MaybeDecompressAhead();
+}
+
+void Volume::ReadFilesCallback(int32_t /*result*/,
+                               const std::string& request_id,
+                               const pp::VarDictionary& dictionary) {
+  Tracer::ScopedEvent trace_event("job", "ReadFiles");
   if (!volume_archive_) {
      message_sender_->SendFileSystemError(
          file_system_id_, request_id, "NOT_OPENED");
      return;
   }
 
-  std::string open_request_id(
-      dictionary.Get(request::key::kOpenRequestId).AsString());
-  int64_t offset =
-      request::GetInt64FromString(dictionary, request::key::kOffset);
-  int64_t length =
-      request::GetInt64FromString(dictionary, request::key::kLength);
-  PP_DCHECK(length > 0);  // JavaScript must not make requests with length <= 0.
+  ReadFilesArgs args(
+      request_id,
+      dictionary.Get(request::key::kEncoding).AsString(),
+      request::GetInt64FromString(dictionary, request::key::kArchiveSize));
+
+  // Sort the files in archive order, so all of them are read in a single pass
+  // even for formats that can't seek.
+  pp::VarArray files(dictionary.Get(request::key::kFiles));
+  std::vector<std::pair<int64_t, int64_t> > files_to_read;
+  for (uint32_t i = 0; i < files.GetLength(); ++i) {
+    PP_DCHECK(files.Get(i).is_dictionary());
+    pp::VarDictionary file(files.Get(i));
+    int64_t index = request::GetInt64FromString(file, request::key::kIndex);
+    int64_t max_bytes =
+        request::GetInt64FromString(file, request::key::kLength);
+    PP_DCHECK(max_bytes > 0);  // JavaScript must not make requests with
+                               // length <= 0.
+    files_to_read.push_back(std::make_pair(index, max_bytes));
+  }
+  std::sort(files_to_read.begin(), files_to_read.end());
+
+  // Duplicates are read only once. They are sorted by max bytes, so the last
+  // one is the largest.
+  for (size_t i = 0; i < files_to_read.size(); ++i) {
+    if (i + 1 == files_to_read.size() ||
+        files_to_read[i + 1].first != files_to_read[i].first)
+      args.files.push_back(files_to_read[i]);
+  }
 
-  job_lock_.Acquire();
-  if (open_request_id != reader_request_id_) {
-    // The file is not opened.
+  if (!AcquireReader(request_id, true /* is_bulk */))
+    return;
+
+  ReadFilesContinueCallback(PP_OK, args);
+}
+
+void Volume::ReadFilesContinueCallback(int32_t /*result*/,
+                                       const ReadFilesArgs& args) {
+  Tracer::ScopedEvent trace_event("job", "ReadFiles");
+  bool reader_moved = false;
+  switch (ResumeReader(args.request_id, &reader_moved)) {
+    case RESUME_ABORTED:
+      message_sender_->SendFileSystemError(
+          file_system_id_, args.request_id, "ABORTED");
+      return;
+    case RESUME_WAIT:
+      WaitForReader(callback_factory_.NewCallback(
+          &Volume::ReadFilesContinueCallback, args));
+      return;
+    case RESUME_READY:
+      break;
+  }
+
+  ReadFilesArgs next_args(args);
+  while (next_args.next_file < next_args.files.size()) {
+    int64_t index = next_args.files[next_args.next_file].first;
+    int64_t max_bytes = next_args.files[next_args.next_file].second;
+
+    // The archive is already on the right entry in case the job yielded in
+    // the middle of the file, unless a file was opened in the meantime.
+    if (next_args.offset == 0 || reader_moved) {
+      if (!SeekEntry(next_args.request_id, index, next_args.encoding,
+                     next_args.archive_size)) {
+        return;
+      }
+      reader_moved = false;
+    }
+
+    switch (SendEntryData(next_args.request_id, index, &next_args.offset,
+                          max_bytes)) {
+      case READ_ENTRY_FAILED:
+        message_sender_->SendFileSystemError(file_system_id_,
+                                             next_args.request_id,
+                                             volume_archive_->error_message());
+        ClearJob();
+        return;
+      case READ_ENTRY_YIELDED:
+        // Continue before other bulk jobs, but after the jobs with a higher
+        // priority.
+        YieldReader(next_args.request_id);
+        scheduler_.PostJobFront(JobScheduler::PRIORITY_BULK,
+                                callback_factory_.NewCallback(
+            &Volume::ReadFilesContinueCallback, next_args));
+        return;
+      case READ_ENTRY_DONE:
+        break;
+    }
+
+    // JavaScript learns that a file was read when the chunks of the next one
+    // arrive, so an empty file must be sent as an empty chunk. The last file
+    // is closed by the final response anyway.
+    ++next_args.next_file;
+    if (next_args.offset == 0 &&
+        next_args.next_file < next_args.files.size()) {
+      message_sender_->SendReadFilesDone(file_system_id_, next_args.request_id,
+                                         index, pp::VarArrayBuffer(0),
+                                         true /* has_more_data */);
+    }
+
+    next_args.last_index = index;
+    next_args.offset = 0;
+  }
+
+  ClearJob();
+
+  // Mark the end of the request.
+  message_sender_->SendReadFilesDone(file_system_id_, next_args.request_id,
+                                     next_args.last_index,
+                                     pp::VarArrayBuffer(0),
+                                     false /* has_more_data */);
+}
+
+void Volume::SearchCallback(int32_t /*result*/,
+                            const std::string& request_id,
+                            const pp::VarDictionary& dictionary) {
+  Tracer::ScopedEvent trace_event("job", "Search");
+  if (!volume_archive_) {
+     message_sender_->SendFileSystemError(
+         file_system_id_, request_id, "NOT_OPENED");
+     return;
+  }
+
+  pp::VarArray patterns_array(dictionary.Get(request::key::kPatterns));
+  std::vector<std::string> patterns;
+  size_t pattern_bytes = 0;
+  for (uint32_t i = 0; i < patterns_array.GetLength(); ++i) {
+    PP_DCHECK(patterns_array.Get(i).is_string());
+    patterns.push_back(patterns_array.Get(i).AsString());
+    pattern_bytes += patterns.back().size();
+  }
+  if (pattern_bytes == 0 || pattern_bytes > kMaxSearchPatternBytes) {
     message_sender_->SendFileSystemError(
-        file_system_id_, request_id, "FILE_NOT_OPENED");
-    job_lock_.Release();
+        file_system_id_, request_id, "INVALID_PATTERNS");
     return;
   }
-  job_lock_.Release();
 
-  // Decompress data and send it to JavaScript. Sending data is done in chunks
-  // depending on how many bytes VolumeArchive::ReadData returns.
-  int64_t left_length = length;
-  while (left_length > 0) {
-    const char* destination_buffer = NULL;
-    int64_t read_bytes = volume_archive_->ReadData(
-        offset, left_length, &destination_buffer);
+  int64_t max_hits = -1;
+  if (dictionary.Get(request::key::kMaxHits).is_string()) {
+    max_hits = request::GetInt64FromString(dictionary, request::key::kMaxHits);
+    PP_DCHECK(max_hits > 0);
+  }
 
-    if (read_bytes < 0) {
-      // Error messages should be sent to the read request (request_id), not
-      // open request (open_request_id), as the last one has finished and this
-      // is a read file.
+  SearchArgs args(
+      request_id,
+      dictionary.Get(request::key::kEncoding).AsString(),
+      request::GetInt64FromString(dictionary, request::key::kArchiveSize),
+      max_hits);
+
+  // Search the files in archive order, so all of them are read in a single
+  // pass even for formats that can't seek.
+  for (VolumeEntryTable::EntryId id = VolumeEntryTable::kRootId + 1;
+       id < entry_table_.size(); ++id) {
+    if (!entry_table_.is_directory(id))
+      args.files.push_back(entry_table_.archive_index(id));
+  }
+  std::sort(args.files.begin(), args.files.end());
+
+  if (!AcquireReader(request_id, true /* is_bulk */))
+    return;
+
+  // The matcher of a previous request is left when the request is aborted.
+  delete search_matcher_;
+  search_matcher_ = new PatternMatcher(patterns);
+
+  SearchContinueCallback(PP_OK, args);
+}
+
+void Volume::SearchContinueCallback(int32_t /*result*/,
+                                    const SearchArgs& args) {
+  Tracer::ScopedEvent trace_event("job", "Search");
+  bool reader_moved = false;
+  switch (ResumeReader(args.request_id, &reader_moved)) {
+    case RESUME_ABORTED:
       message_sender_->SendFileSystemError(
-          file_system_id_, request_id, volume_archive_->error_message());
+          file_system_id_, args.request_id, "ABORTED");
+      return;
+    case RESUME_WAIT:
+      WaitForReader(callback_factory_.NewCallback(
+          &Volume::SearchContinueCallback, args));
+      return;
+    case RESUME_READY:
+      break;
+  }
+
+  SearchArgs next_args(args);
+  SearchHitSender sender(message_sender_, file_system_id_,
+                         next_args.request_id, search_matcher_,
+                         next_args.max_hits, &next_args.hit_count);
+  while (next_args.next_file < next_args.files.size() && !sender.IsDone()) {
+    int64_t index = next_args.files[next_args.next_file];
+
+    // The archive is already on the right entry in case the job yielded in
+    // the middle of the file, unless a file was opened in the meantime, and
+    // the matcher may be in the middle of a match.
+    if (next_args.offset == 0 || reader_moved) {
+      if (!SeekEntry(next_args.request_id, index, next_args.encoding,
+                     next_args.archive_size)) {
+        return;
+      }
+      if (next_args.offset == 0)
+        search_matcher_->Reset();
+      reader_moved = false;
+    }
+
+    sender.set_index(index);
+    switch (ReadEntryData(&next_args.offset,
+                          std::numeric_limits<int64_t>::max(),
+                          JobScheduler::PRIORITY_BULK, &sender)) {
+      case READ_ENTRY_FAILED:
+        message_sender_->SendFileSystemError(file_system_id_,
+                                             next_args.request_id,
+                                             volume_archive_->error_message());
+        ClearJob();
+        return;
+      case READ_ENTRY_YIELDED:
+        sender.Flush();
+        // Continue before other bulk jobs, but after the jobs with a higher
+        // priority.
+        YieldReader(next_args.request_id);
+        scheduler_.PostJobFront(JobScheduler::PRIORITY_BULK,
+                                callback_factory_.NewCallback(
+            &Volume::SearchContinueCallback, next_args));
+        return;
+      case READ_ENTRY_DONE:
+        break;
+    }
+
+    next_args.offset = 0;
+    ++next_args.next_file;
+  }
+
+  ClearJob();
+  delete search_matcher_;
+  search_matcher_ = NULL;
 
-      // Should not cleanup VolumeArchive as Volume::CloseFile will be called in
-      // case of failure.
+  sender.Finish();
+}
+
+void Volume::HashEntriesCallback(int32_t /*result*/,
+                                 const std::string& request_id,
+                                 const pp::VarDictionary& dictionary) {
+  Tracer::ScopedEvent trace_event("job", "HashEntries");
+  if (!volume_archive_) {
+     message_sender_->SendFileSystemError(
+         file_system_id_, request_id, "NOT_OPENED");
+     return;
+  }
+
+  Hasher* hasher =
+      Hasher::Create(dictionary.Get(request::key::kAlgorithm).AsString());
+  if (!hasher) {
+    message_sender_->SendFileSystemError(
+        file_system_id_, request_id, "INVALID_ALGORITHM");
+    return;
+  }
+
+  HashEntriesArgs args(
+      request_id,
+      dictionary.Get(request::key::kEncoding).AsString(),
+      request::GetInt64FromString(dictionary, request::key::kArchiveSize));
+
+  // Hash the files in archive order, so all of them are read in a single pass
+  // even for formats that can't seek.
+  args.files =
+      request::GetInt64ArrayFromStrings(dictionary, request::key::kIndexes);
+  std::sort(args.files.begin(), args.files.end());
+  args.files.erase(std::unique(args.files.begin(), args.files.end()),
+                   args.files.end());
+
+  // Only files can be hashed. Any other index is rejected before reading, as
+  // the archive would be read up to its end in order to look for it.
+  std::vector<int64_t> file_indexes;
+  for (VolumeEntryTable::EntryId id = VolumeEntryTable::kRootId + 1;
+       id < entry_table_.size(); ++id) {
+    if (!entry_table_.is_directory(id))
+      file_indexes.push_back(entry_table_.archive_index(id));
+  }
+  std::sort(file_indexes.begin(), file_indexes.end());
+  if (!std::includes(file_indexes.begin(), file_indexes.end(),
+                     args.files.begin(), args.files.end())) {
+    message_sender_->SendFileSystemError(
+        file_system_id_, request_id, "FAILED");
+    delete hasher;
+    return;
+  }
+
+  if (!AcquireReader(request_id, true /* is_bulk */)) {
+    delete hasher;
+    return;
+  }
+
+  // The hasher of a previous request is left when the request is aborted.
+  delete entry_hasher_;
+  entry_hasher_ = hasher;
+
+  HashEntriesContinueCallback(PP_OK, args);
+}
+
+void Volume::HashEntriesContinueCallback(int32_t /*result*/,
+                                         const HashEntriesArgs& args) {
+  Tracer::ScopedEvent trace_event("job", "HashEntries");
+  bool reader_moved = false;
+  switch (ResumeReader(args.request_id, &reader_moved)) {
+    case RESUME_ABORTED:
+      message_sender_->SendFileSystemError(
+          file_system_id_, args.request_id, "ABORTED");
       return;
+    case RESUME_WAIT:
+      WaitForReader(callback_factory_.NewCallback(
+          &Volume::HashEntriesContinueCallback, args));
+      return;
+    case RESUME_READY:
+      break;
+  }
+
+  HashEntriesArgs next_args(args);
+  HashUpdater updater(entry_hasher_);
+  pp::VarArray digests;
+  while (next_args.next_file < next_args.files.size()) {
+    int64_t index = next_args.files[next_args.next_file];
+
+    // The archive is already on the right entry in case the job yielded in
+    // the middle of the file, unless a file was opened in the meantime, and
+    // the hasher has the state of the file.
+    if (next_args.offset == 0 || reader_moved) {
+      if (!SeekEntry(next_args.request_id, index, next_args.encoding,
+                     next_args.archive_size)) {
+        return;
+      }
+      if (next_args.offset == 0)
+        entry_hasher_->Reset();
+      reader_moved = false;
     }
 
-    // Send response back to ReadFile request.
-    pp::VarArrayBuffer array_buffer(read_bytes);
-    if (read_bytes > 0) {
-      char* array_buffer_data = static_cast<char*>(array_buffer.Map());
-      memcpy(array_buffer_data, destination_buffer, read_bytes);
-      array_buffer.Unmap();
+    switch (ReadEntryData(&next_args.offset,
+                          std::numeric_limits<int64_t>::max(),
+                          JobScheduler::PRIORITY_BULK, &updater)) {
+      case READ_ENTRY_FAILED:
+        message_sender_->SendFileSystemError(file_system_id_,
+                                             next_args.request_id,
+                                             volume_archive_->error_message());
+        ClearJob();
+        return;
+      case READ_ENTRY_YIELDED:
+        if (digests.GetLength() > 0) {
+          message_sender_->SendHashEntriesDone(
+              file_system_id_, next_args.request_id, digests,
+              true /* has_more_data */);
+        }
+        // Continue before other bulk jobs, but after the jobs with a higher
+        // priority.
+        YieldReader(next_args.request_id);
+        scheduler_.PostJobFront(JobScheduler::PRIORITY_BULK,
+                                callback_factory_.NewCallback(
+            &Volume::HashEntriesContinueCallback, next_args));
+        return;
+      case READ_ENTRY_DONE:
+        break;
+    }
+
+    pp::VarDictionary digest;
+    std::stringstream ss_index;
+    ss_index << index;
+    digest.Set(request::key::kIndex, ss_index.str());
+    digest.Set(request::key::kDigest, entry_hasher_->Finish());
+    digests.Set(digests.GetLength(), digest);
+    if (digests.GetLength() >= kDigestsPerResponse) {
+      message_sender_->SendHashEntriesDone(
+          file_system_id_, next_args.request_id, digests,
+          true /* has_more_data */);
+      digests = pp::VarArray();
+    }
+
+    next_args.offset = 0;
+    ++next_args.next_file;
+  }
+
+  ClearJob();
+  delete entry_hasher_;
+  entry_hasher_ = NULL;
+
+  // Mark the end of the request.
+  message_sender_->SendHashEntriesDone(file_system_id_, next_args.request_id,
+                                       digests, false /* has_more_data */);
+}
+
+bool Volume::SeekEntry(const std::string& request_id,
+                       int64_t index,
+                       const std::string& encoding,
+                       int64_t archive_size) {
+  if (!volume_archive_->SeekHeader(index)) {
+    // Maybe we're dealing with a streaming archive format (e.g. tar).
+    // We need to re-read this thing everytime.
+    bool raw = volume_archive_->raw_;
+    if (volume_archive_->curr_index > index || raw) {
+      stats_.Add(Stats::ARCHIVE_REINITIALIZATIONS, 1);
+      volume_archive_->Cleanup();
+      delete volume_archive_;
+      volume_archive_ = volume_archive_factory_->Create(
+          volume_reader_factory_->Create(archive_size));
+      volume_archive_->reader()->SetRequestId(reader_request_id_);
+      if (!volume_archive_->Init(encoding, raw)) {
+        message_sender_->SendFileSystemError(
+            file_system_id_, request_id, volume_archive_->error_message());
+        ClearJob();
+        return false;
+      }
     }
+  }
+
+  do {
+  if (volume_archive_->GetNextHeader() == VolumeArchive::RESULT_FAIL) {
+    message_sender_->SendFileSystemError(
+        file_system_id_, request_id, volume_archive_->error_message());
+    ClearJob();
+    return false;
+  }
+  stats_.Add(Stats::HEADERS_SKIPPED, 1);
+  } while (volume_archive_->curr_index <= index);
 
-    bool has_more_data = left_length - read_bytes > 0 && read_bytes > 0;
-    message_sender_->SendReadFileDone(
-        file_system_id_, request_id, array_buffer, has_more_data);
+  return true;
+}
 
+Volume::ReadEntryResult Volume::ReadEntryData(
+    int64_t* offset,
+    int64_t max_bytes,
+    JobScheduler::Priority priority,
+    EntryDataConsumerInterface* consumer) {
+  while (*offset < max_bytes) {
+    const char* buffer = NULL;
+    int64_t read_bytes =
+        volume_archive_->ReadData(*offset, max_bytes - *offset, &buffer);
+    if (read_bytes < 0)
+      return READ_ENTRY_FAILED;
     if (read_bytes == 0)
-      break;  // No more available data.
+      break;  // End of the entry.
+
+    consumer->Consume(buffer, read_bytes);
+    *offset += read_bytes;
+    if (consumer->IsDone())
+      break;
+
+    if (*offset < max_bytes && scheduler_.HasJobsAbove(priority))
+      return READ_ENTRY_YIELDED;
+  }
+  return READ_ENTRY_DONE;
+}
+
+Volume::ReadEntryResult Volume::SendEntryData(const std::string& request_id,
+                                              int64_t index,
+                                              int64_t* offset,
+                                              int64_t max_bytes) {
+  while (*offset < max_bytes) {
+    // Like for READ_FILE, only full size chunks are pooled.
+    int64_t chunk_length = std::min(max_bytes - *offset, kReadFileChunkSize);
+    bool is_pooled = chunk_length == kReadFileChunkSize;
+    pp::VarArrayBuffer array_buffer =
+        is_pooled ? array_buffer_pool_.Acquire(chunk_length)
+                  : pp::VarArrayBuffer(chunk_length);
+    char* data = static_cast<char*>(array_buffer.Map());
+    int64_t read_bytes =
+        volume_archive_->ReadDataInto(*offset, chunk_length, data);
+
+    // A chunk cut short by the end of the entry is sent as a copy of its
+    // data, as the array buffer is bigger than the data.
+    if (read_bytes > 0) {
+      message_sender_->SendReadFilesDone(
+          file_system_id_, request_id, index,
+          read_bytes == chunk_length ? array_buffer
+                                     : CreateArrayBuffer(data, read_bytes),
+          true /* has_more_data */);
+    }
+
+    // The message holds a copy of the data, so the buffer can be reused.
+    array_buffer.Unmap();
+    if (is_pooled)
+      array_buffer_pool_.Release(array_buffer);
+
+    if (read_bytes < 0)
+      return READ_ENTRY_FAILED;
+    *offset += read_bytes;
+    if (read_bytes < chunk_length)
+      break;  // End of the entry.
+
+    if (*offset < max_bytes &&
+        scheduler_.HasJobsAbove(JobScheduler::PRIORITY_BULK)) {
+      return READ_ENTRY_YIELDED;
+    }
+  }
+  return READ_ENTRY_DONE;
+}
+
+pp::VarDictionary Volume::GetStats() {
+  pp::VarDictionary stats = stats_.ToVarDictionary();
+  for (int i = 0; i < JobScheduler::kPriorityCount; ++i) {
+    JobScheduler::WaitStats wait_stats =
+        scheduler_.GetWaitStats(static_cast<JobScheduler::Priority>(i));
+    if (wait_stats.jobs == 0)
+      continue;
+
+    std::stringstream jobs;
+    jobs << wait_stats.jobs;
+    std::stringstream total_wait_us;
+    total_wait_us << wait_stats.total_wait_us;
+    std::stringstream max_wait_us;
+    max_wait_us << wait_stats.max_wait_us;
+
+    pp::VarDictionary priority_stats;
+    priority_stats.Set("jobs", jobs.str());
+    priority_stats.Set("total_wait_us", total_wait_us.str());
+    priority_stats.Set("max_wait_us", max_wait_us.str());
+    stats.Set(std::string(kPriorityNames[i]) + "_jobs", priority_stats);
+  }
+
+  job_lock_.Acquire();
+  int64_t entry_count = entry_count_;
+  int64_t entry_table_bytes = entry_table_bytes_;
+  job_lock_.Release();
+  if (entry_count > 0) {
+    std::stringstream entry_count_string;
+    entry_count_string << entry_count;
+    std::stringstream entry_table_bytes_string;
+    entry_table_bytes_string << entry_table_bytes;
+    stats.Set("entry_count", entry_count_string.str());
+    stats.Set("entry_table_bytes", entry_table_bytes_string.str());
+  }
+  return stats;
+}
+
+bool Volume::AcquireReader(const std::string& request_id, bool is_bulk) {
+  job_lock_.Acquire();
+  // It is illegal to use the reader while another operation is in progress or
+  // another file is opened. The state of a bulk request that yielded, like
+  // search_matcher_, is kept until it continues, so there can't be another
+  // bulk request meanwhile.
+  if (!reader_request_id_.empty() ||
+      (is_bulk && !yielded_request_id_.empty())) {
+    message_sender_->SendFileSystemError(
+        file_system_id_, request_id, "ILLEGAL");
+    job_lock_.Release();
+    return false;
+  }
+  volume_archive_->reader()->SetRequestId(request_id);
+  reader_request_id_ = request_id;
+  if (!yielded_request_id_.empty())
+    yielded_reader_moved_ = true;
+  job_lock_.Release();
+  return true;
+}
+
+void Volume::YieldReader(const std::string& request_id) {
+  job_lock_.Acquire();
+  PP_DCHECK(reader_request_id_ == request_id);
+  reader_request_id_ = "";
+  yielded_request_id_ = request_id;
+  yielded_reader_moved_ = false;
+  job_lock_.Release();
+}
 
-    left_length -= read_bytes;
-    offset += read_bytes;
+Volume::ResumeResult Volume::ResumeReader(const std::string& request_id,
+                                          bool* reader_moved) {
+  job_lock_.Acquire();
+  ResumeResult result = RESUME_READY;
+  *reader_moved = false;
+  if (reader_request_id_ == request_id) {
+    // The first job of the request, which didn't yield yet.
+  } else if (yielded_request_id_ != request_id) {
+    result = RESUME_ABORTED;
+  } else if (!reader_request_id_.empty()) {
+    result = RESUME_WAIT;
+  } else {
+    volume_archive_->reader()->SetRequestId(request_id);
+    reader_request_id_ = request_id;
+    yielded_request_id_ = "";
+    *reader_moved = yielded_reader_moved_;
   }
-  volume_archive_->MaybeDecompressAhead();
+  job_lock_.Release();
+  return result;
 }
 
+void Volume::WaitForReader(const pp::CompletionCallback& job) {
+  PP_DCHECK(!has_reader_waiting_job_);
+  reader_waiting_job_ = job;
+  has_reader_waiting_job_ = true;
+}
 
 void Volume::ClearJob() {
   job_lock_.Acquire();
   reader_request_id_ = "";
   job_lock_.Release();
+
+  // The bulk request which waits for the reader continues before other bulk
+  // jobs, like after yielding.
+  if (has_reader_waiting_job_) {
+    has_reader_waiting_job_ = false;
+    scheduler_.PostJobFront(JobScheduler::PRIORITY_BULK, reader_waiting_job_);
+  }
 }
@@ -5,19 +5,29 @@
 #ifndef VOLUME_H_
 #define VOLUME_H_
 
+#include <map>
 #include <pthread.h>
+#include <string>
+#include <vector>
 
 #include "archive.h"
-#include "ppapi/cpp/instance_handle.h"
 #include "ppapi/cpp/var_array_buffer.h"
 #include "ppapi/cpp/var_dictionary.h"
 #include "ppapi/utility/completion_callback_factory.h"
 #include "ppapi/utility/threading/lock.h"
-#include "ppapi/utility/threading/simple_thread.h"
 
+#include "array_buffer_pool.h"
+#include "hasher.h"
 #include "javascript_requestor_interface.h"
+#include "job_scheduler.h"
 #include "javascript_message_sender_interface.h"
+#include "pattern_matcher.h"
+#include "stats.h"
 #include "volume_archive.h"
+#include "volume_entry_table.h"
+#include "worker_pool.h"
+
+class VolumeReaderJavaScriptStream;
 
 // A factory that creates VolumeArchive(s). Useful for testing.
 class VolumeArchiveFactoryInterface {
@@ -39,23 +49,49 @@ class VolumeReaderFactoryInterface {
   virtual VolumeReader* Create(int64_t archive_size) = 0;
 };
 
+// Receives the data of an archive entry, chunk by chunk, from
+// Volume::ReadEntryData. Used by operations that process whole entries on the
+// worker instead of sending them to JavaScript as they are.
+class EntryDataConsumerInterface {
+ public:
+  virtual ~EntryDataConsumerInterface() {}
+
+  // Consumes length bytes of the entry. data is valid only during the call.
+  virtual void Consume(const char* data, int64_t length) = 0;
+
+  // Returns true once the consumer doesn't need the rest of the entry.
+  virtual bool IsDone() const { return false; }
+};
+
 // Handles all operations like reading metadata and reading files from a single
 // Volume.
 class Volume {
  public:
-  Volume(const pp::InstanceHandle& instance_handle /* Used for workers. */,
+  Volume(WorkerPool* worker_pool /* Used for jobs. */,
          const std::string& file_system_id,
          JavaScriptMessageSenderInterface* message_sender);
 
   // Used by tests to create custom VolumeArchive and VolumeReader objects.
   // VolumeArchiveFactory and VolumeReaderFactory should be allocated with new
   // and the ownership will be passed to Volume on constructing it.
-  Volume(const pp::InstanceHandle& instance_handle /* Used for workers. */,
+  Volume(WorkerPool* worker_pool /* Used for jobs. */,
          const std::string& file_system_id,
          JavaScriptMessageSenderInterface* message_sender,
          VolumeArchiveFactoryInterface* volume_archive_factory,
          VolumeReaderFactoryInterface* volume_reader_factory);
 
+  // Creates a volume for an archive stored in the outer_index-th entry of
+  // outer_volume, which is read directly from outer_volume instead of being
+  // extracted first. outer_request_id is used by outer_volume for requesting
+  // the chunks of its archive from JavaScript. outer_volume must outlive the
+  // volume.
+  Volume(WorkerPool* worker_pool /* Used for jobs. */,
+         const std::string& file_system_id,
+         JavaScriptMessageSenderInterface* message_sender,
+         Volume* outer_volume,
+         const std::string& outer_request_id,
+         int64_t outer_index);
+
   virtual ~Volume();
 
   // Initializes the volume.
@@ -66,14 +102,21 @@ class Volume {
                     const std::string& encoding,
                     int64_t archive_size);
 
+  // Splits the archive into parts with the given sizes, like .zip.001 and
+  // .zip.002, which are read from JavaScript separately. Does nothing for
+  // less than 2 parts. Must be called before ReadMetadata.
+  void SetPartSizes(const std::vector<int64_t>& part_sizes);
+
   // Processes a successful archive chunk read from JavaScript. Read offset
-  // represents the offset from where the data contained in array_buffer starts.
+  // represents the offset from where the data contained in array_buffer starts,
+  // relative to the part with part_index.
   void ReadChunkDone(const std::string& nacl_request_id,
                      const pp::VarArrayBuffer& array_buffer,
-                     int64_t read_offset);
+                     int64_t read_offset,
+                     int part_index);
 
   // Processes an invalid archive chunk read from JavaScript.
-  void ReadChunkError(const std::string& nacl_request_id);
+  void ReadChunkError(const std::string& nacl_request_id, int part_index);
 
   // Processes a successful passphrase read from JavaScript.
   void ReadPassphraseDone(const std::string& nacl_request_id,
@@ -82,12 +125,26 @@ class Volume {
   // Processes an error when requesting a passphrase from JavaScript.
   void ReadPassphraseError(const std::string& nacl_request_id);
 
-  // Opens a file.
+  // Opens a file. A file can be opened while a bulk request, like ReadFiles,
+  // yields, in which case the bulk request continues after the file is
+  // closed.
   void OpenFile(const std::string& request_id,
                 int64_t index,
                 const std::string& encoding,
                 int64_t archive_size);
 
+  // Opens a file by its path inside the archive, without requiring the
+  // JavaScript side to know the index of the file. ReadMetadata must be
+  // called first, as the path is resolved using the entries found by it.
+  void OpenFileByPath(const std::string& request_id,
+                      const std::string& path,
+                      const std::string& encoding,
+                      int64_t archive_size);
+
+  // Sends back the metadata of the entry with the given path. The "entries"
+  // of directories are not included.
+  void StatPath(const std::string& request_id, const std::string& path);
+
   // Closes a file.
   void CloseFile(const std::string& request_id,
                  const std::string& open_request_id);
@@ -101,15 +158,99 @@ class Volume {
   void ReadFile(const std::string& request_id,
                 const pp::VarDictionary& dictionary);
 
+  // Reads the first bytes of many files in a single pass over the archive.
+  // dictionary should contain the files, the encoding and the archive size
+  // with the keys as defined in "request" namespace. Files are read in archive
+  // order, not in the order of the request, and the data is sent back in
+  // chunks tagged with the index of the file.
+  void ReadFiles(const std::string& request_id,
+                 const pp::VarDictionary& dictionary);
+
+  // Searches the files of the archive for literal patterns, in a single pass
+  // over the archive. dictionary should contain the patterns, the encoding,
+  // the archive size and optionally the maximum number of hits, with the keys
+  // as defined in "request" namespace. Only the hits are sent back, each as
+  // the index of the file, the offset in the file and the index of the
+  // pattern. ReadMetadata must be called first.
+  void Search(const std::string& request_id,
+              const pp::VarDictionary& dictionary);
+
+  // Computes the digests of files of the archive, in a single pass over the
+  // archive. dictionary should contain the indexes of the files, the name of
+  // the hash algorithm, the encoding and the archive size with the keys as
+  // defined in "request" namespace. See hasher.h for the algorithms. Only the
+  // digests are sent back, in archive order. Fails if any index is not the
+  // index of a file.
+  void HashEntries(const std::string& request_id,
+                   const pp::VarDictionary& dictionary);
+
+  // Opens another instance of the archive of the volume, used by the volumes
+  // nested in its entries. The archive requests chunks from JavaScript with
+  // reader_request_id, so it can be read at the same time as the files opened
+  // on this volume. Returns NULL in case of failure or if the metadata wasn't
+  // read yet. Blocks while reading the archive, so it must be called from a
+  // job. Can be called from any thread.
+  VolumeArchive* OpenArchiveForReader(const std::string& reader_request_id);
+
+  // Cleans up and deletes an archive returned by OpenArchiveForReader. Can be
+  // called from any thread.
+  void CloseArchiveForReader(const std::string& reader_request_id,
+                             VolumeArchive* archive);
+
+  // Returns the stats of the volume for GET_STATS, together with the time
+  // jobs waited in the queue of the worker per priority and the size of the
+  // entry table. Can be called from any thread.
+  pp::VarDictionary GetStats();
+
   JavaScriptMessageSenderInterface* message_sender() { return message_sender_; }
   JavaScriptRequestorInterface* requestor() { return requestor_; }
+  JavaScriptRequestorInterface* part_requestor(size_t part_index) {
+    return part_requestors_[part_index];
+  }
+  const std::vector<int64_t>& part_sizes() const { return part_sizes_; }
   std::string file_system_id() { return file_system_id_; }
+  Stats* stats() { return &stats_; }
 
  private:
   // Encapsulates arguments to OpenFileCallback, as NewCallback supports binding
   // up to three arguments, while here we have four.
   struct OpenFileArgs;
 
+  // Encapsulates arguments to OpenFileByPathCallback, for the same reason as
+  // OpenFileArgs.
+  struct OpenFileByPathArgs;
+
+  // The state of a READ_FILES request, kept between the jobs of the request.
+  struct ReadFilesArgs;
+
+  // The state of a SEARCH request, kept between the jobs of the request.
+  struct SearchArgs;
+
+  // The state of a HASH_ENTRIES request, kept between the jobs of the request.
+  struct HashEntriesArgs;
+
+  // A READ_FILE request waiting for a job to serve it.
+  struct PendingRead {
+    std::string request_id;
+    std::string open_request_id;
+    int64_t offset;
+    int64_t length;
+  };
+
+  // The result of ResumeReader.
+  enum ResumeResult {
+    RESUME_READY,    // The reader was taken back by the bulk request.
+    RESUME_WAIT,     // The reader is used by a file opened meanwhile.
+    RESUME_ABORTED   // The bulk request is not in progress anymore.
+  };
+
+  // The result of ReadEntryData.
+  enum ReadEntryResult {
+    READ_ENTRY_DONE,     // All the requested bytes were read.
+    READ_ENTRY_YIELDED,  // Stopped as jobs with a higher priority wait.
+    READ_ENTRY_FAILED    // The error message is available in volume_archive_.
+  };
+
   // A callback helper for ReadMetadata.
   void ReadMetadataCallback(int32_t result,
                             const std::string& request_id,
@@ -120,52 +261,170 @@ class Volume {
   void OpenFileCallback(int32_t result,
                         const OpenFileArgs& args);
 
+  // A calback helper for OpenFileByPath.
+  void OpenFileByPathCallback(int32_t result,
+                              const OpenFileByPathArgs& args);
+
+  // A callback helper for StatPath.
+  void StatPathCallback(int32_t result,
+                        const std::string& request_id,
+                        const std::string& path);
+
   // A callback helper for CloseFile.
   void CloseFileCallback(int32_t result,
                          const std::string& request_id,
                          const std::string& open_request_id);
 
-  // A calback helper for ReadFile.
-  void ReadFileCallback(int32_t result,
-                        const std::string& request_id,
-                        const pp::VarDictionary& dictionary);
+  // A calback helper for ReadFile. Serves all the queued reads of the opened
+  // file, not only the read of request_id.
+  void ReadFileCallback(int32_t result, const std::string& request_id);
+
+  // Orders pending reads by offset.
+  static bool IsPendingReadBefore(const PendingRead& first,
+                                  const PendingRead& second);
+
+  // Serves reads[first] to reads[last - 1], sorted by offset, with a single
+  // pass over the opened file from reads[first].offset to span_end. Each read
+  // must start before or at the end of the reads before it. Returns false on
+  // failure, the error message is available in volume_archive_.
+  bool ReadFileSpan(const std::vector<PendingRead>& reads,
+                    size_t first,
+                    size_t last,
+                    int64_t span_end);
+
+  // A calback helper for ReadFiles.
+  void ReadFilesCallback(int32_t result,
+                         const std::string& request_id,
+                         const pp::VarDictionary& dictionary);
+
+  // Reads the files of a READ_FILES request, starting from where the last job
+  // of the request yielded.
+  void ReadFilesContinueCallback(int32_t result, const ReadFilesArgs& args);
+
+  // A calback helper for Search.
+  void SearchCallback(int32_t result,
+                      const std::string& request_id,
+                      const pp::VarDictionary& dictionary);
+
+  // Searches the files of a SEARCH request, starting from where the last job
+  // of the request yielded.
+  void SearchContinueCallback(int32_t result, const SearchArgs& args);
+
+  // A calback helper for HashEntries.
+  void HashEntriesCallback(int32_t result,
+                           const std::string& request_id,
+                           const pp::VarDictionary& dictionary);
+
+  // Hashes the files of a HASH_ENTRIES request, starting from where the last
+  // job of the request yielded.
+  void HashEntriesContinueCallback(int32_t result,
+                                   const HashEntriesArgs& args);
+
+  // Decompresses ahead the next chunk of the file opened with
+  // open_request_id, in case the file is still opened.
+  void DecompressAheadCallback(int32_t result,
+                               const std::string& open_request_id);
+
+  // Moves volume_archive_ to the header of the entry with the given index, so
+  // its data can be read. The archive is reopened in case the entry was
+  // already passed and the format doesn't support seeking. On failure an
+  // error is sent to request_id and the job is cleared.
+  bool SeekEntry(const std::string& request_id,
+                 int64_t index,
+                 const std::string& encoding,
+                 int64_t archive_size);
+
+  // Reads the current entry from *offset up to max_bytes and passes the data
+  // to consumer. *offset is advanced with the consumed bytes. After every
+  // chunk the read yields in case there are jobs with a higher priority than
+  // priority, so it can be continued later from *offset.
+  ReadEntryResult ReadEntryData(int64_t* offset,
+                                int64_t max_bytes,
+                                JobScheduler::Priority priority,
+                                EntryDataConsumerInterface* consumer);
+
+  // Like ReadEntryData, but sends the data to request_id as READ_FILES_DONE
+  // responses for the entry with the given index. The data is decompressed
+  // directly into the array buffers sent, which are pooled.
+  ReadEntryResult SendEntryData(const std::string& request_id,
+                                int64_t index,
+                                int64_t* offset,
+                                int64_t max_bytes);
 
   // Creates a new archive object for this volume.
   VolumeArchive* CreateVolumeArchive(const std::string& request_id,
                                      const std::string& encoding,
                                      int64_t archive_size);
 
+  // Takes the reader of volume_archive_ for request_id. In case another
+  // request uses it, or in case of a bulk request while another bulk request
+  // yielded, sends an ILLEGAL error and returns false.
+  bool AcquireReader(const std::string& request_id, bool is_bulk);
+
+  // Releases the reader of the bulk request request_id, which yields, so files
+  // can be opened until the request continues.
+  void YieldReader(const std::string& request_id);
+
+  // Takes the reader back for the bulk request request_id, which continues
+  // after yielding. *reader_moved is set in case another request used the
+  // reader in the meantime, so the archive is not on the entry of the request
+  // anymore.
+  ResumeResult ResumeReader(const std::string& request_id, bool* reader_moved);
+
+  // Runs job once the reader is released by the file opened while a bulk
+  // request yielded. Must be called from a job.
+  void WaitForReader(const pp::CompletionCallback& job);
+
   // Clears job.
   void ClearJob();
 
+  // Returns the reader with request_id opened by OpenArchiveForReader, or the
+  // reader of volume_archive_ if there is none. Must be called with job_lock_
+  // acquired.
+  VolumeReader* FindReader(const std::string& request_id);
+
+  // Returns the stream of reader which reads the part with part_index from
+  // JavaScript, or NULL if the archive has no such part.
+  VolumeReaderJavaScriptStream* GetPartStream(VolumeReader* reader,
+                                              int part_index);
+
   // Libarchive wrapper instance per volume, shared across all operations.
   VolumeArchive* volume_archive_;
 
   // The file system id for this volume.
   std::string file_system_id_;
 
+  // The entries of the volume, filled on READ_METADATA. Accessed only from
+  // the jobs of scheduler_.
+  VolumeEntryTable entry_table_;
+
+  // Array buffers reused for sending file data to JavaScript. Accessed only
+  // from the jobs of scheduler_.
+  ArrayBufferPool array_buffer_pool_;
+
   // An object that sends messages to JavaScript.
   JavaScriptMessageSenderInterface* message_sender_;
 
-  // A worker for jobs that require blocking operations or a lot of processing
-  // time. Those shouldn't be done on the main thread. The jobs submitted to
-  // this thread are executed in order, so a new job must wait for the last job
-  // to finish.
-  // TODO(cmihail): Consider using multiple workers in case of many jobs to
-  // improve execution speedup. In case multiple workers are added
-  // synchronization between workers might be needed.
-  pp::SimpleThread worker_;
+  // The module wide pool of workers for jobs that require blocking operations
+  // or a lot of processing time. Those shouldn't be done on the main thread.
+  // Not owned.
+  WorkerPool* worker_pool_;
+
+  // Schedules the jobs of the volume by priority on a strand of worker_pool_,
+  // so they run one at a time and a new job must wait for the current job to
+  // finish or yield. Jobs must be posted only through scheduler_.
+  JobScheduler scheduler_;
 
-  // Callback factory used to submit jobs to worker_.
+  // Callback factory used to create the jobs for scheduler_.
   // See "Detailed Description" Note at:
   // https://developer.chrome.com/native-client/
   //     pepper_dev/cpp/classpp_1_1_completion_callback_factory
   //
   // As a minus this would require ugly synchronization between the main thread
-  // and the function that is executed on worker_ construction. Current
+  // and the function that is executed on worker construction. Current
   // implementation is simimlar to examples in $NACL_SDK_ROOT and according to
   // https://chromiumcodereview.appspot.com/lint_patch/issue10790078_24001_25013
-  // it should be safe (see TODO(dmichael)). That's because both worker_ and
+  // it should be safe (see TODO(dmichael)). That's because both scheduler_ and
   // callback_factory_ will be alive during the life of Volume and deleting a
   // Volume is permitted only if there are no requests in progress on
   // JavaScript side (this means no Callbacks in progress).
@@ -174,11 +433,60 @@ class Volume {
   // Request ID of the current reader instance.
   std::string reader_request_id_;
 
+  // The bulk request, READ_FILES, SEARCH or HASH_ENTRIES, which released the
+  // reader while yielding, or empty if none. Only one bulk request can be in
+  // progress at a time. Guarded by job_lock_.
+  std::string yielded_request_id_;
+
+  // Whether another request used the reader since yielded_request_id_
+  // yielded. Guarded by job_lock_.
+  bool yielded_reader_moved_;
+
+  // The job of yielded_request_id_ waiting for the reader, if
+  // has_reader_waiting_job_. Accessed only from the jobs of scheduler_.
+  pp::CompletionCallback reader_waiting_job_;
+  bool has_reader_waiting_job_;
+
   pp::Lock job_lock_;  // A lock for guarding members related to jobs.
 
+  // READ_FILE requests not served yet. Guarded by job_lock_.
+  std::vector<PendingRead> pending_reads_;
+
+  // The size, encoding and format of the archive found by READ_METADATA, used
+  // by OpenArchiveForReader. Guarded by job_lock_.
+  int64_t archive_size_;  // -1 until the metadata is read.
+  std::string archive_encoding_;
+  bool archive_raw_;
+
+  // The number of entries and the bytes used by entry_table_, reported by
+  // GetStats. Guarded by job_lock_.
+  int64_t entry_count_;
+  int64_t entry_table_bytes_;
+
+  // The readers of the archives opened by OpenArchiveForReader, by their
+  // request id. Guarded by job_lock_.
+  std::map<std::string, VolumeReader*> nested_archive_readers_;
+
+  // The matcher of the last SEARCH request, which keeps its state while the
+  // request yields. Accessed only from the jobs of scheduler_.
+  PatternMatcher* search_matcher_;
+
+  // The hasher of the last HASH_ENTRIES request, which keeps its state while
+  // the request yields. Accessed only from the jobs of scheduler_.
+  Hasher* entry_hasher_;
+
+  // The counters and histograms of the volume, updated by the jobs of
+  // scheduler_ and by the readers and archives of the volume.
+  Stats stats_;
+
   // A requestor for making calls to JavaScript.
   JavaScriptRequestorInterface* requestor_;
 
+  // The sizes of the parts of a split archive, and a requestor per part.
+  // Empty if the archive is not split. Set only before READ_METADATA.
+  std::vector<int64_t> part_sizes_;
+  std::vector<JavaScriptRequestorInterface*> part_requestors_;
+
   // A factory for creating VolumeArchive.
   VolumeArchiveFactoryInterface* volume_archive_factory_;
 
@@ -69,10 +69,27 @@ class VolumeArchive {
                            int64_t length,
                            const char** buffer) = 0;
 
+  // Same as VolumeArchive::ReadData, but the data is decompressed directly
+  // into destination, which must have room for at least length bytes. This
+  // avoids copying the data from the internal buffer of VolumeArchive in
+  // case the caller needs it in its own buffer anyway.
+  //
+  // Unlike VolumeArchive::ReadData, it reads exactly length bytes unless the
+  // end of the file is reached.
+  virtual int64_t ReadDataInto(int64_t offset,
+                               int64_t length,
+                               char* destination) = 0;
+
   // Decompress ahead in case there are no more available bytes in the internal
   // buffer.
   virtual void MaybeDecompressAhead() = 0;
 
+  // Returns the offset in the data of VolumeArchive::reader() where the data
+  // of the file reached with VolumeArchive::GetNextHeader starts, in case it
+  // is stored there as is, without any compression or encryption. Otherwise,
+  // returns -1. Must be called before reading the data of the file.
+  virtual int64_t GetStoredDataOffset() = 0;
+
   // Cleans all resources. Should be called only once. Returns true if
   // successful. In case of failure the error message can be obtained with
   // VolumeArchive::error_message().
@@ -6,11 +6,14 @@
 
 #include <algorithm>
 #include <cerrno>
+#include <cstring>
 #include <limits>
 
 #include "archive_entry.h"
 #include "ppapi/cpp/logging.h"
 
+#include "tracer.h"
+
 namespace {
 
 const int64_t kArchiveReadDataError = -1;  // Negative value means error.
@@ -91,7 +94,15 @@ VolumeArchiveLibarchive::VolumeArchiveLibarchive(VolumeReader* reader)
       last_read_data_length_(0),
       decompressed_data_(NULL),
       decompressed_data_size_(0),
-      decompressed_error_(false) {
+      decompressed_error_(false),
+      retained_size_(0),
+      access_pattern_(ACCESS_SEQUENTIAL),
+      last_request_offset_(0),
+      last_request_stride_(0),
+      decompress_window_size_(volume_archive_constants::kDecompressBufferSize),
+      max_decompress_window_size_(
+          volume_archive_constants::kMaximumDecompressWindowSize),
+      stats_(NULL) {
 }
 
 VolumeArchiveLibarchive::~VolumeArchiveLibarchive() {
@@ -166,6 +177,9 @@ VolumeArchive::Result VolumeArchiveLibarchive::GetNextHeader() {
   // Reset to 0 for new VolumeArchive::ReadData operation.
   last_read_data_offset_ = 0;
   decompressed_data_size_ = 0;
+  decompressed_error_ = false;
+  ClearRetainedData();
+  ResetAccessPattern();
 
   ++curr_index;
 
@@ -220,6 +234,9 @@ bool VolumeArchiveLibarchive::SeekHeader(int64_t index) {
   // Reset to 0 for new VolumeArchive::ReadData operation.
   last_read_data_offset_ = 0;
   decompressed_data_size_ = 0;
+  decompressed_error_ = false;
+  ClearRetainedData();
+  ResetAccessPattern();
 
   if (archive_read_seek_header(archive_, index) != ARCHIVE_OK) {
     set_error_message(ArchiveError(
@@ -237,6 +254,8 @@ void VolumeArchiveLibarchive::DecompressData(int64_t offset, int64_t length) {
   // which avoids extra copying in case offset != last_read_data_offset_.
   // The logic will be more complicated because archive_read_data_block offset
   // will not be aligned with the offset of the read request from JavaScript.
+  Stats::ScopedTimer timer(stats_, Stats::DECOMPRESS_DATA_US);
+  Tracer::ScopedEvent trace_event("libarchive", "DecompressData");
 
   // Requests with offset smaller than last read offset are not supported.
   if (offset < last_read_data_offset_) {
@@ -247,20 +266,62 @@ void VolumeArchiveLibarchive::DecompressData(int64_t offset, int64_t length) {
     return;
   }
 
+  if (!SkipData(offset))
+    return;
+
+  // Do not decompress more bytes than the decompress window. The limit is
+  // used to avoid huge memory usage, and it's bigger only for sequential reads
+  // which will use all the decompressed bytes.
+  int64_t left_length = std::min(length, decompress_window_size_);
+  if (static_cast<int64_t>(decompressed_data_buffer_.size()) < left_length)
+    decompressed_data_buffer_.resize(left_length);
+
+  // ReadData will call CustomArchiveRead when calling archive_read_data. The
+  // read should be done with a value similar to length, which is the requested
+  // number of bytes.
+  reader_data_size_ = ReaderDataSize(left_length);
+
+  // Perform the actual copy.
+  int64_t bytes_read = 0;
+  ssize_t size = -1;
+  do {
+    // archive_read_data receives size_t as length parameter, but we limit it to
+    // decompress_window_size_ (see left_length initialization), which is
+    // positive and less than size_t maximum. So conversion from int64_t to
+    // size_t is safe here.
+    size = archive_read_data(
+        archive_, &decompressed_data_buffer_[bytes_read], left_length);
+    if (size < 0) {  // Error.
+      set_error_message(ArchiveError(
+          volume_archive_constants::kArchiveReadDataErrorPrefix, archive_));
+      decompressed_error_ = true;
+      return;
+    }
+    bytes_read += size;
+    left_length -= size;
+  } while (left_length > 0 && size != 0);  // There is still data to read.
+
+  if (stats_)
+    stats_->Add(Stats::BYTES_DECOMPRESSED, bytes_read);
+
+  // VolumeArchiveLibarchive::DecompressData always stores the data from
+  // beginning of the buffer. VolumeArchiveLibarchive::ConsumeData is used
+  // to preserve the bytes that are decompressed but not required by
+  // VolumeArchiveLibarchive::ReadData.
+  decompressed_data_ = &decompressed_data_buffer_[0];
+  decompressed_data_size_ = bytes_read;
+}
+
+bool VolumeArchiveLibarchive::SkipData(int64_t offset) {
   // Request with offset greater than last read offset. Skip not needed bytes.
   // Because files are compressed, seeking is not possible, so all of the bytes
   // until the requested position must be unpacked.
   ssize_t size = -1;
   while (offset > last_read_data_offset_) {
     // ReadData will call CustomArchiveRead when calling archive_read_data. Read
-    // should not request more bytes than possibly needed, so we request either
-    // offset - last_read_data_offset_, kMaximumDataChunkSize in case the former
-    // is too big or kMinimumDataChunkSize in case its too small and we might
-    // end up with too many IPCs.
-    reader_data_size_ =
-        std::max(std::min(offset - last_read_data_offset_,
-                          volume_archive_constants::kMaximumDataChunkSize),
-                 volume_archive_constants::kMinimumDataChunkSize);
+    // should not request more bytes than possibly needed, so we request
+    // offset - last_read_data_offset_, within the limits of ReaderDataSize.
+    reader_data_size_ = ReaderDataSize(offset - last_read_data_offset_);
 
     // No need for an offset in dummy_buffer as it will be ignored anyway.
     // archive_read_data receives size_t as length parameter, but we limit it to
@@ -277,50 +338,80 @@ void VolumeArchiveLibarchive::DecompressData(int64_t offset, int64_t length) {
       set_error_message(ArchiveError(
           volume_archive_constants::kArchiveReadDataErrorPrefix, archive_));
       decompressed_error_ = true;
-      return;
+      return false;
+    }
+    if (stats_) {
+      stats_->Add(Stats::BYTES_DECOMPRESSED, size);
+      stats_->Add(Stats::BYTES_SKIPPED, size);
+    }
+    // Keep the skipped data in case it is requested by a read that arrives
+    // later.
+    if (last_read_data_offset_ + size >
+        offset - volume_archive_constants::kReorderBufferSize) {
+      RetainData(last_read_data_offset_, dummy_buffer_, size);
     }
     last_read_data_offset_ += size;
   }
+  return true;
+}
 
-  // Do not decompress more bytes than we can store internally. The
-  // kDecompressBufferSize limit is used to avoid huge memory usage.
-  int64_t left_length =
-      std::min(length, volume_archive_constants::kDecompressBufferSize);
+void VolumeArchiveLibarchive::SkipDecompressedData(int64_t offset) {
+  int64_t skipped_bytes =
+      std::min(offset - last_read_data_offset_, decompressed_data_size_);
+  if (skipped_bytes <= 0)
+    return;
 
-  // ReadData will call CustomArchiveRead when calling archive_read_data. The
-  // read should be done with a value similar to length, which is the requested
-  // number of bytes, or kMaximumDataChunkSize / kMinimumDataChunkSize
-  // in case length is too big or too small.
-  reader_data_size_ =
-      std::max(std::min(static_cast<int64_t>(left_length),
-                        volume_archive_constants::kMaximumDataChunkSize),
-               volume_archive_constants::kMinimumDataChunkSize);
+  RetainData(last_read_data_offset_, decompressed_data_, skipped_bytes);
+  decompressed_data_ += skipped_bytes;
+  decompressed_data_size_ -= skipped_bytes;
+  last_read_data_offset_ += skipped_bytes;
+}
 
-  // Perform the actual copy.
-  int64_t bytes_read = 0;
-  do {
-    // archive_read_data receives size_t as length parameter, but we limit it to
-    // volume_archive_constants::kMinimumDataChunkSize (see left_length
-    // initialization), which is positive and less than size_t maximum.
-    // So conversion from int64_t to size_t is safe here.
-    size = archive_read_data(
-        archive_, decompressed_data_buffer_ + bytes_read, left_length);
-    if (size < 0) {  // Error.
-      set_error_message(ArchiveError(
-          volume_archive_constants::kArchiveReadDataErrorPrefix, archive_));
-      decompressed_error_ = true;
-      return;
+void VolumeArchiveLibarchive::RetainData(int64_t offset,
+                                         const char* data,
+                                         int64_t length) {
+  PP_DCHECK(retained_ranges_.empty() ||
+            retained_ranges_.back().offset +
+                    static_cast<int64_t>(retained_ranges_.back().data.size()) <=
+                offset);
+
+  // Keep only the end of data in case it doesn't fit.
+  if (length > volume_archive_constants::kReorderBufferSize) {
+    data += length - volume_archive_constants::kReorderBufferSize;
+    offset += length - volume_archive_constants::kReorderBufferSize;
+    length = volume_archive_constants::kReorderBufferSize;
+  }
+
+  while (retained_size_ + length >
+         volume_archive_constants::kReorderBufferSize) {
+    retained_size_ -= retained_ranges_.front().data.size();
+    retained_ranges_.pop_front();
+  }
+
+  retained_ranges_.push_back(RetainedRange());
+  retained_ranges_.back().offset = offset;
+  retained_ranges_.back().data.assign(data, data + length);
+  retained_size_ += length;
+}
+
+int64_t VolumeArchiveLibarchive::ReadRetainedData(int64_t offset,
+                                                  int64_t length,
+                                                  const char** buffer) {
+  for (size_t i = 0; i < retained_ranges_.size(); ++i) {
+    const RetainedRange& range = retained_ranges_[i];
+    int64_t range_end = range.offset + range.data.size();
+    if (range.offset <= offset && offset < range_end) {
+      *buffer = &range.data[offset - range.offset];
+      return std::min(length, range_end - offset);
     }
-    bytes_read += size;
-    left_length -= size;
-  } while (left_length > 0 && size != 0);  // There is still data to read.
+  }
+  return 0;
+}
 
-  // VolumeArchiveLibarchive::DecompressData always stores the data from
-  // beginning of the buffer. VolumeArchiveLibarchive::ConsumeData is used
-  // to preserve the bytes that are decompressed but not required by
-  // VolumeArchiveLibarchive::ReadData.
-  decompressed_data_ = decompressed_data_buffer_;
-  decompressed_data_size_ = bytes_read;
+void VolumeArchiveLibarchive::ClearRetainedData() {
+  // swap() is used instead of clear() in order to release the memory.
+  std::deque<RetainedRange>().swap(retained_ranges_);
+  retained_size_ = 0;
 }
 
 bool VolumeArchiveLibarchive::Cleanup() {
@@ -333,6 +424,7 @@ bool VolumeArchiveLibarchive::Cleanup() {
   }
   archive_ = NULL;
 
+  ClearRetainedData();
   CleanupReader();
 
   return returnValue;
@@ -351,6 +443,24 @@ int64_t VolumeArchiveLibarchive::ReadData(int64_t offset,
       archive_entry_size(current_archive_entry_) <= offset)
     return 0;
 
+  // A read that arrives after a read from a bigger offset is served from the
+  // reorder buffer, if possible. It doesn't move libarchive, so it doesn't
+  // change the access pattern either.
+  if (offset < last_read_data_offset_) {
+    int64_t retained_bytes = ReadRetainedData(offset, length, buffer);
+    if (retained_bytes > 0) {
+      if (stats_)
+        stats_->Add(Stats::BYTES_FROM_REORDER_BUFFER, retained_bytes);
+      return retained_bytes;
+    }
+  }
+
+  UpdateAccessPattern(offset);
+
+  // The data decompressed ahead until offset is not needed by this read.
+  if (offset > last_read_data_offset_)
+    SkipDecompressedData(offset);
+
   // In case of first read or no more available data in the internal buffer or
   // offset is different from the last_read_data_offset_, then force
   // VolumeArchiveLibarchive::DecompressData as the decompressed data is
@@ -375,13 +485,185 @@ int64_t VolumeArchiveLibarchive::ReadData(int64_t offset,
   last_read_data_offset_ += read_bytes;
 
   PP_DCHECK(decompressed_data_ + decompressed_data_size_ <=
-            decompressed_data_buffer_ +
-                volume_archive_constants::kDecompressBufferSize);
+            &decompressed_data_buffer_[0] + decompressed_data_buffer_.size());
 
   return read_bytes;
 }
 
+int64_t VolumeArchiveLibarchive::ReadDataInto(int64_t offset,
+                                              int64_t length,
+                                              char* destination) {
+  PP_DCHECK(length > 0);              // Length must be at least 1.
+  PP_DCHECK(current_archive_entry_);  // Check that GetNextHeader was called at
+                                      // least once. In case it wasn't, this is
+                                      // a programmer error.
+
+  // End of archive.
+  if (archive_entry_size_is_set(current_archive_entry_) &&
+      archive_entry_size(current_archive_entry_) <= offset)
+    return 0;
+
+  if (decompressed_error_)
+    return kArchiveReadDataError;
+
+  // A read that arrives after a read from a bigger offset is served from the
+  // reorder buffer, if possible. Like for ReadData, only the rest of the read
+  // changes the access pattern.
+  int64_t bytes_read = 0;
+  while (bytes_read < length && offset < last_read_data_offset_) {
+    const char* retained_data = NULL;
+    int64_t retained_bytes =
+        ReadRetainedData(offset, length - bytes_read, &retained_data);
+    if (retained_bytes == 0)
+      break;
+    memcpy(destination + bytes_read, retained_data, retained_bytes);
+    if (stats_)
+      stats_->Add(Stats::BYTES_FROM_REORDER_BUFFER, retained_bytes);
+    bytes_read += retained_bytes;
+    offset += retained_bytes;
+  }
+  if (bytes_read == length)
+    return bytes_read;
+
+  // Requests with offset smaller than last read offset are not supported.
+  if (offset < last_read_data_offset_) {
+    set_error_message(
+        std::string(volume_archive_constants::kArchiveReadDataErrorPrefix) +
+        "Reading backwards is not supported.");
+    decompressed_error_ = true;
+    return kArchiveReadDataError;
+  }
+
+  UpdateAccessPattern(offset);
+  last_read_data_length_ = length;  // Used for decompress ahead.
+
+  // First use the bytes already decompressed, e.g. by MaybeDecompressAhead.
+  SkipDecompressedData(offset);
+  if (offset == last_read_data_offset_ && decompressed_data_size_ > 0) {
+    int64_t decompressed_bytes =
+        std::min(decompressed_data_size_, length - bytes_read);
+    memcpy(destination + bytes_read, decompressed_data_, decompressed_bytes);
+    decompressed_data_ += decompressed_bytes;
+    decompressed_data_size_ -= decompressed_bytes;
+    last_read_data_offset_ += decompressed_bytes;
+    bytes_read += decompressed_bytes;
+    offset += decompressed_bytes;
+    if (bytes_read == length)
+      return bytes_read;
+  }
+
+  // All the bytes decompressed ahead were used, so libarchive continues from
+  // last_read_data_offset_.
+  PP_DCHECK(decompressed_data_size_ == 0);
+  if (!SkipData(offset))
+    return kArchiveReadDataError;
+
+  // Decompress the rest of the bytes directly into destination.
+  reader_data_size_ = ReaderDataSize(length - bytes_read);
+  while (bytes_read < length) {
+    // archive_read_data receives size_t as length parameter, so limit every
+    // call to kDecompressBufferSize, which is less than size_t maximum.
+    ssize_t size = archive_read_data(
+        archive_,
+        destination + bytes_read,
+        std::min(length - bytes_read,
+                 volume_archive_constants::kDecompressBufferSize));
+    if (size < 0) {  // Error.
+      set_error_message(ArchiveError(
+          volume_archive_constants::kArchiveReadDataErrorPrefix, archive_));
+      decompressed_error_ = true;
+      return kArchiveReadDataError;
+    }
+    if (size == 0)
+      break;  // End of file.
+    if (stats_)
+      stats_->Add(Stats::BYTES_DECOMPRESSED, size);
+    bytes_read += size;
+    last_read_data_offset_ += size;
+  }
+
+  return bytes_read;
+}
+
 void VolumeArchiveLibarchive::MaybeDecompressAhead() {
-  if (decompressed_data_size_ == 0)
-    DecompressData(last_read_data_offset_, last_read_data_length_);
+  // Sequential reads will use a whole window of data, while for other reads
+  // only the length of the last read is a good guess.
+  if (decompressed_data_size_ == 0) {
+    DecompressData(last_read_data_offset_,
+                   access_pattern_ == ACCESS_SEQUENTIAL
+                       ? decompress_window_size_
+                       : last_read_data_length_);
+  }
+}
+
+int64_t VolumeArchiveLibarchive::GetStoredDataOffset() {
+  PP_DCHECK(current_archive_entry_);  // Check that GetNextHeader was called at
+                                      // least once.
+
+  // With a compression filter, like for tar.gz, the offsets of libarchive
+  // are not offsets in the data of reader().
+  if (archive_filter_count(archive_) != 1 ||
+      archive_filter_code(archive_, 0) != ARCHIVE_FILTER_NONE ||
+      archive_entry_is_data_encrypted(current_archive_entry_) ||
+      archive_entry_sparse_count(current_archive_entry_) > 0) {
+    return -1;
+  }
+
+  switch (archive_format(archive_) & ARCHIVE_FORMAT_BASE_MASK) {
+    case ARCHIVE_FORMAT_TAR:
+      break;
+    case ARCHIVE_FORMAT_ZIP:
+      // libarchive tells the compression method of a ZIP entry only in the
+      // name of the format.
+      if (!strstr(archive_format_name(archive_), "(uncompressed)"))
+        return -1;
+      break;
+    default:
+      return -1;
+  }
+
+  // The header is consumed, but none of the data, so this is where the data
+  // of the entry starts.
+  return archive_filter_bytes(archive_, 0);
+}
+
+void VolumeArchiveLibarchive::UpdateAccessPattern(int64_t offset) {
+  int64_t stride = offset - last_request_offset_;
+  if (offset == last_read_data_offset_) {
+    access_pattern_ = ACCESS_SEQUENTIAL;
+    decompress_window_size_ = std::min(2 * decompress_window_size_,
+                                       max_decompress_window_size_);
+  } else if (offset > last_read_data_offset_ &&
+             stride == last_request_stride_) {
+    // Keep the window, as the data between the reads is skipped anyway.
+    access_pattern_ = ACCESS_STRIDED;
+  } else {
+    access_pattern_ = ACCESS_RANDOM;
+    decompress_window_size_ = volume_archive_constants::kDecompressBufferSize;
+  }
+  last_request_offset_ = offset;
+  last_request_stride_ = stride;
+}
+
+int64_t VolumeArchiveLibarchive::ReaderDataSize(int64_t length) const {
+  // The decompress window grows only for sequential reads, which use all the
+  // data read ahead, so the reads from VolumeReader can grow with it.
+  int64_t max_size =
+      std::max(decompress_window_size_,
+               volume_archive_constants::kMaximumDataChunkSize);
+  return std::max(std::min(length, max_size),
+                  volume_archive_constants::kMinimumDataChunkSize);
+}
+
+void VolumeArchiveLibarchive::ResetAccessPattern() {
+  access_pattern_ = ACCESS_SEQUENTIAL;
+  last_request_offset_ = 0;
+  last_request_stride_ = 0;
+  decompress_window_size_ = volume_archive_constants::kDecompressBufferSize;
+  // Release the memory of a grown window. swap() is used instead of clear()
+  // in order to release the memory.
+  if (static_cast<int64_t>(decompressed_data_buffer_.size()) >
+      volume_archive_constants::kDecompressBufferSize) {
+    std::vector<char>().swap(decompressed_data_buffer_);
+  }
 }
@@ -5,10 +5,13 @@
 #ifndef VOLUME_ARCHIVE_LIBARCHIVE_H_
 #define VOLUME_ARCHIVE_LIBARCHIVE_H_
 
+#include <deque>
 #include <string>
+#include <vector>
 
 #include "archive.h"
 
+#include "stats.h"
 #include "volume_archive.h"
 
 // A namespace with constants used by VolumeArchiveLibarchive.
@@ -28,24 +31,40 @@ const char kArchiveReadFreeErrorPrefix[] = "Error at archive free: ";
 // Should be positive and less than size_t maximum.
 const int64_t kDummyBufferSize = 512 * 1024;  // 512 KB
 
-// The size of the buffer used by ReadInProgress to decompress data.
+// The size of the buffer used by ReadInProgress to decompress data. It is
+// also the initial size of the decompress window of an entry.
 // Should be positive and less than size_t maximum.
 const int64_t kDecompressBufferSize = 512 * 1024;  // 512 KB.
 
-// The maximum data chunk size for VolumeReader::Read requests.
-// Should be positive.
+// The default maximum size of the decompress window for sequential reads.
+// Should be at least kDecompressBufferSize and less than size_t maximum.
+const int64_t kMaximumDecompressWindowSize = 4 * 1024 * 1024;  // 4 MB.
+
+// The maximum data chunk size for VolumeReader::Read requests, unless the
+// decompress window grew bigger for sequential reads. Should be positive.
 const int64_t kMaximumDataChunkSize = 512 * 1024;  // 512 KB.
 
 // The minimum data chunk size for VolumeReader::Read requests.
 // Should be positive.
 const int64_t kMinimumDataChunkSize = 32 * 1024;  // 16 KB.
 
+// The maximum size of the skipped decompressed data kept for reads that
+// arrive out of order.
+const int64_t kReorderBufferSize = 4 * 1024 * 1024;  // 4 MB.
+
 }  // namespace volume_archive_constants
 
 // Defines an implementation of VolumeArchive that wraps all libarchive
 // operations.
 class VolumeArchiveLibarchive : public VolumeArchive {
  public:
+  // The access pattern of the reads of the current entry.
+  enum AccessPattern {
+    ACCESS_SEQUENTIAL,  // Every read starts where the previous one ended.
+    ACCESS_STRIDED,     // Reads skip forward with a constant stride.
+    ACCESS_RANDOM       // Anything else.
+  };
+
   explicit VolumeArchiveLibarchive(VolumeReader* reader);
 
   virtual ~VolumeArchiveLibarchive();
@@ -68,18 +87,80 @@ class VolumeArchiveLibarchive : public VolumeArchive {
                            int64_t length,
                            const char** buffer);
 
+  // See volume_archive_interface.h.
+  virtual int64_t ReadDataInto(int64_t offset,
+                               int64_t length,
+                               char* destination);
+
   // See volume_archive_interface.h.
   virtual void MaybeDecompressAhead();
 
+  // See volume_archive_interface.h.
+  virtual int64_t GetStoredDataOffset();
+
   // See volume_archive_interface.h.
   virtual bool Cleanup();
 
   int64_t reader_data_size() const { return reader_data_size_; }
 
+  AccessPattern access_pattern() const { return access_pattern_; }
+  int64_t decompress_window_size() const { return decompress_window_size_; }
+
+  // Sets the maximum size of the decompress window. The window grows up to
+  // it for sequential reads. Must be at least kDecompressBufferSize.
+  void set_max_decompress_window_size(int64_t max_decompress_window_size) {
+    max_decompress_window_size_ = max_decompress_window_size;
+  }
+
+  // Sets the stats updated with the decompressed data. NULL by default, so
+  // nothing is counted. VolumeArchiveLibarchive does not own the stats
+  // pointer.
+  void set_stats(Stats* stats) { stats_ = stats; }
+
  private:
   // Decompress length bytes of data starting from offset.
   void DecompressData(int64_t offset, int64_t length);
 
+  // A range of skipped decompressed data kept in the reorder buffer.
+  struct RetainedRange {
+    int64_t offset;
+    std::vector<char> data;
+  };
+
+  // Discards the decompressed bytes until offset. Returns false on failure.
+  bool SkipData(int64_t offset);
+
+  // Consumes the data decompressed ahead up to offset, or all of it in case
+  // offset is after its end. The consumed data is kept in the reorder buffer.
+  void SkipDecompressedData(int64_t offset);
+
+  // Keeps length bytes of data starting from offset in the reorder buffer.
+  // The oldest data is dropped to stay under kReorderBufferSize.
+  void RetainData(int64_t offset, const char* data, int64_t length);
+
+  // Sets *buffer to the data starting from offset in the reorder buffer and
+  // returns its size, at most length. Returns 0 in case the data at offset is
+  // not in the reorder buffer.
+  int64_t ReadRetainedData(int64_t offset,
+                           int64_t length,
+                           const char** buffer);
+
+  // Drops all the data in the reorder buffer.
+  void ClearRetainedData();
+
+  // Updates the access pattern with a read from offset and resizes the
+  // decompress window accordingly. Only the reads that move libarchive count,
+  // not the ones served from the reorder buffer.
+  void UpdateAccessPattern(int64_t offset);
+
+  // Returns the size of the VolumeReader::Read requests for reading length
+  // bytes of compressed data: length within kMinimumDataChunkSize and
+  // kMaximumDataChunkSize, or the decompress window if it is bigger.
+  int64_t ReaderDataSize(int64_t length) const;
+
+  // Resets the access pattern and the decompress window for a new entry.
+  void ResetAccessPattern();
+
   // The size of the requested data from VolumeReader.
   int64_t reader_data_size_;
 
@@ -122,9 +203,9 @@ class VolumeArchiveLibarchive : public VolumeArchive {
   // situations restarting decompressing the file from the beginning.
   char* decompressed_data_;
 
-  // The actual buffer that contains the decompressed data.
-  char decompressed_data_buffer_
-      [volume_archive_constants::kDecompressBufferSize];
+  // The actual buffer that contains the decompressed data. Grows up to
+  // max_decompress_window_size_ with the decompress window.
+  std::vector<char> decompressed_data_buffer_;
 
   // The size of valid data starting from decompressed_data_ that is stored
   // inside decompressed_data_buffer_.
@@ -132,6 +213,35 @@ class VolumeArchiveLibarchive : public VolumeArchive {
 
   // True if VolumeArchiveLibarchive::DecompressData failed.
   bool decompressed_error_;
+
+  // The reorder buffer. Clients like the Files app issue parallel reads which
+  // can arrive in a different order than the order of their offsets. As
+  // reading backwards would mean decompressing the entry again from the
+  // beginning, the data skipped to reach a bigger offset is kept for a while
+  // here, sorted by offset.
+  std::deque<RetainedRange> retained_ranges_;
+
+  // The total size of the data in retained_ranges_.
+  int64_t retained_size_;
+
+  // The access pattern of the current entry, guessed from the offsets of its
+  // reads.
+  AccessPattern access_pattern_;
+
+  // The offset of the last read of the current entry and the distance from
+  // the read before it. Used to detect strided reads.
+  int64_t last_request_offset_;
+  int64_t last_request_stride_;
+
+  // The maximum number of bytes decompressed at once, by both
+  // DecompressData and MaybeDecompressAhead. Doubles with every sequential
+  // read up to max_decompress_window_size_, and goes back to
+  // kDecompressBufferSize on random reads.
+  int64_t decompress_window_size_;
+  int64_t max_decompress_window_size_;
+
+  // The stats of the volume. Can be NULL.
+  Stats* stats_;
 };
 
 #endif  // VOLUME_ARCHIVE_LIBARCHIVE_H_
@@ -0,0 +1,260 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "volume_entry_table.h"
+
+#include <cstring>
+
+#include "ppapi/cpp/logging.h"
+
+namespace {
+
+const char kPathDelimiter = '/';
+
+// The initial number of slots for the hash tables. Must be a power of 2.
+const size_t kInitialSlotCount = 64;
+
+// Marks an empty slot in the hash tables.
+const uint32_t kEmptySlot = 0xFFFFFFFF;
+
+// FNV-1a hash for entry names.
+uint32_t HashName(const char* name, size_t length) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; ++i) {
+    hash ^= static_cast<uint8_t>(name[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+// Hash for (parent id, name offset) pairs. As names are interned, two entries
+// with the same parent and the same name offset are the same entry.
+uint32_t HashChild(uint32_t parent_id, uint32_t name_offset) {
+  uint64_t key = (static_cast<uint64_t>(parent_id) << 32) | name_offset;
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  return static_cast<uint32_t>(key);
+}
+
+}  // namespace
+
+const VolumeEntryTable::EntryId VolumeEntryTable::kRootId;
+const VolumeEntryTable::EntryId VolumeEntryTable::kInvalidId;
+
+VolumeEntryTable::VolumeEntryTable() {
+  Clear();
+}
+
+void VolumeEntryTable::Clear() {
+  // swap() is used instead of clear() in order to release the memory.
+  std::vector<int64_t>().swap(sizes_);
+  std::vector<int64_t>().swap(modification_times_);
+  std::vector<int64_t>().swap(archive_indexes_);
+  std::vector<EntryId>().swap(parent_ids_);
+  std::vector<uint32_t>().swap(name_offsets_);
+  std::vector<uint8_t>().swap(flags_);
+  std::vector<char>().swap(name_pool_);
+  std::vector<uint32_t>(kInitialSlotCount, kEmptySlot).swap(name_slots_);
+  std::vector<EntryId>(kInitialSlotCount, kEmptySlot).swap(child_slots_);
+  name_count_ = 0;
+
+  // The root directory has an empty name and is its own parent.
+  EntryId root_id = AppendEntry(kRootId, InternName("", 0));
+  PP_DCHECK(root_id == kRootId);
+  flags_[root_id] = kDirectoryFlag;
+}
+
+VolumeEntryTable::EntryId VolumeEntryTable::AddEntry(
+    const std::string& path,
+    int64_t archive_index,
+    bool is_directory,
+    int64_t size,
+    time_t modification_time) {
+  // If the path starts with ./ then skip it.  The FSP layers can't handle this
+  // scenario and just keep doing ././././.  The libarchive layers can handle
+  // this fine though.
+  size_t begin = 0;
+  while (path.compare(begin, 2, "./") == 0)
+    begin += 2;
+
+  // Walk the path one component at a time. Empty components, like the one
+  // after the trailing '/' of directories, are ignored.
+  EntryId id = kInvalidId;
+  EntryId parent_id = kRootId;
+  while (begin < path.size()) {
+    size_t end = path.find(kPathDelimiter, begin);
+    if (end == std::string::npos)
+      end = path.size();
+
+    if (end > begin) {
+      uint32_t name_offset = InternName(path.data() + begin, end - begin);
+      id = FindChild(parent_id, name_offset);
+      if (id == kInvalidId) {
+        // Directories on the way to the entry get the modification time of
+        // the entry until (and if) their own header is found.
+        id = AppendEntry(parent_id, name_offset);
+        flags_[id] = kDirectoryFlag;
+        modification_times_[id] = modification_time;
+      }
+      parent_id = id;
+    }
+    begin = end + 1;
+  }
+
+  if (id == kInvalidId)
+    return kInvalidId;
+
+  // Update the attributes of the entry itself. In case the entry is a
+  // directory that was created for its children, its children are preserved.
+  sizes_[id] = size;
+  modification_times_[id] = modification_time;
+  archive_indexes_[id] = archive_index;
+  flags_[id] = is_directory ? kDirectoryFlag : 0;
+  return id;
+}
+
+VolumeEntryTable::EntryId VolumeEntryTable::FindEntry(
+    const std::string& path) const {
+  size_t begin = 0;
+  while (path.compare(begin, 2, "./") == 0)
+    begin += 2;
+
+  EntryId id = kRootId;
+  while (begin < path.size()) {
+    size_t end = path.find(kPathDelimiter, begin);
+    if (end == std::string::npos)
+      end = path.size();
+
+    if (end > begin) {
+      uint32_t name_offset = FindName(path.data() + begin, end - begin);
+      if (name_offset == kInvalidId)
+        return kInvalidId;
+      id = FindChild(id, name_offset);
+      if (id == kInvalidId)
+        return kInvalidId;
+    }
+    begin = end + 1;
+  }
+
+  return id;
+}
+
+void VolumeEntryTable::Compact() {
+  // Copying a vector allocates only the memory needed for its elements.
+  std::vector<int64_t>(sizes_).swap(sizes_);
+  std::vector<int64_t>(modification_times_).swap(modification_times_);
+  std::vector<int64_t>(archive_indexes_).swap(archive_indexes_);
+  std::vector<EntryId>(parent_ids_).swap(parent_ids_);
+  std::vector<uint32_t>(name_offsets_).swap(name_offsets_);
+  std::vector<uint8_t>(flags_).swap(flags_);
+  std::vector<char>(name_pool_).swap(name_pool_);
+}
+
+size_t VolumeEntryTable::MemoryUsage() const {
+  return sizes_.capacity() * sizeof(int64_t) +
+         modification_times_.capacity() * sizeof(int64_t) +
+         archive_indexes_.capacity() * sizeof(int64_t) +
+         parent_ids_.capacity() * sizeof(EntryId) +
+         name_offsets_.capacity() * sizeof(uint32_t) +
+         flags_.capacity() * sizeof(uint8_t) +
+         name_pool_.capacity() * sizeof(char) +
+         name_slots_.capacity() * sizeof(uint32_t) +
+         child_slots_.capacity() * sizeof(EntryId);
+}
+
+uint32_t VolumeEntryTable::InternName(const char* name, size_t length) {
+  uint32_t name_offset = FindName(name, length);
+  if (name_offset != kInvalidId)
+    return name_offset;
+
+  name_offset = name_pool_.size();
+  name_pool_.insert(name_pool_.end(), name, name + length);
+  name_pool_.push_back('\0');
+
+  if (2 * (name_count_ + 1) > name_slots_.size())
+    GrowNameSlots();
+  IndexName(name_offset);
+  ++name_count_;
+  return name_offset;
+}
+
+uint32_t VolumeEntryTable::FindName(const char* name, size_t length) const {
+  size_t mask = name_slots_.size() - 1;
+  for (size_t slot = HashName(name, length) & mask;;
+       slot = (slot + 1) & mask) {
+    uint32_t name_offset = name_slots_[slot];
+    if (name_offset == kEmptySlot)
+      return kInvalidId;
+    const char* stored_name = &name_pool_[name_offset];
+    if (strncmp(stored_name, name, length) == 0 && stored_name[length] == '\0')
+      return name_offset;
+  }
+}
+
+VolumeEntryTable::EntryId VolumeEntryTable::FindChild(
+    EntryId parent_id,
+    uint32_t name_offset) const {
+  size_t mask = child_slots_.size() - 1;
+  for (size_t slot = HashChild(parent_id, name_offset) & mask;;
+       slot = (slot + 1) & mask) {
+    EntryId id = child_slots_[slot];
+    if (id == kEmptySlot)
+      return kInvalidId;
+    if (parent_ids_[id] == parent_id && name_offsets_[id] == name_offset)
+      return id;
+  }
+}
+
+VolumeEntryTable::EntryId VolumeEntryTable::AppendEntry(EntryId parent_id,
+                                                        uint32_t name_offset) {
+  EntryId id = parent_ids_.size();
+  // The root directory is not a child of any directory, so it's not indexed.
+  if (id != kRootId && 2 * (size() + 1) > child_slots_.size())
+    GrowChildSlots();
+
+  sizes_.push_back(0);
+  modification_times_.push_back(0);
+  archive_indexes_.push_back(-1);
+  parent_ids_.push_back(parent_id);
+  name_offsets_.push_back(name_offset);
+  flags_.push_back(0);
+
+  if (id != kRootId)
+    IndexChild(id);
+  return id;
+}
+
+void VolumeEntryTable::IndexName(uint32_t name_offset) {
+  const char* name = &name_pool_[name_offset];
+  size_t mask = name_slots_.size() - 1;
+  size_t slot = HashName(name, strlen(name)) & mask;
+  while (name_slots_[slot] != kEmptySlot)
+    slot = (slot + 1) & mask;
+  name_slots_[slot] = name_offset;
+}
+
+void VolumeEntryTable::IndexChild(EntryId id) {
+  size_t mask = child_slots_.size() - 1;
+  size_t slot = HashChild(parent_ids_[id], name_offsets_[id]) & mask;
+  while (child_slots_[slot] != kEmptySlot)
+    slot = (slot + 1) & mask;
+  child_slots_[slot] = id;
+}
+
+void VolumeEntryTable::GrowNameSlots() {
+  std::vector<uint32_t> old_slots(name_slots_.size() * 2, kEmptySlot);
+  old_slots.swap(name_slots_);
+  for (size_t i = 0; i < old_slots.size(); ++i) {
+    if (old_slots[i] != kEmptySlot)
+      IndexName(old_slots[i]);
+  }
+}
+
+void VolumeEntryTable::GrowChildSlots() {
+  std::vector<EntryId>(child_slots_.size() * 2, kEmptySlot)
+      .swap(child_slots_);
+  for (EntryId id = kRootId + 1; id < size(); ++id)
+    IndexChild(id);
+}
@@ -0,0 +1,121 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOLUME_ENTRY_TABLE_H_
+#define VOLUME_ENTRY_TABLE_H_
+
+#include <ctime>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Stores the entries of a volume as a struct of arrays. Every attribute of an
+// entry lives in its own flat vector and names are kept only once inside a
+// string pool, so the per entry overhead stays in the range of tens of bytes
+// even for archives with millions of entries.
+//
+// Entries are identified by their position in the table. The root directory
+// is always the first entry and parents are always added before their
+// children, so a parent id is always smaller than the ids of its children.
+//
+// The table is not thread safe and should be used from one thread only.
+class VolumeEntryTable {
+ public:
+  typedef uint32_t EntryId;
+
+  // The id of the root directory.
+  static const EntryId kRootId = 0;
+
+  // Returned in case an entry is not present.
+  static const EntryId kInvalidId = 0xFFFFFFFF;
+
+  VolumeEntryTable();
+
+  // Removes all entries except the root directory.
+  void Clear();
+
+  // Adds an entry with its complete path inside the archive. Directories on
+  // the way to the entry are created in case they don't exist yet, as some
+  // archives don't store them or store them after the files inside them. In
+  // case the entry already exists, then its attributes are updated. Returns
+  // the id of the entry or kInvalidId for an empty path.
+  EntryId AddEntry(const std::string& path,
+                   int64_t archive_index,
+                   bool is_directory,
+                   int64_t size,
+                   time_t modification_time);
+
+  // Returns the id of the entry with the given path or kInvalidId if there is
+  // no such entry. The path may start with '/' and directories may end with
+  // '/'. Every path component costs one hash table lookup for its name and
+  // one for the entry itself, so the lookup doesn't depend on the number of
+  // entries in the table.
+  EntryId FindEntry(const std::string& path) const;
+
+  // Releases the memory reserved for future entries. Should be called once
+  // all the entries were added.
+  void Compact();
+
+  // Returns the number of entries, including the root directory.
+  size_t size() const { return parent_ids_.size(); }
+
+  // Returns the number of bytes used by the table.
+  size_t MemoryUsage() const;
+
+  EntryId parent_id(EntryId id) const { return parent_ids_[id]; }
+  const char* name(EntryId id) const { return &name_pool_[name_offsets_[id]]; }
+  int64_t archive_index(EntryId id) const { return archive_indexes_[id]; }
+  bool is_directory(EntryId id) const { return flags_[id] & kDirectoryFlag; }
+  int64_t file_size(EntryId id) const { return sizes_[id]; }
+  time_t modification_time(EntryId id) const {
+    return static_cast<time_t>(modification_times_[id]);
+  }
+
+ private:
+  enum Flag { kDirectoryFlag = 1 << 0 };
+
+  // Returns the offset of name inside name_pool_, adding it in case it is not
+  // present yet.
+  uint32_t InternName(const char* name, size_t length);
+
+  // Returns the offset of name inside name_pool_ or kInvalidId if it isn't
+  // present.
+  uint32_t FindName(const char* name, size_t length) const;
+
+  // Returns the id of the child of parent_id with the name stored at
+  // name_offset or kInvalidId if there is no such child.
+  EntryId FindChild(EntryId parent_id, uint32_t name_offset) const;
+
+  // Appends a new entry and indexes it. Returns its id.
+  EntryId AppendEntry(EntryId parent_id, uint32_t name_offset);
+
+  // Inserts an already stored name or entry into the corresponding hash table.
+  void IndexName(uint32_t name_offset);
+  void IndexChild(EntryId id);
+
+  // Doubles the size of the hash tables and reinserts the stored values.
+  void GrowNameSlots();
+  void GrowChildSlots();
+
+  // Entry attributes, indexed by EntryId.
+  std::vector<int64_t> sizes_;
+  std::vector<int64_t> modification_times_;
+  std::vector<int64_t> archive_indexes_;  // -1 for directories created only
+                                          // because of their children.
+  std::vector<EntryId> parent_ids_;
+  std::vector<uint32_t> name_offsets_;  // Offsets inside name_pool_.
+  std::vector<uint8_t> flags_;
+
+  // Null terminated names of all entries. Each distinct name is stored once.
+  std::vector<char> name_pool_;
+
+  // Open addressing hash tables. name_slots_ maps names to their offsets in
+  // name_pool_ and child_slots_ maps (parent id, name offset) pairs to entry
+  // ids. Both have a power of 2 size and are at most half full.
+  std::vector<uint32_t> name_slots_;
+  size_t name_count_;
+  std::vector<EntryId> child_slots_;
+};
+
+#endif  // VOLUME_ENTRY_TABLE_H_
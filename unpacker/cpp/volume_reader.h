@@ -42,6 +42,15 @@ class VolumeReader {
   // Fetches a passphrase for reading. If the passphrase is not available it
   // returns NULL.
   virtual const char* Passphrase() = 0;
+
+  // Hints that the next read starts at the current offset and will be about
+  // bytes_to_read long, so the data can be fetched before it's needed. Readers
+  // that don't fetch data ahead ignore it.
+  virtual void ReadAhead(int64_t bytes_to_read) {}
+
+  // Sets the request id used for requesting data from JavaScript. Readers that
+  // don't request data from JavaScript ignore it.
+  virtual void SetRequestId(const std::string& request_id) {}
 };
 
 #endif  // VOLUME_READER_H_
@@ -0,0 +1,168 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "volume_reader_archive_entry.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "ppapi/cpp/logging.h"
+
+VolumeReaderArchiveEntry::VolumeReaderArchiveEntry(
+    ArchiveOpenerInterface* archive_opener,
+    int64_t index,
+    int64_t entry_size)
+    : archive_opener_(archive_opener),
+      archive_(NULL),
+      index_(index),
+      entry_size_(entry_size),
+      offset_(0),
+      read_end_(0),
+      data_offset_(-1),
+      reader_offset_(-1) {}
+
+VolumeReaderArchiveEntry::~VolumeReaderArchiveEntry() {
+  CloseArchive();
+  delete archive_opener_;
+}
+
+int64_t VolumeReaderArchiveEntry::Read(int64_t bytes_to_read,
+                                       const void** destination_buffer) {
+  PP_DCHECK(bytes_to_read > 0);
+
+  // No more data, so signal end of reading.
+  if (offset_ >= entry_size_)
+    return 0;
+
+  if (!archive_ && !OpenEntry())
+    return ARCHIVE_FATAL;
+
+  int64_t length = std::min(bytes_to_read, entry_size_ - offset_);
+  if (data_offset_ >= 0)
+    return ReadStoredData(length, destination_buffer);
+
+  const char* buffer = NULL;
+  int64_t read_bytes = archive_->ReadData(offset_, length, &buffer);
+
+  // The outer archive can't read backwards beyond the data it retained, so the
+  // entry is read again from its beginning.
+  if (read_bytes < 0 && offset_ < read_end_) {
+    if (!OpenEntry())
+      return ARCHIVE_FATAL;
+    read_bytes = archive_->ReadData(offset_, length, &buffer);
+  }
+
+  if (read_bytes < 0)
+    return ARCHIVE_FATAL;
+
+  offset_ += read_bytes;
+  read_end_ = std::max(read_end_, offset_);
+  *destination_buffer = buffer;
+  return read_bytes;
+}
+
+int64_t VolumeReaderArchiveEntry::Skip(int64_t bytes_to_skip) {
+  // The skipped data is decompressed anyway by the outer archive on the next
+  // read, or not read at all for stored entries, so skipping only moves the
+  // offset. Like for VolumeReaderJavaScriptStream, invalid skips return 0 so
+  // libarchive uses Read and reports the correct error.
+  if (entry_size_ - offset_ < bytes_to_skip || bytes_to_skip < 0)
+    return 0;
+
+  offset_ += bytes_to_skip;
+  return bytes_to_skip;
+}
+
+int64_t VolumeReaderArchiveEntry::Seek(int64_t offset, int whence) {
+  int64_t new_offset = offset_;
+  switch (whence) {
+    case SEEK_SET:
+      new_offset = offset;
+      break;
+    case SEEK_CUR:
+      new_offset += offset;
+      break;
+    case SEEK_END:
+      new_offset = entry_size_ + offset;
+      break;
+    default:
+      PP_NOTREACHED();
+      return ARCHIVE_FATAL;
+  }
+
+  if (new_offset < 0 || new_offset > entry_size_)
+    return ARCHIVE_FATAL;
+
+  offset_ = new_offset;
+  return new_offset;
+}
+
+const char* VolumeReaderArchiveEntry::Passphrase() {
+  if (!archive_ && !OpenEntry())
+    return NULL;
+  return archive_->reader()->Passphrase();
+}
+
+bool VolumeReaderArchiveEntry::OpenEntry() {
+  read_end_ = 0;
+
+  if (!archive_) {
+    archive_ = archive_opener_->Open();
+    if (!archive_)
+      return false;
+  }
+
+  // Formats without an index, like tar, can't seek to a header, so the
+  // archive is opened again in case the entry was already passed.
+  if (!archive_->SeekHeader(index_) && archive_->curr_index > index_) {
+    CloseArchive();
+    archive_ = archive_opener_->Open();
+    if (!archive_)
+      return false;
+  }
+
+  while (archive_->curr_index <= index_) {
+    if (archive_->GetNextHeader() != VolumeArchive::RESULT_SUCCESS) {
+      CloseArchive();
+      return false;
+    }
+  }
+
+  data_offset_ = archive_->GetStoredDataOffset();
+  reader_offset_ = -1;
+  return true;
+}
+
+int64_t VolumeReaderArchiveEntry::ReadStoredData(
+    int64_t length,
+    const void** destination_buffer) {
+  // The outer archive reads ahead, so the reader is moved to the entry data
+  // before the first read.
+  VolumeReader* reader = archive_->reader();
+  if (reader_offset_ != data_offset_ + offset_) {
+    reader_offset_ = reader->Seek(data_offset_ + offset_, SEEK_SET);
+    if (reader_offset_ < 0) {
+      reader_offset_ = -1;
+      return ARCHIVE_FATAL;
+    }
+  }
+
+  int64_t read_bytes = reader->Read(length, destination_buffer);
+  if (read_bytes < 0) {
+    reader_offset_ = -1;
+    return ARCHIVE_FATAL;
+  }
+
+  reader_offset_ += read_bytes;
+  offset_ += read_bytes;
+  read_end_ = std::max(read_end_, offset_);
+  return read_bytes;
+}
+
+void VolumeReaderArchiveEntry::CloseArchive() {
+  if (archive_) {
+    archive_opener_->Close(archive_);
+    archive_ = NULL;
+  }
+}
@@ -0,0 +1,89 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOLUME_READER_ARCHIVE_ENTRY_H_
+#define VOLUME_READER_ARCHIVE_ENTRY_H_
+
+#include "volume_archive.h"
+#include "volume_reader.h"
+
+// Opens the archive containing the entry read by VolumeReaderArchiveEntry.
+class ArchiveOpenerInterface {
+ public:
+  virtual ~ArchiveOpenerInterface() {}
+
+  // Creates and initializes a new VolumeArchive. Returns NULL in case of
+  // failure.
+  virtual VolumeArchive* Open() = 0;
+
+  // Cleans up and deletes an archive returned by Open.
+  virtual void Close(VolumeArchive* archive) = 0;
+};
+
+// A VolumeReader that reads the data of an entry of another archive, so an
+// archive stored inside another one can be read without extracting it first.
+// The outer archive is opened on the first read and is used only by this
+// reader, so it can be read at the same time as the files of the volume it
+// belongs to.
+//
+// In case the entry is stored in the outer archive as is, like in tar or for
+// the stored ZIP entries, the data is read directly with the reader of the
+// outer archive, so seeking costs nothing. Otherwise, seeking is done by the
+// outer archive: short seeks backwards are served from the data it retained,
+// forward seeks skip the data in between, and only the seeks beyond the
+// retained data read the entry again from its beginning.
+//
+// Like the other VolumeReaders, it must be used from one thread at a time.
+class VolumeReaderArchiveEntry : public VolumeReader {
+ public:
+  // VolumeReaderArchiveEntry takes the ownership of archive_opener. index is
+  // the index of the entry in the outer archive and entry_size its size.
+  VolumeReaderArchiveEntry(ArchiveOpenerInterface* archive_opener,
+                           int64_t index,
+                           int64_t entry_size);
+
+  virtual ~VolumeReaderArchiveEntry();
+
+  // See volume_reader.h for description. *destination_buffer is owned by the
+  // outer archive, so the data is not copied.
+  virtual int64_t Read(int64_t bytes_to_read, const void** destination_buffer);
+
+  // See volume_reader.h for description.
+  virtual int64_t Skip(int64_t bytes_to_skip);
+
+  // See volume_reader.h for description.
+  virtual int64_t Seek(int64_t offset, int whence);
+
+  // See volume_reader.h for description. Asks for the passphrase through the
+  // reader of the outer archive.
+  virtual const char* Passphrase();
+
+  int64_t offset() const { return offset_; }
+
+ private:
+  // Opens the outer archive if needed and moves it to the beginning of the
+  // entry. Returns false in case of failure.
+  bool OpenEntry();
+
+  // Reads the data of a stored entry with the reader of the outer archive.
+  int64_t ReadStoredData(int64_t length, const void** destination_buffer);
+
+  // Closes the outer archive.
+  void CloseArchive();
+
+  ArchiveOpenerInterface* archive_opener_;
+  VolumeArchive* archive_;  // NULL until the first read.
+  const int64_t index_;
+  const int64_t entry_size_;
+  int64_t offset_;  // The offset of the next read.
+  int64_t read_end_;  // The end of the data already read from archive_.
+  // The offset of the entry data in the data of archive_->reader() in case it
+  // is stored as is, otherwise -1.
+  int64_t data_offset_;
+  // The offset of archive_->reader() while reading a stored entry, -1 if
+  // unknown.
+  int64_t reader_offset_;
+};
+
+#endif  // VOLUME_READER_ARCHIVE_ENTRY_H_
@@ -10,6 +10,9 @@
 #include "archive.h"
 #include "ppapi/cpp/logging.h"
 
+#include "tracer.h"
+#include "worker_pool.h"
+
 VolumeReaderJavaScriptStream::VolumeReaderJavaScriptStream(
     int64_t archive_size,
     JavaScriptRequestorInterface* requestor)
@@ -22,7 +25,8 @@ VolumeReaderJavaScriptStream::VolumeReaderJavaScriptStream(
       last_read_chunk_offset_(-1) /* For first call -1 will force a chunk
                                      request from JavaScript as offset
                                      parameter is 0. */,
-      read_ahead_array_buffer_ptr_(&first_array_buffer_) {
+      read_ahead_array_buffer_ptr_(&first_array_buffer_),
+      stats_(NULL) {
   pthread_mutex_init(&shared_state_lock_, NULL);
   pthread_cond_init(&available_data_cond_, NULL);
   pthread_cond_init(&available_passphrase_cond_, NULL);
@@ -67,6 +71,10 @@ void VolumeReaderJavaScriptStream::SetBufferAndSignal(
   // buffer can still be used. In such case we should use it. That can greatly
   // improve traversing headers for archives with small files!
 
+  if (stats_)
+    stats_->Add(Stats::BYTES_FETCHED, array_buffer.ByteLength());
+  Tracer::EndAsync("io", "ReadChunk", Tracer::AsyncId(this, read_offset));
+
   pthread_mutex_lock(&shared_state_lock_);
   if (read_offset == offset_ && !available_data_ && !read_error_) {
     // Signal VolumeReaderJavaScriptStream::Read to continue execution. Copies
@@ -80,6 +88,8 @@ void VolumeReaderJavaScriptStream::SetBufferAndSignal(
     available_data_ = true;
 
     pthread_cond_signal(&available_data_cond_);
+  } else if (stats_) {
+    stats_->Add(Stats::DISCARDED_CHUNKS, 1);
   }
   pthread_mutex_unlock(&shared_state_lock_);
 }
@@ -124,15 +134,19 @@ int64_t VolumeReaderJavaScriptStream::Read(int64_t bytes_to_read,
     RequestChunk(bytes_to_read);
 
   if (!available_data_) {
-    // Wait for data from JavaScript.
+    // Wait for data from JavaScript. Other jobs can run in the meantime.
+    Stats::ScopedTimer timer(stats_, Stats::READ_CHUNK_WAIT_US);
+    WorkerPool::BeginBlockingCall();
     while (!available_data_) {  // Check again available data as first call
                                 // was done outside guarded zone.
       if (read_error_) {
+        WorkerPool::EndBlockingCall();
         pthread_mutex_unlock(&shared_state_lock_);
         return ARCHIVE_FATAL;
       }
       pthread_cond_wait(&available_data_cond_, &shared_state_lock_);
     }
+    WorkerPool::EndBlockingCall();
   }
 
   if (read_error_) {  // Read ahead failed.
@@ -231,6 +245,19 @@ int64_t VolumeReaderJavaScriptStream::Skip(int64_t bytes_to_skip) {
   return bytes_to_skip;
 }
 
+void VolumeReaderJavaScriptStream::ReadAhead(int64_t bytes_to_read) {
+  PP_DCHECK(bytes_to_read > 0);
+
+  pthread_mutex_lock(&shared_state_lock_);
+  // Read requests a chunk only if the last one wasn't for offset_, so the next
+  // Read waits for this chunk instead of requesting it again.
+  if (last_read_chunk_offset_ != offset_) {
+    RequestChunk(bytes_to_read);
+    last_read_chunk_offset_ = offset_;
+  }
+  pthread_mutex_unlock(&shared_state_lock_);
+}
+
 void VolumeReaderJavaScriptStream::SetRequestId(const std::string& request_id) {
   // No lock necessary, as request_id is used by one thread only.
   request_id_ = request_id;
@@ -252,7 +279,9 @@ const char* VolumeReaderJavaScriptStream::Passphrase() {
 
   pthread_mutex_lock(&shared_state_lock_);
   // Wait for the passphrase from JavaScript.
+  WorkerPool::BeginBlockingCall();
   pthread_cond_wait(&available_passphrase_cond_, &shared_state_lock_);
+  WorkerPool::EndBlockingCall();
   const char* result = NULL;
   if (!passphrase_error_)
     result = strdup(available_passphrase_.c_str());
@@ -270,5 +299,9 @@ void VolumeReaderJavaScriptStream::RequestChunk(int64_t length) {
       std::min(length, archive_size_ - offset_ /* Positive check above. */);
   available_data_ = false;
 
+  if (stats_)
+    stats_->Add(Stats::READ_CHUNK_REQUESTS, 1);
+  Tracer::BeginAsync("io", "ReadChunk", Tracer::AsyncId(this, offset_),
+                     "length", bytes_to_read);
   requestor_->RequestFileChunk(request_id_, offset_, bytes_to_read);
 }
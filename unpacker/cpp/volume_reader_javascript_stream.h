@@ -11,6 +11,7 @@
 #include "ppapi/cpp/var_array_buffer.h"
 
 #include "javascript_requestor_interface.h"
+#include "stats.h"
 #include "volume_reader.h"
 
 // A VolumeReader that reads the content of the volume's archive from
@@ -65,8 +66,12 @@ class VolumeReaderJavaScriptStream : public VolumeReader {
   // See volume_reader.h for description.
   virtual int64_t Seek(int64_t offset, int whence);
 
-  // Sets the request Id to be used by the reader.
-  void SetRequestId(const std::string& request_id);
+  // See volume_reader.h for description. Requests the chunk at the current
+  // offset from JavaScript, unless it was already requested.
+  virtual void ReadAhead(int64_t bytes_to_read);
+
+  // See volume_reader.h for description.
+  virtual void SetRequestId(const std::string& request_id);
 
   // See volume_reader.h for description. The method blocks on
   // available_passphrase_cond_. SetPassphraseAndSignal should unblock it from
@@ -75,6 +80,11 @@ class VolumeReaderJavaScriptStream : public VolumeReader {
 
   int64_t offset() const { return offset_; }
 
+  // Sets the stats updated with the chunks requested from JavaScript. NULL
+  // by default, so nothing is counted. VolumeReaderJavaScriptStream does not
+  // own the stats pointer.
+  void set_stats(Stats* stats) { stats_ = stats; }
+
  private:
   // Request a chunk of length number of bytes from JavaScript starting from
   // offset_ member. Should be run within a lock.
@@ -117,6 +127,9 @@ class VolumeReaderJavaScriptStream : public VolumeReader {
   // It points to the array buffer used for reading ahead when data is received
   // from JavaScript at VolumeReaderJavaScriptStream::SetBufferAndSignal.
   pp::VarArrayBuffer* read_ahead_array_buffer_ptr_;
+
+  // The stats of the volume. Can be NULL.
+  Stats* stats_;
 };
 
 #endif  // VOLUME_READER_JAVSCRIPT_STREAM_H_
@@ -0,0 +1,125 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "volume_reader_multi_part.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "ppapi/cpp/logging.h"
+
+VolumeReaderMultiPart::VolumeReaderMultiPart(
+    const std::vector<VolumeReader*>& parts,
+    const std::vector<int64_t>& part_sizes)
+    : parts_(parts), archive_size_(0), offset_(0) {
+  PP_DCHECK(!parts.empty());
+  PP_DCHECK(parts.size() == part_sizes.size());
+  for (size_t i = 0; i < part_sizes.size(); ++i) {
+    part_offsets_.push_back(archive_size_);
+    archive_size_ += part_sizes[i];
+  }
+}
+
+VolumeReaderMultiPart::~VolumeReaderMultiPart() {
+  for (size_t i = 0; i < parts_.size(); ++i)
+    delete parts_[i];
+}
+
+int64_t VolumeReaderMultiPart::Read(int64_t bytes_to_read,
+                                    const void** destination_buffer) {
+  PP_DCHECK(bytes_to_read > 0);
+
+  // No more data, so signal end of reading.
+  if (offset_ >= archive_size_)
+    return 0;
+
+  size_t index = FindPart(offset_);
+  int64_t part_end = index + 1 < parts_.size() ? part_offsets_[index + 1]
+                                               : archive_size_;
+  if (!SeekPart(index, offset_))
+    return ARCHIVE_FATAL;
+
+  int64_t bytes_read = parts_[index]->Read(
+      std::min(bytes_to_read, part_end - offset_), destination_buffer);
+  if (bytes_read <= 0)
+    return ARCHIVE_FATAL;  // The part is shorter than expected.
+
+  offset_ += bytes_read;
+
+  // Fetch the beginning of the next part, while the data of this one is
+  // processed.
+  if (offset_ == part_end && offset_ < archive_size_) {
+    size_t next_index = FindPart(offset_);
+    if (SeekPart(next_index, offset_))
+      parts_[next_index]->ReadAhead(bytes_to_read);
+  }
+
+  return bytes_read;
+}
+
+int64_t VolumeReaderMultiPart::Skip(int64_t bytes_to_skip) {
+  // The parts are seeked on the next read. Like for
+  // VolumeReaderJavaScriptStream, invalid skips return 0 so libarchive uses
+  // Read and reports the correct error.
+  if (archive_size_ - offset_ < bytes_to_skip || bytes_to_skip < 0)
+    return 0;
+
+  offset_ += bytes_to_skip;
+  return bytes_to_skip;
+}
+
+int64_t VolumeReaderMultiPart::Seek(int64_t offset, int whence) {
+  int64_t new_offset = offset_;
+  switch (whence) {
+    case SEEK_SET:
+      new_offset = offset;
+      break;
+    case SEEK_CUR:
+      new_offset += offset;
+      break;
+    case SEEK_END:
+      new_offset = archive_size_ + offset;
+      break;
+    default:
+      PP_NOTREACHED();
+      return ARCHIVE_FATAL;
+  }
+
+  if (new_offset < 0 || new_offset > archive_size_)
+    return ARCHIVE_FATAL;
+
+  offset_ = new_offset;
+  return new_offset;
+}
+
+const char* VolumeReaderMultiPart::Passphrase() {
+  return parts_[0]->Passphrase();
+}
+
+void VolumeReaderMultiPart::ReadAhead(int64_t bytes_to_read) {
+  if (offset_ >= archive_size_)
+    return;
+
+  size_t index = FindPart(offset_);
+  if (SeekPart(index, offset_))
+    parts_[index]->ReadAhead(bytes_to_read);
+}
+
+void VolumeReaderMultiPart::SetRequestId(const std::string& request_id) {
+  for (size_t i = 0; i < parts_.size(); ++i)
+    parts_[i]->SetRequestId(request_id);
+}
+
+size_t VolumeReaderMultiPart::FindPart(int64_t offset) const {
+  PP_DCHECK(offset >= 0 && offset < archive_size_);
+  // The last part starting at or before offset. Empty parts start at the same
+  // offset as the next part, so they are skipped.
+  return std::upper_bound(part_offsets_.begin(), part_offsets_.end(), offset) -
+         part_offsets_.begin() - 1;
+}
+
+bool VolumeReaderMultiPart::SeekPart(size_t index, int64_t offset) {
+  int64_t part_offset = offset - part_offsets_[index];
+  return parts_[index]->Seek(part_offset, SEEK_SET) == part_offset;
+}
@@ -0,0 +1,70 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef VOLUME_READER_MULTI_PART_H_
+#define VOLUME_READER_MULTI_PART_H_
+
+#include <vector>
+
+#include "volume_reader.h"
+
+// A VolumeReader for archives split into several parts, like .zip.001 or
+// .7z.001. The parts are read by their own readers and stitched together, so
+// libarchive sees a single archive.
+//
+// Reads don't cross the end of a part. Once a part is read until its end, the
+// beginning of the next part is read ahead, so reading an archive
+// sequentially doesn't wait for a new part.
+//
+// Like the other VolumeReaders, it must be used from one thread at a time.
+class VolumeReaderMultiPart : public VolumeReader {
+ public:
+  // VolumeReaderMultiPart takes the ownership of the parts. part_sizes has the
+  // size of every part, in the same order.
+  VolumeReaderMultiPart(const std::vector<VolumeReader*>& parts,
+                        const std::vector<int64_t>& part_sizes);
+
+  virtual ~VolumeReaderMultiPart();
+
+  // See volume_reader.h for description.
+  virtual int64_t Read(int64_t bytes_to_read, const void** destination_buffer);
+
+  // See volume_reader.h for description.
+  virtual int64_t Skip(int64_t bytes_to_skip);
+
+  // See volume_reader.h for description.
+  virtual int64_t Seek(int64_t offset, int whence);
+
+  // See volume_reader.h for description. Asks for the passphrase through the
+  // reader of the first part.
+  virtual const char* Passphrase();
+
+  // See volume_reader.h for description.
+  virtual void ReadAhead(int64_t bytes_to_read);
+
+  // See volume_reader.h for description. Every part uses the same request id.
+  virtual void SetRequestId(const std::string& request_id);
+
+  // Returns the reader of the index-th part.
+  VolumeReader* part(size_t index) const { return parts_[index]; }
+  size_t part_count() const { return parts_.size(); }
+
+  int64_t offset() const { return offset_; }
+
+ private:
+  // Returns the index of the part containing offset. Empty parts are never
+  // returned.
+  size_t FindPart(int64_t offset) const;
+
+  // Seeks the index-th part to offset, which is relative to the whole
+  // archive. Returns false in case of failure.
+  bool SeekPart(size_t index, int64_t offset);
+
+  std::vector<VolumeReader*> parts_;
+  std::vector<int64_t> part_offsets_;  // The offset of every part.
+  int64_t archive_size_;  // The size of all the parts together.
+  int64_t offset_;  // The offset of the next read.
+};
+
+#endif  // VOLUME_READER_MULTI_PART_H_
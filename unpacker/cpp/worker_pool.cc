@@ -0,0 +1,252 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <unistd.h>
+
+#include "ppapi/cpp/logging.h"
+#include "ppapi/cpp/message_loop.h"
+
+namespace {
+
+// The key of the thread specific WorkerPool::Worker of the workers.
+pthread_key_t worker_key;
+pthread_once_t worker_key_once = PTHREAD_ONCE_INIT;
+
+void CreateWorkerKey() {
+  pthread_key_create(&worker_key, NULL);
+}
+
+}  // namespace
+
+class WorkerPool::Strand {
+ public:
+  Strand() : is_scheduled(false) {}
+
+  std::deque<pp::CompletionCallback> jobs;
+
+  // True while the strand is in a queue or one of its jobs runs.
+  bool is_scheduled;
+};
+
+const int WorkerPool::kMaximumThreadCount;
+
+WorkerPool::WorkerPool(const pp::InstanceHandle& instance_handle,
+                       int thread_count)
+    : instance_handle_(instance_handle),
+      thread_count_(thread_count),
+      running_jobs_(0),
+      idle_workers_(0),
+      stopped_(false) {
+  PP_DCHECK(thread_count > 0 && thread_count <= kMaximumThreadCount);
+  pthread_once(&worker_key_once, &CreateWorkerKey);
+  pthread_mutex_init(&lock_, NULL);
+  pthread_cond_init(&work_available_cond_, NULL);
+  pthread_cond_init(&strand_idle_cond_, NULL);
+}
+
+WorkerPool::~WorkerPool() {
+  pthread_mutex_lock(&lock_);
+  stopped_ = true;
+  pthread_cond_broadcast(&work_available_cond_);
+  pthread_mutex_unlock(&lock_);
+
+  // No workers are started after stopped_ is set, so workers_ can be read
+  // without the lock.
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    pthread_join(workers_[i]->thread, NULL);
+    delete workers_[i];
+  }
+
+  pthread_cond_destroy(&strand_idle_cond_);
+  pthread_cond_destroy(&work_available_cond_);
+  pthread_mutex_destroy(&lock_);
+}
+
+bool WorkerPool::Start() {
+  bool result = true;
+  pthread_mutex_lock(&lock_);
+  for (int i = workers_.size(); i < thread_count_ && result; ++i)
+    result = StartWorker();
+  pthread_mutex_unlock(&lock_);
+  return result;
+}
+
+WorkerPool::Strand* WorkerPool::CreateStrand() {
+  return new Strand();
+}
+
+void WorkerPool::DestroyStrand(Strand* strand) {
+  pthread_mutex_lock(&lock_);
+  while (strand->is_scheduled && !workers_.empty() && !stopped_)
+    pthread_cond_wait(&strand_idle_cond_, &lock_);
+
+  // The jobs were dropped, so remove the strand from the queues.
+  if (strand->is_scheduled) {
+    shared_strands_.erase(
+        std::remove(shared_strands_.begin(), shared_strands_.end(), strand),
+        shared_strands_.end());
+    for (size_t i = 0; i < workers_.size(); ++i) {
+      std::deque<Strand*>* strands = &workers_[i]->strands;
+      strands->erase(std::remove(strands->begin(), strands->end(), strand),
+                     strands->end());
+    }
+  }
+  pthread_mutex_unlock(&lock_);
+
+  delete strand;
+}
+
+void WorkerPool::Post(Strand* strand, const pp::CompletionCallback& callback) {
+  pthread_mutex_lock(&lock_);
+  strand->jobs.push_back(callback);
+  if (!strand->is_scheduled) {
+    strand->is_scheduled = true;
+    // A strand posted by a job is likely to use the data of the job, so it's
+    // better to run it on the same worker.
+    Worker* worker = CurrentWorker();
+    if (worker && worker->pool == this)
+      worker->strands.push_back(strand);
+    else
+      shared_strands_.push_back(strand);
+    WakeUpWorker();
+  }
+  pthread_mutex_unlock(&lock_);
+}
+
+// static
+void WorkerPool::BeginBlockingCall() {
+  Worker* worker = CurrentWorker();
+  if (!worker)
+    return;
+
+  WorkerPool* pool = worker->pool;
+  pthread_mutex_lock(&pool->lock_);
+  --pool->running_jobs_;
+  pool->WakeUpWorker();
+  pthread_mutex_unlock(&pool->lock_);
+}
+
+// static
+void WorkerPool::EndBlockingCall() {
+  Worker* worker = CurrentWorker();
+  if (!worker)
+    return;
+
+  // The number of running jobs can go above thread_count_ for a while. No
+  // new jobs are started until it drops.
+  WorkerPool* pool = worker->pool;
+  pthread_mutex_lock(&pool->lock_);
+  ++pool->running_jobs_;
+  pthread_mutex_unlock(&pool->lock_);
+}
+
+// static
+int WorkerPool::DefaultThreadCount() {
+  long processors = sysconf(_SC_NPROCESSORS_ONLN);
+  return std::min(std::max(processors, 2L),
+                  static_cast<long>(kMaximumThreadCount));
+}
+
+// static
+void* WorkerPool::WorkerMain(void* worker) {
+  Worker* self = static_cast<Worker*>(worker);
+  self->pool->Run(self);
+  return NULL;
+}
+
+// static
+WorkerPool::Worker* WorkerPool::CurrentWorker() {
+  pthread_once(&worker_key_once, &CreateWorkerKey);
+  return static_cast<Worker*>(pthread_getspecific(worker_key));
+}
+
+bool WorkerPool::StartWorker() {
+  if (stopped_ || static_cast<int>(workers_.size()) >= kMaximumThreadCount)
+    return false;
+
+  Worker* worker = new Worker();
+  worker->pool = this;
+  if (pthread_create(&worker->thread, NULL, &WorkerPool::WorkerMain, worker)) {
+    delete worker;
+    return false;
+  }
+  workers_.push_back(worker);
+  return true;
+}
+
+void WorkerPool::WakeUpWorker() {
+  if (running_jobs_ >= thread_count_)
+    return;  // A worker will take the strand when a job finishes.
+
+  if (idle_workers_ > 0) {
+    pthread_cond_signal(&work_available_cond_);
+  } else if (!workers_.empty()) {
+    // All the workers are busy, but some of them are blocked.
+    StartWorker();
+  }
+}
+
+WorkerPool::Strand* WorkerPool::TakeStrand(Worker* worker) {
+  std::deque<Strand*>* strands = NULL;
+  if (!worker->strands.empty()) {
+    strands = &worker->strands;
+  } else if (!shared_strands_.empty()) {
+    strands = &shared_strands_;
+  } else {
+    for (size_t i = 0; i < workers_.size() && !strands; ++i) {
+      if (!workers_[i]->strands.empty())
+        strands = &workers_[i]->strands;
+    }
+    if (!strands)
+      return NULL;
+    // Steal the strand which would run last.
+    Strand* strand = strands->back();
+    strands->pop_back();
+    return strand;
+  }
+
+  Strand* strand = strands->front();
+  strands->pop_front();
+  return strand;
+}
+
+void WorkerPool::Run(Worker* worker) {
+  // Blocking PPAPI calls are allowed only on threads with a message loop.
+  pp::MessageLoop message_loop(instance_handle_);
+  message_loop.AttachToCurrentThread();
+  pthread_setspecific(worker_key, worker);
+
+  pthread_mutex_lock(&lock_);
+  while (!stopped_) {
+    Strand* strand =
+        running_jobs_ < thread_count_ ? TakeStrand(worker) : NULL;
+    if (!strand) {
+      ++idle_workers_;
+      pthread_cond_wait(&work_available_cond_, &lock_);
+      --idle_workers_;
+      continue;
+    }
+
+    pp::CompletionCallback job = strand->jobs.front();
+    strand->jobs.pop_front();
+    ++running_jobs_;
+    pthread_mutex_unlock(&lock_);
+
+    job.Run(PP_OK);
+
+    pthread_mutex_lock(&lock_);
+    --running_jobs_;
+    if (strand->jobs.empty()) {
+      strand->is_scheduled = false;
+      pthread_cond_broadcast(&strand_idle_cond_);
+    } else {
+      // The other strands of the worker run before the next job of this one.
+      worker->strands.push_back(strand);
+    }
+  }
+  pthread_mutex_unlock(&lock_);
+}
@@ -0,0 +1,126 @@
+// Copyright 2017 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef WORKER_POOL_H_
+#define WORKER_POOL_H_
+
+#include <deque>
+#include <pthread.h>
+#include <vector>
+
+#include "ppapi/cpp/completion_callback.h"
+#include "ppapi/cpp/instance_handle.h"
+
+// A pool of worker threads shared by all the volumes and compressors of the
+// module. Jobs are posted to strands. The jobs of a strand run one at a time,
+// in the order they were posted, while different strands run in parallel. So
+// every volume or compressor keeps the ordering guarantees of a dedicated
+// thread, without having an idle thread for every mounted archive.
+//
+// Every worker has its own queue of strands with pending jobs. Strands posted
+// from a worker go to its own queue, strands posted from other threads go to a
+// shared queue, and idle workers steal strands from the queues of the other
+// workers.
+//
+// Jobs block while waiting for JavaScript, e.g. for archive chunks. Such waits
+// must be wrapped with BeginBlockingCall and EndBlockingCall, so another
+// worker runs the pending strands meanwhile. Spare workers are started in
+// case all the workers are blocked, up to kMaximumThreadCount.
+//
+// All the methods can be called from any thread.
+class WorkerPool {
+ public:
+  // A sequence of jobs that run one at a time, in the order they were posted.
+  class Strand;
+
+  // The maximum number of threads, including the spare workers started for
+  // blocked jobs. Every blocked job holds a thread until it returns, so once
+  // this many jobs are blocked, e.g. waiting for JavaScript, the strands with
+  // pending jobs wait for one of them to return.
+  static const int kMaximumThreadCount = 64;
+
+  // thread_count is the number of jobs that run at the same time, not counting
+  // the blocked ones. instance_handle is used to attach message loops to the
+  // workers, so jobs can make blocking PPAPI calls.
+  WorkerPool(const pp::InstanceHandle& instance_handle, int thread_count);
+
+  // Stops the workers. All the strands must have been destroyed before.
+  virtual ~WorkerPool();
+
+  // Starts the workers. Does nothing if they were already started.
+  bool Start();
+
+  // Creates a new strand. The strand must be destroyed with DestroyStrand
+  // before the pool.
+  Strand* CreateStrand();
+
+  // Waits for the jobs posted to strand to run and deletes it. Must not be
+  // called from a job of the strand. In case the pool was not started, the
+  // pending jobs are dropped.
+  void DestroyStrand(Strand* strand);
+
+  // Posts a job to strand.
+  void Post(Strand* strand, const pp::CompletionCallback& callback);
+
+  // Must be called by jobs before and after waiting for another thread, like
+  // the main thread. Do nothing when not called from a worker of a pool.
+  static void BeginBlockingCall();
+  static void EndBlockingCall();
+
+  // Returns the number of processors, used as the number of workers.
+  static int DefaultThreadCount();
+
+ private:
+  struct Worker {
+    WorkerPool* pool;
+    pthread_t thread;
+    // Strands with pending jobs. The worker takes strands from the front, and
+    // other workers steal strands from the back.
+    std::deque<Strand*> strands;
+  };
+
+  // The function run by the workers.
+  static void* WorkerMain(void* worker);
+
+  // Returns the worker of the calling thread, or NULL if it isn't a worker.
+  static Worker* CurrentWorker();
+
+  // Starts a new worker. Must be called with lock_ acquired.
+  bool StartWorker();
+
+  // Wakes up an idle worker, or starts a spare one in case some of the
+  // workers are blocked. Must be called with lock_ acquired.
+  void WakeUpWorker();
+
+  // Returns a strand with pending jobs for worker, either from its own queue,
+  // from the shared queue or stolen from another worker. Must be called with
+  // lock_ acquired.
+  Strand* TakeStrand(Worker* worker);
+
+  // Runs jobs on worker until the pool is stopped.
+  void Run(Worker* worker);
+
+  pp::InstanceHandle instance_handle_;
+  const int thread_count_;
+
+  // Guards all the members below and the state of the strands.
+  pthread_mutex_t lock_;
+
+  // Signaled when a strand has pending jobs or the pool is stopped.
+  pthread_cond_t work_available_cond_;
+
+  // Signaled when a strand ran all its jobs.
+  pthread_cond_t strand_idle_cond_;
+
+  std::vector<Worker*> workers_;
+
+  // Strands posted from outside of the pool.
+  std::deque<Strand*> shared_strands_;
+
+  int running_jobs_;  // The jobs that run and are not blocked.
+  int idle_workers_;  // The workers waiting for work_available_cond_.
+  bool stopped_;
+};
+
+#endif  // WORKER_POOL_H_
@@ -83,6 +83,21 @@ unpacker.app = {
    */
   mountProcessCounter: 0,
 
+  /**
+   * The callbacks of the module requests, like GET_STATS, waiting for a
+   * response, by request id.
+   * @type {!Object<number, function(*)>}
+   * @private
+   */
+  moduleRequests_: {},
+
+  /**
+   * The request id of the next module request.
+   * @type {number}
+   * @private
+   */
+  nextModuleRequestId_: 0,
+
   /**
    * Function called on receiving a message from NaCl module. Registered by
    * common.js.
@@ -127,6 +142,32 @@ unpacker.app = {
                                        Number(requestId));
   },
 
+  /**
+   * Process messages related to the whole module.
+   * @param {!Object} message The message received from NaCl module.
+   * @param {!unpacker.request.Operation} operation
+   * @private
+   */
+  handleModuleMessage_: function(message, operation) {
+    var requestId = Number(message.data[unpacker.request.Key.REQUEST_ID]);
+    var onSuccess = unpacker.app.moduleRequests_[requestId];
+    delete unpacker.app.moduleRequests_[requestId];
+    switch (operation) {
+      case unpacker.request.Operation.GET_STATS_DONE:
+        if (onSuccess)
+          onSuccess(message.data[unpacker.request.Key.STATS]);
+        break;
+
+      case unpacker.request.Operation.GET_TRACE_DONE:
+        if (onSuccess)
+          onSuccess(message.data[unpacker.request.Key.TRACE]);
+        break;
+
+      default:
+        console.error('Invalid NaCl operation: ' + operation + '.');
+    }
+  },
+
   /**
    * Function called on receiving a message from NaCl module. Registered by
    * common.js.
@@ -140,7 +181,9 @@ unpacker.app = {
                    'No NaCl operation: ' + operation + '.');
 
     // Assign the message to either module.
-    if (unpacker.request.isPackRequest(operation))
+    if (unpacker.request.isModuleRequest(operation))
+      unpacker.app.handleModuleMessage_(message, operation);
+    else if (unpacker.request.isPackRequest(operation))
       unpacker.app.handlePackMessage_(message, operation);
     else
       unpacker.app.handleUnpackMessage_(message, operation);
@@ -442,6 +485,60 @@ unpacker.app = {
     unpacker.app.moduleLoadedPromise = null;
   },
 
+  /**
+   * Gets the counters and histograms of all the volumes and compressors from
+   * the NaCl module, useful for tuning. The int64 values are strings.
+   * @return {!Promise<!Object>} Promise fulfilled with an object with the
+   *     stats of the volumes by file system id and of the compressors by
+   *     compressor id.
+   */
+  getStats: function() {
+    if (!unpacker.app.naclModule)
+      return Promise.reject('FAILED');
+
+    return new Promise(function(fulfill) {
+      var requestId = unpacker.app.nextModuleRequestId_++;
+      unpacker.app.moduleRequests_[requestId] = fulfill;
+      unpacker.app.naclModule.postMessage(
+          unpacker.request.createGetStatsRequest(requestId));
+    });
+  },
+
+  /**
+   * Starts or stops recording the timeline of the jobs of the NaCl module.
+   * Starting drops the events recorded before. Has no response.
+   * @param {boolean} enabled
+   * @param {number=} opt_capacity The number of most recent events to keep.
+   * @return {boolean} False if the NaCl module is not loaded.
+   */
+  setTracing: function(enabled, opt_capacity) {
+    if (!unpacker.app.naclModule)
+      return false;
+
+    unpacker.app.naclModule.postMessage(
+        unpacker.request.createSetTracingRequest(
+            unpacker.app.nextModuleRequestId_++, enabled, opt_capacity));
+    return true;
+  },
+
+  /**
+   * Gets the timeline of the jobs recorded by the NaCl module since tracing
+   * was enabled. Save it to a file and load it in chrome://tracing.
+   * @return {!Promise<string>} Promise fulfilled with the JSON of the Chrome
+   *     trace events.
+   */
+  getTrace: function() {
+    if (!unpacker.app.naclModule)
+      return Promise.reject('FAILED');
+
+    return new Promise(function(fulfill) {
+      var requestId = unpacker.app.nextModuleRequestId_++;
+      unpacker.app.moduleRequests_[requestId] = fulfill;
+      unpacker.app.naclModule.postMessage(
+          unpacker.request.createGetTraceRequest(requestId));
+    });
+  },
+
   /**
    * Cleans up the resources for a volume, except for the local storage. If
    * necessary that can be done using unpacker.app.removeState_.
@@ -68,6 +68,13 @@ unpacker.Compressor = function(naclModule, items) {
    */
   this.entryIdInProgress_ = 0;
 
+  /**
+   * The ids of the entries of the batch being added with a single
+   * ADD_ENTRIES_TO_ARCHIVE request. Empty if no batch is in progress.
+   * @type {!Array<!unpacker.types.EntryId>}
+   */
+  this.batchEntryIdsInProgress_ = [];
+
   /**
    * Map from entry ids to entries.
    * @const {!Object<!unpacker.types.EntryId, !FileEntry|!DirectoryEntry>}
@@ -81,10 +88,19 @@ unpacker.Compressor = function(naclModule, items) {
   this.metadata_ = {};
 
   /**
-   * The offset from which the entry in progress should be read.
-   * @type {number}
+   * The file of the entry in progress. Several chunks of the entry can be
+   * requested before the file is obtained, so they all wait for it.
+   * @type {Promise<!File>}
+   */
+  this.filePromise_ = null;
+
+  /**
+   * Fulfilled once the last chunk received from NaCl is written onto the
+   * archive. NaCl sends the next chunks without waiting for the previous ones
+   * to be written, so every chunk is written after the previous one.
+   * @type {!Promise}
    */
-  this.offset_ = 0;
+  this.lastWritePromise_ = Promise.resolve();
 };
 
 /**
@@ -108,6 +124,27 @@ unpacker.Compressor.CompressorIdQueue = [];
  */
 unpacker.Compressor.DEFAULT_ARCHIVE_NAME = 'Archive.zip';
 
+/**
+ * The maximum size of the files added in batches. Their data is read at once
+ * and sent with the ADD_ENTRIES_TO_ARCHIVE request, instead of NaCl
+ * requesting it chunk by chunk, so adding them costs no round trip. Bigger
+ * files are added one by one.
+ * @const {number}
+ */
+unpacker.Compressor.MAXIMUM_BATCHED_FILE_SIZE = 64 * 1024;
+
+/**
+ * The maximum total size of the data of the files of a batch.
+ * @const {number}
+ */
+unpacker.Compressor.MAXIMUM_BATCH_DATA_SIZE = 4 * 1024 * 1024;
+
+/**
+ * The maximum number of entries in a batch.
+ * @const {number}
+ */
+unpacker.Compressor.MAXIMUM_BATCH_ENTRY_COUNT = 1024;
+
 /**
  * The getter function for compressor id.
  * @return {!unpacker.types.CompressorId}
@@ -149,6 +186,30 @@ unpacker.Compressor.prototype.compress = function(onSuccess, onError) {
   this.getArchiveFile_();
 };
 
+/**
+ * Adds the items to an existing zip archive instead of creating one. The
+ * entries already in the archive are neither read nor written again.
+ * @param {!FileEntry} archiveFileEntry The archive to append to.
+ * @param {function(!unpacker.types.CompressorId)} onSuccess
+ * @param {function(!unpacker.types.CompressorId)} onError
+ */
+unpacker.Compressor.prototype.appendTo = function(archiveFileEntry, onSuccess,
+                                                  onError) {
+  this.onSuccess_ = onSuccess;
+  this.onError_ = onError;
+  this.archiveFileEntry_ = archiveFileEntry;
+
+  archiveFileEntry.getMetadata(function(metadata) {
+    var request = unpacker.request.createAppendToArchiveRequest(
+        this.compressorId_, metadata.size);
+    this.naclModule_.postMessage(request);
+  }.bind(this), function(error) {
+    console.error('Failed to get metadata of ' + archiveFileEntry.name + ': ' +
+        error.message + '.');
+    this.onError_(this.compressorId_);
+  }.bind(this));
+};
+
 /**
  * Gets an archive file with write permission. Currently, this extension does
  * not have permission to create files from the background page. Thus, this
@@ -179,8 +240,9 @@ unpacker.Compressor.prototype.getArchiveFile_ = function() {
  * @private
  */
 unpacker.Compressor.prototype.sendCreateArchiveRequest_ = function() {
+  // The archive name ends with .zip, so the format is the default one.
   var request = unpacker.request.createCreateArchiveRequest(
-      this.compressorId_);
+      this.compressorId_, {parallel: true});
   this.naclModule_.postMessage(request);
 }
 
@@ -261,16 +323,55 @@ unpacker.Compressor.prototype.getDirectoryEntryMetadata_ = function(dir) {
   this.getSingleMetadata_(dir);
 }
 
+/**
+ * Returns the size of the data of an entry, 0 for directories.
+ * @param {!unpacker.types.EntryId} entryId
+ * @return {number}
+ * @private
+ */
+unpacker.Compressor.prototype.getEntryDataSize_ = function(entryId) {
+  return this.entries_[entryId].isDirectory ? 0 : this.metadata_[entryId].size;
+}
+
+/**
+ * Returns the description of an entry sent to NaCl to add it to the archive.
+ * @param {!unpacker.types.EntryId} entryId
+ * @return {!unpacker.types.ArchiveEntry}
+ * @private
+ */
+unpacker.Compressor.prototype.getArchiveEntry_ = function(entryId) {
+  // Convert the absolute path on the virtual filesystem to a relative path from
+  // the archive root by removing the leading '/' if exists.
+  var fullPath = this.entries_[entryId].fullPath;
+  if (fullPath.length && fullPath[0] == '/')
+    fullPath = fullPath.substring(1);
+
+  // Modification time is sent as string in a format: 'mm/dd/yy hh:mm:ss'.
+  var mt = this.metadata_[entryId].modificationTime;
+  var formattedTime = (mt.getMonth() + 1) + '/' + mt.getDate() + '/' +
+                      mt.getFullYear() + ' ' + mt.getHours() + ':' +
+                      mt.getMinutes() + ':' + mt.getSeconds();
+
+  return {
+    pathname: fullPath,
+    fileSize: this.metadata_[entryId].size,
+    modificationTime: formattedTime,
+    isDirectory: this.entries_[entryId].isDirectory
+  };
+}
+
 /**
  * Pops an entry from the queue and adds it to the archive.
  * If another entry is in progress, this function does nothing. If there is no
- * entry in the queue, it shifts to close archive process. Otherwise, this sends
- * an add to archive request for a popped entry with its metadata to libarchive.
+ * entry in the queue, it shifts to close archive process. If the entry is a
+ * directory or a small file, it is added with the next small entries of the
+ * queue in a batch. Otherwise, this sends an add to archive request for a
+ * popped entry with its metadata to libarchive.
  * @private
  */
 unpacker.Compressor.prototype.sendAddToArchiveRequest_ = function() {
   // Another process is in progress.
-  if (this.entryIdInProgress_ != 0)
+  if (this.entryIdInProgress_ != 0 || this.batchEntryIdsInProgress_.length)
     return;
 
   // All entries have already been archived.
@@ -280,28 +381,84 @@ unpacker.Compressor.prototype.sendAddToArchiveRequest_ = function() {
     return;
   }
 
+  if (this.getEntryDataSize_(this.pendingAddToArchiveRequests_[0]) <=
+      unpacker.Compressor.MAXIMUM_BATCHED_FILE_SIZE) {
+    this.sendAddEntriesToArchiveRequest_();
+    return;
+  }
+
   var entryId = this.pendingAddToArchiveRequests_.shift();
   this.entryIdInProgress_ = entryId;
 
-  // Convert the absolute path on the virtual filesystem to a relative path from
-  // the archive root by removing the leading '/' if exists.
-  var fullPath = this.entries_[entryId].fullPath;
-  if (fullPath.length && fullPath[0] == '/')
-    fullPath = fullPath.substring(1);
-
-  // Modification time is sent as string in a format: 'mm/dd/yy hh:mm:ss'.
-  var mt = this.metadata_[entryId].modificationTime;
-  var formattedTime = (mt.getMonth() + 1) + '/' + mt.getDate() + '/' +
-                      mt.getFullYear() + ' ' + mt.getHours() + ':' +
-                      mt.getMinutes() + ':' + mt.getSeconds();
-
+  var archiveEntry = this.getArchiveEntry_(entryId);
   var request = unpacker.request.createAddToArchiveRequest(
-      this.compressorId_, entryId, fullPath,
-      this.metadata_[entryId].size, formattedTime,
-      this.entries_[entryId].isDirectory);
+      this.compressorId_, entryId, archiveEntry.pathname,
+      archiveEntry.fileSize, archiveEntry.modificationTime,
+      archiveEntry.isDirectory);
   this.naclModule_.postMessage(request);
 }
 
+/**
+ * Pops the directories and small files at the front of the queue and adds them
+ * to the archive with a single add entries to archive request. The data of
+ * all the files is read at once from a blob concatenating them, and sent with
+ * the request.
+ * @private
+ */
+unpacker.Compressor.prototype.sendAddEntriesToArchiveRequest_ = function() {
+  var queue = this.pendingAddToArchiveRequests_;
+  var entryIds = [];
+  var dataSize = 0;
+  while (queue.length &&
+         entryIds.length < unpacker.Compressor.MAXIMUM_BATCH_ENTRY_COUNT) {
+    var size = this.getEntryDataSize_(queue[0]);
+    if (size > unpacker.Compressor.MAXIMUM_BATCHED_FILE_SIZE ||
+        dataSize + size > unpacker.Compressor.MAXIMUM_BATCH_DATA_SIZE) {
+      break;
+    }
+    entryIds.push(queue.shift());
+    dataSize += size;
+  }
+  this.batchEntryIdsInProgress_ = entryIds;
+
+  var filePromises = entryIds.filter(function(entryId) {
+    return this.getEntryDataSize_(entryId) > 0;
+  }.bind(this)).map(function(entryId) {
+    return new Promise(function(fulfill, reject) {
+      this.entries_[entryId].file(fulfill, reject);
+    }.bind(this));
+  }.bind(this));
+
+  Promise.all(filePromises).then(function(files) {
+    return new Promise(function(fulfill, reject) {
+      var reader = new FileReader();
+      reader.onload = function(event) {
+        fulfill(event.target.result);
+      };
+      reader.onerror = function(event) {
+        reject(reader.error);
+      };
+      reader.readAsArrayBuffer(new Blob(files));
+    });
+  }).then(function(buffer) {
+    // The files may have changed since their metadata was read.
+    if (buffer.byteLength !== dataSize) {
+      console.error('Tried to read a batch of files with length ' + dataSize +
+          ', but byte with length ' + buffer.byteLength + ' was returned.');
+      this.onError_(this.compressorId_);
+      return;
+    }
+
+    var request = unpacker.request.createAddEntriesToArchiveRequest(
+        this.compressorId_, entryIds.map(this.getArchiveEntry_.bind(this)),
+        buffer);
+    this.naclModule_.postMessage(request);
+  }.bind(this), function(error) {
+    console.error('Failed to read a batch of files: ' + error.message + '.');
+    this.onError_(this.compressorId_);
+  }.bind(this));
+}
+
 /**
  * Sends a close archive request to libarchive. libarchive writes metadata of
  * the archive itself on the archive and releases objects obtainted in the
@@ -315,31 +472,35 @@ unpacker.Compressor.prototype.sendCloseArchiveRequest = function(hasError) {
 
 /**
  * Sends a read file chunk done response.
+ * @param {number} offset The offset of the chunk in the entry.
  * @param {number} length The number of bytes read from the entry.
  * @param {!ArrayBuffer} buffer A buffer containing the data that was read.
  * @private
  */
 unpacker.Compressor.prototype.sendReadFileChunkDone_ =
-    function(length, buffer) {
+    function(offset, length, buffer) {
   var request = unpacker.request.createReadFileChunkDoneResponse(
-      this.compressorId_, length, buffer);
+      this.compressorId_, offset, length, buffer);
   this.naclModule_.postMessage(request);
 }
 
 /**
  * A handler of read file chunk messages.
- * Reads 'length' bytes from the entry currently in process.
+ * Reads 'length' bytes at 'offset' from the entry currently in process. NaCl
+ * requests the next chunks while compressing the current one, so several
+ * chunks can be read at the same time.
  * @param {!Object} data
  * @private
  */
 unpacker.Compressor.prototype.onReadFileChunk_ = function(data) {
   var entryId = this.entryIdInProgress_;
   var entry = this.entries_[entryId];
+  var offset = Number(data[unpacker.request.Key.OFFSET]);
   var length = Number(data[unpacker.request.Key.LENGTH]);
 
   // A function to create a reader and read bytes.
-  var readFileChunk = function() {
-    var file = this.file_.slice(this.offset_, this.offset_ + length);
+  var readFileChunk = function(entryFile) {
+    var file = entryFile.slice(offset, offset + length);
     var reader = new FileReader();
 
     reader.onloadend = function(event) {
@@ -353,90 +514,172 @@ unpacker.Compressor.prototype.onReadFileChunk_ = function(data) {
 
         // If the first argument(length) is negative, it means that an error
         // occurred in reading a chunk.
-        this.sendReadFileChunkDone_(-1, buffer);
+        this.sendReadFileChunkDone_(offset, -1, buffer);
         this.onError_(this.compressorId_);
         return;
       }
 
-      this.offset_ += length;
-      this.sendReadFileChunkDone_(length, buffer);
+      this.sendReadFileChunkDone_(offset, length, buffer);
     }.bind(this);
 
     reader.onerror = function(event) {
-      console.error('Failed to read file chunk. Name: ' + file.name +
-          ', offset: ' + this.offset_ + ', length: ' + length + '.');
+      console.error('Failed to read file chunk. Name: ' + entryFile.name +
+          ', offset: ' + offset + ', length: ' + length + '.');
 
       // If the first argument(length) is negative, it means that an error
       // occurred in reading a chunk.
-      this.sendReadFileChunkDone_(-1, new ArrayBuffer(0));
+      this.sendReadFileChunkDone_(offset, -1, new ArrayBuffer(0));
       this.onError_(this.compressorId_);
-    }
+    }.bind(this);
 
     reader.readAsArrayBuffer(file);
   }.bind(this);
 
   // When the entry is read for the first time.
-  if (!this.file_) {
-    entry.file(function(file) {
-      this.file_ = file;
-      readFileChunk();
-    }.bind(this));
-    return;
+  if (!this.filePromise_) {
+    this.filePromise_ = new Promise(function(fulfill, reject) {
+      entry.file(fulfill, reject);
+    });
   }
 
-  // From the second time onward.
-  readFileChunk();
+  this.filePromise_.then(readFileChunk, function(error) {
+    console.error('Failed to get file: ' + error.message + '.');
+    this.sendReadFileChunkDone_(offset, -1, new ArrayBuffer(0));
+    this.onError_(this.compressorId_);
+  }.bind(this));
+}
+
+/**
+ * Sends a read archive chunk done response.
+ * @param {number} length The number of bytes read from the archive.
+ * @param {!ArrayBuffer} buffer A buffer containing the data that was read.
+ * @private
+ */
+unpacker.Compressor.prototype.sendReadArchiveChunkDone_ =
+    function(length, buffer) {
+  var request = unpacker.request.createReadArchiveChunkDoneResponse(
+      this.compressorId_, length, buffer);
+  this.naclModule_.postMessage(request);
+}
+
+/**
+ * A handler of read archive chunk messages.
+ * Reads 'length' bytes at 'offset' from the archive appended to, for NaCl to
+ * find its central directory.
+ * @param {!Object} data
+ * @private
+ */
+unpacker.Compressor.prototype.onReadArchiveChunk_ = function(data) {
+  var offset = Number(data[unpacker.request.Key.OFFSET]);
+  var length = Number(data[unpacker.request.Key.LENGTH]);
+
+  this.archiveFileEntry_.file(function(archiveFile) {
+    var reader = new FileReader();
+    reader.onloadend = function(event) {
+      var buffer = event.target.result;
+      this.sendReadArchiveChunkDone_(buffer.byteLength, buffer);
+    }.bind(this);
+
+    reader.onerror = function(event) {
+      console.error('Failed to read archive chunk. Offset: ' + offset +
+          ', length: ' + length + '.');
+
+      // If the first argument(length) is negative, it means that an error
+      // occurred in reading a chunk.
+      this.sendReadArchiveChunkDone_(-1, new ArrayBuffer(0));
+    }.bind(this);
+
+    reader.readAsArrayBuffer(archiveFile.slice(offset, offset + length));
+  }.bind(this), function(error) {
+    console.error('Failed to get archive file: ' + error.message + '.');
+    this.sendReadArchiveChunkDone_(-1, new ArrayBuffer(0));
+  }.bind(this));
 }
 
 /**
  * A handler of write chunk requests.
- * Writes the data in the given buffer onto the archive file.
+ * Writes the data in the given buffer onto the archive file, once the chunks
+ * received before are written.
  * @param {!Object} data
  * @private
  */
 unpacker.Compressor.prototype.onWriteChunk_ = function(data) {
   var length = Number(data[unpacker.request.Key.LENGTH]);
   var buffer = data[unpacker.request.Key.CHUNK_BUFFER];
-  this.writeChunk_(length, buffer, this.sendWriteChunkDone_.bind(this));
+  // Only the first chunk written when appending to an archive has an offset.
+  var offset = data[unpacker.request.Key.OFFSET] !== undefined ?
+      Number(data[unpacker.request.Key.OFFSET]) : -1;
+  this.lastWritePromise_ = this.lastWritePromise_.then(function() {
+    return new Promise(function(fulfill) {
+      this.writeChunk_(length, buffer, offset, function(writtenLength) {
+        this.sendWriteChunkDone_(writtenLength);
+        fulfill();
+      }.bind(this));
+    }.bind(this));
+  }.bind(this));
 }
 
 /**
  * Writes buffer into the archive file (window.archiveFileEntry).
  * @param {number} length The number of bytes in the buffer to write.
  * @param {!ArrayBuffer} buffer The buffer to write in the archive.
+ * @param {number} offset The offset to write the buffer at. The archive file
+ *     is truncated there first, as nothing after it is kept. Negative to
+ *     append the buffer.
  * @param {function(number)} callback Callback to execute at the end of the
  *     function. This function has one parameter: length, which represents the
  *     length of bytes written on to the archive. If writing a chunk fails,
  *     a negative value must be assigned to this argument.
  * @private
  */
-unpacker.Compressor.prototype.writeChunk_ = function(length, buffer,
+unpacker.Compressor.prototype.writeChunk_ = function(length, buffer, offset,
     callback) {
   // TODO(takise): Use the same instance of FileWriter over multiple calls of
   // this function instead of creating new ones.
   this.archiveFileEntry_.createWriter(function(fileWriter) {
+    // writeend is dispatched after error too, but NaCl counts the chunks
+    // left to be written, so the callback must be called only once.
+    var failed = false;
     fileWriter.onwriteend = function(event) {
-      callback(length);
+      if (!failed)
+        callback(length);
     };
 
     fileWriter.onerror = function(event) {
+      failed = true;
       console.error('Failed to write chunk to ' + this.archiveFileEntry_ + '.');
 
       // If the first argument(length) is negative, it means that an error
       // occurred in writing a chunk.
       callback(-1 /* length */);
       this.onError_(this.compressorId_);
-    };
+    }.bind(this);
+
+    // Create a new Blob and append it to the archive file. NaCl recycles its
+    // buffers, so the buffer can be bigger than the chunk.
+    var blob = new Blob([new Uint8Array(buffer, 0, length)], {});
+    if (offset < 0) {
+      fileWriter.seek(fileWriter.length);
+      fileWriter.write(blob);
+      return;
+    }
 
-    // Create a new Blob and append it to the archive file.
-    var blob = new Blob([buffer], {});
-    fileWriter.seek(fileWriter.length);
-    fileWriter.write(blob);
-  }, function(event) {
+    // writeend is dispatched after truncate too, so the chunk is written then.
+    var onwriteend = fileWriter.onwriteend;
+    fileWriter.onwriteend = function(event) {
+      if (failed)
+        return;
+      fileWriter.onwriteend = onwriteend;
+      fileWriter.seek(fileWriter.length);
+      fileWriter.write(blob);
+    };
+    fileWriter.truncate(offset);
+  }.bind(this), function(event) {
     console.error('Failed to create writer for ' + this.archiveFileEntry_ +
         '.');
+    callback(-1 /* length */);
     this.onError_(this.compressorId_);
-  });
+  }.bind(this));
 };
 
 /**
@@ -458,13 +701,22 @@ unpacker.Compressor.prototype.sendWriteChunkDone_ = function(length) {
 unpacker.Compressor.prototype.onAddToArchiveDone_ = function() {
   // Reset information on the current entry.
   this.entryIdInProgress_ = 0;
-  this.file_ = null;
-  this.offset_ = 0;
+  this.filePromise_ = null;
 
   // Start processing another entry.
   this.sendAddToArchiveRequest_();
 }
 
+/**
+ * A handler of add entries to archive done responses.
+ * Resets the batch in progress and starts processing other entries.
+ * @private
+ */
+unpacker.Compressor.prototype.onAddEntriesToArchiveDone_ = function() {
+  this.batchEntryIdsInProgress_ = [];
+  this.sendAddToArchiveRequest_();
+}
+
 /**
  * A handler of close archive responses.
  * Receiving this response means the entire packing process has finished.
@@ -486,6 +738,14 @@ unpacker.Compressor.prototype.processMessage = function(data, operation) {
       this.createArchiveDone_();
       break;
 
+    case unpacker.request.Operation.APPEND_TO_ARCHIVE_DONE:
+      this.createArchiveDone_();
+      break;
+
+    case unpacker.request.Operation.READ_ARCHIVE_CHUNK:
+      this.onReadArchiveChunk_(data);
+      break;
+
     case unpacker.request.Operation.READ_FILE_CHUNK:
       this.onReadFileChunk_(data);
       break;
@@ -498,6 +758,10 @@ unpacker.Compressor.prototype.processMessage = function(data, operation) {
       this.onAddToArchiveDone_();
       break;
 
+    case unpacker.request.Operation.ADD_ENTRIES_TO_ARCHIVE_DONE:
+      this.onAddEntriesToArchiveDone_();
+      break;
+
     case unpacker.request.Operation.CLOSE_ARCHIVE_DONE:
       this.onCloseArchiveDone_();
       break;
@@ -14,9 +14,12 @@
  *     the archive volume to decompress.
  * @param {!Blob} blob The correspondent file blob for fileSystemId.
  * @param {!unpacker.PassphraseManager} passphraseManager Passphrase manager.
+ * @param {Array<!Blob>=} opt_parts The parts of a split archive, like
+ *     .zip.001 and .zip.002, starting with blob. NaCl reads them as a single
+ *     archive.
  */
 unpacker.Decompressor = function(naclModule, fileSystemId, blob,
-                                 passphraseManager) {
+                                 passphraseManager, opt_parts) {
   /**
    * @private {!Object}
    * @const
@@ -35,6 +38,13 @@ unpacker.Decompressor = function(naclModule, fileSystemId, blob,
    */
   this.blob_ = blob;
 
+  /**
+   * The parts of the archive. Only blob_ if the archive is not split.
+   * @private {!Array<!Blob>}
+   * @const
+   */
+  this.parts_ = opt_parts && opt_parts.length > 1 ? opt_parts : [blob];
+
   /**
    * @public {!unpacker.PassphraseManager}
    * @const
@@ -57,6 +67,17 @@ unpacker.Decompressor.prototype.hasRequestsInProgress = function() {
   return Object.keys(this.requestsInProgress).length > 0;
 };
 
+/**
+ * @return {number} The size of the archive, which is the size of all its parts
+ *     together.
+ * @private
+ */
+unpacker.Decompressor.prototype.getArchiveSize_ = function() {
+  return this.parts_.reduce(function(size, part) {
+    return size + part.size;
+  }, 0);
+};
+
 /**
  * Sends a request to NaCl and mark it as a request in progress. onSuccess and
  * onError are the callbacks used when receiving an answer from NaCl.
@@ -95,8 +116,49 @@ unpacker.Decompressor.prototype.readMetadata = function(requestId, encoding,
                                                         onSuccess, onError) {
   this.addRequest_(
       requestId, onSuccess, onError,
-      unpacker.request.createReadMetadataRequest(this.fileSystemId_, requestId,
-                                                 encoding, this.blob_.size));
+      unpacker.request.createReadMetadataRequest(
+          this.fileSystemId_, requestId, encoding, this.getArchiveSize_(),
+          this.parts_.length > 1 ? this.parts_.map(function(part) {
+            return part.size;
+          }) : undefined));
+};
+
+/**
+ * Creates a request for reading the metadata of an archive stored in an entry
+ * of the archive of outerDecompressor. NaCl reads the entry directly from the
+ * outer archive, so only the size of the blob of this decompressor is used,
+ * which must be the size of the entry.
+ * @param {!unpacker.types.RequestId} requestId
+ * @param {string} encoding Default encoding for the archive's headers.
+ * @param {!unpacker.Decompressor} outerDecompressor The decompressor of the
+ *     archive containing the entry.
+ * @param {!unpacker.types.RequestId} outerRequestId A request id of
+ *     outerDecompressor used by NaCl for reading the outer archive. It stays in
+ *     progress until this volume is closed.
+ * @param {number} index Index of the entry in the header list of the outer
+ *     archive.
+ * @param {function(!Object<string, !Object>)} onSuccess Callback to execute
+ *     once the metadata is obtained from NaCl.
+ * @param {function(!ProviderError)} onError Callback to execute on error.
+ */
+unpacker.Decompressor.prototype.readNestedMetadata = function(
+    requestId, encoding, outerDecompressor, outerRequestId, index, onSuccess,
+    onError) {
+  // The outer decompressor answers the READ_CHUNK and READ_PASSPHRASE requests
+  // for outerRequestId.
+  console.assert(!outerDecompressor.requestsInProgress[outerRequestId],
+                 'There is already a request with the id ' + outerRequestId +
+                     '.');
+  outerDecompressor.requestsInProgress[outerRequestId] = {
+    onSuccess: function() {},
+    onError: onError
+  };
+
+  this.addRequest_(
+      requestId, onSuccess, onError,
+      unpacker.request.createReadNestedMetadataRequest(
+          this.fileSystemId_, requestId, encoding, this.blob_.size,
+          outerDecompressor.fileSystemId_, outerRequestId, index));
 };
 
 /**
@@ -112,7 +174,43 @@ unpacker.Decompressor.prototype.openFile = function(requestId, index, encoding,
   this.addRequest_(
       requestId, onSuccess, onError,
       unpacker.request.createOpenFileRequest(this.fileSystemId_, requestId,
-                                             index, encoding, this.blob_.size));
+                                             index, encoding,
+                                             this.getArchiveSize_()));
+};
+
+/**
+ * Sends an open file request to NaCl for a file identified by its path. This
+ * doesn't require the caller to walk the metadata in order to find the index
+ * of the file, though readMetadata must be called first.
+ * @param {!unpacker.types.RequestId} requestId
+ * @param {string} path The path of the file inside the archive.
+ * @param {string} encoding Default encoding for the archive's headers.
+ * @param {function()} onSuccess Callback to execute on successful open.
+ * @param {function(!ProviderError)} onError Callback to execute on error.
+ */
+unpacker.Decompressor.prototype.openFileByPath = function(
+    requestId, path, encoding, onSuccess, onError) {
+  this.addRequest_(
+      requestId, onSuccess, onError,
+      unpacker.request.createOpenFileByPathRequest(
+          this.fileSystemId_, requestId, path, encoding,
+          this.getArchiveSize_()));
+};
+
+/**
+ * Sends a request to NaCl for the metadata of a single entry.
+ * @param {!unpacker.types.RequestId} requestId
+ * @param {string} path The path of the entry inside the archive.
+ * @param {function(!Object)} onSuccess Callback to execute once the metadata
+ *     of the entry is obtained. Directories don't include their entries.
+ * @param {function(!ProviderError)} onError Callback to execute on error.
+ */
+unpacker.Decompressor.prototype.statPath = function(requestId, path, onSuccess,
+                                                    onError) {
+  this.addRequest_(
+      requestId, onSuccess, onError,
+      unpacker.request.createStatPathRequest(this.fileSystemId_, requestId,
+                                             path));
 };
 
 /**
@@ -149,6 +247,79 @@ unpacker.Decompressor.prototype.readFile = function(
                                              openRequestId, offset, length));
 };
 
+/**
+ * Sends a request to NaCl to read the first bytes of many files at once. The
+ * files are read in a single pass over the archive, in archive order, so the
+ * chunks don't arrive in the order of the files parameter. All the chunks of a
+ * file arrive before the chunks of the next one, and an empty file arrives as a
+ * single empty chunk.
+ * @param {!unpacker.types.RequestId} requestId
+ * @param {!Array<{index: number, maxBytes: number}>} files The indexes of the
+ *     files in the header list and the maximum number of bytes to read from
+ *     each of them.
+ * @param {string} encoding Default encoding for the archive's headers.
+ * @param {function(number, !ArrayBuffer, boolean)} onSuccess Callback to
+ *     execute for every chunk, with the index of the file, the data and
+ *     whether more chunks will follow.
+ * @param {function(!ProviderError)} onError Callback to execute on error.
+ */
+unpacker.Decompressor.prototype.readFiles = function(
+    requestId, files, encoding, onSuccess, onError) {
+  this.addRequest_(
+      requestId, onSuccess, onError,
+      unpacker.request.createReadFilesRequest(this.fileSystemId_, requestId,
+                                              files, encoding,
+                                              this.getArchiveSize_()));
+};
+
+/**
+ * Sends a request to NaCl to search the files of the archive for literal
+ * patterns. The files are decompressed and searched by NaCl in a single pass
+ * over the archive, and only the hits are sent back, in batches.
+ * @param {!unpacker.types.RequestId} requestId
+ * @param {!Array<string>} patterns The patterns to search for. Matching is
+ *     case sensitive.
+ * @param {string} encoding Default encoding for the archive's headers.
+ * @param {number|undefined} maxHits The search stops after this many hits.
+ *     Undefined for no limit.
+ * @param {function(!Array<{index: number, offset: number, pattern: number}>,
+ *     boolean)} onSuccess Callback to execute for every batch of hits, with
+ *     the index of the file, the offset of the hit in the file and the index
+ *     of the pattern, and whether more batches will follow.
+ * @param {function(!ProviderError)} onError Callback to execute on error.
+ */
+unpacker.Decompressor.prototype.search = function(
+    requestId, patterns, encoding, maxHits, onSuccess, onError) {
+  this.addRequest_(
+      requestId, onSuccess, onError,
+      unpacker.request.createSearchRequest(this.fileSystemId_, requestId,
+                                           patterns, encoding,
+                                           this.getArchiveSize_(), maxHits));
+};
+
+/**
+ * Sends a request to NaCl to compute the digests of files of the archive. The
+ * files are decompressed and hashed by NaCl in a single pass over the archive,
+ * and only the digests are sent back, in batches and in archive order.
+ * @param {!unpacker.types.RequestId} requestId
+ * @param {!Array<number>} indexes The indexes of the files in the header list.
+ * @param {string} algorithm One of 'sha256', 'crc32c' and 'blake3'.
+ * @param {string} encoding Default encoding for the archive's headers.
+ * @param {function(!Array<{index: number, digest: string}>, boolean)}
+ *     onSuccess Callback to execute for every batch of digests, with the index
+ *     of the file and its digest as lowercase hex, and whether more batches
+ *     will follow.
+ * @param {function(!ProviderError)} onError Callback to execute on error.
+ */
+unpacker.Decompressor.prototype.hashEntries = function(
+    requestId, indexes, algorithm, encoding, onSuccess, onError) {
+  this.addRequest_(
+      requestId, onSuccess, onError,
+      unpacker.request.createHashEntriesRequest(this.fileSystemId_, requestId,
+                                                indexes, algorithm, encoding,
+                                                this.getArchiveSize_()));
+};
+
 /**
  * Processes messages from NaCl module.
  * @param {!Object} data The data contained in the message from NaCl. Its
@@ -190,6 +361,12 @@ unpacker.Decompressor.prototype.processMessage = function(data, operation,
       // file so NaCL can make READ_CHUNK requests.
       return;
 
+    case unpacker.request.Operation.STAT_PATH_DONE:
+      var entryMetadata = data[unpacker.request.Key.METADATA];
+      console.assert(entryMetadata, 'No entry metadata.');
+      requestInProgress.onSuccess(entryMetadata);
+      break;
+
     case unpacker.request.Operation.CLOSE_FILE_DONE:
       var openRequestId = data[unpacker.request.Key.OPEN_REQUEST_ID];
       console.assert(openRequestId, 'No open request id.');
@@ -211,6 +388,49 @@ unpacker.Decompressor.prototype.processMessage = function(data, operation,
         return;  // Do not delete requestInProgress.
       break;
 
+    case unpacker.request.Operation.READ_FILES_DONE:
+      var index = Number(data[unpacker.request.Key.INDEX]);  // Received as
+                                                             // string.
+      var filesBuffer = data[unpacker.request.Key.READ_FILE_DATA];
+      console.assert(filesBuffer, 'No buffer for read files operation.');
+      var filesHaveMoreData = data[unpacker.request.Key.HAS_MORE_DATA];
+
+      requestInProgress.onSuccess(index, filesBuffer, filesHaveMoreData);
+      if (filesHaveMoreData)
+        return;  // Do not delete requestInProgress.
+      break;
+
+    case unpacker.request.Operation.SEARCH_DONE:
+      var hits = data[unpacker.request.Key.HITS].map(function(hit) {
+        return {
+          index: Number(hit[unpacker.request.Key.INDEX]),  // Received as
+                                                           // string.
+          offset: Number(hit[unpacker.request.Key.OFFSET]),
+          pattern: hit[unpacker.request.Key.PATTERN_INDEX]
+        };
+      });
+      var searchHasMoreData = data[unpacker.request.Key.HAS_MORE_DATA];
+
+      requestInProgress.onSuccess(hits, searchHasMoreData);
+      if (searchHasMoreData)
+        return;  // Do not delete requestInProgress.
+      break;
+
+    case unpacker.request.Operation.HASH_ENTRIES_DONE:
+      var digests = data[unpacker.request.Key.DIGESTS].map(function(digest) {
+        return {
+          index: Number(digest[unpacker.request.Key.INDEX]),  // Received as
+                                                              // string.
+          digest: digest[unpacker.request.Key.DIGEST]
+        };
+      });
+      var digestsHaveMoreData = data[unpacker.request.Key.HAS_MORE_DATA];
+
+      requestInProgress.onSuccess(digests, digestsHaveMoreData);
+      if (digestsHaveMoreData)
+        return;  // Do not delete requestInProgress.
+      break;
+
     case unpacker.request.Operation.FILE_SYSTEM_ERROR:
       console.error('File system error for <' + this.fileSystemId_ + '>: ' +
                     data[unpacker.request.Key.ERROR]);  // The error contains
@@ -237,7 +457,9 @@ unpacker.Decompressor.prototype.processMessage = function(data, operation,
 };
 
 /**
- * Reads a chunk of data from this.blob_ for READ_CHUNK operation.
+ * Reads a chunk of data from a part of the archive for READ_CHUNK operation.
+ * The offset is relative to the part, which is this.blob_ if the archive is
+ * not split.
  * @param {!Object} data The data received from the NaCl module.
  * @param {number} requestId The request id, which should be unique per every
  *     volume.
@@ -247,31 +469,35 @@ unpacker.Decompressor.prototype.readChunk_ = function(data, requestId) {
   // Offset and length are received as strings. See request.js.
   var offset_str = data[unpacker.request.Key.OFFSET];
   var length_str = data[unpacker.request.Key.LENGTH];
+  var partIndex = data[unpacker.request.Key.PART_INDEX] || 0;
+  var part = this.parts_[partIndex];
 
+  console.assert(part, 'Invalid part index.');
   // Explicit check if offset is undefined as it can be 0.
   console.assert(offset_str !== undefined && !isNaN(offset_str) &&
                      Number(offset_str) >= 0 &&
-                     Number(offset_str) < this.blob_.size,
+                     Number(offset_str) < part.size,
                  'Invalid offset.');
   console.assert(length_str && !isNaN(length_str) && Number(length_str) > 0,
                  'Invalid length.');
 
   var offset = Number(offset_str);
-  var length = Math.min(this.blob_.size - offset, Number(length_str));
+  var length = Math.min(part.size - offset, Number(length_str));
 
   // Read a chunk from offset to offset + length.
-  var blob = this.blob_.slice(offset, offset + length);
+  var blob = part.slice(offset, offset + length);
   var fileReader = new FileReader();
 
   fileReader.onload = function(event) {
     this.naclModule_.postMessage(unpacker.request.createReadChunkDoneResponse(
-        this.fileSystemId_, requestId, event.target.result, offset));
+        this.fileSystemId_, requestId, event.target.result, offset,
+        partIndex));
   }.bind(this);
 
   fileReader.onerror = function(event) {
     console.error('Failed to read a chunk of data from the archive.');
     this.naclModule_.postMessage(unpacker.request.createReadChunkErrorResponse(
-        this.fileSystemId_, requestId));
+        this.fileSystemId_, requestId, partIndex));
     // Reading from the source file failed. Assume that the file is gone and
     // unmount the archive.
     // TODO(523195): Show a notification that the source file is gone.
@@ -32,6 +32,39 @@ unpacker.request = {
     READ_FILE_DATA: 'read_file_data',       // Should be an ArrayBuffer.
     HAS_MORE_DATA: 'has_more_data',         // Should be a boolean.
     PASSPHRASE: 'passphrase',               // Should be a string.
+    PATH: 'path',                           // Should be a string.
+    FILES: 'files',                         // Should be an array of objects
+                                            // with INDEX and LENGTH.
+    OUTER_FILE_SYSTEM_ID: 'outer_file_system_id',  // Should be a string.
+    OUTER_REQUEST_ID: 'outer_request_id',  // Should be a string, just like
+                                           // REQUEST_ID.
+    PART_SIZES: 'part_sizes',  // Should be an array of strings. Same reason
+                               // as ARCHIVE_SIZE.
+    PART_INDEX: 'part_index',  // Should be an int.
+    PATTERNS: 'patterns',      // Should be an array of strings.
+    MAX_HITS: 'max_hits',      // Should be a string. Same reason as
+                               // ARCHIVE_SIZE.
+    HITS: 'hits',              // Should be an array of objects with INDEX,
+                               // OFFSET and PATTERN_INDEX.
+    PATTERN_INDEX: 'pattern_index',  // Should be an int.
+    INDEXES: 'indexes',        // Should be an array of strings. Same reason
+                               // as INDEX.
+    ALGORITHM: 'algorithm',    // Should be a string.
+    DIGESTS: 'digests',        // Should be an array of objects with INDEX and
+                               // DIGEST.
+    DIGEST: 'digest',          // Should be a string.
+
+    // Optional keys unique to module operations.
+    STATS: 'stats',            // Should be an object with VOLUMES and
+                               // COMPRESSORS.
+    VOLUMES: 'volumes',        // Should be an object with the stats of every
+                               // volume by file system id.
+    COMPRESSORS: 'compressors',  // Should be an object with the stats of
+                                 // every compressor by compressor id.
+    ENABLED: 'enabled',        // Should be a boolean.
+    CAPACITY: 'capacity',      // Should be an int.
+    TRACE: 'trace',            // Should be a string with the JSON of Chrome
+                               // trace events.
 
     // Mandatory keys for all packing operations.
     COMPRESSOR_ID: 'compressor_id',         // Should be an int.
@@ -46,6 +79,17 @@ unpacker.request = {
                                             // (mm/dd/yy h:m:s)
     HAS_ERROR: 'has_error',                 // Should be a boolean Sent from JS
                                             // to NaCL.
+    READ_AHEAD_DEPTH: 'read_ahead_depth',   // Should be an int.
+    WRITE_BEHIND_DEPTH: 'write_behind_depth',  // Should be an int.
+    PARALLEL: 'parallel',                   // Should be a boolean.
+    FORMAT: 'format',                       // Should be a Format.
+    COMPRESSION_LEVEL: 'compression_level',  // Should be an int.
+    THREAD_COUNT: 'thread_count',           // Should be an int.
+    DEDUPLICATE: 'deduplicate',             // Should be a boolean.
+    ENTRIES: 'entries',                     // Should be an array of objects
+                                            // with PATHNAME, FILE_SIZE,
+                                            // IS_DIRECTORY and
+                                            // MODIFICATION_TIME.
 
     // Optional keys used for both packing and unpacking operations.
     ERROR: 'error',                // Should be a string.
@@ -94,15 +138,57 @@ unpacker.request = {
     WRITE_CHUNK_DONE: 24,
     CLOSE_ARCHIVE: 25,
     CLOSE_ARCHIVE_DONE: 26,
+    ADD_ENTRIES_TO_ARCHIVE: 27,
+    ADD_ENTRIES_TO_ARCHIVE_DONE: 28,
+    APPEND_TO_ARCHIVE: 29,
+    APPEND_TO_ARCHIVE_DONE: 30,
+    READ_ARCHIVE_CHUNK: 31,
+    READ_ARCHIVE_CHUNK_DONE: 32,
+    OPEN_FILE_BY_PATH: 100,
+    STAT_PATH: 101,
+    STAT_PATH_DONE: 102,
+    READ_FILES: 103,
+    READ_FILES_DONE: 104,
+    SEARCH: 105,
+    SEARCH_DONE: 106,
+    HASH_ENTRIES: 107,
+    HASH_ENTRIES_DONE: 108,
+    GET_STATS: 200,
+    GET_STATS_DONE: 201,
+    SET_TRACING: 202,
+    GET_TRACE: 203,
+    GET_TRACE_DONE: 204,
     FILE_SYSTEM_ERROR: -1,
     COMPRESSOR_ERROR: -2
   },
 
   /**
-  * Operations greater than or equal to this value are for packing.
+   * Defines the archive formats created by the compressor, with their
+   * compression. Should be the same as request::format on the NaCL side.
+   * @enum {string}
+   */
+  Format: {
+    ZIP_DEFLATE: 'zip-deflate',
+    ZIP_STORE: 'zip-store',
+    TAR: 'tar',
+    TAR_GZIP: 'tar.gz',
+    TAR_XZ: 'tar.xz'
+  },
+
+  /**
+  * Operations between these values, inclusive, are for packing. Unpacking
+  * operations added later start after MAXIMUM_PACK_REQUEST_VALUE.
   * @const {number}
   */
   MINIMUM_PACK_REQUEST_VALUE: 17,
+  MAXIMUM_PACK_REQUEST_VALUE: 99,
+
+  /**
+  * Operations greater than or equal to this value are for the whole module.
+  * They have only REQUEST_ID.
+  * @const {number}
+  */
+  MINIMUM_MODULE_REQUEST_VALUE: 200,
 
   /**
   * Return true if the given operation is related to packing.
@@ -110,10 +196,20 @@ unpacker.request = {
   * @return {boolean}
   */
   isPackRequest: function(operation) {
-    return unpacker.request.MINIMUM_PACK_REQUEST_VALUE <= operation ||
+    return (unpacker.request.MINIMUM_PACK_REQUEST_VALUE <= operation &&
+            operation <= unpacker.request.MAXIMUM_PACK_REQUEST_VALUE) ||
            operation == unpacker.request.Operation.COMPRESSOR_ERROR;
   },
 
+  /**
+  * Return true if the given operation is related to the whole module.
+  * @param {!unpacker.request.Operation} operation
+  * @return {boolean}
+  */
+  isModuleRequest: function(operation) {
+    return unpacker.request.MINIMUM_MODULE_REQUEST_VALUE <= operation;
+  },
+
   /**
    * Creates a basic request with mandatory fields.
    * @param {!unpacker.request.Operation} operation
@@ -137,15 +233,51 @@ unpacker.request = {
    * @param {!unpacker.types.RequestId} requestId
    * @param {string} encoding Default encoding for the archive.
    * @param {number} archiveSize The size of the archive for fileSystemId.
+   * @param {Array<number>=} opt_partSizes The sizes of the parts of a split
+   *     archive.
    * @return {!Object} A read metadata request.
    */
   createReadMetadataRequest: function(fileSystemId, requestId, encoding,
-                                      archiveSize) {
+                                      archiveSize, opt_partSizes) {
     var readMetadataRequest = unpacker.request.createBasic_(
         unpacker.request.Operation.READ_METADATA, fileSystemId, requestId);
     readMetadataRequest[unpacker.request.Key.ENCODING] = encoding;
     readMetadataRequest[unpacker.request.Key.ARCHIVE_SIZE] =
         archiveSize.toString();
+    if (opt_partSizes) {
+      readMetadataRequest[unpacker.request.Key.PART_SIZES] =
+          opt_partSizes.map(function(partSize) {
+            return partSize.toString();
+          });
+    }
+    return readMetadataRequest;
+  },
+
+  /**
+   * Creates a read metadata request for an archive stored in an entry of
+   * another archive. The archive is read directly from the other archive,
+   * without extracting it.
+   * @param {!unpacker.types.FileSystemId} fileSystemId
+   * @param {!unpacker.types.RequestId} requestId
+   * @param {string} encoding Default encoding for the archive.
+   * @param {number} archiveSize The size of the entry.
+   * @param {!unpacker.types.FileSystemId} outerFileSystemId The file system id
+   *     of the archive containing the entry.
+   * @param {!unpacker.types.RequestId} outerRequestId The request id used by
+   *     NaCl for reading the chunks of the outer archive.
+   * @param {number} index The index of the entry in the outer archive.
+   * @return {!Object} A read metadata request.
+   */
+  createReadNestedMetadataRequest: function(fileSystemId, requestId, encoding,
+                                            archiveSize, outerFileSystemId,
+                                            outerRequestId, index) {
+    var readMetadataRequest = unpacker.request.createReadMetadataRequest(
+        fileSystemId, requestId, encoding, archiveSize);
+    readMetadataRequest[unpacker.request.Key.OUTER_FILE_SYSTEM_ID] =
+        outerFileSystemId;
+    readMetadataRequest[unpacker.request.Key.OUTER_REQUEST_ID] =
+        outerRequestId.toString();
+    readMetadataRequest[unpacker.request.Key.INDEX] = index.toString();
     return readMetadataRequest;
   },
 
@@ -158,14 +290,17 @@ unpacker.request = {
    * @param {number} readOffset The offset from where buffer starts. This is
    *     required for distinguishing multiple read chunk requests done in
    *     parallel for different offsets.
+   * @param {number} partIndex The part of a split archive the chunk was read
+   *     from, as received in READ_CHUNK.
    * @return {!Object} A read chunk done response.
    */
   createReadChunkDoneResponse: function(fileSystemId, requestId, buffer,
-                                        readOffset) {
+                                        readOffset, partIndex) {
     var response = unpacker.request.createBasic_(
         unpacker.request.Operation.READ_CHUNK_DONE, fileSystemId, requestId);
     response[unpacker.request.Key.CHUNK_BUFFER] = buffer;
     response[unpacker.request.Key.OFFSET] = readOffset.toString();
+    response[unpacker.request.Key.PART_INDEX] = partIndex;
     return response;
   },
 
@@ -175,11 +310,15 @@ unpacker.request = {
    * resources.
    * @param {!unpacker.types.FileSystemId} fileSystemId
    * @param {!unpacker.types.RequestId} requestId
+   * @param {number} partIndex The part of a split archive that couldn't be
+   *     read, as received in READ_CHUNK.
    * @return {!Object} A read chunk error response.
    */
-  createReadChunkErrorResponse: function(fileSystemId, requestId) {
-    return unpacker.request.createBasic_(
+  createReadChunkErrorResponse: function(fileSystemId, requestId, partIndex) {
+    var response = unpacker.request.createBasic_(
         unpacker.request.Operation.READ_CHUNK_ERROR, fileSystemId, requestId);
+    response[unpacker.request.Key.PART_INDEX] = partIndex;
+    return response;
   },
 
   /**
@@ -242,6 +381,166 @@ unpacker.request = {
     return openFileRequest;
   },
 
+  /**
+   * Creates an open file request for a file identified by its path instead of
+   * its index in the header list.
+   * @param {!unpacker.types.FileSystemId} fileSystemId
+   * @param {!unpacker.types.RequestId} requestId
+   * @param {string} path The path of the file inside the archive.
+   * @param {string} encoding Default encoding for the archive.
+   * @param {number} archiveSize The size of the volume's archive.
+   * @return {!Object} An open file by path request.
+   */
+  createOpenFileByPathRequest: function(fileSystemId, requestId, path,
+                                        encoding, archiveSize) {
+    var openFileRequest = unpacker.request.createBasic_(
+        unpacker.request.Operation.OPEN_FILE_BY_PATH, fileSystemId, requestId);
+    openFileRequest[unpacker.request.Key.PATH] = path;
+    openFileRequest[unpacker.request.Key.ENCODING] = encoding;
+    openFileRequest[unpacker.request.Key.ARCHIVE_SIZE] = archiveSize.toString();
+    return openFileRequest;
+  },
+
+  /**
+   * Creates a request for the metadata of a single entry.
+   * @param {!unpacker.types.FileSystemId} fileSystemId
+   * @param {!unpacker.types.RequestId} requestId
+   * @param {string} path The path of the entry inside the archive.
+   * @return {!Object} A stat path request.
+   */
+  createStatPathRequest: function(fileSystemId, requestId, path) {
+    var statPathRequest = unpacker.request.createBasic_(
+        unpacker.request.Operation.STAT_PATH, fileSystemId, requestId);
+    statPathRequest[unpacker.request.Key.PATH] = path;
+    return statPathRequest;
+  },
+
+  /**
+   * Creates a request for the first bytes of many files, read in a single pass
+   * over the archive.
+   * @param {!unpacker.types.FileSystemId} fileSystemId
+   * @param {!unpacker.types.RequestId} requestId
+   * @param {!Array<{index: number, maxBytes: number}>} files The indexes of the
+   *     files in the header list and the maximum number of bytes to read from
+   *     each of them.
+   * @param {string} encoding Default encoding for the archive.
+   * @param {number} archiveSize The size of the volume's archive.
+   * @return {!Object} A read files request.
+   */
+  createReadFilesRequest: function(fileSystemId, requestId, files, encoding,
+                                   archiveSize) {
+    var readFilesRequest = unpacker.request.createBasic_(
+        unpacker.request.Operation.READ_FILES, fileSystemId, requestId);
+    readFilesRequest[unpacker.request.Key.FILES] = files.map(function(file) {
+      var fileToRead = {};
+      fileToRead[unpacker.request.Key.INDEX] = file.index.toString();
+      fileToRead[unpacker.request.Key.LENGTH] = file.maxBytes.toString();
+      return fileToRead;
+    });
+    readFilesRequest[unpacker.request.Key.ENCODING] = encoding;
+    readFilesRequest[unpacker.request.Key.ARCHIVE_SIZE] =
+        archiveSize.toString();
+    return readFilesRequest;
+  },
+
+  /**
+   * Creates a request to search the files of the archive for literal patterns
+   * in a single pass over the archive.
+   * @param {!unpacker.types.FileSystemId} fileSystemId
+   * @param {!unpacker.types.RequestId} requestId
+   * @param {!Array<string>} patterns The patterns to search for.
+   * @param {string} encoding Default encoding for the archive.
+   * @param {number} archiveSize The size of the volume's archive.
+   * @param {number=} opt_maxHits The search stops after this many hits. No
+   *     limit if not set.
+   * @return {!Object} A search request.
+   */
+  createSearchRequest: function(fileSystemId, requestId, patterns, encoding,
+                                archiveSize, opt_maxHits) {
+    var searchRequest = unpacker.request.createBasic_(
+        unpacker.request.Operation.SEARCH, fileSystemId, requestId);
+    searchRequest[unpacker.request.Key.PATTERNS] = patterns;
+    searchRequest[unpacker.request.Key.ENCODING] = encoding;
+    searchRequest[unpacker.request.Key.ARCHIVE_SIZE] = archiveSize.toString();
+    if (opt_maxHits)
+      searchRequest[unpacker.request.Key.MAX_HITS] = opt_maxHits.toString();
+    return searchRequest;
+  },
+
+  /**
+   * Creates a request for the digests of files of the archive, computed in a
+   * single pass over the archive.
+   * @param {!unpacker.types.FileSystemId} fileSystemId
+   * @param {!unpacker.types.RequestId} requestId
+   * @param {!Array<number>} indexes The indexes of the files in the header
+   *     list.
+   * @param {string} algorithm One of 'sha256', 'crc32c' and 'blake3'.
+   * @param {string} encoding Default encoding for the archive.
+   * @param {number} archiveSize The size of the volume's archive.
+   * @return {!Object} A hash entries request.
+   */
+  createHashEntriesRequest: function(fileSystemId, requestId, indexes,
+                                     algorithm, encoding, archiveSize) {
+    var hashEntriesRequest = unpacker.request.createBasic_(
+        unpacker.request.Operation.HASH_ENTRIES, fileSystemId, requestId);
+    hashEntriesRequest[unpacker.request.Key.INDEXES] =
+        indexes.map(function(index) {
+          return index.toString();
+        });
+    hashEntriesRequest[unpacker.request.Key.ALGORITHM] = algorithm;
+    hashEntriesRequest[unpacker.request.Key.ENCODING] = encoding;
+    hashEntriesRequest[unpacker.request.Key.ARCHIVE_SIZE] =
+        archiveSize.toString();
+    return hashEntriesRequest;
+  },
+
+  /**
+   * Creates a request for the counters and histograms of all the volumes and
+   * compressors.
+   * @param {number} requestId
+   * @return {!Object} A get stats request.
+   */
+  createGetStatsRequest: function(requestId) {
+    var getStatsRequest = {};
+    getStatsRequest[unpacker.request.Key.OPERATION] =
+        unpacker.request.Operation.GET_STATS;
+    getStatsRequest[unpacker.request.Key.REQUEST_ID] = requestId.toString();
+    return getStatsRequest;
+  },
+
+  /**
+   * Creates a request to start or stop recording the timeline of the jobs of
+   * the module. Starting drops the events recorded before.
+   * @param {number} requestId
+   * @param {boolean} enabled
+   * @param {number=} opt_capacity The number of events to keep, the most
+   *     recent ones. The module default is used if not provided.
+   * @return {!Object} A set tracing request.
+   */
+  createSetTracingRequest: function(requestId, enabled, opt_capacity) {
+    var setTracingRequest = {};
+    setTracingRequest[unpacker.request.Key.OPERATION] =
+        unpacker.request.Operation.SET_TRACING;
+    setTracingRequest[unpacker.request.Key.REQUEST_ID] = requestId.toString();
+    setTracingRequest[unpacker.request.Key.ENABLED] = enabled;
+    if (opt_capacity)
+      setTracingRequest[unpacker.request.Key.CAPACITY] = opt_capacity;
+    return setTracingRequest;
+  },
+
+  /**
+   * Creates a request for the recorded timeline of the jobs of the module.
+   * @param {number} requestId
+   * @return {!Object} A get trace request.
+   */
+  createGetTraceRequest: function(requestId) {
+    var getTraceRequest = {};
+    getTraceRequest[unpacker.request.Key.OPERATION] =
+        unpacker.request.Operation.GET_TRACE;
+    getTraceRequest[unpacker.request.Key.REQUEST_ID] = requestId.toString();
+    return getTraceRequest;
+  },
+
   /**
    * Creates a close file request.
    * @param {!unpacker.types.FileSystemId} fileSystemId
@@ -280,13 +579,63 @@ unpacker.request = {
   /**
    * Creates a create archive request for compressor.
    * @param {!unpacker.types.CompressorId} compressorId
+   * @param {!unpacker.types.CreateArchiveOptions=} opt_options The options of
+   *     the archive. The NaCl module defaults are used for the missing ones.
    * @return {!Object} A create archive request.
    */
-  createCreateArchiveRequest: function(compressorId) {
+  createCreateArchiveRequest: function(compressorId, opt_options) {
+    var options = opt_options || {};
     var request = {};
     request[unpacker.request.Key.OPERATION] =
         unpacker.request.Operation.CREATE_ARCHIVE;
     request[unpacker.request.Key.COMPRESSOR_ID] = compressorId;
+    if (options.readAheadDepth !== undefined)
+      request[unpacker.request.Key.READ_AHEAD_DEPTH] = options.readAheadDepth;
+    if (options.writeBehindDepth !== undefined)
+      request[unpacker.request.Key.WRITE_BEHIND_DEPTH] =
+          options.writeBehindDepth;
+    if (options.parallel !== undefined)
+      request[unpacker.request.Key.PARALLEL] = options.parallel;
+    if (options.format !== undefined)
+      request[unpacker.request.Key.FORMAT] = options.format;
+    if (options.compressionLevel !== undefined)
+      request[unpacker.request.Key.COMPRESSION_LEVEL] =
+          options.compressionLevel;
+    if (options.threadCount !== undefined)
+      request[unpacker.request.Key.THREAD_COUNT] = options.threadCount;
+    if (options.deduplicate !== undefined)
+      request[unpacker.request.Key.DEDUPLICATE] = options.deduplicate;
+    return request;
+  },
+
+  /**
+   * Creates an append to archive request for compressor, to add entries to an
+   * existing zip archive instead of creating one.
+   * @param {!unpacker.types.CompressorId} compressorId
+   * @param {number} archiveSize The size of the existing archive.
+   * @param {!unpacker.types.CreateArchiveOptions=} opt_options The options of
+   *     the archive. format, parallel and deduplicate are ignored, as the
+   *     entries are appended by the parallel zip writer.
+   * @return {!Object} An append to archive request.
+   */
+  createAppendToArchiveRequest: function(compressorId, archiveSize,
+                                         opt_options) {
+    var options = opt_options || {};
+    var request = {};
+    request[unpacker.request.Key.OPERATION] =
+        unpacker.request.Operation.APPEND_TO_ARCHIVE;
+    request[unpacker.request.Key.COMPRESSOR_ID] = compressorId;
+    request[unpacker.request.Key.ARCHIVE_SIZE] = archiveSize.toString();
+    if (options.readAheadDepth !== undefined)
+      request[unpacker.request.Key.READ_AHEAD_DEPTH] = options.readAheadDepth;
+    if (options.writeBehindDepth !== undefined)
+      request[unpacker.request.Key.WRITE_BEHIND_DEPTH] =
+          options.writeBehindDepth;
+    if (options.compressionLevel !== undefined)
+      request[unpacker.request.Key.COMPRESSION_LEVEL] =
+          options.compressionLevel;
+    if (options.threadCount !== undefined)
+      request[unpacker.request.Key.THREAD_COUNT] = options.threadCount;
     return request;
   },
 
@@ -315,18 +664,67 @@ unpacker.request = {
     return request;
   },
 
+  /**
+   * Creates an add entries to archive request for compressor, to add a batch
+   * of entries in one request.
+   * @param {!unpacker.types.CompressorId} compressorId
+   * @param {!Array<!unpacker.types.ArchiveEntry>} entries
+   * @param {!ArrayBuffer} buffer The data of all the files of entries, one
+   *     after the other in the order of entries.
+   * @return {!Object} An add entries to archive request.
+   */
+  createAddEntriesToArchiveRequest: function(compressorId, entries, buffer) {
+    var request = {};
+    request[unpacker.request.Key.OPERATION] =
+        unpacker.request.Operation.ADD_ENTRIES_TO_ARCHIVE;
+    request[unpacker.request.Key.COMPRESSOR_ID] = compressorId;
+    request[unpacker.request.Key.ENTRIES] = entries.map(function(entry) {
+      var entryRequest = {};
+      entryRequest[unpacker.request.Key.PATHNAME] = entry.pathname.toString();
+      entryRequest[unpacker.request.Key.FILE_SIZE] = entry.fileSize.toString();
+      entryRequest[unpacker.request.Key.MODIFICATION_TIME] =
+          entry.modificationTime.toString();
+      entryRequest[unpacker.request.Key.IS_DIRECTORY] = entry.isDirectory;
+      return entryRequest;
+    });
+    request[unpacker.request.Key.CHUNK_BUFFER] = buffer;
+    return request;
+  },
+
   /**
    * Creates a read file chunk response for compressor.
    * @param {!unpacker.types.CompressorId} compressorId
+   * @param {number} offset The offset of the chunk in the entry, as requested
+   *     by READ_FILE_CHUNK.
    * @param {number} length The number of bytes read from the entry.
    * @param {!ArrayBuffer} buffer A buffer containing the data that was read.
    * @return {!Object} A read file chunk done response.
    */
-  createReadFileChunkDoneResponse: function(compressorId, length, buffer) {
+  createReadFileChunkDoneResponse: function(compressorId, offset, length,
+                                            buffer) {
     var response = {};
     response[unpacker.request.Key.OPERATION] =
         unpacker.request.Operation.READ_FILE_CHUNK_DONE;
     response[unpacker.request.Key.COMPRESSOR_ID] = compressorId;
+    response[unpacker.request.Key.OFFSET] = offset.toString();
+    response[unpacker.request.Key.LENGTH] = length.toString();
+    response[unpacker.request.Key.CHUNK_BUFFER] = buffer;
+    return response;
+  },
+
+  /**
+   * Creates a read archive chunk response for compressor.
+   * @param {!unpacker.types.CompressorId} compressorId
+   * @param {number} length The number of bytes read from the archive, or a
+   *     negative value if reading failed.
+   * @param {!ArrayBuffer} buffer A buffer containing the data that was read.
+   * @return {!Object} A read archive chunk done response.
+   */
+  createReadArchiveChunkDoneResponse: function(compressorId, length, buffer) {
+    var response = {};
+    response[unpacker.request.Key.OPERATION] =
+        unpacker.request.Operation.READ_ARCHIVE_CHUNK_DONE;
+    response[unpacker.request.Key.COMPRESSOR_ID] = compressorId;
     response[unpacker.request.Key.LENGTH] = length.toString();
     response[unpacker.request.Key.CHUNK_BUFFER] = buffer;
     return response;
@@ -78,3 +78,39 @@ unpacker.types.CloseFileRequestedOptions;
  *                    length: number}>}
  */
 unpacker.types.ReadFileRequestedOptions;
+
+/**
+ * The options of a CREATE_ARCHIVE request, all optional.
+ * - readAheadDepth: The number of chunks of an entry to read while the
+ *   previous chunk is compressed. 0 disables reading ahead.
+ * - writeBehindDepth: The number of compressed chunks NaCl can send before
+ *   the previous ones are written. 0 makes NaCl wait for every chunk.
+ * - parallel: Whether to deflate the entries of zip archives in parallel on
+ *   the NaCl worker threads instead of with libarchive.
+ * - format: The format of the archive, zip-deflate by default.
+ * - compressionLevel: The level of the compression of the format.
+ * - threadCount: The number of threads deflating the entries in parallel.
+ * - deduplicate: Whether to write the files of tar archives identical to a
+ *   previous file as hard links to it.
+ * @typedef {!Object<{readAheadDepth: (number|undefined),
+ *                    writeBehindDepth: (number|undefined),
+ *                    parallel: (boolean|undefined),
+ *                    format: (!unpacker.request.Format|undefined),
+ *                    compressionLevel: (number|undefined),
+ *                    threadCount: (number|undefined),
+                    deduplicate: (boolean|undefined)}>}
+ */
+unpacker.types.CreateArchiveOptions;
+
+/**
+ * An entry of an ADD_ENTRIES_TO_ARCHIVE request.
+ * - pathname: The relative path of the entry.
+ * - fileSize: The size of the entry.
+ * - modificationTime: The modification time of the entry.
+ * - isDirectory: Whether the entry is a directory or not.
+ * @typedef {!Object<{pathname: string,
+ *                    fileSize: number,
+ *                    modificationTime: string,
+ *                    isDirectory: boolean}>}
+ */
+unpacker.types.ArchiveEntry;